@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+#include "cabbage/CabbageClient.h"
+#include "cabbage/MovieCache.h"
+#include "cabbage/common/util.h"
+#include "cabbage/common/histogram.h"
+
+// Benchmark da libcabbage-client: um processo só, com -t threads da aplicação dividindo um CabbageClient de -c
+// conexões. Cada thread mantém até -w requisições em andamento (GET_MOVIE de filmes pré-carregados, ou a operação
+// de -x) e a resposta é contada no callback. Comparar com o cabbage-bench (uma requisição por vez por conexão) mostra
+// quanto o pipelining ganha.
+//
+// Com -k, os GET_MOVIE passam pelo MovieCache (uma chamada síncrona por vez em cada thread) e -m mistura ADD_GENRE
+// nos mesmos filmes, para ver o hit rate e quantas respostas do cache ficaram desatualizadas.
+//
+// Com -x getmany, cada requisição é um GET_MOVIES de -g filmes aleatórios, para comparar com o mesmo número de
+// GET_MOVIEs.
+
+#define DEFAULT_PORT 12345
+#define DEFAULT_CONNECTIONS 4
+#define DEFAULT_THREADS 4
+#define DEFAULT_WINDOW 64
+#define DEFAULT_DURATION_S 10
+#define DEFAULT_PRELOAD 1000
+#define DEFAULT_GET_MANY 100
+
+typedef enum {
+    OP_GET,
+    OP_LIST,
+    OP_ADD_GENRE,
+    OP_GET_MANY,
+} op_t;
+
+typedef struct Worker Worker;
+
+typedef struct {
+    Worker* worker;
+    u64 start_ns;
+} Slot;
+
+struct Worker {
+    pthread_t thread;
+    int index;
+    u64 seed;
+    sem_t window;
+    Slot* slots;
+    int* free_slots; // pilha de slots livres, protegida pelo mutex
+    int free_count;
+    pthread_mutex_t mutex;
+    u64 counter;
+};
+
+static struct {
+    CabbageClientConfig client;
+    int threads;
+    int window;
+    double duration_s;
+    size_t preload;
+    op_t op;
+    MovieCacheConfig cache;
+    int use_cache;
+    int write_percent;
+    int get_many;
+} config;
+
+static CabbageClient* client;
+static MovieCache* cache;
+static u32* preloaded_ids;
+static size_t preloaded_count;
+// Mesmo histograma do cabbage-bench, mas com contadores atômicos: os callbacks rodam nas threads de I/O.
+static atomic_ullong buckets[HIST_BUCKETS];
+static atomic_ullong completed;
+static atomic_ullong errors;
+static atomic_ullong failures;
+static atomic_ullong max_latency;
+static u64 bench_end_ns;
+
+static void release_slot(Worker* worker, int slot) {
+    pthread_mutex_lock(&worker->mutex);
+    worker->free_slots[worker->free_count++] = slot;
+    pthread_mutex_unlock(&worker->mutex);
+    sem_post(&worker->window);
+}
+
+static void record_latency(u64 latency) {
+    atomic_fetch_add_explicit(&buckets[hist_bucket_index(latency)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&completed, 1, memory_order_relaxed);
+    u64 seen = atomic_load_explicit(&max_latency, memory_order_relaxed);
+    while (latency > seen && !atomic_compare_exchange_weak(&max_latency, &seen, latency)) {}
+}
+
+static void on_response(void* arg, int status, S2CPacket* response) {
+    Slot* slot = arg;
+    Worker* worker = slot->worker;
+    if (status == 0) {
+        record_latency(now_ns() - slot->start_ns);
+        if (response->type == S2C_ERROR) atomic_fetch_add_explicit(&errors, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&failures, 1, memory_order_relaxed);
+    }
+    release_slot(worker, (int)(slot - worker->slots));
+}
+
+// Com o cache as chamadas são síncronas: a janela de -w não vale aqui.
+static void* cached_worker_main(void* arg) {
+    Worker* worker = arg;
+    char text[64];
+    while (now_ns() < bench_end_ns) {
+        u32 id = preloaded_count ? preloaded_ids[next_random(&worker->seed) % preloaded_count] : 1;
+        u64 start = now_ns();
+        S2CPacket response;
+        int result;
+        if ((int)(next_random(&worker->seed) % 100) < config.write_percent) {
+            snprintf(text, sizeof(text), "G%d-%llu", worker->index, (unsigned long long)worker->counter++);
+            C2SPacket request = {.type = C2S_ADD_GENRE_TO_MOVIE};
+            request.data.add_genre.movie_id = id;
+            request.data.add_genre.genre = text;
+            result = CabbageClient_call(client, &request, &response);
+        } else {
+            result = MovieCache_get(cache, id, &response);
+        }
+        if (result < 0) {
+            atomic_fetch_add_explicit(&failures, 1, memory_order_relaxed);
+            if (CabbageClient_connected(client) == 0) usleep(10000);
+            continue;
+        }
+        record_latency(now_ns() - start);
+        if (response.type == S2C_ERROR) atomic_fetch_add_explicit(&errors, 1, memory_order_relaxed);
+        S2CPacket_free(&response);
+    }
+    return NULL;
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    char text[64];
+    u32 ids[GET_MOVIES_MAX_IDS];
+    while (now_ns() < bench_end_ns) {
+        sem_wait(&worker->window);
+        pthread_mutex_lock(&worker->mutex);
+        int index = worker->free_slots[--worker->free_count];
+        pthread_mutex_unlock(&worker->mutex);
+
+        C2SPacket request;
+        memset(&request, 0, sizeof(request));
+        u32 id = preloaded_count ? preloaded_ids[next_random(&worker->seed) % preloaded_count] : 1;
+        switch (config.op) {
+        case OP_GET:
+            request.type = C2S_GET_MOVIE;
+            request.data.get_movie.movie_id = id;
+            break;
+        case OP_LIST:
+            request.type = C2S_LIST_MOVIES;
+            break;
+        case OP_ADD_GENRE:
+            snprintf(text, sizeof(text), "G%d-%llu", worker->index, (unsigned long long)worker->counter++);
+            request.type = C2S_ADD_GENRE_TO_MOVIE;
+            request.data.add_genre.movie_id = id;
+            request.data.add_genre.genre = text;
+            break;
+        case OP_GET_MANY:
+            // O submit serializa a requisição na hora, então os IDs podem ficar na pilha.
+            ids[0] = id;
+            for (int i = 1; i < config.get_many; ++i) {
+                ids[i] = preloaded_count ? preloaded_ids[next_random(&worker->seed) % preloaded_count] : 1;
+            }
+            request.type = C2S_GET_MOVIES;
+            request.data.get_movies.count = (u32)config.get_many;
+            request.data.get_movies.movie_ids = ids;
+            break;
+        }
+
+        Slot* slot = &worker->slots[index];
+        slot->start_ns = now_ns();
+        if (CabbageClient_submit(client, &request, on_response, slot) < 0) {
+            atomic_fetch_add_explicit(&failures, 1, memory_order_relaxed);
+            release_slot(worker, index);
+            if (CabbageClient_connected(client) == 0) usleep(10000);
+        }
+    }
+    // Espera as respostas que faltam.
+    for (int i = 0; i < config.window; ++i) sem_wait(&worker->window);
+    return NULL;
+}
+
+static int preload(size_t count) {
+    preloaded_ids = malloc(count * sizeof(u32));
+    if (count && !preloaded_ids) return -1;
+    for (size_t i = 0; i < count; ++i) {
+        char title[64];
+        snprintf(title, sizeof(title), "Preload %zu", i);
+        C2SPacket request = {.type = C2S_ADD_MOVIE};
+        request.data.add_movie.title = title;
+        request.data.add_movie.genres = "Drama";
+        request.data.add_movie.director = "Bench Director";
+        request.data.add_movie.release_year = "2024";
+        S2CPacket response;
+        if (CabbageClient_call(client, &request, &response) < 0) return -1;
+        if (response.type == S2C_MOVIE) preloaded_ids[preloaded_count++] = response.data.movie.id;
+        S2CPacket_free(&response);
+    }
+    return 0;
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] [host] [port]\n", program);
+    fprintf(stderr, "  -c <connections>  connections in the pool (default: %d)\n", DEFAULT_CONNECTIONS);
+    fprintf(stderr, "  -i <threads>      I/O threads (default: 1)\n");
+    fprintf(stderr, "  -t <threads>      application threads (default: %d)\n", DEFAULT_THREADS);
+    fprintf(stderr, "  -w <requests>     requests in flight per application thread (default: %d)\n", DEFAULT_WINDOW);
+    fprintf(stderr, "  -d <seconds>      duration (default: %d)\n", DEFAULT_DURATION_S);
+    fprintf(stderr, "  -p <movies>       movies added before the run (default: %d)\n", DEFAULT_PRELOAD);
+    fprintf(stderr, "  -x get|list|addgenre|getmany  operation (default: get)\n");
+    fprintf(stderr, "  -g <ids>          movie IDs per GET_MOVIES with -x getmany (default: %d)\n", DEFAULT_GET_MANY);
+    fprintf(stderr, "  -k <MB>           GET_MOVIE through a MovieCache of this size\n");
+    fprintf(stderr, "  -u <ms>           cache polling interval, 0 disables (default: %d)\n", config.cache.poll_ms);
+    fprintf(stderr, "  -a <ms>           cache entry max age before revalidation, 0 disables (default: 0)\n");
+    fprintf(stderr, "  -m <percent>      with -k, percentage of ADD_GENRE mixed in (default: 0)\n");
+}
+
+int main(int argc, char* argv[]) {
+    CabbageClient_default_config(&config.client);
+    config.client.port = DEFAULT_PORT;
+    config.client.connections = DEFAULT_CONNECTIONS;
+    config.threads = DEFAULT_THREADS;
+    config.window = DEFAULT_WINDOW;
+    config.duration_s = DEFAULT_DURATION_S;
+    config.preload = DEFAULT_PRELOAD;
+    config.op = OP_GET;
+    config.get_many = DEFAULT_GET_MANY;
+    MovieCache_default_config(&config.cache);
+
+    int c;
+    while ((c = getopt(argc, argv, "c:i:t:w:d:p:x:k:u:a:m:g:h")) != -1) {
+        switch (c) {
+        case 'c': config.client.connections = atoi(optarg); break;
+        case 'i': config.client.io_threads = atoi(optarg); break;
+        case 't': config.threads = atoi(optarg); break;
+        case 'w': config.window = atoi(optarg); break;
+        case 'd': config.duration_s = strtod(optarg, NULL); break;
+        case 'p': config.preload = strtoull(optarg, NULL, 10); break;
+        case 'x':
+            if (strcmp(optarg, "get") == 0) config.op = OP_GET;
+            else if (strcmp(optarg, "list") == 0) config.op = OP_LIST;
+            else if (strcmp(optarg, "addgenre") == 0) config.op = OP_ADD_GENRE;
+            else if (strcmp(optarg, "getmany") == 0) config.op = OP_GET_MANY;
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'k':
+            config.use_cache = 1;
+            config.cache.max_bytes = (size_t)(strtod(optarg, NULL) * 1024 * 1024);
+            break;
+        case 'u': config.cache.poll_ms = atoi(optarg); break;
+        case 'a': config.cache.max_age_ms = atoi(optarg); break;
+        case 'm': config.write_percent = atoi(optarg); break;
+        case 'g': config.get_many = atoi(optarg); break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc) config.client.host = argv[optind++];
+    if (optind < argc) config.client.port = atoi(argv[optind++]);
+    if (config.threads < 1 || config.window < 1 || config.duration_s <= 0 || (config.use_cache && config.op != OP_GET) ||
+        config.get_many < 1 || config.get_many > GET_MOVIES_MAX_IDS) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    client = CabbageClient_create(&config.client);
+    if (!client) {
+        fprintf(stderr, "Could not connect to %s:%d: %s\n", config.client.host, config.client.port, strerror(errno));
+        return 1;
+    }
+    printf("Preloading %zu movies...\n", config.preload);
+    if (preload(config.preload) < 0) {
+        fprintf(stderr, "Failed to preload movies\n");
+        return 1;
+    }
+
+    if (config.use_cache) {
+        cache = MovieCache_create(client, &config.cache);
+        if (!cache) {
+            fprintf(stderr, "Failed to create the cache: %s\n", strerror(errno));
+            return 1;
+        }
+        printf("Cache: %.1f MB, polling every %d ms, max age %d ms, %d%% ADD_GENRE\n",
+               config.cache.max_bytes / (1024.0 * 1024.0), config.cache.poll_ms, config.cache.max_age_ms,
+               config.write_percent);
+    }
+
+    printf("Running %d threads x %d in flight over %d connections (%d I/O threads) for %.1f s...\n", config.threads,
+           config.window, config.client.connections, config.client.io_threads, config.duration_s);
+    Worker* workers = calloc((size_t)config.threads, sizeof(Worker));
+    if (!workers) return 1;
+    u64 start = now_ns();
+    bench_end_ns = start + (u64)(config.duration_s * 1e9);
+    for (int i = 0; i < config.threads; ++i) {
+        Worker* worker = &workers[i];
+        worker->index = i;
+        worker->seed = 0x9e3779b97f4a7c15ull * (u64)(i + 1);
+        worker->slots = calloc((size_t)config.window, sizeof(Slot));
+        worker->free_slots = calloc((size_t)config.window, sizeof(int));
+        if (!worker->slots || !worker->free_slots) return 1;
+        for (int s = 0; s < config.window; ++s) {
+            worker->slots[s].worker = worker;
+            worker->free_slots[s] = s;
+        }
+        worker->free_count = config.window;
+        pthread_mutex_init(&worker->mutex, NULL);
+        sem_init(&worker->window, 0, (unsigned)config.window);
+        if (pthread_create(&worker->thread, NULL, cache ? cached_worker_main : worker_main, worker) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    for (int i = 0; i < config.threads; ++i) pthread_join(workers[i].thread, NULL);
+    double elapsed = (double)(now_ns() - start) / 1e9;
+
+    u64 total = atomic_load(&completed);
+    u64 max = atomic_load(&max_latency);
+    static u64 counts[HIST_BUCKETS];
+    for (unsigned i = 0; i < HIST_BUCKETS; ++i) counts[i] = atomic_load(&buckets[i]);
+    printf("%10s %8s %8s %12s %10s %10s %10s %10s\n", "requests", "errors", "failed", "req/s", "p50_us", "p99_us",
+           "p999_us", "max_us");
+    printf("%10llu %8llu %8llu %12.0f %10.1f %10.1f %10.1f %10.1f\n", (unsigned long long)total,
+           (unsigned long long)atomic_load(&errors), (unsigned long long)atomic_load(&failures), total / elapsed,
+           hist_percentile(counts, total, max, 50.0) / 1e3, hist_percentile(counts, total, max, 99.0) / 1e3,
+           hist_percentile(counts, total, max, 99.9) / 1e3, max / 1e3);
+    if (config.op == OP_GET_MANY) {
+        printf("%d IDs per request: %.0f movies/s\n", config.get_many, (double)total * config.get_many / elapsed);
+    }
+
+    if (cache) {
+        MovieCacheStats stats;
+        MovieCache_stats(cache, &stats);
+        u64 lookups = stats.hits + stats.misses;
+        printf("Cache: %.1f%% hits (%llu hits, %llu misses, %llu negative), %llu entries, %.1f MB, %llu evictions\n",
+               lookups ? 100.0 * (double)stats.hits / (double)lookups : 0.0, (unsigned long long)stats.hits,
+               (unsigned long long)stats.misses, (unsigned long long)stats.negative_hits,
+               (unsigned long long)stats.entries, stats.bytes / (1024.0 * 1024.0), (unsigned long long)stats.evictions);
+        printf("Staleness: %llu stale entries, %llu stale hits (%.2f%% of the hits), %llu revalidations "
+               "(%llu not modified)\n",
+               (unsigned long long)stats.stale_entries, (unsigned long long)stats.stale_hits,
+               stats.hits ? 100.0 * (double)stats.stale_hits / (double)stats.hits : 0.0,
+               (unsigned long long)stats.revalidations, (unsigned long long)stats.not_modified);
+        printf("Polling: %llu polls, %llu errors, %llu full resyncs, max gap %llu ms, last %llu ms ago\n",
+               (unsigned long long)stats.polls, (unsigned long long)stats.poll_errors,
+               (unsigned long long)stats.full_resyncs, (unsigned long long)stats.max_sync_gap_ms,
+               (unsigned long long)stats.sync_age_ms);
+        MovieCache_destroy(cache);
+    }
+    CabbageClient_destroy(client);
+    for (int i = 0; i < config.threads; ++i) {
+        sem_destroy(&workers[i].window);
+        pthread_mutex_destroy(&workers[i].mutex);
+        free(workers[i].slots);
+        free(workers[i].free_slots);
+    }
+    free(workers);
+    free(preloaded_ids);
+    return 0;
+}
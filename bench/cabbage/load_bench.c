@@ -0,0 +1,481 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "cabbage/common/Packet.h"
+#include "cabbage/common/util.h"
+#include "cabbage/common/histogram.h"
+
+// Gerador de carga: abre N conexões com o servidor, cada uma em uma thread, e envia uma mistura de operações por
+// um tempo fixo, medindo a latência de cada requisição.
+//
+// Sem -r, cada conexão manda a próxima requisição assim que recebe a resposta (vazão máxima). Com -r, as
+// requisições seguem uma agenda fixa (open loop) e a latência é medida a partir do horário agendado, não do envio:
+// se o servidor atrasa, as requisições que deveriam ter saído nesse tempo também contam o atraso (sem "coordinated
+// omission").
+
+#define DEFAULT_PORT 12345
+#define DEFAULT_CONNECTIONS 8
+#define DEFAULT_DURATION_S 10
+#define DEFAULT_PRELOAD 1000
+#define GENRE_POOL 20
+
+typedef enum {
+    OP_ADD,
+    OP_GET,
+    OP_ADD_GENRE,
+    OP_REMOVE,
+    OP_LIST,
+    OP_LIST_BY_GENRE,
+    OP_COUNT
+} op_t;
+
+static const char* op_names[OP_COUNT] = {"add", "get", "addgenre", "remove", "list", "listgenre"};
+
+typedef struct {
+    u64 buckets[HIST_BUCKETS];
+    u64 count;
+    u64 max;
+    u64 sum;
+} Histogram;
+
+typedef struct {
+    Histogram latency;
+    u64 errors;
+} OpResult;
+
+typedef struct {
+    pthread_t thread;
+    int index;
+    int fd;
+    u64 seed;
+    u32* own_ids; // filmes adicionados por esta conexão, candidatos para o remove
+    size_t own_count;
+    size_t own_capacity;
+    OpResult ops[OP_COUNT];
+    int failed;
+} Worker;
+
+static struct {
+    const char* host;
+    int port;
+    int connections;
+    double duration_s;
+    double rate; // requisições por segundo no total, 0 = vazão máxima
+    unsigned mix[OP_COUNT];
+    unsigned mix_total;
+    size_t preload;
+    const char* json_path;
+} config;
+
+static u32* preloaded_ids = NULL;
+static size_t preloaded_count = 0;
+
+static void histogram_record(Histogram* histogram, u64 value) {
+    histogram->buckets[hist_bucket_index(value)]++;
+    histogram->count++;
+    histogram->sum += value;
+    if (value > histogram->max) histogram->max = value;
+}
+
+static void histogram_merge(Histogram* dst, const Histogram* src) {
+    for (unsigned i = 0; i < HIST_BUCKETS; ++i) dst->buckets[i] += src->buckets[i];
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+static u64 histogram_percentile(const Histogram* histogram, double percentile) {
+    return hist_percentile(histogram->buckets, histogram->count, histogram->max, percentile);
+}
+
+static int connect_server(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)config.port);
+    if (inet_pton(AF_INET, config.host, &address.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid address: %s\n", config.host);
+        close(fd);
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// Envia uma requisição e espera a resposta. Retorna -1 se a conexão falhar; *error indica um S2C_ERROR.
+static int round_trip(int fd, const C2SPacket* request, S2CPacket* response, int* error) {
+    if (C2SPacket_send(fd, request) < 0) return -1;
+    if (S2CPacket_recv(fd, response) < 0) return -1;
+    *error = response->type == S2C_ERROR;
+    return 0;
+}
+
+static int add_movie(Worker* worker, char* title, u32* id, int* error) {
+    char genres[64];
+    snprintf(genres, sizeof(genres), "Genre%d", (int)(next_random(&worker->seed) % GENRE_POOL));
+    C2SPacket request = {.type = C2S_ADD_MOVIE};
+    request.data.add_movie.title = title;
+    request.data.add_movie.genres = genres;
+    request.data.add_movie.director = "Bench Director";
+    request.data.add_movie.release_year = "2024";
+    S2CPacket response;
+    if (round_trip(worker->fd, &request, &response, error) < 0) return -1;
+    if (!*error && response.type == S2C_MOVIE) *id = response.data.movie.id;
+    S2CPacket_free(&response);
+    return 0;
+}
+
+static u32 pick_id(Worker* worker) {
+    size_t total = preloaded_count + worker->own_count;
+    if (total == 0) return 1;
+    size_t pick = next_random(&worker->seed) % total;
+    return pick < preloaded_count ? preloaded_ids[pick] : worker->own_ids[pick - preloaded_count];
+}
+
+static void remember_id(Worker* worker, u32 id) {
+    if (worker->own_count == worker->own_capacity) {
+        size_t capacity = worker->own_capacity ? worker->own_capacity * 2 : 256;
+        u32* ids = realloc(worker->own_ids, capacity * sizeof(u32));
+        if (!ids) return;
+        worker->own_ids = ids;
+        worker->own_capacity = capacity;
+    }
+    worker->own_ids[worker->own_count++] = id;
+}
+
+static op_t pick_op(Worker* worker) {
+    unsigned roll = (unsigned)(next_random(&worker->seed) % config.mix_total);
+    for (int op = 0; op < OP_COUNT; ++op) {
+        if (roll < config.mix[op]) return (op_t)op;
+        roll -= config.mix[op];
+    }
+    return OP_GET;
+}
+
+static int run_op(Worker* worker, op_t op, u64* counter, int* error) {
+    C2SPacket request;
+    memset(&request, 0, sizeof(request));
+    S2CPacket response;
+    char text[64];
+
+    switch (op) {
+    case OP_ADD: {
+        snprintf(text, sizeof(text), "Bench %d-%llu", worker->index, (unsigned long long)(*counter)++);
+        u32 id = 0;
+        if (add_movie(worker, text, &id, error) < 0) return -1;
+        if (id) remember_id(worker, id);
+        return 0;
+    }
+    case OP_GET:
+        request.type = C2S_GET_MOVIE;
+        request.data.get_movie.movie_id = pick_id(worker);
+        break;
+    case OP_ADD_GENRE:
+        // Gêneros novos a cada chamada, senão quase todas as requisições voltam "Genre already exists".
+        snprintf(text, sizeof(text), "G%d-%llu", worker->index, (unsigned long long)(*counter)++);
+        request.type = C2S_ADD_GENRE_TO_MOVIE;
+        request.data.add_genre.movie_id = pick_id(worker);
+        request.data.add_genre.genre = text;
+        break;
+    case OP_REMOVE:
+        // Só remove os próprios filmes, os pré-carregados ficam para os gets das outras conexões.
+        request.type = C2S_REMOVE_MOVIE;
+        if (worker->own_count > 0) {
+            size_t victim = next_random(&worker->seed) % worker->own_count;
+            request.data.remove_movie.movie_id = worker->own_ids[victim];
+            worker->own_ids[victim] = worker->own_ids[--worker->own_count];
+        } else {
+            request.data.remove_movie.movie_id = 0;
+        }
+        break;
+    case OP_LIST:
+        request.type = C2S_LIST_MOVIES;
+        break;
+    case OP_LIST_BY_GENRE:
+        snprintf(text, sizeof(text), "Genre%d", (int)(next_random(&worker->seed) % GENRE_POOL));
+        request.type = C2S_LIST_MOVIES_BY_GENRE;
+        request.data.list_by_genre.genre = text;
+        break;
+    default:
+        return 0;
+    }
+
+    if (round_trip(worker->fd, &request, &response, error) < 0) return -1;
+    S2CPacket_free(&response);
+    return 0;
+}
+
+static void sleep_until(u64 deadline_ns) {
+    struct timespec ts = {.tv_sec = (time_t)(deadline_ns / 1000000000ull), .tv_nsec = (long)(deadline_ns % 1000000000ull)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+}
+
+static u64 bench_start_ns;
+static u64 bench_end_ns;
+
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    u64 counter = 0;
+    // Cada conexão tem sua parte da taxa, com a agenda deslocada para as conexões não enviarem juntas.
+    u64 interval_ns = config.rate > 0 ? (u64)(1e9 * config.connections / config.rate) : 0;
+    u64 scheduled = bench_start_ns + (interval_ns * (u64)worker->index) / (u64)config.connections;
+
+    while (1) {
+        u64 start;
+        if (interval_ns) {
+            if (scheduled >= bench_end_ns) break;
+            sleep_until(scheduled);
+            start = scheduled;
+            scheduled += interval_ns;
+        } else {
+            start = now_ns();
+            if (start >= bench_end_ns) break;
+        }
+
+        op_t op = pick_op(worker);
+        int error = 0;
+        if (run_op(worker, op, &counter, &error) < 0) {
+            fprintf(stderr, "Connection %d: %s failed: %s\n", worker->index, op_names[op], strerror(errno));
+            worker->failed = 1;
+            break;
+        }
+        histogram_record(&worker->ops[op].latency, now_ns() - start);
+        if (error) worker->ops[op].errors++;
+    }
+    return NULL;
+}
+
+// Adiciona 'count' filmes antes da medição, para gets e addgenres terem alvos.
+static int preload(size_t count) {
+    if (count == 0) return 0;
+    Worker loader = {.index = -1, .seed = 7};
+    loader.fd = connect_server();
+    if (loader.fd < 0) return -1;
+    preloaded_ids = malloc(count * sizeof(u32));
+    if (!preloaded_ids) {
+        close(loader.fd);
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        char title[64];
+        snprintf(title, sizeof(title), "Preload %zu", i);
+        u32 id = 0;
+        int error = 0;
+        if (add_movie(&loader, title, &id, &error) < 0) {
+            close(loader.fd);
+            return -1;
+        }
+        if (id) preloaded_ids[preloaded_count++] = id;
+    }
+    close(loader.fd);
+    return 0;
+}
+
+static int parse_mix(const char* text) {
+    memset(config.mix, 0, sizeof(config.mix));
+    config.mix_total = 0;
+    char* copy = strdup(text);
+    if (!copy) return -1;
+    char* save = NULL;
+    for (char* item = strtok_r(copy, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char* equals = strchr(item, '=');
+        if (!equals) {
+            free(copy);
+            return -1;
+        }
+        *equals = '\0';
+        int op;
+        for (op = 0; op < OP_COUNT; ++op) {
+            if (strcmp(item, op_names[op]) == 0) break;
+        }
+        if (op == OP_COUNT) {
+            free(copy);
+            return -1;
+        }
+        config.mix[op] = (unsigned)strtoul(equals + 1, NULL, 10);
+        config.mix_total += config.mix[op];
+    }
+    free(copy);
+    return config.mix_total > 0 ? 0 : -1;
+}
+
+static void print_row(FILE* out, const char* name, const OpResult* result, double elapsed) {
+    const Histogram* h = &result->latency;
+    fprintf(out, "%-10s %10llu %8llu %10.0f %10.1f %10.1f %10.1f %10.1f\n", name, (unsigned long long)h->count,
+            (unsigned long long)result->errors, h->count / elapsed, histogram_percentile(h, 50.0) / 1e3,
+            histogram_percentile(h, 99.0) / 1e3, histogram_percentile(h, 99.9) / 1e3, h->max / 1e3);
+}
+
+static void write_json_op(FILE* out, const char* name, const OpResult* result, double elapsed) {
+    const Histogram* h = &result->latency;
+    fprintf(out, "\"%s\": {\"requests\": %llu, \"errors\": %llu, \"throughput\": %.1f, \"mean_us\": %.1f, "
+            "\"p50_us\": %.1f, \"p99_us\": %.1f, \"p999_us\": %.1f, \"max_us\": %.1f}",
+            name, (unsigned long long)h->count, (unsigned long long)result->errors, h->count / elapsed,
+            h->count ? (double)h->sum / (double)h->count / 1e3 : 0.0, histogram_percentile(h, 50.0) / 1e3,
+            histogram_percentile(h, 99.0) / 1e3, histogram_percentile(h, 99.9) / 1e3, h->max / 1e3);
+}
+
+static int write_json(const char* path, OpResult* totals, OpResult* all, double elapsed) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        perror("fopen");
+        return -1;
+    }
+    fputs("{\n  \"host\": ", out);
+    json_write_string(out, config.host);
+    fprintf(out, ", \"port\": %d, \"connections\": %d, \"duration_s\": %.3f,\n", config.port, config.connections,
+            elapsed);
+    fprintf(out, "  \"mode\": \"%s\", \"target_rate\": %.1f, \"preload\": %zu,\n",
+            config.rate > 0 ? "open" : "closed", config.rate, config.preload);
+    fprintf(out, "  \"mix\": {");
+    for (int op = 0, first = 1; op < OP_COUNT; ++op) {
+        if (!config.mix[op]) continue;
+        fprintf(out, "%s\"%s\": %u", first ? "" : ", ", op_names[op], config.mix[op]);
+        first = 0;
+    }
+    fprintf(out, "},\n  ");
+    write_json_op(out, "total", all, elapsed);
+    fprintf(out, ",\n  \"ops\": {\n");
+    for (int op = 0, first = 1; op < OP_COUNT; ++op) {
+        if (totals[op].latency.count == 0) continue;
+        fprintf(out, "%s    ", first ? "" : ",\n");
+        write_json_op(out, op_names[op], &totals[op], elapsed);
+        first = 0;
+    }
+    fprintf(out, "\n  }\n}\n");
+    return fclose(out);
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] [host] [port]\n", program);
+    fprintf(stderr, "  -c <connections>  concurrent connections (default: %d)\n", DEFAULT_CONNECTIONS);
+    fprintf(stderr, "  -d <seconds>      duration (default: %d)\n", DEFAULT_DURATION_S);
+    fprintf(stderr, "  -r <requests/s>   total request rate, open loop (default: as fast as possible)\n");
+    fprintf(stderr, "  -x <mix>          operation weights, e.g. add=10,get=60,addgenre=10,remove=5,list=5,listgenre=10\n");
+    fprintf(stderr, "  -p <movies>       movies added before the run (default: %d)\n", DEFAULT_PRELOAD);
+    fprintf(stderr, "  -o <file>         write the results as JSON\n");
+}
+
+int main(int argc, char* argv[]) {
+    config.host = "127.0.0.1";
+    config.port = DEFAULT_PORT;
+    config.connections = DEFAULT_CONNECTIONS;
+    config.duration_s = DEFAULT_DURATION_S;
+    config.preload = DEFAULT_PRELOAD;
+    parse_mix("add=10,get=60,addgenre=10,remove=5,list=5,listgenre=10");
+
+    int c;
+    while ((c = getopt(argc, argv, "c:d:r:x:p:o:h")) != -1) {
+        switch (c) {
+        case 'c': config.connections = atoi(optarg); break;
+        case 'd': config.duration_s = strtod(optarg, NULL); break;
+        case 'r': config.rate = strtod(optarg, NULL); break;
+        case 'p': config.preload = strtoull(optarg, NULL, 10); break;
+        case 'o': config.json_path = optarg; break;
+        case 'x':
+            if (parse_mix(optarg) < 0) {
+                fprintf(stderr, "Invalid operation mix: %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc) config.host = argv[optind++];
+    if (optind < argc) config.port = atoi(argv[optind++]);
+    if (config.connections <= 0 || config.duration_s <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    printf("Preloading %zu movies...\n", config.preload);
+    if (preload(config.preload) < 0) {
+        fprintf(stderr, "Failed to preload movies\n");
+        return 1;
+    }
+
+    Worker* workers = calloc((size_t)config.connections, sizeof(Worker));
+    if (!workers) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < config.connections; ++i) {
+        workers[i].index = i;
+        workers[i].seed = 0x9e3779b97f4a7c15ull * (u64)(i + 1);
+        workers[i].fd = connect_server();
+        if (workers[i].fd < 0) return 1;
+    }
+
+    if (config.rate > 0) {
+        printf("Running %d connections for %.1f s at %.0f requests/s (open loop)...\n",
+               config.connections, config.duration_s, config.rate);
+    } else {
+        printf("Running %d connections for %.1f s as fast as possible...\n", config.connections, config.duration_s);
+    }
+    bench_start_ns = now_ns();
+    bench_end_ns = bench_start_ns + (u64)(config.duration_s * 1e9);
+    for (int i = 0; i < config.connections; ++i) {
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    int failed = 0;
+    for (int i = 0; i < config.connections; ++i) {
+        pthread_join(workers[i].thread, NULL);
+        failed |= workers[i].failed;
+        close(workers[i].fd);
+    }
+    double elapsed = (double)(now_ns() - bench_start_ns) / 1e9;
+
+    static OpResult totals[OP_COUNT];
+    static OpResult all;
+    for (int i = 0; i < config.connections; ++i) {
+        for (int op = 0; op < OP_COUNT; ++op) {
+            histogram_merge(&totals[op].latency, &workers[i].ops[op].latency);
+            totals[op].errors += workers[i].ops[op].errors;
+        }
+        free(workers[i].own_ids);
+    }
+    for (int op = 0; op < OP_COUNT; ++op) {
+        histogram_merge(&all.latency, &totals[op].latency);
+        all.errors += totals[op].errors;
+    }
+
+    printf("%-10s %10s %8s %10s %10s %10s %10s %10s\n", "op", "requests", "errors", "req/s", "p50_us", "p99_us",
+           "p999_us", "max_us");
+    for (int op = 0; op < OP_COUNT; ++op) {
+        if (totals[op].latency.count) print_row(stdout, op_names[op], &totals[op], elapsed);
+    }
+    print_row(stdout, "total", &all, elapsed);
+
+    if (config.json_path && write_json(config.json_path, totals, &all, elapsed) == 0) {
+        printf("Results written to %s\n", config.json_path);
+    }
+
+    free(workers);
+    free(preloaded_ids);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "loggen.h"
+
+// Gera um log binário sintético (loggen.h) para testar a restauração e o checkpoint do servidor com um log grande.
+// O arquivo sai no formato de arquivo único, que o servidor migra para o primeiro segmento no boot (-d).
+
+#define DEFAULT_OUTPUT "cabbage.log"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Aceita sufixos K, M e G (potências de 1024).
+static size_t parse_size(const char* text) {
+    char* end;
+    double value = strtod(text, &end);
+    switch (*end) {
+    case 'k': case 'K': value *= 1024.0; break;
+    case 'm': case 'M': value *= 1024.0 * 1024.0; break;
+    case 'g': case 'G': value *= 1024.0 * 1024.0 * 1024.0; break;
+    }
+    return (size_t)value;
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-o output] [-n records | -s size] [-x mix] [-m max_live] [-S seed]\n", program);
+    fprintf(stderr, "  -o output    output file (default %s)\n", DEFAULT_OUTPUT);
+    fprintf(stderr, "  -n records   number of records (default 1000000)\n");
+    fprintf(stderr, "  -s size      approximate file size instead, e.g. 512M or 2G\n");
+    fprintf(stderr, "  -x mix       operation weights (default add=40,addgenre=45,remove=15)\n");
+    fprintf(stderr, "  -m max_live  maximum live movies, the server table size (default 65536)\n");
+    fprintf(stderr, "  -S seed      random seed (default 42)\n");
+}
+
+int main(int argc, char* argv[]) {
+    LoggenConfig config;
+    loggen_default_config(&config);
+    const char* output = DEFAULT_OUTPUT;
+
+    int c;
+    while ((c = getopt(argc, argv, "o:n:s:x:m:S:h")) != -1) {
+        switch (c) {
+        case 'o': output = optarg; break;
+        case 'n': config.records = strtoull(optarg, NULL, 10); break;
+        case 's': config.target_bytes = parse_size(optarg); break;
+        case 'x':
+            if (loggen_parse_mix(optarg, &config) < 0) {
+                fprintf(stderr, "Invalid mix: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'm': config.max_live = strtoull(optarg, NULL, 10); break;
+        case 'S': config.seed = strtoull(optarg, NULL, 10); break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.max_live == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    LoggenStats stats;
+    double start = now_seconds();
+    if (loggen_write(output, &config, &stats) != 0) {
+        fprintf(stderr, "Failed to generate log\n");
+        return 1;
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("Wrote %zu records (%.1f MB) to %s in %.3f s\n", stats.records, (double)stats.bytes / (1024.0 * 1024.0),
+           output, elapsed);
+    printf("  add: %zu, addgenre: %zu, remove: %zu, live movies at the end: %zu\n", stats.adds, stats.add_genres,
+           stats.removes, stats.live);
+    return 0;
+}
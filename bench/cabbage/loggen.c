@@ -0,0 +1,282 @@
+#include "loggen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cabbage/LogRecord.h"
+#include "cabbage/common/util.h"
+
+#define LOGGEN_GENRE_BITS 64
+// 2024-01-01 00:00:00 UTC, os registros são espaçados a partir daqui.
+#define LOGGEN_START_TIMESTAMP_US 1704067200000000ull
+
+static const char* words[] = {
+    "The", "Last", "Night", "Love", "Dark", "City", "Man", "Story", "Day", "Life", "World", "Time", "House", "Girl",
+    "Return", "Secret", "Dead", "Blood", "King", "Lost", "Black", "Red", "Star", "Heart", "Game", "War", "Home",
+    "Dream", "Summer", "Shadow", "Fire", "River", "Road", "Moon", "Sun", "Island", "Ghost", "Wild", "Little",
+    "Big", "Old", "New", "American", "Blue", "Golden", "Silent", "Hidden", "Broken", "Eternal", "Final", "First",
+    "Storm", "Winter", "Ocean", "Mountain", "Garden", "Empire", "Kingdom", "Legend", "Journey", "Mission",
+    "Escape", "Revenge", "Promise", "Memory", "Stranger", "Angel", "Devil", "Hunter", "Soldier", "Detective",
+    "Princess", "Dragon", "Machine", "Planet", "Galaxy", "Future", "Past", "Midnight", "Morning", "Paradise",
+    "Silence", "Thunder", "Whisper", "Mirror", "Crown", "Bridge", "Tower", "Forest", "Desert", "Harbor",
+};
+#define WORD_COUNT (sizeof(words) / sizeof(words[0]))
+
+// Os primeiros são os mais comuns; junto com as tags, formam o vocabulário dos ADDGENRE.
+static const char* genres[] = {
+    "Drama", "Comedy", "Action", "Thriller", "Romance", "Horror", "Crime", "Adventure", "Sci-Fi", "Fantasy",
+    "Mystery", "Animation", "Family", "Documentary", "Biography", "History", "War", "Music", "Sport", "Western",
+    "Musical", "Film-Noir", "Short", "Reality", "Superhero", "Cyberpunk", "Heist", "Noir", "Satire", "Slasher",
+    "Space-Opera", "Coming-of-Age", "Mockumentary", "Disaster", "Martial-Arts", "Spy", "Zombie", "Vampire",
+    "Time-Travel", "Post-Apocalyptic", "Psychological", "Courtroom", "Political", "Road-Movie", "Buddy",
+    "Parody", "Period", "Epic", "Experimental", "Silent", "Surreal", "Teen", "Mecha", "Kaiju", "Wuxia",
+    "Giallo", "Found-Footage", "Dystopian", "Steampunk", "Sword-and-Sandal", "Neo-Noir", "Anthology",
+    "Holiday", "Cult",
+};
+#define GENRE_COUNT (sizeof(genres) / sizeof(genres[0]))
+
+static const char* first_names[] = {
+    "John", "Mary", "James", "Patricia", "Robert", "Jennifer", "Michael", "Linda", "David", "Elizabeth",
+    "Steven", "Sofia", "Akira", "Pedro", "Agnes", "Martin", "Greta", "Bong", "Denis", "Kathryn",
+    "Wes", "Ana", "Ridley", "Jane", "Alfonso", "Chloe", "Hayao", "Claire", "Guillermo", "Lucrecia",
+};
+#define FIRST_NAME_COUNT (sizeof(first_names) / sizeof(first_names[0]))
+
+static const char* last_names[] = {
+    "Smith", "Johnson", "Williams", "Brown", "Jones", "Garcia", "Miller", "Davis", "Rodriguez", "Martinez",
+    "Kurosawa", "Almodovar", "Varda", "Scorsese", "Gerwig", "Villeneuve", "Bigelow", "Anderson", "Scott",
+    "Campion", "Cuaron", "Zhao", "Miyazaki", "Denis", "del Toro", "Martel", "Coppola", "Kubrick", "Lynch",
+    "Hitchcock", "Fellini", "Bergman", "Tarkovsky", "Ozu", "Wong", "Park", "Lee", "Nolan", "Spielberg", "Carpenter",
+};
+#define LAST_NAME_COUNT (sizeof(last_names) / sizeof(last_names[0]))
+
+typedef struct {
+    double* cdf;
+    size_t count;
+} Zipf;
+
+typedef struct {
+    u32 id;
+    u64 genre_bits; // gêneros do vocabulário que o filme já tem
+} LiveMovie;
+
+static double next_uniform(u64* state) {
+    return (double)(next_random(state) >> 11) / (double)(1ull << 53);
+}
+
+static int zipf_init(Zipf* zipf, size_t count, double exponent) {
+    zipf->cdf = malloc(count * sizeof(double));
+    if (!zipf->cdf) return -1;
+    zipf->count = count;
+    double total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += 1.0 / pow((double)(i + 1), exponent);
+        zipf->cdf[i] = total;
+    }
+    for (size_t i = 0; i < count; ++i) zipf->cdf[i] /= total;
+    return 0;
+}
+
+static size_t zipf_sample(const Zipf* zipf, u64* state) {
+    double u = next_uniform(state);
+    size_t lo = 0, hi = zipf->count - 1;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (zipf->cdf[mid] < u) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+typedef struct {
+    Zipf words;
+    Zipf genres;
+    Zipf first_names;
+    Zipf last_names;
+} Distributions;
+
+static void set_field(LogRecord* record, u32 index, const char* value) {
+    record->fields[index] = value;
+    record->field_lengths[index] = (u32)strlen(value);
+}
+
+static void make_title(const Distributions* d, u64* seed, char* out, size_t size) {
+    size_t length = 0;
+    int count = 1 + (int)(next_random(seed) % 4);
+    out[0] = '\0';
+    for (int i = 0; i < count && length < size; ++i) {
+        length += (size_t)snprintf(out + length, size - length, "%s%s", i ? " " : "",
+                                   words[zipf_sample(&d->words, seed)]);
+    }
+    // Algumas continuações.
+    if (length < size && next_random(seed) % 10 == 0) {
+        snprintf(out + length, size - length, " %d", 2 + (int)(next_random(seed) % 4));
+    }
+}
+
+static u64 make_genres(const Distributions* d, u64* seed, char* out, size_t size) {
+    u64 bits = 0;
+    size_t length = 0;
+    int count = 1 + (int)(next_random(seed) % 3);
+    out[0] = '\0';
+    for (int i = 0; i < count; ++i) {
+        size_t genre = zipf_sample(&d->genres, seed);
+        if (bits & (1ull << genre)) continue;
+        bits |= 1ull << genre;
+        length += (size_t)snprintf(out + length, size - length, "%s%s", length ? "," : "", genres[genre]);
+        if (length >= size) break;
+    }
+    return bits;
+}
+
+// Anos concentrados nas últimas décadas (exponencial com média de 15 anos a partir de 2025).
+static int make_year(u64* seed) {
+    int year = 2025 - (int)(-15.0 * log(1.0 - next_uniform(seed)));
+    return year < 1900 ? 1900 : year;
+}
+
+// ADDGENRE: metade das vezes um filme recente (as edições se concentram nos lançamentos), metade qualquer um.
+static size_t pick_for_genre(u64* seed, size_t live_count) {
+    if (next_random(seed) % 2) return next_random(seed) % live_count;
+    size_t back = (size_t)(-50.0 * log(1.0 - next_uniform(seed)));
+    return back >= live_count ? 0 : live_count - 1 - back;
+}
+
+void loggen_default_config(LoggenConfig* config) {
+    memset(config, 0, sizeof(*config));
+    config->records = 1000000;
+    config->add_weight = 40;
+    config->add_genre_weight = 45;
+    config->remove_weight = 15;
+    config->max_live = 65536;
+    config->seed = 42;
+}
+
+int loggen_parse_mix(const char* text, LoggenConfig* config) {
+    unsigned add = 0, add_genre = 0, remove = 0;
+    char* copy = strdup(text);
+    if (!copy) return -1;
+    char* save = NULL;
+    int result = 0;
+    for (char* item = strtok_r(copy, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char* equals = strchr(item, '=');
+        if (!equals) {
+            result = -1;
+            break;
+        }
+        *equals = '\0';
+        unsigned weight = (unsigned)strtoul(equals + 1, NULL, 10);
+        if (strcmp(item, "add") == 0) add = weight;
+        else if (strcmp(item, "addgenre") == 0) add_genre = weight;
+        else if (strcmp(item, "remove") == 0) remove = weight;
+        else {
+            result = -1;
+            break;
+        }
+    }
+    free(copy);
+    if (result < 0 || add == 0) return -1;
+    config->add_weight = add;
+    config->add_genre_weight = add_genre;
+    config->remove_weight = remove;
+    return 0;
+}
+
+int loggen_write(const char* filename, const LoggenConfig* config, LoggenStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    FILE* f = fopen(filename, "wb");
+    if (!f) {
+        perror("fopen");
+        return -1;
+    }
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+    char header[LOG_FILE_HEADER_SIZE];
+    LogFile_write_header(header);
+    fwrite(header, 1, sizeof(header), f);
+    stats->bytes = sizeof(header);
+
+    Distributions d;
+    LiveMovie* live = malloc(config->max_live * sizeof(LiveMovie));
+    if (!live || zipf_init(&d.words, WORD_COUNT, 1.0) < 0 || zipf_init(&d.genres, GENRE_COUNT, 1.1) < 0 ||
+        zipf_init(&d.first_names, FIRST_NAME_COUNT, 0.8) < 0 || zipf_init(&d.last_names, LAST_NAME_COUNT, 0.8) < 0) {
+        fclose(f);
+        free(live);
+        return -1;
+    }
+
+    u64 seed = config->seed ? config->seed : 1;
+    size_t live_count = 0;
+    u32 next_id = 1;
+    u64 timestamp_us = LOGGEN_START_TIMESTAMP_US;
+    u32 next_tag = 1;
+    unsigned total_weight = config->add_weight + config->add_genre_weight + config->remove_weight;
+    char buffer[1024], title[128], genre_list[128], director[64], year[12], genre[32];
+
+    while (config->target_bytes ? stats->bytes < config->target_bytes : stats->records < config->records) {
+        unsigned roll = (unsigned)(next_random(&seed) % total_weight);
+        int op = roll < config->add_weight ? LOG_RECORD_ADD
+               : roll < config->add_weight + config->add_genre_weight ? LOG_RECORD_ADD_GENRE
+               : LOG_RECORD_REMOVE;
+        if (live_count == 0) op = LOG_RECORD_ADD;
+        if (live_count == config->max_live && op == LOG_RECORD_ADD) op = LOG_RECORD_REMOVE;
+
+        LogRecord record;
+        record.type = (u8)op;
+        record.version = stats->records + 1;
+        timestamp_us += next_random(&seed) % 2000;
+        record.timestamp_us = timestamp_us;
+
+        if (op == LOG_RECORD_ADD) {
+            make_title(&d, &seed, title, sizeof(title));
+            u64 bits = make_genres(&d, &seed, genre_list, sizeof(genre_list));
+            snprintf(director, sizeof(director), "%s %s", first_names[zipf_sample(&d.first_names, &seed)],
+                     last_names[zipf_sample(&d.last_names, &seed)]);
+            snprintf(year, sizeof(year), "%d", make_year(&seed));
+            record.movie_id = next_id;
+            record.field_count = 4;
+            set_field(&record, 0, title);
+            set_field(&record, 1, genre_list);
+            set_field(&record, 2, director);
+            set_field(&record, 3, year);
+            live[live_count].id = next_id++;
+            live[live_count].genre_bits = bits;
+            live_count++;
+            stats->adds++;
+        } else if (op == LOG_RECORD_ADD_GENRE) {
+            LiveMovie* movie = &live[pick_for_genre(&seed, live_count)];
+            size_t choice = zipf_sample(&d.genres, &seed);
+            if (choice < LOGGEN_GENRE_BITS && !(movie->genre_bits & (1ull << choice))) {
+                movie->genre_bits |= 1ull << choice;
+                snprintf(genre, sizeof(genre), "%s", genres[choice]);
+            } else {
+                // Gênero repetido: usa uma tag nova, o servidor não aceitaria o mesmo gênero duas vezes.
+                snprintf(genre, sizeof(genre), "Tag%u", next_tag++);
+            }
+            record.movie_id = movie->id;
+            record.field_count = 1;
+            set_field(&record, 0, genre);
+            stats->add_genres++;
+        } else {
+            size_t victim = next_random(&seed) % live_count;
+            record.movie_id = live[victim].id;
+            record.field_count = 0;
+            live[victim] = live[--live_count];
+            stats->removes++;
+        }
+
+        size_t size = LogRecord_encoded_size(&record);
+        LogRecord_encode(&record, buffer);
+        fwrite(buffer, 1, size, f);
+        stats->bytes += size;
+        stats->records++;
+    }
+
+    stats->live = live_count;
+    free(live);
+    free(d.words.cdf);
+    free(d.genres.cdf);
+    free(d.first_names.cdf);
+    free(d.last_names.cdf);
+    return fclose(f);
+}
@@ -0,0 +1,39 @@
+#ifndef _CABBAGE_BENCH_LOGGEN_H
+#define _CABBAGE_BENCH_LOGGEN_H
+
+#include <stddef.h>
+#include "cabbage/common/types.h"
+
+// Gerador de logs sintéticos no formato binário do servidor (server/cabbage/LogRecord.h), usado pelo log-gen e pelo
+// restore-bench.
+//
+// Os dados tentam parecer com os de verdade: títulos de 1 a 4 palavras e gêneros sorteados com distribuição de Zipf
+// (poucos muito comuns, cauda longa), diretores de um conjunto limitado (alguns com muitos filmes), anos concentrados
+// nas últimas décadas. Os ADDGENRE preferem filmes recentes e nunca repetem um gênero no mesmo filme, e os REMOVE
+// escolhem qualquer filme vivo. A mesma semente gera sempre o mesmo arquivo.
+
+typedef struct {
+    size_t records;       // número de registros, usado quando target_bytes == 0
+    size_t target_bytes;  // tamanho aproximado do arquivo
+    unsigned add_weight;
+    unsigned add_genre_weight;
+    unsigned remove_weight;
+    size_t max_live;      // máximo de filmes vivos (a capacidade da tabela do servidor)
+    u64 seed;
+} LoggenConfig;
+
+typedef struct {
+    size_t records;
+    size_t adds;
+    size_t add_genres;
+    size_t removes;
+    size_t bytes;
+    size_t live;
+} LoggenStats;
+
+void loggen_default_config(LoggenConfig* config);
+// Lê pesos no formato "add=40,addgenre=45,remove=15". Retorna -1 se o texto for inválido.
+int loggen_parse_mix(const char* text, LoggenConfig* config);
+int loggen_write(const char* filename, const LoggenConfig* config, LoggenStats* stats);
+
+#endif // _CABBAGE_BENCH_LOGGEN_H
@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "cabbage/common/Packet.h"
+
+// Microbenchmark do Packet.c: mede send + recv de pacotes típicos (um filme, listas de 1k e 65k filmes) em dois
+// transportes:
+//
+// - socketpair: uma thread envia e a principal recebe, passando pelo kernel como numa conexão de verdade.
+// - memória: send e recv são redirecionados para um buffer (com -Wl,--wrap=send,--wrap=recv), então sobra só o custo
+//   de calcular o tamanho, serializar, deserializar e alocar.
+// - decode: como o de memória, mas os pacotes S2C são lidos com o S2CPacket_decode direto do buffer.
+//
+// O malloc/calloc/realloc/strdup também são interceptados (--wrap) para contar alocações por pacote, e o número de
+// chamadas de send/recv por pacote mostra o custo da leitura campo a campo.
+
+#define MEMORY_FD 1000000
+#define DEFAULT_TARGET_MS 300
+
+// --- Interceptação (ver os -Wl,--wrap no bench/Makefile) ---
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+char* __real_strdup(const char* str);
+ssize_t __real_send(int fd, const void* buf, size_t len, int flags);
+ssize_t __real_recv(int fd, void* buf, size_t len, int flags);
+
+static _Thread_local u64 allocations;
+static _Thread_local u64 syscalls;
+
+void* __wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+char* __wrap_strdup(const char* str) {
+    allocations++;
+    return __real_strdup(str);
+}
+
+// Buffer do transporte em memória: o send escreve no fim, o recv lê do começo.
+static char* memory_data = NULL;
+static size_t memory_length = 0;
+static size_t memory_capacity = 0;
+static size_t memory_read = 0;
+
+ssize_t __wrap_send(int fd, const void* buf, size_t len, int flags) {
+    syscalls++;
+    if (fd != MEMORY_FD) return __real_send(fd, buf, len, flags);
+    if (memory_length + len > memory_capacity) {
+        size_t capacity = memory_capacity ? memory_capacity : 4096;
+        while (capacity < memory_length + len) capacity *= 2;
+        char* data = __real_realloc(memory_data, capacity);
+        if (!data) {
+            errno = ENOMEM;
+            return -1;
+        }
+        memory_data = data;
+        memory_capacity = capacity;
+    }
+    memcpy(memory_data + memory_length, buf, len);
+    memory_length += len;
+    return (ssize_t)len;
+}
+
+ssize_t __wrap_recv(int fd, void* buf, size_t len, int flags) {
+    syscalls++;
+    if (fd != MEMORY_FD) return __real_recv(fd, buf, len, flags);
+    size_t available = memory_length - memory_read;
+    if (len > available) len = available;
+    memcpy(buf, memory_data + memory_read, len);
+    memory_read += len;
+    if (memory_read == memory_length) memory_read = memory_length = 0;
+    return (ssize_t)len;
+}
+
+// --- Pacotes ---
+
+typedef struct {
+    const char* name;
+    int is_c2s;
+    C2SPacket c2s;
+    S2CPacket s2c;
+} BenchCase;
+
+typedef struct {
+    u64 iterations;
+    double seconds;
+    u64 bytes;
+    u64 send_allocations;
+    u64 recv_allocations;
+    u64 send_syscalls;
+    u64 recv_syscalls;
+} BenchResult;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void fill_movie(Movie* movie, u32 id) {
+    char title[64];
+    snprintf(title, sizeof(title), "A Reasonably Long Movie Title %u", id);
+    movie->id = id;
+    movie->version = (u64)id << 8;
+    movie->title = strdup(title);
+    movie->genres = strdup("Action,Adventure,Sci-Fi");
+    movie->director = strdup("Some Famous Director");
+    movie->release_year = strdup("2010");
+}
+
+static void make_list(BenchCase* bench, u32 count, int detailed) {
+    bench->is_c2s = 0;
+    if (detailed) {
+        bench->s2c.type = S2C_MOVIE_LIST_DETAILED;
+        bench->s2c.data.movie_list_detailed.version = 42;
+        bench->s2c.data.movie_list_detailed.count = count;
+        bench->s2c.data.movie_list_detailed.movies = calloc(count, sizeof(Movie));
+        for (u32 i = 0; i < count; ++i) fill_movie(&bench->s2c.data.movie_list_detailed.movies[i], i + 1);
+    } else {
+        bench->s2c.type = S2C_MOVIE_LIST;
+        bench->s2c.data.movie_list.version = 42;
+        bench->s2c.data.movie_list.count = count;
+        bench->s2c.data.movie_list.movies = calloc(count, sizeof(S2C_MovieIdTitle));
+        for (u32 i = 0; i < count; ++i) {
+            char title[64];
+            snprintf(title, sizeof(title), "A Reasonably Long Movie Title %u", i + 1);
+            bench->s2c.data.movie_list.movies[i].id = i + 1;
+            bench->s2c.data.movie_list.movies[i].title = strdup(title);
+        }
+    }
+}
+
+static int send_case(int fd, const BenchCase* bench) {
+    return bench->is_c2s ? C2SPacket_send(fd, &bench->c2s) : S2CPacket_send(fd, &bench->s2c);
+}
+
+static int recv_case(int fd, const BenchCase* bench) {
+    if (bench->is_c2s) {
+        C2SPacket packet;
+        if (C2SPacket_recv(fd, &packet) < 0) return -1;
+        C2SPacket_free(&packet);
+    } else {
+        S2CPacket packet;
+        if (S2CPacket_recv(fd, &packet) < 0) return -1;
+        S2CPacket_free(&packet);
+    }
+    return 0;
+}
+
+static int run_memory(const BenchCase* bench, u64 iterations, BenchResult* result) {
+    memset(result, 0, sizeof(*result));
+    u64 bytes_before = packet_bytes_sent;
+    double start = now_seconds();
+    for (u64 i = 0; i < iterations; ++i) {
+        u64 a = allocations, s = syscalls;
+        if (send_case(MEMORY_FD, bench) < 0) return -1;
+        result->send_allocations += allocations - a;
+        result->send_syscalls += syscalls - s;
+        a = allocations, s = syscalls;
+        if (recv_case(MEMORY_FD, bench) < 0) return -1;
+        result->recv_allocations += allocations - a;
+        result->recv_syscalls += syscalls - s;
+    }
+    result->seconds = now_seconds() - start;
+    result->iterations = iterations;
+    result->bytes = packet_bytes_sent - bytes_before;
+    return 0;
+}
+
+// Igual ao de memória, mas o lado que recebe usa o S2CPacket_decode sobre o buffer inteiro, como a biblioteca do
+// cliente faz (só para pacotes S2C).
+static int run_decode(const BenchCase* bench, u64 iterations, BenchResult* result) {
+    memset(result, 0, sizeof(*result));
+    u64 bytes_before = packet_bytes_sent;
+    double start = now_seconds();
+    for (u64 i = 0; i < iterations; ++i) {
+        u64 a = allocations, s = syscalls;
+        if (send_case(MEMORY_FD, bench) < 0) return -1;
+        result->send_allocations += allocations - a;
+        result->send_syscalls += syscalls - s;
+        a = allocations;
+        S2CPacket packet;
+        if (S2CPacket_decode(memory_data, memory_length, &packet) != (ssize_t)memory_length) return -1;
+        S2CPacket_free(&packet);
+        memory_length = 0;
+        result->recv_allocations += allocations - a;
+    }
+    result->seconds = now_seconds() - start;
+    result->iterations = iterations;
+    result->bytes = packet_bytes_sent - bytes_before;
+    return 0;
+}
+
+typedef struct {
+    int fd;
+    const BenchCase* bench;
+    u64 iterations;
+    u64 allocations;
+    u64 syscalls;
+    u64 bytes;
+    int failed;
+} Sender;
+
+static void* sender_main(void* arg) {
+    Sender* sender = arg;
+    u64 bytes_before = packet_bytes_sent;
+    for (u64 i = 0; i < sender->iterations; ++i) {
+        if (send_case(sender->fd, sender->bench) < 0) {
+            sender->failed = 1;
+            break;
+        }
+    }
+    sender->allocations = allocations;
+    sender->syscalls = syscalls;
+    sender->bytes = packet_bytes_sent - bytes_before;
+    return NULL;
+}
+
+static int run_socketpair(const BenchCase* bench, u64 iterations, BenchResult* result) {
+    memset(result, 0, sizeof(*result));
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        perror("socketpair");
+        return -1;
+    }
+    Sender sender = {.fd = fds[0], .bench = bench, .iterations = iterations};
+    pthread_t thread;
+    u64 a = allocations, s = syscalls;
+    double start = now_seconds();
+    if (pthread_create(&thread, NULL, sender_main, &sender) != 0) {
+        perror("pthread_create");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    int failed = 0;
+    for (u64 i = 0; i < iterations; ++i) {
+        if (recv_case(fds[1], bench) < 0) {
+            failed = 1;
+            break;
+        }
+    }
+    pthread_join(thread, NULL);
+    result->seconds = now_seconds() - start;
+    close(fds[0]);
+    close(fds[1]);
+    if (failed || sender.failed) return -1;
+
+    result->iterations = iterations;
+    result->bytes = sender.bytes;
+    result->send_allocations = sender.allocations;
+    result->send_syscalls = sender.syscalls;
+    result->recv_allocations = allocations - a;
+    result->recv_syscalls = syscalls - s;
+    return 0;
+}
+
+static void print_result(const char* name, const char* transport, const BenchResult* r) {
+    double n = (double)r->iterations;
+    printf("%-22s %-10s %10llu %12.0f %10.1f %12.0f %8.1f %8.1f %8.1f %10.1f\n", name, transport,
+           (unsigned long long)r->iterations, r->seconds * 1e9 / n, r->bytes / r->seconds / (1024.0 * 1024.0),
+           r->bytes / n, r->send_allocations / n, r->recv_allocations / n, r->send_syscalls / n, r->recv_syscalls / n);
+}
+
+typedef int (*runner_t)(const BenchCase* bench, u64 iterations, BenchResult* result);
+
+// Escolhe o número de iterações para o caso levar ~target_s no transporte dado.
+static u64 calibrate(runner_t run, const BenchCase* bench, double target_s) {
+    BenchResult probe;
+    u64 iterations = 1;
+    while (1) {
+        if (run(bench, iterations, &probe) < 0) return 0;
+        if (probe.seconds >= target_s / 10 || iterations >= (1ull << 30)) break;
+        iterations *= 4;
+    }
+    u64 scaled = (u64)((double)iterations * target_s / (probe.seconds > 0 ? probe.seconds : 1e-9));
+    return scaled ? scaled : 1;
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-t target_ms] [-f filter]\n", program);
+}
+
+int main(int argc, char* argv[]) {
+    double target_s = DEFAULT_TARGET_MS / 1000.0;
+    const char* filter = NULL;
+    int c;
+    while ((c = getopt(argc, argv, "t:f:h")) != -1) {
+        switch (c) {
+        case 't': target_s = strtod(optarg, NULL) / 1000.0; break;
+        case 'f': filter = optarg; break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    static BenchCase cases[8];
+    int case_count = 0;
+
+    BenchCase* add = &cases[case_count++];
+    add->name = "c2s_add_movie";
+    add->is_c2s = 1;
+    add->c2s.type = C2S_ADD_MOVIE;
+    add->c2s.data.add_movie.title = "A Reasonably Long Movie Title";
+    add->c2s.data.add_movie.genres = "Action,Adventure,Sci-Fi";
+    add->c2s.data.add_movie.director = "Some Famous Director";
+    add->c2s.data.add_movie.release_year = "2010";
+
+    BenchCase* get = &cases[case_count++];
+    get->name = "c2s_get_movie";
+    get->is_c2s = 1;
+    get->c2s.type = C2S_GET_MOVIE;
+    get->c2s.data.get_movie.movie_id = 1234;
+
+    BenchCase* movie = &cases[case_count++];
+    movie->name = "s2c_movie";
+    movie->s2c.type = S2C_MOVIE;
+    fill_movie(&movie->s2c.data.movie, 1234);
+
+    cases[case_count].name = "s2c_list_1k";
+    make_list(&cases[case_count++], 1000, 0);
+    cases[case_count].name = "s2c_list_65k";
+    make_list(&cases[case_count++], 65536, 0);
+    cases[case_count].name = "s2c_list_detailed_1k";
+    make_list(&cases[case_count++], 1000, 1);
+    cases[case_count].name = "s2c_list_detailed_65k";
+    make_list(&cases[case_count++], 65536, 1);
+
+    printf("%-22s %-10s %10s %12s %10s %12s %8s %8s %8s %10s\n", "packet", "transport", "packets", "ns/packet",
+           "MiB/s", "bytes/pkt", "allocs_tx", "allocs_rx", "sends", "recvs");
+    for (int i = 0; i < case_count; ++i) {
+        if (filter && !strstr(cases[i].name, filter)) continue;
+        static const runner_t runners[] = {run_memory, run_socketpair, run_decode};
+        static const char* transports[] = {"memory", "socketpair", "decode"};
+        for (int t = 0; t < 3; ++t) {
+            if (runners[t] == run_decode && cases[i].is_c2s) continue;
+            u64 iterations = calibrate(runners[t], &cases[i], target_s);
+            BenchResult result;
+            if (iterations == 0 || runners[t](&cases[i], iterations, &result) < 0) {
+                fprintf(stderr, "%s: %s run failed\n", cases[i].name, transports[t]);
+                return 1;
+            }
+            print_result(cases[i].name, transports[t], &result);
+        }
+    }
+    printf("allocs_tx and allocs_rx: allocations per packet on the sending and receiving side;\n"
+           "sends and recvs: send()/recv() calls per packet.\n");
+
+    for (int i = 0; i < case_count; ++i) {
+        if (!cases[i].is_c2s) S2CPacket_free(&cases[i].s2c);
+    }
+    return 0;
+}
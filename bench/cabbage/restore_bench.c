@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "cabbage/logger.h"
+#include "cabbage/LogRecord.h"
+#include "cabbage/snapshot.h"
+#include "loggen.h"
+
+// Benchmark do log_restore: gera um log binário sintético com o loggen.h (ou usa um existente com -f) e mede quanto
+// tempo a restauração leva, em registros por segundo, e o pico de memória residente. Com -s, também escreve um snapshot do resultado e mede quanto tempo
+// o snapshot_load leva para deixar uma tabela vazia pronta (o tempo até a primeira requisição no boot).
+
+#define DEFAULT_RECORDS 1000000
+#define DEFAULT_MAX_ENTRIES 65536
+#define DEFAULT_LOG_FILE "restore-bench.log"
+#define SNAPSHOT_BENCH_FILE "restore-bench.snap"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Pico de memória residente do processo até agora, em MB.
+static double peak_rss_mb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)usage.ru_maxrss / 1024.0;
+}
+
+static size_t count_records(const char* filename) {
+    FILE* f = fopen(filename, "rb");
+    if (!f) return 0;
+    size_t count = 0;
+    char header[LOG_RECORD_HEADER_SIZE];
+    fseek(f, LOG_FILE_HEADER_SIZE, SEEK_SET);
+    while (fread(header, 1, sizeof(header), f) == sizeof(header)) {
+        u32 length;
+        memcpy(&length, header, sizeof(length));
+        if (fseek(f, length, SEEK_CUR) != 0) break;
+        count++;
+    }
+    fclose(f);
+    return count;
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-n records] [-m max_entries] [-x mix] [-f existing_log] [-s]\n", program);
+}
+
+int main(int argc, char* argv[]) {
+    size_t records = DEFAULT_RECORDS;
+    size_t max_entries = DEFAULT_MAX_ENTRIES;
+    // Por padrão, a mesma mistura de antes: 60% ADD, 30% ADDGENRE, 10% REM.
+    LoggenConfig config;
+    loggen_default_config(&config);
+    config.add_weight = 60;
+    config.add_genre_weight = 30;
+    config.remove_weight = 10;
+    const char* filename = NULL;
+    int bench_snapshot = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "n:m:x:f:sh")) != -1) {
+        switch (c) {
+        case 'n': records = strtoull(optarg, NULL, 10); break;
+        case 'm': max_entries = strtoull(optarg, NULL, 10); break;
+        case 'x':
+            if (loggen_parse_mix(optarg, &config) < 0) {
+                fprintf(stderr, "Invalid mix: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'f': filename = optarg; break;
+        case 's': bench_snapshot = 1; break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    int generated = 0;
+    if (!filename) {
+        filename = DEFAULT_LOG_FILE;
+        printf("Generating %zu records into %s...\n", records, filename);
+        double start = now_seconds();
+        config.records = records;
+        config.max_live = max_entries;
+        LoggenStats gen;
+        if (loggen_write(filename, &config, &gen) != 0) {
+            fprintf(stderr, "Failed to generate log\n");
+            return 1;
+        }
+        printf("Generated in %.3f s\n", now_seconds() - start);
+        generated = 1;
+    } else {
+        records = count_records(filename);
+    }
+
+    struct stat st;
+    if (stat(filename, &st) < 0) {
+        perror("stat");
+        return 1;
+    }
+
+    MovieEntry* entries = calloc(max_entries, sizeof(MovieEntry));
+    if (!entries) {
+        perror("calloc");
+        return 1;
+    }
+    for (size_t i = 0; i < max_entries; ++i) {
+        MovieEntry_init(&entries[i]);
+    }
+
+    atomic_uint movie_count = 0, next_id = 1;
+    atomic_ullong store_version = 0;
+    double rss_before = peak_rss_mb();
+    double start = now_seconds();
+    int result = log_restore(filename, entries, max_entries, NULL, &movie_count, &next_id, &store_version);
+    double elapsed = now_seconds() - start;
+    double rss_after = peak_rss_mb();
+
+    printf("log_restore returned %d\n", result);
+    printf("Records: %zu (%.1f MB)\n", records, (double)st.st_size / (1024.0 * 1024.0));
+    printf("Movies restored: %u\n", atomic_load(&movie_count));
+    printf("Restore time: %.3f s\n", elapsed);
+    printf("Throughput: %.0f records/s, %.1f MB/s\n", records / elapsed, (double)st.st_size / (1024.0 * 1024.0) / elapsed);
+    printf("Peak RSS: %.1f MB (%.1f MB before the restore)\n", rss_after, rss_before);
+
+    if (bench_snapshot && result >= 0) {
+        start = now_seconds();
+        if (snapshot_write(SNAPSHOT_BENCH_FILE, entries, max_entries, &next_id, &store_version) < 0) {
+            fprintf(stderr, "Failed to write snapshot\n");
+            return 1;
+        }
+        printf("Snapshot write time: %.3f s\n", now_seconds() - start);
+
+        MovieEntry* fresh = calloc(max_entries, sizeof(MovieEntry));
+        if (!fresh) {
+            perror("calloc");
+            return 1;
+        }
+        for (size_t i = 0; i < max_entries; ++i) {
+            MovieEntry_init(&fresh[i]);
+        }
+        atomic_uint fresh_count = 0, fresh_next_id = 1;
+        atomic_ullong fresh_version = 0;
+        IdIndex index = {0};
+        start = now_seconds();
+        int loaded = snapshot_load(SNAPSHOT_BENCH_FILE, fresh, max_entries, &index, &fresh_count, &fresh_next_id, &fresh_version);
+        elapsed = now_seconds() - start;
+        printf("snapshot_load returned %d: %u movies in %.3f ms\n", loaded, atomic_load(&fresh_count), elapsed * 1e3);
+        IdIndex_free(&index);
+        unlink(SNAPSHOT_BENCH_FILE);
+    }
+
+    if (generated) unlink(filename);
+    return result < 0 ? 1 : 0;
+}
@@ -0,0 +1,406 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <libgen.h>
+#include <signal.h>
+#include <time.h>
+#include <ftw.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// Curva de escalabilidade do servidor: para cada tipo de pacote, sobe um cabbage-server novo (diretório de dados
+// temporário, mesma carga inicial) e roda o cabbage-bench com 1, 2, 4, ... N conexões, uma thread cada, só com
+// aquele tipo de requisição. A eficiência com N conexões é vazão(N) / (N * vazão(1)): 1.0 é escalar linearmente,
+// e um lock global derruba a curva para perto de 1/N.
+//
+// Com -w, as eficiências medidas viram o baseline. Sem -w, cada ponto é comparado com o baseline e o programa
+// termina com erro se algum ficar abaixo de baseline * (1 - tolerância). O baseline depende da máquina, então ele
+// deve ser gravado na mesma máquina (e com o mesmo -n e -d) em que a comparação vai rodar. Sem baseline também é
+// erro (um CI sem o arquivo passaria sempre), a não ser com -a, que só mede.
+
+#define DEFAULT_PORT 23600
+#define DEFAULT_DURATION_S 3
+#define DEFAULT_PRELOAD 1000
+#define DEFAULT_TOLERANCE 0.2
+#define DEFAULT_BASELINE "scaling-baseline.txt"
+#define SERVER_START_TIMEOUT_MS 5000
+#define MAX_POINTS 16
+
+typedef struct {
+    const char* name; // nome no -x
+    const char* mix;  // mistura passada ao cabbage-bench
+    const char* ops[2]; // operações medidas nessa carga
+} Workload;
+
+// O add sozinho enche a tabela do servidor, então ele roda junto com o remove dos filmes que a própria conexão
+// adicionou, e cada um dos dois tem sua curva.
+static const Workload workloads[] = {
+    {"get", "get=1", {"get", NULL}},
+    {"list", "list=1", {"list", NULL}},
+    {"listgenre", "listgenre=1", {"listgenre", NULL}},
+    {"addgenre", "addgenre=1", {"addgenre", NULL}},
+    {"add", "add=1,remove=1", {"add", "remove"}},
+};
+#define WORKLOAD_COUNT (sizeof(workloads) / sizeof(workloads[0]))
+
+typedef struct {
+    const char* op;
+    int points;
+    int threads[MAX_POINTS];
+    double throughput[MAX_POINTS];
+    double efficiency[MAX_POINTS];
+} Curve;
+
+static struct {
+    char server_path[PATH_MAX];
+    char bench_path[PATH_MAX];
+    char baseline_path[PATH_MAX];
+    int port;
+    int max_threads;
+    double duration_s;
+    size_t preload;
+    double tolerance;
+    int write_baseline;
+    int allow_missing;
+    const char* json_path;
+    const char* only;
+} config;
+
+static Curve curves[WORKLOAD_COUNT * 2];
+static int curve_count = 0;
+
+static void sleep_ms(long ms) {
+    struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L};
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
+}
+
+static int remove_entry(const char* path, const struct stat* st, int flag, struct FTW* ftw) {
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+static int server_ready(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return 0;
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    int ok = connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0;
+    close(fd);
+    return ok;
+}
+
+static void redirect_output(const char* path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+}
+
+// Sobe o servidor em 'dir', sem checkpoints e só com avisos, e espera ele aceitar conexões.
+static pid_t start_server(const char* dir) {
+    char port[16];
+    snprintf(port, sizeof(port), "%d", config.port);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        if (chdir(dir) < 0) _exit(127);
+        redirect_output("server.out");
+        execl(config.server_path, config.server_path, "-c", "0", "-C", "0", "-l", "warn", port, (char*)NULL);
+        _exit(127);
+    }
+    for (int waited = 0; waited < SERVER_START_TIMEOUT_MS; waited += 10) {
+        if (server_ready(config.port)) return pid;
+        if (waitpid(pid, NULL, WNOHANG) == pid) break;
+        sleep_ms(10);
+    }
+    fprintf(stderr, "%s did not start (see %s/server.out)\n", config.server_path, dir);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    return -1;
+}
+
+static void stop_server(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+static int run_bench(const char* dir, const char* mix, int threads, const char* json_path) {
+    char connections[16], duration[32], preload[32], port[16], output[PATH_MAX];
+    snprintf(connections, sizeof(connections), "%d", threads);
+    snprintf(duration, sizeof(duration), "%g", config.duration_s);
+    snprintf(preload, sizeof(preload), "%zu", config.preload);
+    snprintf(port, sizeof(port), "%d", config.port);
+    snprintf(output, sizeof(output), "%s/bench.out", dir);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        redirect_output(output);
+        execl(config.bench_path, config.bench_path, "-c", connections, "-d", duration, "-p", preload, "-x", mix,
+              "-o", json_path, "127.0.0.1", port, (char*)NULL);
+        _exit(127);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s failed (see %s)\n", config.bench_path, output);
+        return -1;
+    }
+    return 0;
+}
+
+// Procura '"op": {... "throughput": X' no JSON do cabbage-bench.
+static double read_throughput(const char* json, const char* op) {
+    char key[64];
+    snprintf(key, sizeof(key), "\"%s\": {", op);
+    const char* at = strstr(json, key);
+    if (!at) return 0.0;
+    at = strstr(at, "\"throughput\": ");
+    return at ? strtod(at + strlen("\"throughput\": "), NULL) : 0.0;
+}
+
+static char* read_file(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* text = malloc((size_t)size + 1);
+    if (text) {
+        text[fread(text, 1, (size_t)size, f)] = '\0';
+    }
+    fclose(f);
+    return text;
+}
+
+static int selected(const char* name) {
+    if (!config.only) return 1;
+    size_t length = strlen(name);
+    for (const char* at = config.only; (at = strstr(at, name)); at += length) {
+        if ((at == config.only || at[-1] == ',') && (at[length] == ',' || at[length] == '\0')) return 1;
+    }
+    return 0;
+}
+
+// 1, 2, 4, ... e por último o máximo, mesmo que não seja potência de 2.
+static int next_thread_count(int threads) {
+    if (threads == config.max_threads) return threads + 1;
+    return threads * 2 > config.max_threads ? config.max_threads : threads * 2;
+}
+
+static int run_workload(const Workload* workload) {
+    Curve* workload_curves = &curves[curve_count];
+    int op_count = workload->ops[1] ? 2 : 1;
+    for (int i = 0; i < op_count; ++i) {
+        workload_curves[i].op = workload->ops[i];
+        workload_curves[i].points = 0;
+    }
+    curve_count += op_count;
+
+    for (int threads = 1; threads <= config.max_threads; threads = next_thread_count(threads)) {
+        // Servidor novo a cada ponto, para todos partirem do mesmo estado.
+        char dir[] = "/tmp/cabbage-scaling-XXXXXX";
+        if (!mkdtemp(dir)) {
+            perror("mkdtemp");
+            return -1;
+        }
+        char json_path[PATH_MAX];
+        snprintf(json_path, sizeof(json_path), "%s/bench.json", dir);
+
+        pid_t server = start_server(dir);
+        if (server < 0) return -1;
+        int result = run_bench(dir, workload->mix, threads, json_path);
+        stop_server(server);
+        char* json = result == 0 ? read_file(json_path) : NULL;
+        if (!json) return -1;
+
+        for (int i = 0; i < op_count; ++i) {
+            Curve* curve = &workload_curves[i];
+            double throughput = read_throughput(json, curve->op);
+            int point = curve->points++;
+            curve->threads[point] = threads;
+            curve->throughput[point] = throughput;
+            curve->efficiency[point] = curve->throughput[0] > 0 ? throughput / (threads * curve->throughput[0]) : 0.0;
+            printf("%-10s %8d %12.0f %8.2fx %10.2f\n", curve->op, threads, throughput,
+                   curve->throughput[0] > 0 ? throughput / curve->throughput[0] : 0.0, curve->efficiency[point]);
+            fflush(stdout);
+        }
+        free(json);
+        nftw(dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+    }
+    return 0;
+}
+
+static int write_baseline(void) {
+    FILE* out = fopen(config.baseline_path, "w");
+    if (!out) {
+        perror("fopen");
+        return -1;
+    }
+    fprintf(out, "# op threads efficiency (scaling-bench -n %d -d %g)\n", config.max_threads, config.duration_s);
+    for (int c = 0; c < curve_count; ++c) {
+        for (int p = 1; p < curves[c].points; ++p) {
+            fprintf(out, "%s %d %.3f\n", curves[c].op, curves[c].threads[p], curves[c].efficiency[p]);
+        }
+    }
+    return fclose(out);
+}
+
+// Retorna o número de pontos abaixo do baseline, ou -1 se não houver baseline.
+static int check_baseline(void) {
+    FILE* in = fopen(config.baseline_path, "r");
+    if (!in) return -1;
+    int failures = 0;
+    char line[256], op[64];
+    int threads;
+    double expected;
+    while (fgets(line, sizeof(line), in)) {
+        if (line[0] == '#' || sscanf(line, "%63s %d %lf", op, &threads, &expected) != 3) continue;
+        for (int c = 0; c < curve_count; ++c) {
+            if (strcmp(curves[c].op, op) != 0) continue;
+            for (int p = 0; p < curves[c].points; ++p) {
+                if (curves[c].threads[p] != threads) continue;
+                double minimum = expected * (1.0 - config.tolerance);
+                if (curves[c].efficiency[p] < minimum) {
+                    printf("FAIL %s with %d threads: efficiency %.2f, baseline %.2f (minimum %.2f)\n", op, threads,
+                           curves[c].efficiency[p], expected, minimum);
+                    failures++;
+                }
+            }
+        }
+    }
+    fclose(in);
+    return failures;
+}
+
+static int write_json(const char* path) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        perror("fopen");
+        return -1;
+    }
+    fprintf(out, "{\n  \"duration_s\": %.3f, \"preload\": %zu, \"max_threads\": %d,\n  \"curves\": {\n",
+            config.duration_s, config.preload, config.max_threads);
+    for (int c = 0; c < curve_count; ++c) {
+        fprintf(out, "    \"%s\": [", curves[c].op);
+        for (int p = 0; p < curves[c].points; ++p) {
+            fprintf(out, "%s{\"threads\": %d, \"throughput\": %.1f, \"efficiency\": %.3f}", p ? ", " : "",
+                    curves[c].threads[p], curves[c].throughput[p], curves[c].efficiency[p]);
+        }
+        fprintf(out, "]%s\n", c + 1 < curve_count ? "," : "");
+    }
+    fprintf(out, "  }\n}\n");
+    return fclose(out);
+}
+
+// O cabbage-server e o cabbage-bench ficam, por padrão, ao lado deste executável (bench/ e server/).
+static void default_paths(void) {
+    char self[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (length < 0) length = 0;
+    self[length] = '\0';
+    char* dir = dirname(self);
+    snprintf(config.server_path, sizeof(config.server_path), "%s/../server/cabbage-server", dir);
+    snprintf(config.bench_path, sizeof(config.bench_path), "%s/cabbage-bench", dir);
+    snprintf(config.baseline_path, sizeof(config.baseline_path), "%s/%s", dir, DEFAULT_BASELINE);
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options]\n", program);
+    fprintf(stderr, "  -n <threads>   largest client thread count (default: number of CPUs)\n");
+    fprintf(stderr, "  -d <seconds>   duration of each point (default: %d)\n", DEFAULT_DURATION_S);
+    fprintf(stderr, "  -p <movies>    movies added before each point (default: %d)\n", DEFAULT_PRELOAD);
+    fprintf(stderr, "  -x <list>      workloads to run, e.g. get,add (default: get,list,listgenre,addgenre,add)\n");
+    fprintf(stderr, "  -b <file>      baseline file (default: %s next to this program)\n", DEFAULT_BASELINE);
+    fprintf(stderr, "  -w             write the measured efficiencies as the new baseline\n");
+    fprintf(stderr, "  -a             don't fail when there is no baseline to compare with\n");
+    fprintf(stderr, "  -t <fraction>  allowed drop below the baseline efficiency (default: %.2f)\n", DEFAULT_TOLERANCE);
+    fprintf(stderr, "  -o <file>      write the curves as JSON\n");
+    fprintf(stderr, "  -P <port>      server port (default: %d)\n", DEFAULT_PORT);
+    fprintf(stderr, "  -s <path>      cabbage-server binary\n");
+    fprintf(stderr, "  -B <path>      cabbage-bench binary\n");
+}
+
+int main(int argc, char* argv[]) {
+    default_paths();
+    config.port = DEFAULT_PORT;
+    config.max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    config.duration_s = DEFAULT_DURATION_S;
+    config.preload = DEFAULT_PRELOAD;
+    config.tolerance = DEFAULT_TOLERANCE;
+
+    int c;
+    while ((c = getopt(argc, argv, "n:d:p:x:b:wat:o:P:s:B:h")) != -1) {
+        switch (c) {
+        case 'n': config.max_threads = atoi(optarg); break;
+        case 'd': config.duration_s = strtod(optarg, NULL); break;
+        case 'p': config.preload = strtoull(optarg, NULL, 10); break;
+        case 'x': config.only = optarg; break;
+        case 'b': snprintf(config.baseline_path, sizeof(config.baseline_path), "%s", optarg); break;
+        case 'w': config.write_baseline = 1; break;
+        case 'a': config.allow_missing = 1; break;
+        case 't': config.tolerance = strtod(optarg, NULL); break;
+        case 'o': config.json_path = optarg; break;
+        case 'P': config.port = atoi(optarg); break;
+        case 's': snprintf(config.server_path, sizeof(config.server_path), "%s", optarg); break;
+        case 'B': snprintf(config.bench_path, sizeof(config.bench_path), "%s", optarg); break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.max_threads < 1 || config.duration_s <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    // Checa antes de medir, para não descobrir só depois de alguns minutos.
+    if (!config.write_baseline && !config.allow_missing && access(config.baseline_path, R_OK) != 0) {
+        fprintf(stderr, "No baseline at %s (use -w to record one, or -a to run without it)\n", config.baseline_path);
+        return 1;
+    }
+
+    printf("Up to %d threads, %.1f s per point, %zu movies preloaded\n", config.max_threads, config.duration_s,
+           config.preload);
+    printf("%-10s %8s %12s %9s %10s\n", "op", "threads", "req/s", "speedup", "efficiency");
+    for (size_t w = 0; w < WORKLOAD_COUNT; ++w) {
+        if (!selected(workloads[w].name)) continue;
+        if (run_workload(&workloads[w]) < 0) return 1;
+    }
+
+    if (config.json_path && write_json(config.json_path) == 0) {
+        printf("Curves written to %s\n", config.json_path);
+    }
+    if (config.write_baseline) {
+        if (write_baseline() < 0) return 1;
+        printf("Baseline written to %s\n", config.baseline_path);
+        return 0;
+    }
+    int failures = check_baseline();
+    if (failures < 0) {
+        printf("No baseline at %s, nothing to compare (use -w to record one)\n", config.baseline_path);
+        return config.allow_missing ? 0 : 1;
+    }
+    if (failures > 0) {
+        printf("%d points below the baseline\n", failures);
+        return 1;
+    }
+    printf("All points within the baseline\n");
+    return 0;
+}
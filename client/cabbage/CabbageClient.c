@@ -0,0 +1,642 @@
+#include "CabbageClient.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "cabbage/common/util.h"
+
+#define READ_CHUNK (64 * 1024)
+#define MAX_EVENTS 64
+
+typedef enum {
+    CONN_DOWN,
+    CONN_CONNECTING,
+    CONN_UP,
+} ConnectionState;
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+typedef struct {
+    CabbageCallback callback;
+    void* arg;
+} Pending;
+
+typedef struct IoThread IoThread;
+
+typedef struct {
+    IoThread* io;
+    int fd;
+
+    // Protegido pelo mutex, acessado por quem envia e pela thread de I/O.
+    pthread_mutex_t mutex;
+    ConnectionState state;
+    Buffer queued;        // requisições serializadas que a thread de I/O ainda não pegou
+    int flush_scheduled;  // a thread de I/O já foi acordada para pegar 'queued'
+    Pending* pending;     // fila circular das requisições sem resposta, na ordem de envio
+    int head;
+    int count;
+
+    // Só da thread de I/O.
+    Buffer out;
+    size_t out_offset;
+    Buffer in;
+    int want_write;
+    u64 retry_at_ns;
+    int backoff_ms;
+} Connection;
+
+struct IoThread {
+    CabbageClient* client;
+    pthread_t thread;
+    int epoll_fd;
+    int wake_fd;
+    Connection** connections;
+    int connection_count;
+};
+
+struct CabbageClient {
+    CabbageClientConfig config;
+    struct sockaddr_in address;
+    Connection* connections;
+    IoThread* io_threads;
+    atomic_uint next_connection;
+    atomic_int stopping;
+
+    // Quem está esperando espaço em alguma conexão (todas com max_in_flight requisições).
+    pthread_mutex_t space_mutex;
+    pthread_cond_t space_cond;
+    atomic_int space_waiters;
+};
+
+struct CabbageFuture {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int done;
+    int status;
+    S2CPacket response;
+};
+
+static int buffer_reserve(Buffer* buffer, size_t extra) {
+    if (buffer->length + extra <= buffer->capacity) return 0;
+    size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+    while (capacity < buffer->length + extra) capacity *= 2;
+    char* data = realloc(buffer->data, capacity);
+    if (!data) return -1;
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+static void wake_space_waiters(CabbageClient* client) {
+    if (atomic_load(&client->space_waiters) == 0) return;
+    pthread_mutex_lock(&client->space_mutex);
+    pthread_cond_broadcast(&client->space_cond);
+    pthread_mutex_unlock(&client->space_mutex);
+}
+
+static void io_wake(IoThread* io) {
+    u64 one = 1;
+    ssize_t written = write(io->wake_fd, &one, sizeof(one));
+    (void)written;
+}
+
+static void set_events(Connection* conn, u32 events) {
+    struct epoll_event event = {.events = events, .data.ptr = conn};
+    epoll_ctl(conn->io->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+}
+
+static void set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// Falha todas as requisições da conexão. Os callbacks rodam fora do lock.
+static void fail_pending(Connection* conn, int max_in_flight) {
+    pthread_mutex_lock(&conn->mutex);
+    int count = conn->count;
+    Pending* failed = NULL;
+    if (count > 0) {
+        failed = malloc((size_t)count * sizeof(Pending));
+        for (int i = 0; failed && i < count; ++i) failed[i] = conn->pending[(conn->head + i) % max_in_flight];
+    }
+    conn->head = 0;
+    conn->count = 0;
+    conn->queued.length = 0;
+    conn->flush_scheduled = 0;
+    pthread_mutex_unlock(&conn->mutex);
+
+    for (int i = 0; failed && i < count; ++i) failed[i].callback(failed[i].arg, -1, NULL);
+    free(failed);
+}
+
+static void connection_down(Connection* conn) {
+    CabbageClient* client = conn->io->client;
+    if (conn->fd >= 0) {
+        epoll_ctl(conn->io->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+        close(conn->fd);
+        conn->fd = -1;
+    }
+    pthread_mutex_lock(&conn->mutex);
+    conn->state = CONN_DOWN;
+    pthread_mutex_unlock(&conn->mutex);
+    fail_pending(conn, client->config.max_in_flight);
+
+    conn->out.length = 0;
+    conn->out_offset = 0;
+    conn->in.length = 0;
+    conn->want_write = 0;
+    conn->retry_at_ns = now_ns() + (u64)conn->backoff_ms * 1000000ull;
+    conn->backoff_ms = conn->backoff_ms * 2 > client->config.reconnect_max_ms ? client->config.reconnect_max_ms
+                                                                              : conn->backoff_ms * 2;
+    // Quem esperava espaço pode precisar saber que não há mais conexões.
+    wake_space_waiters(client);
+}
+
+static void connection_up(Connection* conn) {
+    CabbageClient* client = conn->io->client;
+    set_events(conn, EPOLLIN);
+    pthread_mutex_lock(&conn->mutex);
+    conn->state = CONN_UP;
+    pthread_mutex_unlock(&conn->mutex);
+    conn->backoff_ms = client->config.reconnect_min_ms;
+    wake_space_waiters(client);
+}
+
+// Começa uma conexão (não bloqueante) pela thread de I/O.
+static void connection_start(Connection* conn) {
+    CabbageClient* client = conn->io->client;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        connection_down(conn);
+        return;
+    }
+    set_nonblocking(fd);
+    conn->fd = fd;
+    int result = connect(fd, (struct sockaddr*)&client->address, sizeof(client->address));
+    if (result < 0 && errno != EINPROGRESS) {
+        close(fd);
+        conn->fd = -1;
+        connection_down(conn);
+        return;
+    }
+    struct epoll_event event = {.events = EPOLLOUT, .data.ptr = conn};
+    epoll_ctl(conn->io->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    pthread_mutex_lock(&conn->mutex);
+    conn->state = CONN_CONNECTING;
+    pthread_mutex_unlock(&conn->mutex);
+    if (result == 0) connection_up(conn);
+}
+
+// Envia o que estiver no buffer de saída, pegando o que as outras threads enfileiraram enquanto isso.
+static void connection_flush(Connection* conn) {
+    while (1) {
+        if (conn->out_offset == conn->out.length) {
+            conn->out.length = 0;
+            conn->out_offset = 0;
+            pthread_mutex_lock(&conn->mutex);
+            Buffer swap = conn->out;
+            conn->out = conn->queued;
+            conn->queued = swap;
+            conn->flush_scheduled = 0;
+            pthread_mutex_unlock(&conn->mutex);
+            if (conn->out.length == 0) break;
+        }
+        ssize_t sent = send(conn->fd, conn->out.data + conn->out_offset, conn->out.length - conn->out_offset,
+                            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!conn->want_write) {
+                    conn->want_write = 1;
+                    set_events(conn, EPOLLIN | EPOLLOUT);
+                }
+                return;
+            }
+            connection_down(conn);
+            return;
+        }
+        packet_bytes_sent += (u64)sent;
+        conn->out_offset += (size_t)sent;
+    }
+    if (conn->want_write) {
+        conn->want_write = 0;
+        set_events(conn, EPOLLIN);
+    }
+}
+
+// Lê tudo o que chegou e entrega as respostas completas. O decode só é tentado depois de esvaziar o socket, para uma
+// resposta grande não ser decodificada de novo a cada pedaço que chega.
+static void connection_read(Connection* conn) {
+    CabbageClient* client = conn->io->client;
+    while (1) {
+        if (buffer_reserve(&conn->in, READ_CHUNK) < 0) {
+            connection_down(conn);
+            return;
+        }
+        ssize_t received = recv(conn->fd, conn->in.data + conn->in.length, conn->in.capacity - conn->in.length,
+                                MSG_DONTWAIT);
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            connection_down(conn);
+            return;
+        }
+        if (received == 0) {
+            connection_down(conn);
+            return;
+        }
+        packet_bytes_received += (u64)received;
+        conn->in.length += (size_t)received;
+    }
+
+    size_t offset = 0;
+    int completed = 0;
+    while (offset < conn->in.length) {
+        S2CPacket response;
+        ssize_t used = S2CPacket_decode(conn->in.data + offset, conn->in.length - offset, &response);
+        if (used == 0) break;
+        if (used < 0) {
+            connection_down(conn);
+            return;
+        }
+        offset += (size_t)used;
+
+        pthread_mutex_lock(&conn->mutex);
+        if (conn->count == 0) {
+            // Resposta sem requisição: o protocolo saiu de sincronia.
+            pthread_mutex_unlock(&conn->mutex);
+            S2CPacket_free(&response);
+            connection_down(conn);
+            return;
+        }
+        Pending pending = conn->pending[conn->head];
+        conn->head = (conn->head + 1) % client->config.max_in_flight;
+        conn->count--;
+        pthread_mutex_unlock(&conn->mutex);
+
+        pending.callback(pending.arg, 0, &response);
+        S2CPacket_free(&response);
+        completed++;
+    }
+    if (offset > 0) {
+        memmove(conn->in.data, conn->in.data + offset, conn->in.length - offset);
+        conn->in.length -= offset;
+    }
+    if (completed) wake_space_waiters(client);
+}
+
+static void* io_main(void* arg) {
+    IoThread* io = arg;
+    CabbageClient* client = io->client;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!atomic_load(&client->stopping)) {
+        // Espera até a próxima reconexão agendada.
+        int timeout = -1;
+        u64 now = now_ns();
+        for (int i = 0; i < io->connection_count; ++i) {
+            Connection* conn = io->connections[i];
+            if (conn->fd >= 0) continue;
+            if (conn->retry_at_ns <= now) {
+                connection_start(conn);
+                continue;
+            }
+            int wait_ms = (int)((conn->retry_at_ns - now + 999999) / 1000000);
+            if (timeout < 0 || wait_ms < timeout) timeout = wait_ms;
+        }
+
+        int n = epoll_wait(io->epoll_fd, events, MAX_EVENTS, timeout);
+        if (n < 0 && errno != EINTR) break;
+        for (int i = 0; i < n; ++i) {
+            Connection* conn = events[i].data.ptr;
+            if (!conn) {
+                u64 value;
+                ssize_t got = read(io->wake_fd, &value, sizeof(value));
+                (void)got;
+                for (int c = 0; c < io->connection_count; ++c) {
+                    Connection* other = io->connections[c];
+                    if (other->fd >= 0 && !other->want_write) {
+                        pthread_mutex_lock(&other->mutex);
+                        int up = other->state == CONN_UP;
+                        pthread_mutex_unlock(&other->mutex);
+                        if (up) connection_flush(other);
+                    }
+                }
+                continue;
+            }
+            if (conn->fd < 0) continue;
+
+            pthread_mutex_lock(&conn->mutex);
+            ConnectionState state = conn->state;
+            pthread_mutex_unlock(&conn->mutex);
+            if (state == CONN_CONNECTING) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                if (error != 0) connection_down(conn);
+                else connection_up(conn);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) connection_read(conn);
+            if (conn->fd >= 0 && (events[i].events & EPOLLOUT)) connection_flush(conn);
+        }
+    }
+    return NULL;
+}
+
+void CabbageClient_default_config(CabbageClientConfig* config) {
+    config->host = "127.0.0.1";
+    config->port = 12345;
+    config->connections = 4;
+    config->io_threads = 1;
+    config->max_in_flight = 128;
+    config->reconnect_min_ms = 50;
+    config->reconnect_max_ms = 5000;
+}
+
+// Conexão inicial, bloqueante, para o create já saber se o servidor está lá.
+static int connect_blocking(CabbageClient* client, Connection* conn) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&client->address, sizeof(client->address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    set_nonblocking(fd);
+    conn->fd = fd;
+    conn->state = CONN_UP;
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = conn};
+    epoll_ctl(conn->io->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    return 0;
+}
+
+CabbageClient* CabbageClient_create(const CabbageClientConfig* config) {
+    if (config->connections < 1 || config->io_threads < 1 || config->max_in_flight < 1) {
+        errno = EINVAL;
+        return NULL;
+    }
+    CabbageClient* client = calloc(1, sizeof(CabbageClient));
+    if (!client) return NULL;
+    client->config = *config;
+    if (client->config.io_threads > client->config.connections) client->config.io_threads = client->config.connections;
+    client->address.sin_family = AF_INET;
+    client->address.sin_port = htons((uint16_t)config->port);
+    if (inet_pton(AF_INET, config->host, &client->address.sin_addr) <= 0) {
+        free(client);
+        errno = EINVAL;
+        return NULL;
+    }
+    pthread_mutex_init(&client->space_mutex, NULL);
+    pthread_cond_init(&client->space_cond, NULL);
+
+    int io_count = client->config.io_threads;
+    client->connections = calloc((size_t)config->connections, sizeof(Connection));
+    client->io_threads = calloc((size_t)io_count, sizeof(IoThread));
+    if (!client->connections || !client->io_threads) goto fail;
+    for (int i = 0; i < config->connections; ++i) client->connections[i].fd = -1;
+    for (int t = 0; t < io_count; ++t) {
+        client->io_threads[t].epoll_fd = -1;
+        client->io_threads[t].wake_fd = -1;
+    }
+    for (int t = 0; t < io_count; ++t) {
+        IoThread* io = &client->io_threads[t];
+        io->client = client;
+        io->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        io->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        io->connections = calloc((size_t)config->connections, sizeof(Connection*));
+        if (io->epoll_fd < 0 || io->wake_fd < 0 || !io->connections) goto fail;
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+        epoll_ctl(io->epoll_fd, EPOLL_CTL_ADD, io->wake_fd, &event);
+    }
+
+    int connected = 0;
+    for (int i = 0; i < config->connections; ++i) {
+        Connection* conn = &client->connections[i];
+        conn->io = &client->io_threads[i % io_count];
+        conn->io->connections[conn->io->connection_count++] = conn;
+        conn->backoff_ms = config->reconnect_min_ms;
+        pthread_mutex_init(&conn->mutex, NULL);
+        conn->pending = calloc((size_t)config->max_in_flight, sizeof(Pending));
+        if (!conn->pending) goto fail;
+        if (connect_blocking(client, conn) == 0) connected++;
+        else conn->retry_at_ns = now_ns() + (u64)conn->backoff_ms * 1000000ull;
+    }
+    if (connected == 0) {
+        errno = ECONNREFUSED;
+        goto fail;
+    }
+
+    for (int t = 0; t < io_count; ++t) {
+        if (pthread_create(&client->io_threads[t].thread, NULL, io_main, &client->io_threads[t]) != 0) {
+            // As threads já criadas precisam parar antes de liberar tudo.
+            atomic_store(&client->stopping, 1);
+            for (int j = 0; j < t; ++j) {
+                io_wake(&client->io_threads[j]);
+                pthread_join(client->io_threads[j].thread, NULL);
+            }
+            goto fail;
+        }
+    }
+    return client;
+
+fail: {
+    int saved = errno;
+    for (int i = 0; client->connections && i < config->connections; ++i) {
+        if (client->connections[i].fd >= 0) close(client->connections[i].fd);
+        free(client->connections[i].pending);
+    }
+    for (int t = 0; client->io_threads && t < io_count; ++t) {
+        if (client->io_threads[t].epoll_fd >= 0) close(client->io_threads[t].epoll_fd);
+        if (client->io_threads[t].wake_fd >= 0) close(client->io_threads[t].wake_fd);
+        free(client->io_threads[t].connections);
+    }
+    free(client->connections);
+    free(client->io_threads);
+    free(client);
+    errno = saved;
+    return NULL;
+}
+}
+
+void CabbageClient_destroy(CabbageClient* client) {
+    if (!client) return;
+    atomic_store(&client->stopping, 1);
+    for (int t = 0; t < client->config.io_threads; ++t) {
+        io_wake(&client->io_threads[t]);
+        pthread_join(client->io_threads[t].thread, NULL);
+    }
+    wake_space_waiters(client);
+
+    for (int i = 0; i < client->config.connections; ++i) {
+        Connection* conn = &client->connections[i];
+        if (conn->fd >= 0) close(conn->fd);
+        fail_pending(conn, client->config.max_in_flight);
+        pthread_mutex_destroy(&conn->mutex);
+        free(conn->pending);
+        free(conn->queued.data);
+        free(conn->out.data);
+        free(conn->in.data);
+    }
+    for (int t = 0; t < client->config.io_threads; ++t) {
+        close(client->io_threads[t].epoll_fd);
+        close(client->io_threads[t].wake_fd);
+        free(client->io_threads[t].connections);
+    }
+    pthread_cond_destroy(&client->space_cond);
+    pthread_mutex_destroy(&client->space_mutex);
+    free(client->connections);
+    free(client->io_threads);
+    free(client);
+}
+
+// Retorna 0 se a requisição entrou em alguma conexão, 1 se todas as conexões ativas estão cheias e -1 (com errno) se
+// não há conexão ativa ou a requisição não pôde ser serializada.
+static int try_enqueue(CabbageClient* client, const C2SPacket* request, size_t size, CabbageCallback callback,
+                       void* arg) {
+    int connections = client->config.connections;
+    int max_in_flight = client->config.max_in_flight;
+    int any_up = 0;
+    unsigned start = atomic_fetch_add_explicit(&client->next_connection, 1, memory_order_relaxed);
+
+    for (int i = 0; i < connections; ++i) {
+        Connection* conn = &client->connections[(start + (unsigned)i) % (unsigned)connections];
+        pthread_mutex_lock(&conn->mutex);
+        if (conn->state != CONN_UP) {
+            pthread_mutex_unlock(&conn->mutex);
+            continue;
+        }
+        any_up = 1;
+        if (conn->count == max_in_flight) {
+            pthread_mutex_unlock(&conn->mutex);
+            continue;
+        }
+        if (buffer_reserve(&conn->queued, size) < 0) {
+            pthread_mutex_unlock(&conn->mutex);
+            errno = ENOMEM;
+            return -1;
+        }
+        if (C2SPacket_encode(request, conn->queued.data + conn->queued.length) < 0) {
+            pthread_mutex_unlock(&conn->mutex);
+            errno = EINVAL;
+            return -1;
+        }
+        conn->queued.length += size;
+        conn->pending[(conn->head + conn->count) % max_in_flight] = (Pending){callback, arg};
+        conn->count++;
+        int wake = !conn->flush_scheduled;
+        conn->flush_scheduled = 1;
+        pthread_mutex_unlock(&conn->mutex);
+        if (wake) io_wake(conn->io);
+        return 0;
+    }
+    if (any_up) return 1;
+    errno = ENOTCONN;
+    return -1;
+}
+
+int CabbageClient_submit(CabbageClient* client, const C2SPacket* request, CabbageCallback callback, void* arg) {
+    // A fila de cada conexão casa uma resposta com cada requisição; o export tem várias (ver cabbage-export).
+    if (request->type == C2S_EXPORT) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t size = C2SPacket_encoded_size(request);
+    while (1) {
+        if (atomic_load(&client->stopping)) {
+            errno = ESHUTDOWN;
+            return -1;
+        }
+        int result = try_enqueue(client, request, size, callback, arg);
+        if (result <= 0) return result;
+
+        // Tudo cheio: espera alguma resposta (ou uma conexão cair/voltar) e tenta de novo. O contador de espera é
+        // incrementado antes da segunda tentativa, então uma resposta que chegue entre ela e o wait acorda esta thread.
+        pthread_mutex_lock(&client->space_mutex);
+        atomic_fetch_add(&client->space_waiters, 1);
+        result = try_enqueue(client, request, size, callback, arg);
+        if (result == 1 && !atomic_load(&client->stopping)) {
+            pthread_cond_wait(&client->space_cond, &client->space_mutex);
+        }
+        atomic_fetch_sub(&client->space_waiters, 1);
+        pthread_mutex_unlock(&client->space_mutex);
+        if (result <= 0) return result;
+    }
+}
+
+static void future_complete(void* arg, int status, S2CPacket* response) {
+    CabbageFuture* future = arg;
+    pthread_mutex_lock(&future->mutex);
+    future->status = status;
+    if (response) {
+        future->response = *response;
+        response->type = S2C_UNKNOWN;
+    }
+    future->done = 1;
+    pthread_cond_signal(&future->cond);
+    pthread_mutex_unlock(&future->mutex);
+}
+
+CabbageFuture* CabbageClient_request(CabbageClient* client, const C2SPacket* request) {
+    CabbageFuture* future = calloc(1, sizeof(CabbageFuture));
+    if (!future) return NULL;
+    pthread_mutex_init(&future->mutex, NULL);
+    pthread_cond_init(&future->cond, NULL);
+    future->response.type = S2C_UNKNOWN;
+    if (CabbageClient_submit(client, request, future_complete, future) < 0) {
+        int saved = errno;
+        pthread_cond_destroy(&future->cond);
+        pthread_mutex_destroy(&future->mutex);
+        free(future);
+        errno = saved;
+        return NULL;
+    }
+    return future;
+}
+
+int CabbageFuture_wait(CabbageFuture* future, S2CPacket* response) {
+    pthread_mutex_lock(&future->mutex);
+    while (!future->done) pthread_cond_wait(&future->cond, &future->mutex);
+    pthread_mutex_unlock(&future->mutex);
+
+    int status = future->status;
+    if (response) *response = future->response;
+    else S2CPacket_free(&future->response);
+    pthread_cond_destroy(&future->cond);
+    pthread_mutex_destroy(&future->mutex);
+    free(future);
+    return status;
+}
+
+int CabbageClient_call(CabbageClient* client, const C2SPacket* request, S2CPacket* response) {
+    CabbageFuture* future = CabbageClient_request(client, request);
+    if (!future) return -1;
+    return CabbageFuture_wait(future, response);
+}
+
+int CabbageClient_connected(CabbageClient* client) {
+    int connected = 0;
+    for (int i = 0; i < client->config.connections; ++i) {
+        Connection* conn = &client->connections[i];
+        pthread_mutex_lock(&conn->mutex);
+        connected += conn->state == CONN_UP;
+        pthread_mutex_unlock(&conn->mutex);
+    }
+    return connected;
+}
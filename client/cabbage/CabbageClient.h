@@ -0,0 +1,63 @@
+#ifndef _CABBAGE_CLIENT_CABBAGECLIENT_H
+#define _CABBAGE_CLIENT_CABBAGECLIENT_H
+
+#include "cabbage/common/Packet.h"
+
+// Biblioteca de cliente (libcabbage-client.a): um pool de conexões com o servidor, compartilhado por quantas threads
+// da aplicação quiserem, com várias requisições em andamento por conexão.
+//
+// Cada conexão tem uma fila das requisições enviadas. O servidor responde na ordem em que recebe, então a próxima
+// resposta que chega é sempre da requisição mais antiga da fila. O envio e a leitura ficam com as threads de I/O
+// (epoll, sockets não bloqueantes): CabbageClient_submit só serializa a requisição no buffer de saída da conexão e
+// acorda a thread de I/O dela, e a resposta é lida com o S2CPacket_decode a partir do que já chegou.
+//
+// Quando uma conexão cai, as requisições dela terminam com status -1 (elas podem ou não ter sido executadas no
+// servidor) e a thread de I/O tenta reconectar, esperando de reconnect_min_ms até reconnect_max_ms entre as
+// tentativas. Enquanto isso, as requisições novas vão para as outras conexões.
+
+typedef struct CabbageClient CabbageClient;
+typedef struct CabbageFuture CabbageFuture;
+
+// Com status 0, 'response' é a resposta do servidor (que pode ser um S2C_ERROR). Com status -1, a conexão caiu
+// antes da resposta ou o cliente foi destruído, e 'response' é NULL.
+//
+// O callback roda na thread de I/O, então não pode bloquear (nem chamar CabbageClient_submit, que bloqueia quando
+// todas as conexões estão cheias). A resposta é liberada quando o callback retorna; para ficar com ela, copie o
+// S2CPacket e troque o tipo do original para S2C_UNKNOWN.
+typedef void (*CabbageCallback)(void* arg, int status, S2CPacket* response);
+
+typedef struct {
+    const char* host;
+    int port;
+    int connections;
+    int io_threads;
+    int max_in_flight;    // requisições em andamento por conexão
+    int reconnect_min_ms;
+    int reconnect_max_ms;
+} CabbageClientConfig;
+
+void CabbageClient_default_config(CabbageClientConfig* config);
+
+// Conecta o pool. Retorna NULL se nenhuma conexão pôde ser aberta.
+CabbageClient* CabbageClient_create(const CabbageClientConfig* config);
+
+// Fecha as conexões. As requisições que ainda não tiveram resposta terminam com status -1.
+void CabbageClient_destroy(CabbageClient* client);
+
+// Envia a requisição por uma conexão com espaço, bloqueando enquanto todas estão com max_in_flight requisições.
+// Retorna -1 (com errno) se nenhuma conexão estiver ativa ou se a requisição for inválida (inclusive um C2S_EXPORT,
+// que tem várias respostas); nesse caso o callback não é chamado.
+int CabbageClient_submit(CabbageClient* client, const C2SPacket* request, CabbageCallback callback, void* arg);
+
+// O mesmo, com o resultado em um future. CabbageFuture_wait espera a resposta, passa ela para 'response' (que deve
+// ser liberado com S2CPacket_free) e libera o future. Retorna o status do callback.
+CabbageFuture* CabbageClient_request(CabbageClient* client, const C2SPacket* request);
+int CabbageFuture_wait(CabbageFuture* future, S2CPacket* response);
+
+// Envia e espera a resposta.
+int CabbageClient_call(CabbageClient* client, const C2SPacket* request, S2CPacket* response);
+
+// Número de conexões ativas no momento.
+int CabbageClient_connected(CabbageClient* client);
+
+#endif // _CABBAGE_CLIENT_CABBAGECLIENT_H
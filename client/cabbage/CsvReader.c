@@ -0,0 +1,118 @@
+#include "CsvReader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define READ_BUFFER_SIZE (1024 * 1024)
+
+int CsvReader_init(CsvReader* reader, FILE* file, char delimiter, u64 offset, u64 line) {
+    memset(reader, 0, sizeof(*reader));
+    reader->file = file;
+    reader->delimiter = delimiter;
+    reader->offset = offset;
+    reader->line = line;
+    reader->buffer = malloc(READ_BUFFER_SIZE);
+    reader->record = malloc(CSV_MAX_RECORD);
+    if (!reader->buffer || !reader->record) {
+        CsvReader_free(reader);
+        return -1;
+    }
+    if (offset > 0 && fseeko(file, (off_t)offset, SEEK_SET) != 0) {
+        CsvReader_free(reader);
+        return -1;
+    }
+    return 0;
+}
+
+void CsvReader_free(CsvReader* reader) {
+    free(reader->buffer);
+    free(reader->record);
+    reader->buffer = NULL;
+    reader->record = NULL;
+}
+
+// Próximo byte (ou EOF), sem consumir. Retorna -2 em erro de leitura.
+static int peek_byte(CsvReader* reader) {
+    if (reader->buffer_pos == reader->buffer_len) {
+        reader->buffer_len = fread(reader->buffer, 1, READ_BUFFER_SIZE, reader->file);
+        reader->buffer_pos = 0;
+        if (reader->buffer_len == 0) return ferror(reader->file) ? -2 : EOF;
+    }
+    return (unsigned char)reader->buffer[reader->buffer_pos];
+}
+
+static int next_byte(CsvReader* reader) {
+    int c = peek_byte(reader);
+    if (c >= 0) {
+        reader->buffer_pos++;
+        reader->offset++;
+        if (c == '\n') reader->line++;
+    }
+    return c;
+}
+
+int CsvReader_next(CsvReader* reader) {
+    int quoting = reader->delimiter == ',';
+    size_t length = 0;
+    int too_long = 0;
+    int in_quotes = 0;
+    int field_empty = 1;  // nada foi lido no campo atual (aspas só abrem um campo no começo dele)
+    int record_empty = 1; // a linha não tem nenhum byte (linha vazia é ignorada)
+    reader->field_count = 1;
+    reader->fields[0] = reader->record;
+    reader->record_line = reader->line;
+
+    for (;;) {
+        int c = next_byte(reader);
+        if (c == -2) return CSV_ERROR;
+        if (c == EOF) {
+            if (record_empty) return CSV_EOF;
+            if (in_quotes) return CSV_UNTERMINATED;
+            break;
+        }
+        if (in_quotes) {
+            if (c == '"') {
+                if (peek_byte(reader) == '"') {
+                    next_byte(reader);
+                } else {
+                    in_quotes = 0;
+                    continue;
+                }
+            }
+        } else if (c == '"' && quoting && field_empty) {
+            in_quotes = 1;
+            field_empty = 0;
+            record_empty = 0;
+            continue;
+        } else if (c == (unsigned char)reader->delimiter) {
+            record_empty = 0;
+            field_empty = 1;
+            if (length == CSV_MAX_RECORD) {
+                too_long = 1;
+                continue;
+            }
+            reader->record[length++] = '\0';
+            if (reader->field_count < CSV_MAX_FIELDS) reader->fields[reader->field_count] = reader->record + length;
+            reader->field_count++;
+            continue;
+        } else if (c == '\n') {
+            if (record_empty) {
+                reader->record_line = reader->line;
+                continue;
+            }
+            break;
+        } else if (c == '\r' && peek_byte(reader) == '\n') {
+            continue;
+        }
+        record_empty = 0;
+        field_empty = 0;
+        if (length == CSV_MAX_RECORD) too_long = 1;
+        else reader->record[length++] = (char)c;
+    }
+
+    // O último campo também precisa do '\0'.
+    if (length == CSV_MAX_RECORD) too_long = 1;
+    if (too_long) return CSV_TOO_LONG;
+    reader->record[length] = '\0';
+    return CSV_ROW;
+}
@@ -0,0 +1,46 @@
+#ifndef _CABBAGE_CLIENT_CSVREADER_H
+#define _CABBAGE_CLIENT_CSVREADER_H
+
+#include <stdio.h>
+#include "cabbage/common/types.h"
+
+// Leitor de CSV/TSV em streaming, com memória limitada: um buffer de leitura fixo e um buffer para o registro atual,
+// de no máximo CSV_MAX_RECORD bytes. Registros maiores que isso são pulados (CSV_TOO_LONG), sem parar a leitura.
+//
+// Com vírgula como separador vale o formato do RFC 4180: campos entre aspas podem ter o separador, quebras de linha
+// e aspas duplicadas (""). Com TAB não existe quoting, como no TSV do IANA. Linhas vazias são ignoradas e o \r de
+// um \r\n é descartado. Um campo entre aspas que não fecha até o fim do arquivo é um erro (CSV_UNTERMINATED), não
+// um registro.
+
+#define CSV_MAX_RECORD (64 * 1024)
+#define CSV_MAX_FIELDS 16
+
+#define CSV_ROW 1
+#define CSV_EOF 0
+#define CSV_ERROR -1
+#define CSV_TOO_LONG -2
+#define CSV_UNTERMINATED -3
+
+typedef struct {
+    FILE* file;
+    char delimiter;
+    char* buffer;
+    size_t buffer_pos;
+    size_t buffer_len;
+    u64 offset;        // bytes já consumidos do arquivo (depois do último registro lido, é onde o próximo começa)
+    u64 line;          // linha atual (começando em 1)
+    u64 record_line;   // linha em que o último registro começou
+    char* record;
+    int field_count;
+    char* fields[CSV_MAX_FIELDS];
+} CsvReader;
+
+// Começa a ler de 'file' a partir da posição 'offset' (que deve ser o começo de um registro) e da linha 'line'.
+int CsvReader_init(CsvReader* reader, FILE* file, char delimiter, u64 offset, u64 line);
+void CsvReader_free(CsvReader* reader);
+
+// Lê o próximo registro. Com CSV_ROW, os campos ficam em reader->fields[0..field_count) até a próxima chamada.
+// Campos além de CSV_MAX_FIELDS são descartados, mas contados em field_count.
+int CsvReader_next(CsvReader* reader);
+
+#endif // _CABBAGE_CLIENT_CSVREADER_H
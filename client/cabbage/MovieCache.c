@@ -0,0 +1,528 @@
+#include "MovieCache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "cabbage/common/util.h"
+
+// Mesma mensagem do servidor, para uma entrada negativa responder igual a ele.
+#define NOT_FOUND_MESSAGE "Movie ID not found"
+
+// Tamanho médio esperado de uma entrada, só para dimensionar a tabela hash de cada shard.
+#define EXPECTED_ENTRY_BYTES 160
+
+typedef struct CacheEntry {
+    struct CacheEntry* next; // encadeamento do bucket
+    u32 id;
+    u32 slot;                // posição no anel do CLOCK
+    u64 version;
+    u8 removed;              // entrada negativa: o filme foi removido no servidor
+    u8 referenced;           // bit de referência do CLOCK
+    u32 epoch_hits;          // acertos desde a última verificação (ver MovieCacheStats.stale_hits)
+    u64 hit_epoch;
+    u64 checked_ns;          // última vez que a entrada foi confirmada com o servidor
+    size_t bytes;
+    char* title;             // as strings ficam em 'data', na mesma alocação
+    char* genres;
+    char* director;
+    char* release_year;
+    char data[];
+} CacheEntry;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    CacheEntry** buckets;
+    u32 bucket_mask;
+    CacheEntry** ring;
+    u32 ring_count;
+    u32 ring_capacity;
+    u32 hand;
+    size_t bytes;
+    size_t max_bytes;
+
+    // Muda quando uma mudança do servidor chega para um ID que não está no shard. Uma resposta de GET_MOVIE pedida
+    // antes disso pode ser mais velha que a mudança, então ela não entra no cache.
+    atomic_ullong generation;
+
+    u64 hits;
+    u64 misses;
+    u64 negative_hits;
+    u64 revalidations;
+    u64 not_modified;
+    u64 evictions;
+    u64 stale_entries;
+    u64 stale_hits;
+} CacheShard;
+
+struct MovieCache {
+    CabbageClient* client;
+    MovieCacheConfig config;
+    CacheShard* shards;
+
+    // Número do polling atual, para contar os acertos de cada entrada entre dois pollings.
+    atomic_ullong epoch;
+
+    pthread_t poller;
+    int has_poller;
+    pthread_mutex_t poll_mutex;
+    pthread_cond_t poll_cond;
+    int stopping;
+
+    // Protegidos pelo poll_mutex.
+    u64 version;
+    u64 polls;
+    u64 poll_errors;
+    u64 full_resyncs;
+    u64 last_sync_ns;
+    u64 max_sync_gap_ns;
+};
+
+// Os IDs são sequenciais, então o resto da divisão já espalha bem entre os shards e os buckets.
+static CacheShard* shard_of(MovieCache* cache, u32 id) {
+    return &cache->shards[id % (u32)cache->config.shards];
+}
+
+static CacheEntry** bucket_of(MovieCache* cache, CacheShard* shard, u32 id) {
+    return &shard->buckets[(id / (u32)cache->config.shards) & shard->bucket_mask];
+}
+
+static CacheEntry* shard_find(MovieCache* cache, CacheShard* shard, u32 id) {
+    for (CacheEntry* entry = *bucket_of(cache, shard, id); entry; entry = entry->next) {
+        if (entry->id == id) return entry;
+    }
+    return NULL;
+}
+
+static CacheEntry* entry_from_movie(const Movie* movie) {
+    size_t title = strlen(movie->title) + 1;
+    size_t genres = strlen(movie->genres) + 1;
+    size_t director = strlen(movie->director) + 1;
+    size_t year = strlen(movie->release_year) + 1;
+    size_t bytes = sizeof(CacheEntry) + title + genres + director + year;
+    CacheEntry* entry = calloc(1, bytes);
+    if (!entry) return NULL;
+    entry->id = movie->id;
+    entry->version = movie->version;
+    entry->bytes = bytes;
+    entry->title = memcpy(entry->data, movie->title, title);
+    entry->genres = memcpy(entry->title + title, movie->genres, genres);
+    entry->director = memcpy(entry->genres + genres, movie->director, director);
+    entry->release_year = memcpy(entry->director + director, movie->release_year, year);
+    return entry;
+}
+
+static CacheEntry* entry_removed(u32 id, u64 version) {
+    CacheEntry* entry = calloc(1, sizeof(CacheEntry));
+    if (!entry) return NULL;
+    entry->id = id;
+    entry->version = version;
+    entry->removed = 1;
+    entry->bytes = sizeof(CacheEntry);
+    return entry;
+}
+
+static int entry_response(const CacheEntry* entry, S2CPacket* response) {
+    memset(response, 0, sizeof(*response));
+    if (entry->removed) {
+        response->type = S2C_ERROR;
+        response->data.error.message = strdup(NOT_FOUND_MESSAGE);
+        return response->data.error.message ? 0 : -1;
+    }
+    response->type = S2C_MOVIE;
+    response->data.movie.id = entry->id;
+    response->data.movie.version = entry->version;
+    response->data.movie.title = strdup(entry->title);
+    response->data.movie.genres = strdup(entry->genres);
+    response->data.movie.director = strdup(entry->director);
+    response->data.movie.release_year = strdup(entry->release_year);
+    if (!response->data.movie.title || !response->data.movie.genres || !response->data.movie.director ||
+        !response->data.movie.release_year) {
+        S2CPacket_free(response);
+        return -1;
+    }
+    return 0;
+}
+
+static void entry_hit(MovieCache* cache, CacheEntry* entry) {
+    u64 epoch = atomic_load_explicit(&cache->epoch, memory_order_relaxed);
+    if (entry->hit_epoch != epoch) {
+        entry->hit_epoch = epoch;
+        entry->epoch_hits = 0;
+    }
+    entry->epoch_hits++;
+    entry->referenced = 1;
+}
+
+// A entrada acabou de ser confirmada pelo servidor, então os acertos anteriores não estavam atrasados.
+static void entry_checked(MovieCache* cache, CacheEntry* entry) {
+    entry->checked_ns = now_ns();
+    entry->hit_epoch = atomic_load_explicit(&cache->epoch, memory_order_relaxed);
+    entry->epoch_hits = 0;
+}
+
+// O servidor tem uma versão mais nova do filme: os acertos desde a última verificação podem ter sido desatualizados.
+static void entry_stale(MovieCache* cache, CacheShard* shard, const CacheEntry* entry) {
+    shard->stale_entries++;
+    if (entry->hit_epoch == atomic_load_explicit(&cache->epoch, memory_order_relaxed)) {
+        shard->stale_hits += entry->epoch_hits;
+    }
+}
+
+static void shard_unlink(MovieCache* cache, CacheShard* shard, CacheEntry* entry) {
+    CacheEntry** link = bucket_of(cache, shard, entry->id);
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+
+    // Tira do anel trocando com a última entrada; a ordem do CLOCK muda um pouco, mas não importa.
+    CacheEntry* last = shard->ring[--shard->ring_count];
+    shard->ring[entry->slot] = last;
+    last->slot = entry->slot;
+    if (shard->hand >= shard->ring_count) shard->hand = 0;
+
+    shard->bytes -= entry->bytes;
+    free(entry);
+}
+
+static void shard_evict(MovieCache* cache, CacheShard* shard, size_t needed) {
+    while (shard->ring_count > 0 && shard->bytes + needed > shard->max_bytes) {
+        CacheEntry* entry = shard->ring[shard->hand];
+        if (entry->referenced) {
+            entry->referenced = 0;
+            shard->hand = (shard->hand + 1) % shard->ring_count;
+            continue;
+        }
+        shard_unlink(cache, shard, entry);
+        shard->evictions++;
+    }
+}
+
+// Coloca a entrada no shard, no lugar de 'old' se houver. Se não couber, a entrada é descartada.
+static void shard_put(MovieCache* cache, CacheShard* shard, CacheEntry* old, CacheEntry* entry) {
+    if (old) {
+        entry->referenced = old->referenced;
+        shard_unlink(cache, shard, old);
+    }
+    if (entry->bytes > shard->max_bytes) {
+        free(entry);
+        return;
+    }
+    shard_evict(cache, shard, entry->bytes);
+    if (shard->ring_count == shard->ring_capacity) {
+        u32 capacity = shard->ring_capacity ? shard->ring_capacity * 2 : 64;
+        CacheEntry** ring = realloc(shard->ring, capacity * sizeof(CacheEntry*));
+        if (!ring) {
+            free(entry);
+            return;
+        }
+        shard->ring = ring;
+        shard->ring_capacity = capacity;
+    }
+    entry->slot = shard->ring_count;
+    shard->ring[shard->ring_count++] = entry;
+    CacheEntry** bucket = bucket_of(cache, shard, entry->id);
+    entry->next = *bucket;
+    *bucket = entry;
+    shard->bytes += entry->bytes;
+    entry_checked(cache, entry);
+}
+
+static void shard_clear(MovieCache* cache, CacheShard* shard) {
+    while (shard->ring_count > 0) shard_unlink(cache, shard, shard->ring[shard->ring_count - 1]);
+}
+
+// --- Polling do LIST_CHANGES_SINCE ---
+
+static void apply_changes(MovieCache* cache, const S2C_MovieChangesData* changes) {
+    if (changes->full) {
+        // O servidor não tem mais o histórico desde a nossa versão; sem saber o que mudou, o cache recomeça vazio.
+        for (int i = 0; i < cache->config.shards; ++i) {
+            CacheShard* shard = &cache->shards[i];
+            pthread_mutex_lock(&shard->mutex);
+            atomic_fetch_add(&shard->generation, 1);
+            shard_clear(cache, shard);
+            pthread_mutex_unlock(&shard->mutex);
+        }
+        return;
+    }
+
+    for (u32 i = 0; i < changes->count; ++i) {
+        const Movie* movie = &changes->movies[i];
+        CacheShard* shard = shard_of(cache, movie->id);
+        pthread_mutex_lock(&shard->mutex);
+        CacheEntry* entry = shard_find(cache, shard, movie->id);
+        if (!entry) {
+            atomic_fetch_add(&shard->generation, 1);
+        } else if (!entry->removed && entry->version < movie->version) {
+            entry_stale(cache, shard, entry);
+            CacheEntry* updated = entry_from_movie(movie);
+            if (updated) shard_put(cache, shard, entry, updated);
+            else shard_unlink(cache, shard, entry);
+        }
+        pthread_mutex_unlock(&shard->mutex);
+    }
+
+    for (u32 i = 0; i < changes->removed_count; ++i) {
+        u32 id = changes->removed_ids[i];
+        CacheShard* shard = shard_of(cache, id);
+        pthread_mutex_lock(&shard->mutex);
+        CacheEntry* entry = shard_find(cache, shard, id);
+        if (!entry) {
+            atomic_fetch_add(&shard->generation, 1);
+        } else if (!entry->removed) {
+            entry_stale(cache, shard, entry);
+            CacheEntry* removed = entry_removed(id, changes->version);
+            if (removed) shard_put(cache, shard, entry, removed);
+            else shard_unlink(cache, shard, entry);
+        }
+        pthread_mutex_unlock(&shard->mutex);
+    }
+}
+
+static void* poller_main(void* arg) {
+    MovieCache* cache = arg;
+    pthread_mutex_lock(&cache->poll_mutex);
+    while (!cache->stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        u64 nanos = (u64)deadline.tv_nsec + (u64)cache->config.poll_ms * 1000000ull;
+        deadline.tv_sec += (time_t)(nanos / 1000000000ull);
+        deadline.tv_nsec = (long)(nanos % 1000000000ull);
+        while (!cache->stopping && pthread_cond_timedwait(&cache->poll_cond, &cache->poll_mutex, &deadline) != ETIMEDOUT) {}
+        if (cache->stopping) break;
+
+        C2SPacket request = {.type = C2S_LIST_CHANGES_SINCE};
+        request.data.list_changes.since_version = cache->version;
+        pthread_mutex_unlock(&cache->poll_mutex);
+
+        S2CPacket response;
+        int ok = 0;
+        int full = 0;
+        u64 version = 0;
+        if (CabbageClient_call(cache->client, &request, &response) == 0) {
+            if (response.type == S2C_NOT_MODIFIED) {
+                version = response.data.not_modified.version;
+                ok = 1;
+            } else if (response.type == S2C_MOVIE_CHANGES) {
+                apply_changes(cache, &response.data.movie_changes);
+                version = response.data.movie_changes.version;
+                full = response.data.movie_changes.full;
+                ok = 1;
+            }
+            S2CPacket_free(&response);
+        }
+
+        pthread_mutex_lock(&cache->poll_mutex);
+        if (ok) {
+            u64 now = now_ns();
+            if (cache->last_sync_ns && now - cache->last_sync_ns > cache->max_sync_gap_ns) {
+                cache->max_sync_gap_ns = now - cache->last_sync_ns;
+            }
+            cache->last_sync_ns = now;
+            cache->version = version;
+            cache->polls++;
+            if (full) cache->full_resyncs++;
+            atomic_fetch_add(&cache->epoch, 1);
+        } else {
+            cache->poll_errors++;
+        }
+    }
+    pthread_mutex_unlock(&cache->poll_mutex);
+    return NULL;
+}
+
+// --- API ---
+
+void MovieCache_default_config(MovieCacheConfig* config) {
+    config->max_bytes = 32 * 1024 * 1024;
+    config->shards = 16;
+    config->poll_ms = 100;
+    config->max_age_ms = 0;
+}
+
+MovieCache* MovieCache_create(CabbageClient* client, const MovieCacheConfig* config) {
+    if (!client || config->shards < 1 || config->poll_ms < 0 || config->max_age_ms < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    MovieCache* cache = calloc(1, sizeof(MovieCache));
+    if (!cache) return NULL;
+    cache->client = client;
+    cache->config = *config;
+    cache->shards = calloc((size_t)config->shards, sizeof(CacheShard));
+    if (!cache->shards) {
+        free(cache);
+        return NULL;
+    }
+
+    pthread_mutex_init(&cache->poll_mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cache->poll_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    size_t shard_bytes = config->max_bytes / (size_t)config->shards;
+    size_t expected = shard_bytes / EXPECTED_ENTRY_BYTES;
+    u32 bucket_count = 16;
+    while (bucket_count < expected && bucket_count < (1u << 20)) bucket_count *= 2;
+    for (int i = 0; i < config->shards; ++i) pthread_mutex_init(&cache->shards[i].mutex, NULL);
+    for (int i = 0; i < config->shards; ++i) {
+        CacheShard* shard = &cache->shards[i];
+        shard->max_bytes = shard_bytes;
+        shard->bucket_mask = bucket_count - 1;
+        shard->buckets = calloc(bucket_count, sizeof(CacheEntry*));
+        if (!shard->buckets) {
+            MovieCache_destroy(cache);
+            return NULL;
+        }
+    }
+
+    if (config->poll_ms > 0) {
+        if (pthread_create(&cache->poller, NULL, poller_main, cache) != 0) {
+            MovieCache_destroy(cache);
+            return NULL;
+        }
+        cache->has_poller = 1;
+    }
+    return cache;
+}
+
+void MovieCache_destroy(MovieCache* cache) {
+    if (!cache) return;
+    if (cache->has_poller) {
+        pthread_mutex_lock(&cache->poll_mutex);
+        cache->stopping = 1;
+        pthread_cond_signal(&cache->poll_cond);
+        pthread_mutex_unlock(&cache->poll_mutex);
+        pthread_join(cache->poller, NULL);
+    }
+    for (int i = 0; i < cache->config.shards; ++i) {
+        CacheShard* shard = &cache->shards[i];
+        if (shard->buckets) shard_clear(cache, shard);
+        free(shard->buckets);
+        free(shard->ring);
+        pthread_mutex_destroy(&shard->mutex);
+    }
+    pthread_mutex_destroy(&cache->poll_mutex);
+    pthread_cond_destroy(&cache->poll_cond);
+    free(cache->shards);
+    free(cache);
+}
+
+int MovieCache_get(MovieCache* cache, u32 movie_id, S2CPacket* response) {
+    CacheShard* shard = shard_of(cache, movie_id);
+    u64 max_age_ns = (u64)cache->config.max_age_ms * 1000000ull;
+
+    pthread_mutex_lock(&shard->mutex);
+    CacheEntry* entry = shard_find(cache, shard, movie_id);
+    u64 if_version = 0;
+    int revalidating = 0;
+    if (entry) {
+        // Um filme removido nunca volta, então a entrada negativa não precisa de revalidação.
+        if (entry->removed || max_age_ns == 0 || now_ns() - entry->checked_ns < max_age_ns) {
+            entry_hit(cache, entry);
+            shard->hits++;
+            if (entry->removed) shard->negative_hits++;
+            int result = entry_response(entry, response);
+            pthread_mutex_unlock(&shard->mutex);
+            if (result < 0) errno = ENOMEM;
+            return result;
+        }
+        if_version = entry->version;
+        revalidating = 1;
+        shard->revalidations++;
+    } else {
+        shard->misses++;
+    }
+    u64 generation = atomic_load(&shard->generation);
+    pthread_mutex_unlock(&shard->mutex);
+
+    for (;;) {
+        C2SPacket request = {.type = C2S_GET_MOVIE};
+        request.data.get_movie.movie_id = movie_id;
+        request.data.get_movie.if_version = if_version;
+        if (CabbageClient_call(cache->client, &request, response) < 0) return -1;
+
+        pthread_mutex_lock(&shard->mutex);
+        entry = shard_find(cache, shard, movie_id);
+        if (response->type == S2C_NOT_MODIFIED) {
+            if (entry && !entry->removed && entry->version == if_version) {
+                entry_checked(cache, entry);
+                entry_hit(cache, entry);
+                shard->not_modified++;
+                shard->hits++;
+                S2CPacket_free(response);
+                int result = entry_response(entry, response);
+                pthread_mutex_unlock(&shard->mutex);
+                if (result < 0) errno = ENOMEM;
+                return result;
+            }
+            // A entrada saiu do cache (ou mudou) enquanto a revalidação estava em andamento: pede o filme inteiro.
+            pthread_mutex_unlock(&shard->mutex);
+            S2CPacket_free(response);
+            generation = atomic_load(&shard->generation);
+            if_version = 0;
+            continue;
+        }
+
+        CacheEntry* fresh = NULL;
+        if (response->type == S2C_MOVIE) {
+            // Só entra se for mais nova que o que já está no cache, e se nenhuma mudança que o cache não tinha como
+            // aplicar chegou enquanto o pedido estava em andamento.
+            int newer = entry ? !entry->removed && entry->version < response->data.movie.version
+                              : atomic_load(&shard->generation) == generation;
+            if (newer) fresh = entry_from_movie(&response->data.movie);
+        } else if (response->type == S2C_ERROR && entry && !entry->removed && response->data.error.message &&
+                   strcmp(response->data.error.message, NOT_FOUND_MESSAGE) == 0) {
+            // O filme estava no cache e não existe mais. (Uma mensagem de erro vazia chega como NULL.)
+            fresh = entry_removed(movie_id, entry->version);
+        }
+        if (fresh) {
+            if (entry && revalidating) entry_stale(cache, shard, entry);
+            shard_put(cache, shard, entry, fresh);
+        }
+        if (revalidating) shard->misses++;
+        pthread_mutex_unlock(&shard->mutex);
+        return 0;
+    }
+}
+
+void MovieCache_invalidate(MovieCache* cache, u32 movie_id) {
+    CacheShard* shard = shard_of(cache, movie_id);
+    pthread_mutex_lock(&shard->mutex);
+    CacheEntry* entry = shard_find(cache, shard, movie_id);
+    if (entry) shard_unlink(cache, shard, entry);
+    atomic_fetch_add(&shard->generation, 1);
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+void MovieCache_stats(MovieCache* cache, MovieCacheStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int i = 0; i < cache->config.shards; ++i) {
+        CacheShard* shard = &cache->shards[i];
+        pthread_mutex_lock(&shard->mutex);
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->negative_hits += shard->negative_hits;
+        stats->revalidations += shard->revalidations;
+        stats->not_modified += shard->not_modified;
+        stats->evictions += shard->evictions;
+        stats->entries += shard->ring_count;
+        stats->bytes += shard->bytes;
+        stats->stale_entries += shard->stale_entries;
+        stats->stale_hits += shard->stale_hits;
+        pthread_mutex_unlock(&shard->mutex);
+    }
+
+    pthread_mutex_lock(&cache->poll_mutex);
+    stats->version = cache->version;
+    stats->polls = cache->polls;
+    stats->poll_errors = cache->poll_errors;
+    stats->full_resyncs = cache->full_resyncs;
+    if (cache->last_sync_ns) stats->sync_age_ms = (now_ns() - cache->last_sync_ns) / 1000000ull;
+    stats->max_sync_gap_ms = cache->max_sync_gap_ns / 1000000ull;
+    pthread_mutex_unlock(&cache->poll_mutex);
+}
@@ -0,0 +1,73 @@
+#ifndef _CABBAGE_CLIENT_MOVIECACHE_H
+#define _CABBAGE_CLIENT_MOVIECACHE_H
+
+#include <stddef.h>
+#include "CabbageClient.h"
+
+// Cache local de filmes (GET_MOVIE) em cima de um CabbageClient, para aplicações que leem muito mais do que escrevem.
+//
+// As entradas ficam em shards, cada um com o seu mutex, uma tabela hash por ID e um anel do CLOCK para a remoção:
+// quando o shard passa do seu pedaço de max_bytes, o ponteiro do relógio anda pelo anel tirando o bit de referência
+// das entradas usadas desde a última volta e remove a primeira que não foi usada.
+//
+// A coerência vem de duas formas, que podem ser usadas juntas:
+//   - poll_ms: uma thread pede LIST_CHANGES_SINCE a cada poll_ms e aplica as mudanças (filmes modificados trocam a
+//     entrada, filmes removidos viram uma entrada negativa, que responde "Movie ID not found"). Quando o servidor
+//     responde com a listagem completa (histórico expirado), o cache é esvaziado. Uma leitura pode ficar até poll_ms
+//     (mais o tempo da resposta) atrasada em relação ao servidor.
+//   - max_age_ms: uma entrada mais velha que isso é revalidada com GET_MOVIE + if_version antes de ser usada; se o
+//     filme não mudou, o servidor responde só com NOT_MODIFIED.
+// Com os dois em 0 as entradas nunca são revalidadas (só faz sentido se mais ninguém escreve na store).
+//
+// Os IDs nunca são reaproveitados pelo servidor, então uma entrada negativa nunca volta a ser um filme, e uma resposta
+// que chega depois de uma mudança mais nova (versão menor que a da entrada) é descartada.
+
+typedef struct MovieCache MovieCache;
+
+typedef struct {
+    size_t max_bytes;    // limite de memória das entradas (structs + strings), dividido entre os shards
+    int shards;
+    int poll_ms;         // intervalo do LIST_CHANGES_SINCE (0 desliga)
+    int max_age_ms;      // idade máxima antes da revalidação com if_version (0 desliga)
+} MovieCacheConfig;
+
+typedef struct {
+    u64 hits;
+    u64 misses;
+    u64 negative_hits;       // acertos em entradas negativas (filme removido), incluídos em hits
+    u64 revalidations;       // GET_MOVIE com if_version por causa do max_age_ms
+    u64 not_modified;        // revalidações respondidas com NOT_MODIFIED
+    u64 evictions;
+    u64 entries;
+    u64 bytes;
+
+    // Staleness: uma entrada é "velha" quando o polling ou uma revalidação descobre que o filme mudou. stale_hits
+    // conta os acertos que essas entradas tiveram desde a verificação anterior (um limite superior das respostas
+    // desatualizadas que o cache deu).
+    u64 stale_entries;
+    u64 stale_hits;
+
+    u64 version;             // versão da store até onde as mudanças já foram aplicadas
+    u64 polls;
+    u64 poll_errors;
+    u64 full_resyncs;        // respostas completas do LIST_CHANGES_SINCE (cache esvaziado)
+    u64 sync_age_ms;         // tempo desde o último polling com sucesso (atraso máximo atual do cache)
+    u64 max_sync_gap_ms;     // maior intervalo entre dois pollings com sucesso
+} MovieCacheStats;
+
+void MovieCache_default_config(MovieCacheConfig* config);
+
+// O cliente continua sendo do chamador e deve ser destruído depois do cache.
+MovieCache* MovieCache_create(CabbageClient* client, const MovieCacheConfig* config);
+void MovieCache_destroy(MovieCache* cache);
+
+// Mesmo contrato do CabbageClient_call com um C2S_GET_MOVIE: retorna 0 com a resposta em 'response' (S2C_MOVIE ou
+// S2C_ERROR, liberada com S2CPacket_free) ou -1 se o servidor não pôde ser consultado.
+int MovieCache_get(MovieCache* cache, u32 movie_id, S2CPacket* response);
+
+// Tira um filme do cache (por exemplo, depois de um ADD_GENRE feito pela própria aplicação, para não esperar o polling).
+void MovieCache_invalidate(MovieCache* cache, u32 movie_id);
+
+void MovieCache_stats(MovieCache* cache, MovieCacheStats* stats);
+
+#endif // _CABBAGE_CLIENT_MOVIECACHE_H
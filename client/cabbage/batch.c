@@ -0,0 +1,357 @@
+#include "batch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "cabbage/common/Packet.h"
+#include "cabbage/common/util.h"
+#include "command.h"
+
+#define BATCH_LINE_SIZE 2048
+#define BATCH_COMMAND_SIZE 16
+
+// Um comando inválido: não é enviado, mas a linha dele ainda precisa sair na ordem.
+typedef struct {
+    u64 line;
+    char command[BATCH_COMMAND_SIZE];
+} BatchInvalid;
+
+// Uma requisição enviada. Os comandos inválidos que vieram depois dela (antes da próxima requisição) ficam em
+// 'deferred' e saem logo depois da resposta, sem ocupar um lugar da fila.
+typedef struct {
+    u64 line;
+    char command[BATCH_COMMAND_SIZE];
+    u64 sent_ns;
+    BatchInvalid* deferred;
+    int deferred_count;
+    int deferred_capacity;
+} BatchEntry;
+
+typedef struct {
+    int sockfd;
+    FILE* input;
+    int depth;
+
+    // Fila circular das requisições em andamento. Só o escritor aumenta 'count' e só o leitor diminui, depois de
+    // receber a resposta, então nunca há mais que 'depth' requisições esperando resposta no servidor.
+    BatchEntry* entries;
+    int head;
+    int count;
+    int done;
+    int failed;
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+
+    u64* latencies;
+    size_t latency_count;
+    size_t latency_capacity;
+    u64 errors;
+    u64 invalid;
+} Batch;
+
+static void print_json_movie(const Movie* movie) {
+    printf("{\"id\":%u,\"title\":", movie->id);
+    json_write_string(stdout, movie->title);
+    fputs(",\"genres\":", stdout);
+    json_write_string(stdout, movie->genres);
+    fputs(",\"director\":", stdout);
+    json_write_string(stdout, movie->director);
+    fputs(",\"year\":", stdout);
+    json_write_string(stdout, movie->release_year);
+    printf(",\"version\":%llu}", (unsigned long long)movie->version);
+}
+
+static void print_json_movies(const Movie* movies, u32 count) {
+    putchar('[');
+    for (u32 i = 0; i < count; ++i) {
+        if (i) putchar(',');
+        print_json_movie(&movies[i]);
+    }
+    putchar(']');
+}
+
+// Os campos de cada tipo de resposta, depois de "type".
+static void print_json_reply(const S2CPacket* packet) {
+    switch (packet->type) {
+    case S2C_MOVIE:
+        fputs("\"movie\",\"movie\":", stdout);
+        print_json_movie(&packet->data.movie);
+        break;
+    case S2C_MOVIE_LIST:
+        printf("\"movie_list\",\"version\":%llu,\"movies\":[", (unsigned long long)packet->data.movie_list.version);
+        for (u32 i = 0; i < packet->data.movie_list.count; ++i) {
+            printf("%s{\"id\":%u,\"title\":", i ? "," : "", packet->data.movie_list.movies[i].id);
+            json_write_string(stdout, packet->data.movie_list.movies[i].title);
+            putchar('}');
+        }
+        putchar(']');
+        break;
+    case S2C_MOVIE_LIST_DETAILED:
+        printf("\"movie_list_detailed\",\"version\":%llu,\"movies\":",
+               (unsigned long long)packet->data.movie_list_detailed.version);
+        print_json_movies(packet->data.movie_list_detailed.movies, packet->data.movie_list_detailed.count);
+        break;
+    case S2C_MOVIES:
+        fputs("\"movies\",\"movies\":", stdout);
+        print_json_movies(packet->data.movies.movies, packet->data.movies.count);
+        fputs(",\"missing\":[", stdout);
+        for (u32 i = 0; i < packet->data.movies.missing_count; ++i) {
+            printf("%s%u", i ? "," : "", packet->data.movies.missing_ids[i]);
+        }
+        putchar(']');
+        break;
+    case S2C_ERROR:
+        fputs("\"error\",\"error\":", stdout);
+        json_write_string(stdout, packet->data.error.message);
+        break;
+    case S2C_OK:
+        fputs("\"ok\"", stdout);
+        break;
+    case S2C_NOT_MODIFIED:
+        printf("\"not_modified\",\"version\":%llu", (unsigned long long)packet->data.not_modified.version);
+        break;
+    case S2C_MOVIE_CHANGES:
+        printf("\"movie_changes\",\"version\":%llu,\"full\":%s,\"movies\":",
+               (unsigned long long)packet->data.movie_changes.version,
+               packet->data.movie_changes.full ? "true" : "false");
+        print_json_movies(packet->data.movie_changes.movies, packet->data.movie_changes.count);
+        fputs(",\"removed\":[", stdout);
+        for (u32 i = 0; i < packet->data.movie_changes.removed_count; ++i) {
+            printf("%s%u", i ? "," : "", packet->data.movie_changes.removed_ids[i]);
+        }
+        putchar(']');
+        break;
+    case S2C_STATS:
+        fputs("\"stats\",\"counters\":{", stdout);
+        for (u32 i = 0; i < packet->data.stats.counter_count; ++i) {
+            if (i) putchar(',');
+            json_write_string(stdout, packet->data.stats.counters[i].name);
+            printf(":%llu", (unsigned long long)packet->data.stats.counters[i].value);
+        }
+        fputs("},\"latencies\":[", stdout);
+        for (u32 i = 0; i < packet->data.stats.latency_count; ++i) {
+            const S2C_StatsLatency* item = &packet->data.stats.latencies[i];
+            fputs(i ? ",{\"name\":" : "{\"name\":", stdout);
+            json_write_string(stdout, item->name);
+            printf(",\"count\":%llu,\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f}",
+                   (unsigned long long)item->count, item->p50_ns / 1e3, item->p99_ns / 1e3, item->p999_ns / 1e3,
+                   item->max_ns / 1e3);
+        }
+        putchar(']');
+        break;
+    default:
+        printf("\"unknown\",\"code\":%u", packet->type);
+        break;
+    }
+}
+
+static void print_json_prefix(const BatchEntry* entry, const char* status) {
+    printf("{\"line\":%llu,\"command\":", (unsigned long long)entry->line);
+    json_write_string(stdout, entry->command);
+    printf(",\"status\":\"%s\"", status);
+}
+
+// Com o mutex, para não se misturar com a outra thread.
+static void print_invalid(Batch* batch, const BatchInvalid* invalid) {
+    printf("{\"line\":%llu,\"command\":", (unsigned long long)invalid->line);
+    json_write_string(stdout, invalid->command);
+    fputs(",\"status\":\"invalid\",\"error\":\"Invalid command or incorrect number of arguments\"}\n", stdout);
+    batch->invalid++;
+}
+
+// Com o mutex: imprime o comando inválido agora se não há nada em andamento, ou guarda ele para sair depois da
+// resposta da última requisição enviada.
+static void report_invalid(Batch* batch, const BatchInvalid* invalid) {
+    if (batch->count == 0) {
+        print_invalid(batch, invalid);
+        return;
+    }
+    BatchEntry* last = &batch->entries[(batch->head + batch->count - 1) % batch->depth];
+    if (last->deferred_count == last->deferred_capacity) {
+        int capacity = last->deferred_capacity ? last->deferred_capacity * 2 : 4;
+        BatchInvalid* deferred = realloc(last->deferred, (size_t)capacity * sizeof(BatchInvalid));
+        if (!deferred) {
+            // Sem memória, sai fora de ordem mas não se perde.
+            print_invalid(batch, invalid);
+            return;
+        }
+        last->deferred = deferred;
+        last->deferred_capacity = capacity;
+    }
+    last->deferred[last->deferred_count++] = *invalid;
+}
+
+static void record_latency(Batch* batch, u64 latency) {
+    if (batch->latency_count == batch->latency_capacity) {
+        size_t capacity = batch->latency_capacity ? batch->latency_capacity * 2 : 1024;
+        u64* latencies = realloc(batch->latencies, capacity * sizeof(u64));
+        if (!latencies) return;
+        batch->latencies = latencies;
+        batch->latency_capacity = capacity;
+    }
+    batch->latencies[batch->latency_count++] = latency;
+}
+
+static void fail(Batch* batch) {
+    pthread_mutex_lock(&batch->mutex);
+    batch->failed = 1;
+    pthread_cond_broadcast(&batch->changed);
+    pthread_mutex_unlock(&batch->mutex);
+    // Acorda a outra thread se ela estiver presa em um send/recv.
+    shutdown(batch->sockfd, SHUT_RDWR);
+}
+
+static void* batch_writer(void* arg) {
+    Batch* batch = arg;
+    char line[BATCH_LINE_SIZE];
+    u64 number = 0;
+
+    while (fgets(line, sizeof(line), batch->input)) {
+        number++;
+        line[strcspn(line, "\n")] = '\0';
+        char* args[MAX_ARGS];
+        int arg_count = parse_command_line(line, args, MAX_ARGS);
+        if (arg_count == 0 || (arg_count > 0 && args[0][0] == '#')) continue;
+        if (arg_count > 0 && (strcmp(args[0], "quit") == 0 || strcmp(args[0], "exit") == 0)) break;
+
+        C2SPacket request;
+        if (arg_count < 0 || build_request(args, arg_count, &request) < 0) {
+            BatchInvalid invalid = {.line = number};
+            snprintf(invalid.command, sizeof(invalid.command), "%s", arg_count > 0 ? args[0] : "");
+            pthread_mutex_lock(&batch->mutex);
+            report_invalid(batch, &invalid);
+            pthread_mutex_unlock(&batch->mutex);
+            continue;
+        }
+
+        pthread_mutex_lock(&batch->mutex);
+        while (batch->count == batch->depth && !batch->failed) {
+            pthread_cond_wait(&batch->changed, &batch->mutex);
+        }
+        int failed = batch->failed;
+        BatchEntry* entry = &batch->entries[(batch->head + batch->count) % batch->depth];
+        pthread_mutex_unlock(&batch->mutex);
+        if (failed) break;
+
+        // O leitor só olha a entrada depois do count++, então ela pode ser preenchida fora do lock.
+        entry->line = number;
+        snprintf(entry->command, sizeof(entry->command), "%s", args[0]);
+        entry->deferred_count = 0;
+        entry->sent_ns = now_ns();
+        if (C2SPacket_send(batch->sockfd, &request) < 0) {
+            perror("C2SPacket_send error");
+            fail(batch);
+            break;
+        }
+
+        pthread_mutex_lock(&batch->mutex);
+        batch->count++;
+        pthread_cond_broadcast(&batch->changed);
+        pthread_mutex_unlock(&batch->mutex);
+    }
+
+    pthread_mutex_lock(&batch->mutex);
+    batch->done = 1;
+    pthread_cond_broadcast(&batch->changed);
+    pthread_mutex_unlock(&batch->mutex);
+    return NULL;
+}
+
+// Recebe as respostas na ordem em que as requisições saíram.
+static void batch_reader(Batch* batch) {
+    while (1) {
+        pthread_mutex_lock(&batch->mutex);
+        while (batch->count == 0 && !batch->done && !batch->failed) {
+            pthread_cond_wait(&batch->changed, &batch->mutex);
+        }
+        if (batch->count == 0 || batch->failed) {
+            pthread_mutex_unlock(&batch->mutex);
+            return;
+        }
+        BatchEntry* entry = &batch->entries[batch->head];
+        pthread_mutex_unlock(&batch->mutex);
+
+        S2CPacket response;
+        memset(&response, 0, sizeof(response));
+        if (S2CPacket_recv(batch->sockfd, &response) < 0) {
+            perror("S2CPacket_recv error");
+            fail(batch);
+            return;
+        }
+        u64 latency = now_ns() - entry->sent_ns;
+        record_latency(batch, latency);
+        int error = response.type == S2C_ERROR;
+        if (error) batch->errors++;
+        print_json_prefix(entry, error ? "error" : "ok");
+        printf(",\"latency_us\":%.1f,\"type\":", latency / 1e3);
+        print_json_reply(&response);
+        fputs("}\n", stdout);
+        S2CPacket_free(&response);
+
+        // Os inválidos guardados saem junto com a liberação da entrada, no mesmo lock: o escritor só imprime direto
+        // quando a fila está vazia, então nada passa na frente deles.
+        pthread_mutex_lock(&batch->mutex);
+        for (int i = 0; i < entry->deferred_count; ++i) print_invalid(batch, &entry->deferred[i]);
+        entry->deferred_count = 0;
+        batch->head = (batch->head + 1) % batch->depth;
+        batch->count--;
+        pthread_cond_broadcast(&batch->changed);
+        pthread_mutex_unlock(&batch->mutex);
+    }
+}
+
+static int compare_u64(const void* a, const void* b) {
+    u64 x = *(const u64*)a, y = *(const u64*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_us(const u64* sorted, size_t count, double percentile) {
+    if (count == 0) return 0.0;
+    size_t index = (size_t)(percentile / 100.0 * (double)(count - 1) + 0.5);
+    return sorted[index] / 1e3;
+}
+
+int batch_run(int sockfd, FILE* input, int depth) {
+    Batch batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.sockfd = sockfd;
+    batch.input = input;
+    batch.depth = depth > 0 ? depth : 1;
+    batch.entries = calloc((size_t)batch.depth, sizeof(BatchEntry));
+    if (!batch.entries) {
+        perror("calloc");
+        return -1;
+    }
+    pthread_mutex_init(&batch.mutex, NULL);
+    pthread_cond_init(&batch.changed, NULL);
+
+    u64 start = now_ns();
+    pthread_t writer;
+    if (pthread_create(&writer, NULL, batch_writer, &batch) != 0) {
+        perror("pthread_create");
+        free(batch.entries);
+        return -1;
+    }
+    batch_reader(&batch);
+    pthread_join(writer, NULL);
+    double elapsed = (double)(now_ns() - start) / 1e9;
+    fflush(stdout);
+
+    qsort(batch.latencies, batch.latency_count, sizeof(u64), compare_u64);
+    fprintf(stderr, "Batch: %zu requests (%llu errors, %llu invalid commands) in %.3f s, %.0f requests/s, depth %d\n",
+            batch.latency_count, (unsigned long long)batch.errors, (unsigned long long)batch.invalid, elapsed,
+            elapsed > 0 ? batch.latency_count / elapsed : 0.0, batch.depth);
+    fprintf(stderr, "Latency (us): p50 %.1f, p99 %.1f, p999 %.1f, max %.1f\n",
+            percentile_us(batch.latencies, batch.latency_count, 50.0),
+            percentile_us(batch.latencies, batch.latency_count, 99.0),
+            percentile_us(batch.latencies, batch.latency_count, 99.9),
+            percentile_us(batch.latencies, batch.latency_count, 100.0));
+
+    pthread_cond_destroy(&batch.changed);
+    pthread_mutex_destroy(&batch.mutex);
+    free(batch.latencies);
+    for (int i = 0; i < batch.depth; ++i) free(batch.entries[i].deferred);
+    free(batch.entries);
+    return batch.failed ? -1 : 0;
+}
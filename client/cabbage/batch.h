@@ -0,0 +1,14 @@
+#ifndef _CABBAGE_CLIENT_BATCH_H
+#define _CABBAGE_CLIENT_BATCH_H
+
+#include <stdio.h>
+
+// Modo batch do cliente: lê os comandos de 'input' (um por linha, mesma sintaxe do modo interativo, linhas vazias e
+// começando com '#' são ignoradas) e mantém até 'depth' requisições em andamento na conexão. O servidor responde na
+// ordem em que recebe, então uma thread envia e outra recebe, casando cada resposta com a requisição mais antiga.
+//
+// Cada resposta vira uma linha JSON em stdout, na ordem dos comandos, e um resumo com a vazão e a latência sai em
+// stderr no final. Retorna 0 se todas as requisições foram respondidas (mesmo que com erro) e -1 se a conexão caiu.
+int batch_run(int sockfd, FILE* input, int depth);
+
+#endif // _CABBAGE_CLIENT_BATCH_H
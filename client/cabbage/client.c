@@ -3,19 +3,21 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <errno.h>
-#include <ctype.h>
 
 #include "cabbage/common/Packet.h"
+#include "command.h"
+#include "batch.h"
 
 // Implementação de um CLI simples para interagir com o servidor de filmes
 
 #define DEFAULT_IP "127.0.0.1"
 #define DEFAULT_PORT 12345
 #define INPUT_BUFFER_SIZE 2048
-#define MAX_ARGS 10
+#define DEFAULT_BATCH_DEPTH 32
 
 void print_movie(const Movie* movie) {
     if (!movie) return;
@@ -24,6 +26,7 @@ void print_movie(const Movie* movie) {
     printf("  Genres: %s\n", movie->genres ? movie->genres : "(null)");
     printf("  Director: %s\n", movie->director ? movie->director : "(null)");
     printf("  Year: %s\n", movie->release_year ? movie->release_year : "(null)");
+    printf("  Version: %llu\n", (unsigned long long)movie->version);
 }
 
 void print_s2c_packet(S2CPacket *packet) {
@@ -32,6 +35,7 @@ void print_s2c_packet(S2CPacket *packet) {
             print_movie(&packet->data.movie);
             break;
         case S2C_MOVIE_LIST:
+            printf("Version: %llu\n", (unsigned long long)packet->data.movie_list.version);
             printf("Count: %u\n", packet->data.movie_list.count);
             for (u32 i = 0; i < packet->data.movie_list.count; ++i) {
                 printf("  %u - %s\n", packet->data.movie_list.movies[i].id,
@@ -39,6 +43,7 @@ void print_s2c_packet(S2CPacket *packet) {
             }
             break;
         case S2C_MOVIE_LIST_DETAILED:
+            printf("Version: %llu\n", (unsigned long long)packet->data.movie_list_detailed.version);
             printf("Count: %u\n", packet->data.movie_list_detailed.count);
             for (u32 i = 0; i < packet->data.movie_list_detailed.count; ++i) {
                 printf(" Movie %u/%u:\n", i + 1, packet->data.movie_list_detailed.count);
@@ -46,12 +51,54 @@ void print_s2c_packet(S2CPacket *packet) {
                 if (i < packet->data.movie_list_detailed.count - 1) printf(" -----\n");
             }
             break;
+        case S2C_MOVIES:
+            printf("Found: %u\n", packet->data.movies.count);
+            for (u32 i = 0; i < packet->data.movies.count; ++i) {
+                print_movie(&packet->data.movies.movies[i]);
+                if (i < packet->data.movies.count - 1) printf(" -----\n");
+            }
+            printf("Not found: %u\n", packet->data.movies.missing_count);
+            for (u32 i = 0; i < packet->data.movies.missing_count; ++i) {
+                printf("  %u\n", packet->data.movies.missing_ids[i]);
+            }
+            break;
         case S2C_ERROR:
             printf("Error: %s\n", packet->data.error.message ? packet->data.error.message : "(null)");
             break;
         case S2C_OK:
             printf("Success!\n");
             break;
+        case S2C_NOT_MODIFIED:
+            printf("Not modified (version %llu)\n", (unsigned long long)packet->data.not_modified.version);
+            break;
+        case S2C_MOVIE_CHANGES:
+            printf("Version: %llu%s\n", (unsigned long long)packet->data.movie_changes.version,
+                   packet->data.movie_changes.full ? " (full listing, history expired)" : "");
+            printf("Changed: %u\n", packet->data.movie_changes.count);
+            for (u32 i = 0; i < packet->data.movie_changes.count; ++i) {
+                print_movie(&packet->data.movie_changes.movies[i]);
+                if (i < packet->data.movie_changes.count - 1) printf(" -----\n");
+            }
+            printf("Removed: %u\n", packet->data.movie_changes.removed_count);
+            for (u32 i = 0; i < packet->data.movie_changes.removed_count; ++i) {
+                printf("  %u\n", packet->data.movie_changes.removed_ids[i]);
+            }
+            break;
+        case S2C_STATS:
+            printf("Counters:\n");
+            for (u32 i = 0; i < packet->data.stats.counter_count; ++i) {
+                printf("  %-22s %llu\n", packet->data.stats.counters[i].name ? packet->data.stats.counters[i].name : "(null)",
+                       (unsigned long long)packet->data.stats.counters[i].value);
+            }
+            printf("Latency (us):\n");
+            printf("  %-22s %10s %10s %10s %10s %10s\n", "type", "count", "p50", "p99", "p999", "max");
+            for (u32 i = 0; i < packet->data.stats.latency_count; ++i) {
+                const S2C_StatsLatency* item = &packet->data.stats.latencies[i];
+                printf("  %-22s %10llu %10.1f %10.1f %10.1f %10.1f\n", item->name ? item->name : "(null)",
+                       (unsigned long long)item->count, item->p50_ns / 1e3, item->p99_ns / 1e3,
+                       item->p999_ns / 1e3, item->max_ns / 1e3);
+            }
+            break;
         default:
             printf("Unknown packet (%u)\n", packet->type);
             break;
@@ -64,77 +111,63 @@ void print_usage() {
     printf("  add \"<title>\" \"<genres>\" \"<director>\" \"<year>\"\n");
     printf("    Adds a new movie. Use quotes (\") for arguments with spaces.\n");
     printf("    Genres field should be comma-separated (e.g., \"Action,Comedy\").\n");
-    printf("  list\n");
+    printf("  list [version]\n");
     printf("    Lists all movies (ID and Title).\n");
-    printf("  listd\n");
+    printf("  listd [version]\n");
     printf("    Lists all movies with details.\n");
-    printf("  get <movie_id>\n");
+    printf("  get <movie_id> [version]\n");
     printf("    Gets details for a specific movie ID.\n");
+    printf("  getm <movie_id> [movie_id...]\n");
+    printf("    Gets details for several movie IDs in one request, plus the IDs that do not exist.\n");
     printf("  remove <movie_id>\n");
     printf("    Removes a movie by its ID.\n");
     printf("  addgenre <movie_id> <genre>\n");
     printf("    Adds a single genre to a movie. Genre name should not contain spaces/commas.\n");
-    printf("  listgenre <genre> | \"<genre with spaces>\"\n");
+    printf("  listgenre <genre> | \"<genre with spaces>\" [version]\n");
     printf("    Lists movies matching the genre. Use quotes for genres with spaces.\n");
+    printf("  changes <version>\n");
+    printf("    Lists movies added/modified and IDs removed since the given store version.\n");
+    printf("  stats\n");
+    printf("    Shows the server counters and p50/p99/p999 latency per request type.\n");
+    printf("  The optional [version] makes the server answer 'Not modified' if nothing changed since it.\n");
     printf("  help\n");
     printf("    Displays this help message.\n");
     printf("  quit | exit\n");
     printf("    Disconnects and exits.\n");
 }
 
-
-int parse_command_line(char* input, char** args, int max_args) {
-    int argc = 0;
-    char* p = input;
-
-    while (*p != '\0' && argc < max_args) {
-        while (*p != '\0' && isspace((unsigned char)*p)) {
-            p++;
-        }
-        if (*p == '\0') {
-            break;
-        }
-
-        if (*p == '"') {
-            args[argc] = ++p;
-            char* end_quote = strchr(p, '"');
-            if (end_quote == NULL) {
-                 fprintf(stderr, "Error: Unmatched quote in command.\n");
-                 return -1;
-            }
-            *end_quote = '\0';
-            p = end_quote + 1;
-        } else {
-            args[argc] = p;
-            while (*p != '\0' && !isspace((unsigned char)*p)) {
-                p++;
-            }
-            if (*p != '\0') {
-                *p = '\0';
-                p++;
-            }
-        }
-        argc++;
-    }
-    return argc;
+void print_program_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-b <file|->] [-p <depth>] <server_ip> <server_port>\n", program);
+    fprintf(stderr, "  -b <file|->  batch mode: run the commands in <file> (or stdin) and print one JSON line per reply\n");
+    fprintf(stderr, "  -p <depth>   requests in flight in batch mode (default: %d)\n", DEFAULT_BATCH_DEPTH);
 }
 
-
 int main(int argc, char* argv[]) {
     const char* server_ip = DEFAULT_IP;
     int server_port = DEFAULT_PORT;
+    const char* batch_path = NULL;
+    int batch_depth = DEFAULT_BATCH_DEPTH;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:p:h")) != -1) {
+        switch (opt) {
+        case 'b': batch_path = optarg; break;
+        case 'p': batch_depth = atoi(optarg); break;
+        default:
+            print_program_usage(argv[0]);
+            return 1;
+        }
+    }
 
     // Sem ip padrão, pra facilitar a mensagem de erro.
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <server_ip> <server_port>\n", argv[0]);
+    if (optind >= argc || batch_depth < 1) {
+        print_program_usage(argv[0]);
         return 1;
     }
 
-    if (argc >= 2) {
-        server_ip = argv[1];
-    }
-    if (argc >= 3) {
-        server_port = atoi(argv[2]);
+    server_ip = argv[optind++];
+    if (optind < argc) {
+        server_port = atoi(argv[optind]);
     }
 
     int sockfd;
@@ -159,11 +192,27 @@ int main(int argc, char* argv[]) {
 
     if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
         perror("Connection Failed");
-        fprintf(stderr, "Usage: %s <server_ip> <server_port>\n", argv[0]);
+        print_program_usage(argv[0]);
         close(sockfd);
         return 1;
     }
 
+    if (batch_path) {
+        // Sem Nagle, senão as requisições em sequência esperam o ACK atrasado das anteriores.
+        int one = 1;
+        setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        FILE* input = strcmp(batch_path, "-") == 0 ? stdin : fopen(batch_path, "r");
+        if (!input) {
+            perror(batch_path);
+            close(sockfd);
+            return 1;
+        }
+        int result = batch_run(sockfd, input, batch_depth);
+        if (input != stdin) fclose(input);
+        close(sockfd);
+        return result < 0 ? 1 : 0;
+    }
+
     printf("Connected to server %s:%d\n", server_ip, server_port);
     printf("Enter commands (type 'help' for options, 'quit' or 'exit' to stop):\n");
 
@@ -202,35 +251,9 @@ int main(int argc, char* argv[]) {
         }
 
         C2SPacket request_packet;
-        memset(&request_packet, 0, sizeof(C2SPacket));
-        int valid_command = 1;
-
-        if (strcmp(args[0], "add") == 0 && arg_count == 5) {
-            request_packet.type = C2S_ADD_MOVIE;
-            request_packet.data.add_movie.title = args[1];
-            request_packet.data.add_movie.genres = args[2];
-            request_packet.data.add_movie.director = args[3];
-            request_packet.data.add_movie.release_year = args[4];
-        } else if (strcmp(args[0], "list") == 0 && arg_count == 1) {
-            request_packet.type = C2S_LIST_MOVIES;
-        } else if (strcmp(args[0], "listd") == 0 && arg_count == 1) {
-            request_packet.type = C2S_LIST_MOVIES_DETAILED;
-        } else if (strcmp(args[0], "get") == 0 && arg_count == 2) {
-            request_packet.type = C2S_GET_MOVIE;
-            request_packet.data.get_movie.movie_id = (u32)strtoul(args[1], NULL, 10);
-        } else if (strcmp(args[0], "remove") == 0 && arg_count == 2) {
-            request_packet.type = C2S_REMOVE_MOVIE;
-            request_packet.data.remove_movie.movie_id = (u32)strtoul(args[1], NULL, 10);
-        } else if (strcmp(args[0], "addgenre") == 0 && arg_count == 3) {
-            request_packet.type = C2S_ADD_GENRE_TO_MOVIE;
-            request_packet.data.add_genre.movie_id = (u32)strtoul(args[1], NULL, 10);
-            request_packet.data.add_genre.genre = args[2];
-        } else if (strcmp(args[0], "listgenre") == 0 && arg_count == 2) {
-            request_packet.type = C2S_LIST_MOVIES_BY_GENRE;
-            request_packet.data.list_by_genre.genre = args[1];
-        } else {
+        int valid_command = build_request(args, arg_count, &request_packet) == 0;
+        if (!valid_command) {
             fprintf(stderr, "Error: Invalid command or incorrect number of arguments. Type 'help' for usage.\n");
-            valid_command = 0;
         }
 
         if (valid_command) {
@@ -0,0 +1,91 @@
+#include "command.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+int parse_command_line(char* input, char** args, int max_args) {
+    int argc = 0;
+    char* p = input;
+
+    while (*p != '\0' && argc < max_args) {
+        while (*p != '\0' && isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+
+        if (*p == '"') {
+            args[argc] = ++p;
+            char* end_quote = strchr(p, '"');
+            if (end_quote == NULL) {
+                 fprintf(stderr, "Error: Unmatched quote in command.\n");
+                 return -1;
+            }
+            *end_quote = '\0';
+            p = end_quote + 1;
+        } else {
+            args[argc] = p;
+            while (*p != '\0' && !isspace((unsigned char)*p)) {
+                p++;
+            }
+            if (*p != '\0') {
+                *p = '\0';
+                p++;
+            }
+        }
+        argc++;
+    }
+    return argc;
+}
+
+static _Thread_local u32 request_ids[MAX_ARGS];
+
+int build_request(char** args, int arg_count, C2SPacket* request) {
+    memset(request, 0, sizeof(C2SPacket));
+
+    if (strcmp(args[0], "add") == 0 && arg_count == 5) {
+        request->type = C2S_ADD_MOVIE;
+        request->data.add_movie.title = args[1];
+        request->data.add_movie.genres = args[2];
+        request->data.add_movie.director = args[3];
+        request->data.add_movie.release_year = args[4];
+    } else if (strcmp(args[0], "list") == 0 && (arg_count == 1 || arg_count == 2)) {
+        request->type = C2S_LIST_MOVIES;
+        if (arg_count == 2) request->data.list.if_version = strtoull(args[1], NULL, 10);
+    } else if (strcmp(args[0], "listd") == 0 && (arg_count == 1 || arg_count == 2)) {
+        request->type = C2S_LIST_MOVIES_DETAILED;
+        if (arg_count == 2) request->data.list.if_version = strtoull(args[1], NULL, 10);
+    } else if (strcmp(args[0], "get") == 0 && (arg_count == 2 || arg_count == 3)) {
+        request->type = C2S_GET_MOVIE;
+        request->data.get_movie.movie_id = (u32)strtoul(args[1], NULL, 10);
+        if (arg_count == 3) request->data.get_movie.if_version = strtoull(args[2], NULL, 10);
+    } else if (strcmp(args[0], "getm") == 0 && arg_count >= 2) {
+        request->type = C2S_GET_MOVIES;
+        request->data.get_movies.count = (u32)(arg_count - 1);
+        request->data.get_movies.movie_ids = request_ids;
+        for (int i = 1; i < arg_count; ++i) {
+            request_ids[i - 1] = (u32)strtoul(args[i], NULL, 10);
+        }
+    } else if (strcmp(args[0], "remove") == 0 && arg_count == 2) {
+        request->type = C2S_REMOVE_MOVIE;
+        request->data.remove_movie.movie_id = (u32)strtoul(args[1], NULL, 10);
+    } else if (strcmp(args[0], "addgenre") == 0 && arg_count == 3) {
+        request->type = C2S_ADD_GENRE_TO_MOVIE;
+        request->data.add_genre.movie_id = (u32)strtoul(args[1], NULL, 10);
+        request->data.add_genre.genre = args[2];
+    } else if (strcmp(args[0], "listgenre") == 0 && (arg_count == 2 || arg_count == 3)) {
+        request->type = C2S_LIST_MOVIES_BY_GENRE;
+        request->data.list_by_genre.genre = args[1];
+        if (arg_count == 3) request->data.list_by_genre.if_version = strtoull(args[2], NULL, 10);
+    } else if (strcmp(args[0], "changes") == 0 && arg_count == 2) {
+        request->type = C2S_LIST_CHANGES_SINCE;
+        request->data.list_changes.since_version = strtoull(args[1], NULL, 10);
+    } else if (strcmp(args[0], "stats") == 0 && arg_count == 1) {
+        request->type = C2S_STATS;
+    } else {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef _CABBAGE_CLIENT_COMMAND_H
+#define _CABBAGE_CLIENT_COMMAND_H
+
+#include "cabbage/common/Packet.h"
+
+// Interpretação dos comandos do cliente, compartilhada pelo modo interativo e pelo modo batch (batch.h).
+
+// Grande o bastante para um getm com uma página inteira de IDs.
+#define MAX_ARGS 256
+
+// Separa a linha em argumentos (aspas agrupam argumentos com espaços), modificando 'input'. Retorna o número de
+// argumentos ou -1 se alguma aspa não foi fechada.
+int parse_command_line(char* input, char** args, int max_args);
+
+// Monta o pacote de um comando já separado. As strings do pacote apontam para 'args' (e os IDs do getm para um buffer
+// da thread, válido até a próxima chamada). Retorna -1 se o comando não existe ou o número de argumentos está errado.
+int build_request(char** args, int arg_count, C2SPacket* request);
+
+#endif // _CABBAGE_CLIENT_COMMAND_H
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "cabbage/common/Packet.h"
+#include "cabbage/common/util.h"
+
+// cabbage-export: exporta o catálogo para CSV ou JSON Lines com o C2S_EXPORT.
+//
+// O servidor manda os filmes em S2C_MOVIE_CHUNKs enquanto percorre a tabela, e cada chunk é escrito e liberado antes
+// do próximo ser lido, então a memória usada é a de um chunk, qualquer que seja o tamanho do catálogo. O CSV sai com
+// as mesmas colunas que o cabbage-import lê (title, genres, director, year); o JSON Lines inclui também o id e a versão.
+//
+// Com -o, a saída é escrita em <arquivo>.tmp e renomeada no final, então um export que falha no meio não deixa um
+// arquivo pela metade no lugar do anterior.
+
+#define DEFAULT_IP "127.0.0.1"
+#define DEFAULT_PORT 12345
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+#define PROGRESS_INTERVAL_NS 1000000000ull
+
+typedef enum {
+    FORMAT_CSV,
+    FORMAT_JSONL,
+} format_t;
+
+// Campos com separador, aspas ou quebra de linha vão entre aspas, com as aspas duplicadas (RFC 4180).
+static void write_csv_field(FILE* out, const char* text) {
+    if (!text) text = "";
+    if (!strpbrk(text, ",\"\r\n")) {
+        fputs(text, out);
+        return;
+    }
+    putc('"', out);
+    for (const char* p = text; *p; ++p) {
+        if (*p == '"') putc('"', out);
+        putc(*p, out);
+    }
+    putc('"', out);
+}
+
+static void write_movie(FILE* out, format_t format, const Movie* movie) {
+    if (format == FORMAT_CSV) {
+        write_csv_field(out, movie->title);
+        putc(',', out);
+        write_csv_field(out, movie->genres);
+        putc(',', out);
+        write_csv_field(out, movie->director);
+        putc(',', out);
+        write_csv_field(out, movie->release_year);
+        putc('\n', out);
+        return;
+    }
+    fprintf(out, "{\"id\":%u,\"title\":", movie->id);
+    json_write_string(out, movie->title);
+    fputs(",\"genres\":", out);
+    json_write_string(out, movie->genres);
+    fputs(",\"director\":", out);
+    json_write_string(out, movie->director);
+    fputs(",\"year\":", out);
+    json_write_string(out, movie->release_year);
+    fprintf(out, ",\"version\":%llu}\n", (unsigned long long)movie->version);
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] [host] [port]\n", program);
+    fprintf(stderr, "  -o <file>         output file (default: standard output)\n");
+    fprintf(stderr, "  -f csv|jsonl      output format (default: jsonl for *.jsonl and *.json, csv otherwise)\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* host = DEFAULT_IP;
+    int port = DEFAULT_PORT;
+    const char* output_path = NULL;
+    int format = -1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:f:h")) != -1) {
+        switch (opt) {
+        case 'o': output_path = optarg; break;
+        case 'f':
+            if (strcmp(optarg, "csv") == 0) format = FORMAT_CSV;
+            else if (strcmp(optarg, "jsonl") == 0) format = FORMAT_JSONL;
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc) host = argv[optind++];
+    if (optind < argc) port = atoi(argv[optind++]);
+    if (format < 0) {
+        const char* extension = output_path ? strrchr(output_path, '.') : NULL;
+        format = extension && (strcasecmp(extension, ".jsonl") == 0 || strcasecmp(extension, ".json") == 0)
+                     ? FORMAT_JSONL
+                     : FORMAT_CSV;
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((u16)port);
+    if (inet_pton(AF_INET, host, &address.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid address: %s\n", host);
+        return 1;
+    }
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0 || connect(sockfd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        fprintf(stderr, "Could not connect to %s:%d: %s\n", host, port, strerror(errno));
+        return 1;
+    }
+
+    char temp_path[4096];
+    FILE* out = stdout;
+    if (output_path) {
+        snprintf(temp_path, sizeof(temp_path), "%s.tmp", output_path);
+        out = fopen(temp_path, "w");
+        if (!out) {
+            fprintf(stderr, "Could not create %s: %s\n", temp_path, strerror(errno));
+            return 1;
+        }
+    }
+    setvbuf(out, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+    if (format == FORMAT_CSV) fputs("title,genres,director,year\n", out);
+
+    C2SPacket request = {.type = C2S_EXPORT};
+    if (C2SPacket_send(sockfd, &request) < 0) {
+        fprintf(stderr, "Failed to send the export request: %s\n", strerror(errno));
+        return 1;
+    }
+
+    u64 started_ns = now_ns();
+    u64 last_report_ns = started_ns;
+    u64 exported = 0;
+    int result = -1;
+    int ended = 0;
+    S2CPacket response;
+    while (S2CPacket_recv(sockfd, &response) == 0) {
+        if (response.type == S2C_MOVIE_CHUNK) {
+            for (u32 i = 0; i < response.data.movie_chunk.count; ++i) {
+                write_movie(out, (format_t)format, &response.data.movie_chunk.movies[i]);
+            }
+            exported += response.data.movie_chunk.count;
+            S2CPacket_free(&response);
+
+            u64 now = now_ns();
+            if (now - last_report_ns >= PROGRESS_INTERVAL_NS) {
+                fprintf(stderr, "%llu movies, %.1f MB, %.0f movies/s\n", (unsigned long long)exported,
+                        packet_bytes_received / (1024.0 * 1024.0), exported * 1e9 / (double)(now - started_ns));
+                last_report_ns = now;
+            }
+            continue;
+        }
+
+        if (response.type == S2C_EXPORT_END) {
+            if (response.data.export_end.count == exported) {
+                fprintf(stderr, "Exported %llu movies (store version %llu) in %.1f s\n", (unsigned long long)exported,
+                        (unsigned long long)response.data.export_end.version,
+                        (double)(now_ns() - started_ns) / 1e9);
+                result = 0;
+            } else {
+                fprintf(stderr, "Export ended with %llu movies, but %llu were received\n",
+                        (unsigned long long)response.data.export_end.count, (unsigned long long)exported);
+            }
+        } else if (response.type == S2C_ERROR) {
+            fprintf(stderr, "Server error: %s\n", response.data.error.message);
+        } else {
+            fprintf(stderr, "Unexpected packet type %u during export\n", response.type);
+        }
+        S2CPacket_free(&response);
+        ended = 1;
+        break;
+    }
+    if (!ended) fprintf(stderr, "Connection lost after %llu movies: %s\n", (unsigned long long)exported, strerror(errno));
+    close(sockfd);
+
+    if (fflush(out) != 0 || ferror(out)) {
+        fprintf(stderr, "Write error: %s\n", strerror(errno));
+        result = -1;
+    }
+    if (output_path) {
+        if (fclose(out) != 0) result = -1;
+        if (result == 0 && rename(temp_path, output_path) < 0) {
+            fprintf(stderr, "Could not rename %s to %s: %s\n", temp_path, output_path, strerror(errno));
+            result = -1;
+        }
+        if (result < 0) unlink(temp_path);
+    }
+    return result < 0 ? 1 : 0;
+}
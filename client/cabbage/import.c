@@ -0,0 +1,490 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "CabbageClient.h"
+#include "CsvReader.h"
+#include "cabbage/common/util.h"
+
+// cabbage-import: carga em massa de um CSV/TSV (title, genres, director, year) com a libcabbage-client.
+//
+// O arquivo é lido em streaming pelo CsvReader e cada linha vira um ADD_MOVIE, com até -w requisições em andamento
+// divididas entre as -c conexões do pool. Cada linha ocupa um slot de uma janela circular até ser respondida, e a
+// "marca d'água" (todas as linhas antes dela já foram respondidas) anda na ordem do arquivo. O checkpoint guarda a
+// marca d'água e o offset do arquivo nela, então uma importação interrompida continua do checkpoint; só as linhas
+// que estavam em andamento (no máximo -w) podem ser adicionadas duas vezes.
+//
+// A tabela do servidor tem tamanho fixo (MAX_ENTRIES, 65536 por padrão). Antes de começar o import pergunta pelo
+// C2S_STATS quantos filmes ainda cabem, e quando esse limite chega (ou o servidor responde que está cheio) ele para
+// com o checkpoint gravado, em vez de seguir com todas as linhas restantes recusadas.
+
+#define DEFAULT_PORT 12345
+#define DEFAULT_CONNECTIONS 4
+#define DEFAULT_WINDOW 1024
+#define DEFAULT_MAX_ERRORS 100
+#define MAX_REPORTED_ERRORS 10
+#define PROGRESS_INTERVAL_NS 1000000000ull
+// O handler do sinal não pode acordar o cond, então as esperas acordam sozinhas de tempos em tempos para ver o Ctrl+C.
+#define SIGNAL_POLL_NS 100000000L
+// Mesma mensagem do servidor quando a tabela de filmes enche.
+#define SERVER_FULL_MESSAGE "Maximum number of movies reached"
+
+#define IMPORT_FIELDS 4
+#define CHECKPOINT_MAGIC "cabbage-import checkpoint v1"
+
+typedef enum {
+    SLOT_FREE,
+    SLOT_PENDING,
+    SLOT_DONE,
+} SlotState;
+
+typedef struct {
+    SlotState state;
+    u64 line;        // linha do arquivo em que o registro começa (para as mensagens de erro)
+    u64 end_offset;  // offset e linha logo depois do registro: onde o import continua a partir dele
+    u64 end_line;
+} Slot;
+
+// Progresso que vai para o checkpoint.
+typedef struct {
+    u64 file_size;
+    u64 rows;       // registros já respondidos (ou descartados), na ordem do arquivo
+    u64 offset;
+    u64 line;
+    u64 imported;
+    u64 rejected;   // respondidos com S2C_ERROR pelo servidor
+    u64 invalid;    // registros com o número errado de campos ou longos demais
+} Progress;
+
+static struct {
+    const char* file;
+    const char* checkpoint;
+    char delimiter;
+    int window;
+    u64 max_errors;
+    int fresh;
+    CabbageClientConfig client;
+} config;
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    Slot* slots;
+    u64 next_row;   // próximo registro a ocupar um slot
+    u64 in_flight;
+    int failed;     // uma conexão caiu com requisições em andamento
+    int full;       // o servidor recusou uma linha por estar cheio
+    u64 reported_errors;
+    Progress done;  // até a marca d'água
+} state = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handle_signal(int sig) {
+    (void)sig;
+    interrupted++;
+}
+
+// Com o mutex: espera uma mudança no estado, ou até SIGNAL_POLL_NS.
+static void wait_state(void) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += SIGNAL_POLL_NS;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&state.cond, &state.mutex, &deadline);
+}
+
+// Com o mutex: anda com a marca d'água pelos slots já respondidos.
+static void advance_watermark(void) {
+    while (state.done.rows < state.next_row) {
+        Slot* slot = &state.slots[state.done.rows % (u64)config.window];
+        if (slot->state != SLOT_DONE) break;
+        state.done.offset = slot->end_offset;
+        state.done.line = slot->end_line;
+        slot->state = SLOT_FREE;
+        state.done.rows++;
+    }
+    pthread_cond_broadcast(&state.cond);
+}
+
+static void on_response(void* arg, int status, S2CPacket* response) {
+    Slot* slot = arg;
+    pthread_mutex_lock(&state.mutex);
+    state.in_flight--;
+    if (status < 0) {
+        // Não dá para saber se a linha entrou; ela fica antes da marca d'água e é enviada de novo no próximo import.
+        state.failed = 1;
+        pthread_cond_broadcast(&state.cond);
+        pthread_mutex_unlock(&state.mutex);
+        return;
+    }
+    if (response->type == S2C_ERROR && response->data.error.message &&
+        strcmp(response->data.error.message, SERVER_FULL_MESSAGE) == 0) {
+        // Como numa conexão perdida, a linha fica antes da marca d'água e é enviada de novo no próximo import.
+        state.full = 1;
+        pthread_cond_broadcast(&state.cond);
+        pthread_mutex_unlock(&state.mutex);
+        return;
+    }
+    if (response->type == S2C_ERROR) {
+        state.done.rejected++;
+        if (state.reported_errors++ < MAX_REPORTED_ERRORS) {
+            fprintf(stderr, "Line %llu rejected: %s\n", (unsigned long long)slot->line, response->data.error.message);
+        }
+    } else {
+        state.done.imported++;
+    }
+    slot->state = SLOT_DONE;
+    advance_watermark();
+    pthread_mutex_unlock(&state.mutex);
+}
+
+static int write_checkpoint(const Progress* progress) {
+    char temp[4096];
+    snprintf(temp, sizeof(temp), "%s.tmp", config.checkpoint);
+    FILE* file = fopen(temp, "w");
+    if (!file) return -1;
+    fprintf(file, "%s\nsize %llu\nrows %llu\noffset %llu\nline %llu\nimported %llu\nrejected %llu\ninvalid %llu\n",
+            CHECKPOINT_MAGIC, (unsigned long long)progress->file_size, (unsigned long long)progress->rows,
+            (unsigned long long)progress->offset, (unsigned long long)progress->line,
+            (unsigned long long)progress->imported, (unsigned long long)progress->rejected,
+            (unsigned long long)progress->invalid);
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        fclose(file);
+        return -1;
+    }
+    if (fclose(file) != 0) return -1;
+    return rename(temp, config.checkpoint);
+}
+
+// Retorna 1 se leu um checkpoint, 0 se ele não existe e -1 se ele é inválido.
+static int read_checkpoint(Progress* progress) {
+    FILE* file = fopen(config.checkpoint, "r");
+    if (!file) return errno == ENOENT ? 0 : -1;
+    char magic[64];
+    unsigned long long size, rows, offset, line, imported, rejected, invalid;
+    int fields = 0;
+    if (fgets(magic, sizeof(magic), file) && strncmp(magic, CHECKPOINT_MAGIC, strlen(CHECKPOINT_MAGIC)) == 0) {
+        fields = fscanf(file, "size %llu rows %llu offset %llu line %llu imported %llu rejected %llu invalid %llu",
+                        &size, &rows, &offset, &line, &imported, &rejected, &invalid);
+    }
+    fclose(file);
+    if (fields != 7) return -1;
+    progress->file_size = size;
+    progress->rows = rows;
+    progress->offset = offset;
+    progress->line = line;
+    progress->imported = imported;
+    progress->rejected = rejected;
+    progress->invalid = invalid;
+    return 1;
+}
+
+// Quantos filmes ainda cabem no servidor, pelos contadores "capacity" e "movies" do C2S_STATS. Retorna -1 se não
+// deu para saber.
+static int server_room(CabbageClient* client, u64* room, u64* capacity) {
+    C2SPacket request = {.type = C2S_STATS};
+    S2CPacket response;
+    if (CabbageClient_call(client, &request, &response) < 0) return -1;
+    u64 movies = 0;
+    int found = 0;
+    if (response.type == S2C_STATS) {
+        for (u32 i = 0; i < response.data.stats.counter_count; ++i) {
+            const S2C_StatsCounter* counter = &response.data.stats.counters[i];
+            if (!counter->name) continue;
+            if (strcmp(counter->name, "capacity") == 0) {
+                *capacity = counter->value;
+                found |= 1;
+            } else if (strcmp(counter->name, "movies") == 0) {
+                movies = counter->value;
+                found |= 2;
+            }
+        }
+    }
+    S2CPacket_free(&response);
+    if (found != 3) return -1;
+    *room = *capacity > movies ? *capacity - movies : 0;
+    return 0;
+}
+
+static void print_progress(const Progress* progress, u64 elapsed_ns, double rate, int final) {
+    double percent = progress->file_size ? 100.0 * (double)progress->offset / (double)progress->file_size : 100.0;
+    fprintf(stderr, "%s%llu rows (%.1f%%), %llu imported, %llu rejected, %llu invalid, %.0f rows/s, %.0f s%s",
+            isatty(STDERR_FILENO) && !final ? "\r" : "", (unsigned long long)progress->rows, percent,
+            (unsigned long long)progress->imported, (unsigned long long)progress->rejected,
+            (unsigned long long)progress->invalid, rate, (double)elapsed_ns / 1e9,
+            isatty(STDERR_FILENO) && !final ? "" : "\n");
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] <file.csv|file.tsv> [host] [port]\n", program);
+    fprintf(stderr, "  -c <connections>  connections in the pool (default: %d)\n", DEFAULT_CONNECTIONS);
+    fprintf(stderr, "  -i <threads>      I/O threads (default: 1)\n");
+    fprintf(stderr, "  -w <requests>     rows in flight (default: %d)\n", DEFAULT_WINDOW);
+    fprintf(stderr, "  -t                tab-separated input (default for *.tsv)\n");
+    fprintf(stderr, "  -k <file>         checkpoint file (default: <file>.checkpoint)\n");
+    fprintf(stderr, "  -f                ignore an existing checkpoint and start over\n");
+    fprintf(stderr, "  -e <rows>         stop after this many rejected rows, 0 for no limit (default: %d)\n",
+            DEFAULT_MAX_ERRORS);
+}
+
+int main(int argc, char* argv[]) {
+    CabbageClient_default_config(&config.client);
+    config.client.port = DEFAULT_PORT;
+    config.client.connections = DEFAULT_CONNECTIONS;
+    config.window = DEFAULT_WINDOW;
+    config.max_errors = DEFAULT_MAX_ERRORS;
+    config.delimiter = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "c:i:w:tk:fe:h")) != -1) {
+        switch (c) {
+        case 'c': config.client.connections = atoi(optarg); break;
+        case 'i': config.client.io_threads = atoi(optarg); break;
+        case 'w': config.window = atoi(optarg); break;
+        case 't': config.delimiter = '\t'; break;
+        case 'k': config.checkpoint = optarg; break;
+        case 'f': config.fresh = 1; break;
+        case 'e': config.max_errors = strtoull(optarg, NULL, 10); break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc || config.window < 1 || config.client.connections < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    config.file = argv[optind++];
+    if (optind < argc) config.client.host = argv[optind++];
+    if (optind < argc) config.client.port = atoi(argv[optind++]);
+    if (!config.delimiter) {
+        size_t length = strlen(config.file);
+        config.delimiter = length >= 4 && strcasecmp(config.file + length - 4, ".tsv") == 0 ? '\t' : ',';
+    }
+    char default_checkpoint[4096];
+    if (!config.checkpoint) {
+        snprintf(default_checkpoint, sizeof(default_checkpoint), "%s.checkpoint", config.file);
+        config.checkpoint = default_checkpoint;
+    }
+    // A janela já limita as requisições em andamento; o limite por conexão do pool não precisa segurar nada.
+    config.client.max_in_flight = config.window;
+
+    FILE* file = fopen(config.file, "r");
+    struct stat st;
+    if (!file || fstat(fileno(file), &st) != 0) {
+        fprintf(stderr, "Could not open %s: %s\n", config.file, strerror(errno));
+        return 1;
+    }
+
+    Progress start = {.file_size = (u64)st.st_size, .line = 1};
+    if (!config.fresh) {
+        Progress saved;
+        int result = read_checkpoint(&saved);
+        if (result < 0) {
+            fprintf(stderr, "Invalid checkpoint %s (use -f to start over)\n", config.checkpoint);
+            return 1;
+        }
+        if (result == 1) {
+            if (saved.file_size != start.file_size || saved.offset > start.file_size) {
+                fprintf(stderr, "Checkpoint %s is for a file of %llu bytes, %s has %llu (use -f to start over)\n",
+                        config.checkpoint, (unsigned long long)saved.file_size, config.file,
+                        (unsigned long long)start.file_size);
+                return 1;
+            }
+            start = saved;
+            fprintf(stderr, "Resuming from line %llu (%llu rows already done)\n", (unsigned long long)start.line,
+                    (unsigned long long)start.rows);
+        }
+    }
+
+    CsvReader reader;
+    if (CsvReader_init(&reader, file, config.delimiter, start.offset, start.line) < 0) {
+        fprintf(stderr, "Could not read %s: %s\n", config.file, strerror(errno));
+        return 1;
+    }
+    state.slots = calloc((size_t)config.window, sizeof(Slot));
+    if (!state.slots) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    state.done = start;
+    state.next_row = start.rows;
+
+    CabbageClient* client = CabbageClient_create(&config.client);
+    if (!client) {
+        fprintf(stderr, "Could not connect to %s:%d: %s\n", config.client.host, config.client.port, strerror(errno));
+        return 1;
+    }
+
+    u64 room = UINT64_MAX, capacity = 0;
+    if (server_room(client, &room, &capacity) < 0) {
+        fprintf(stderr, "Could not read the server capacity, importing without a limit\n");
+        room = UINT64_MAX;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    u64 started_ns = now_ns();
+    u64 last_report_ns = started_ns;
+    u64 last_report_rows = start.rows;
+    u64 reported_invalid = 0;
+    int read_error = 0;
+    int reached_end = 0;
+    int too_many_errors = 0;
+    int no_room = 0;
+
+    while (!interrupted) {
+        int result = CsvReader_next(&reader);
+        if (result == CSV_EOF) {
+            reached_end = 1;
+            break;
+        }
+        if (result == CSV_ERROR) {
+            read_error = 1;
+            break;
+        }
+
+        pthread_mutex_lock(&state.mutex);
+        while (state.next_row - state.done.rows >= (u64)config.window && !state.failed && !state.full &&
+               !interrupted) {
+            wait_state();
+        }
+        too_many_errors = config.max_errors && state.done.rejected >= config.max_errors;
+        if (state.failed || state.full || interrupted || too_many_errors) {
+            pthread_mutex_unlock(&state.mutex);
+            break;
+        }
+        Slot* slot = &state.slots[state.next_row % (u64)config.window];
+        slot->line = reader.record_line;
+        slot->end_offset = reader.offset;
+        slot->end_line = reader.line;
+        state.next_row++;
+
+        int header = reader.record_line == 1 && result == CSV_ROW && reader.field_count == IMPORT_FIELDS &&
+                     strcasecmp(reader.fields[0], "title") == 0;
+        if (header || result == CSV_TOO_LONG || result == CSV_UNTERMINATED || reader.field_count != IMPORT_FIELDS) {
+            if (!header) {
+                state.done.invalid++;
+                if (reported_invalid++ < MAX_REPORTED_ERRORS) {
+                    if (result == CSV_TOO_LONG) {
+                        fprintf(stderr, "Line %llu skipped: longer than %d bytes\n",
+                                (unsigned long long)reader.record_line, CSV_MAX_RECORD);
+                    } else if (result == CSV_UNTERMINATED) {
+                        fprintf(stderr, "Line %llu skipped: unterminated quoted field at the end of the file\n",
+                                (unsigned long long)reader.record_line);
+                    } else {
+                        fprintf(stderr, "Line %llu skipped: %d fields, expected %d\n",
+                                (unsigned long long)reader.record_line, reader.field_count, IMPORT_FIELDS);
+                    }
+                }
+            }
+            slot->state = SLOT_DONE;
+            advance_watermark();
+            pthread_mutex_unlock(&state.mutex);
+            continue;
+        }
+        if (room == 0) {
+            // A linha não entra: devolve o slot, e o checkpoint fica antes dela.
+            state.next_row--;
+            no_room = 1;
+            pthread_mutex_unlock(&state.mutex);
+            break;
+        }
+        room--;
+        slot->state = SLOT_PENDING;
+        state.in_flight++;
+        pthread_mutex_unlock(&state.mutex);
+
+        // O submit serializa a requisição na hora, então os campos podem apontar para o buffer do leitor.
+        C2SPacket request = {.type = C2S_ADD_MOVIE};
+        request.data.add_movie.title = reader.fields[0];
+        request.data.add_movie.genres = reader.fields[1];
+        request.data.add_movie.director = reader.fields[2];
+        request.data.add_movie.release_year = reader.fields[3];
+        if (CabbageClient_submit(client, &request, on_response, slot) < 0) {
+            pthread_mutex_lock(&state.mutex);
+            state.in_flight--;
+            state.failed = 1;
+            pthread_mutex_unlock(&state.mutex);
+            break;
+        }
+
+        u64 now = now_ns();
+        if (now - last_report_ns >= PROGRESS_INTERVAL_NS) {
+            pthread_mutex_lock(&state.mutex);
+            Progress progress = state.done;
+            pthread_mutex_unlock(&state.mutex);
+            if (write_checkpoint(&progress) < 0) {
+                fprintf(stderr, "\nCould not write checkpoint %s: %s\n", config.checkpoint, strerror(errno));
+            }
+            double rate = (double)(progress.rows - last_report_rows) * 1e9 / (double)(now - last_report_ns);
+            print_progress(&progress, now - started_ns, rate, 0);
+            last_report_ns = now;
+            last_report_rows = progress.rows;
+        }
+    }
+
+    // Espera as respostas que faltam (ou a queda das conexões) antes de gravar o checkpoint final. Um segundo Ctrl+C
+    // desiste delas: as linhas sem resposta estão depois da marca d'água e são enviadas de novo no próximo import.
+    pthread_mutex_lock(&state.mutex);
+    if (interrupted && state.in_flight > 0) {
+        fprintf(stderr, "\nWaiting for %llu replies (Ctrl+C again to stop now)\n", (unsigned long long)state.in_flight);
+    }
+    while (state.in_flight > 0 && interrupted < 2) wait_state();
+    Progress progress = state.done;
+    int failed = state.failed;
+    int full = state.full || no_room;
+    pthread_mutex_unlock(&state.mutex);
+    CabbageClient_destroy(client);
+    CsvReader_free(&reader);
+    fclose(file);
+    free(state.slots);
+
+    u64 elapsed = now_ns() - started_ns;
+    double rate = elapsed ? (double)(progress.rows - start.rows) * 1e9 / (double)elapsed : 0.0;
+    if (isatty(STDERR_FILENO)) fputc('\n', stderr);
+    print_progress(&progress, elapsed, rate, 1);
+
+    if (reached_end && !failed && !full) {
+        if (unlink(config.checkpoint) < 0 && errno != ENOENT) {
+            fprintf(stderr, "Could not remove checkpoint %s: %s\n", config.checkpoint, strerror(errno));
+        }
+        printf("Imported %llu movies (%llu rejected, %llu invalid lines) in %.1f s, %.0f rows/s\n",
+               (unsigned long long)progress.imported, (unsigned long long)progress.rejected,
+               (unsigned long long)progress.invalid, (double)elapsed / 1e9, rate);
+        return 0;
+    }
+
+    if (write_checkpoint(&progress) < 0) {
+        fprintf(stderr, "Could not write checkpoint %s: %s\n", config.checkpoint, strerror(errno));
+    }
+    if (read_error) fprintf(stderr, "Read error on %s: %s\n", config.file, strerror(errno));
+    else if (failed) fprintf(stderr, "Lost the connection to the server\n");
+    else if (full && capacity) {
+        fprintf(stderr, "The server is full (%llu movies); rebuild it with a larger MAX_ENTRIES to import the rest\n",
+                (unsigned long long)capacity);
+    } else if (full) fprintf(stderr, "The server is full; rebuild it with a larger MAX_ENTRIES to import the rest\n");
+    else if (too_many_errors) fprintf(stderr, "Stopped after %llu rejected rows\n", (unsigned long long)progress.rejected);
+    else fprintf(stderr, "Interrupted\n");
+    fprintf(stderr, "Checkpoint saved to %s at line %llu; run again to continue\n", config.checkpoint,
+            (unsigned long long)progress.line);
+    return 1;
+}
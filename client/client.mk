@@ -0,0 +1,7 @@
+# Biblioteca de cliente (libcabbage-client.a, já com o Packet.o), para outras ferramentas.
+CLIENT_LIB = $(CLIENT_DIR)/libcabbage-client.a
+
+$(CLIENT_LIB): CLIENT_FORCE
+	@$(MAKE) -C $(CLIENT_DIR) libcabbage-client.a
+
+CLIENT_FORCE:
@@ -10,6 +10,7 @@ typedef struct
     char* genres;
     char* director;
     char *release_year;
+    u64 version; // versão da última modificação do filme (ver store_version no servidor)
 } Movie;
 
 #endif // _CABBAGE_MOVIE_H
@@ -7,6 +7,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <endian.h>
 
 // Para enviar os pacotes, usamos um mecanismo de serialização, onde cada pacote é serializado em um buffer antes
 // de ser enviado pela rede, tentando fazer apenas uma chamada de send() para cada pacote.
@@ -15,6 +16,10 @@
 
 // --- Funções utilitárias ---
 
+_Thread_local u64 packet_bytes_sent;
+_Thread_local u64 packet_bytes_received;
+_Thread_local void (*packet_serialized_hook)(void) = NULL;
+
 // Mesmo com o socket em modo blocking, uma interrupção no momento certo pode fazer com que
 // o send() envie menos bytes do que o esperado.
 static int send_all(int sockfd, const void *buf, size_t len) {
@@ -31,9 +36,18 @@ static int send_all(int sockfd, const void *buf, size_t len) {
         }
         total_sent += (size_t)sent;
     }
+    packet_bytes_sent += len;
     return 0;
 }
 
+// Envio de uma resposta do servidor já serializada: avisa o hook (o trace marca o fim da serialização) e conta os
+// bytes no send_all. Nas respostas mandadas em partes (export, GET_MOVIES), o hook é chamado em cada parte e fica a
+// marca da última.
+static int send_serialized(int sockfd, const void *buf, size_t len) {
+    if (packet_serialized_hook) packet_serialized_hook();
+    return send_all(sockfd, buf, len);
+}
+
 // Similar ao anterior, na verdade não tenho certeza se é necessário aqui, mas melhor
 // prevenir do que remediar.
 static int recv_all(int sockfd, void *buf, size_t len) {
@@ -51,6 +65,28 @@ static int recv_all(int sockfd, void *buf, size_t len) {
         }
         total_recv += (size_t)received;
     }
+    packet_bytes_received += len;
+    return 0;
+}
+
+// Os pacotes podem ser lidos direto do socket (os *_recv) ou de um buffer já recebido (S2CPacket_decode). Os
+// deserializadores leem sempre por aqui; no modo buffer, 'incomplete' indica que os dados acabaram antes do pacote.
+typedef struct {
+    int socket_fd; // -1 para ler de 'data'
+    const char *data;
+    size_t size;
+    size_t offset;
+    int incomplete;
+} PacketReader;
+
+static int read_bytes(PacketReader *reader, void *buf, size_t len) {
+    if (reader->socket_fd >= 0) return recv_all(reader->socket_fd, buf, len);
+    if (reader->size - reader->offset < len) {
+        reader->incomplete = 1;
+        return -1;
+    }
+    memcpy(buf, reader->data + reader->offset, len);
+    reader->offset += len;
     return 0;
 }
 
@@ -76,15 +112,28 @@ static size_t calculate_c2s_packet_size(const C2SPacket *packet) {
         size += (packet->data.add_genre.genre ? strlen(packet->data.add_genre.genre) : 0);
         break;
     case C2S_REMOVE_MOVIE:
+        size += sizeof(u32);
+        break;
     case C2S_GET_MOVIE:
         size += sizeof(u32);
+        size += sizeof(u64);
+        break;
+    case C2S_GET_MOVIES:
+        size += sizeof(u32);
+        size += (size_t)packet->data.get_movies.count * sizeof(u32);
         break;
     case C2S_LIST_MOVIES_BY_GENRE:
         size += sizeof(u32);
         size += (packet->data.list_by_genre.genre ? strlen(packet->data.list_by_genre.genre) : 0);
+        size += sizeof(u64);
         break;
     case C2S_LIST_MOVIES:
     case C2S_LIST_MOVIES_DETAILED:
+    case C2S_LIST_CHANGES_SINCE:
+        size += sizeof(u64);
+        break;
+    case C2S_STATS:
+    case C2S_EXPORT:
     case C2S_UNKNOWN:
         break;
     default:
@@ -93,6 +142,15 @@ static size_t calculate_c2s_packet_size(const C2SPacket *packet) {
     return size;
 }
 
+static size_t calculate_movie_size(const Movie *movie) {
+    size_t size = sizeof(u32) + sizeof(u64);
+    size += sizeof(u32) + (movie->title ? strlen(movie->title) : 0);
+    size += sizeof(u32) + (movie->genres ? strlen(movie->genres) : 0);
+    size += sizeof(u32) + (movie->director ? strlen(movie->director) : 0);
+    size += sizeof(u32) + (movie->release_year ? strlen(movie->release_year) : 0);
+    return size;
+}
+
 // Função equivalente para o pacote S2C.
 static size_t calculate_s2c_packet_size(const S2CPacket *packet) {
     size_t size = sizeof(u8);
@@ -100,12 +158,14 @@ static size_t calculate_s2c_packet_size(const S2CPacket *packet) {
     switch (packet->type) {
     case S2C_MOVIE:
         size += sizeof(u32);
+        size += sizeof(u64);
         size += sizeof(u32) + (packet->data.movie.title ? strlen(packet->data.movie.title) : 0);
         size += sizeof(u32) + (packet->data.movie.genres ? strlen(packet->data.movie.genres) : 0);
         size += sizeof(u32) + (packet->data.movie.director ? strlen(packet->data.movie.director) : 0);
         size += sizeof(u32) + (packet->data.movie.release_year ? strlen(packet->data.movie.release_year) : 0);
         break;
     case S2C_MOVIE_LIST:
+        size += sizeof(u64);
         size += sizeof(u32);
         if(packet->data.movie_list.movies) {
             for (u32 i = 0; i < packet->data.movie_list.count; ++i) {
@@ -115,11 +175,13 @@ static size_t calculate_s2c_packet_size(const S2CPacket *packet) {
         }
         break;
     case S2C_MOVIE_LIST_DETAILED:
+        size += sizeof(u64);
         size += sizeof(u32);
         if(packet->data.movie_list_detailed.movies) {
             for (u32 i = 0; i < packet->data.movie_list_detailed.count; ++i) {
                 const Movie* item = &packet->data.movie_list_detailed.movies[i];
                 size += sizeof(u32);
+                size += sizeof(u64);
                 size += sizeof(u32) + (item->title ? strlen(item->title) : 0);
                 size += sizeof(u32) + (item->genres ? strlen(item->genres) : 0);
                 size += sizeof(u32) + (item->director ? strlen(item->director) : 0);
@@ -131,6 +193,57 @@ static size_t calculate_s2c_packet_size(const S2CPacket *packet) {
         size += sizeof(u32);
         size += (packet->data.error.message ? strlen(packet->data.error.message) : 0);
         break;
+    case S2C_NOT_MODIFIED:
+        size += sizeof(u64);
+        break;
+    case S2C_MOVIE_CHANGES:
+        size += sizeof(u64);
+        size += sizeof(u8);
+        size += sizeof(u32);
+        if (packet->data.movie_changes.movies) {
+            for (u32 i = 0; i < packet->data.movie_changes.count; ++i) {
+                const Movie* item = &packet->data.movie_changes.movies[i];
+                size += sizeof(u32);
+                size += sizeof(u64);
+                size += sizeof(u32) + (item->title ? strlen(item->title) : 0);
+                size += sizeof(u32) + (item->genres ? strlen(item->genres) : 0);
+                size += sizeof(u32) + (item->director ? strlen(item->director) : 0);
+                size += sizeof(u32) + (item->release_year ? strlen(item->release_year) : 0);
+            }
+        }
+        size += sizeof(u32);
+        size += (size_t)packet->data.movie_changes.removed_count * sizeof(u32);
+        break;
+    case S2C_STATS:
+        size += sizeof(u32);
+        for (u32 i = 0; packet->data.stats.counters && i < packet->data.stats.counter_count; ++i) {
+            const S2C_StatsCounter* item = &packet->data.stats.counters[i];
+            size += sizeof(u32) + (item->name ? strlen(item->name) : 0);
+            size += sizeof(u64);
+        }
+        size += sizeof(u32);
+        for (u32 i = 0; packet->data.stats.latencies && i < packet->data.stats.latency_count; ++i) {
+            const S2C_StatsLatency* item = &packet->data.stats.latencies[i];
+            size += sizeof(u32) + (item->name ? strlen(item->name) : 0);
+            size += 5 * sizeof(u64);
+        }
+        break;
+    case S2C_MOVIE_CHUNK:
+        size += sizeof(u32);
+        for (u32 i = 0; packet->data.movie_chunk.movies && i < packet->data.movie_chunk.count; ++i) {
+            size += calculate_movie_size(&packet->data.movie_chunk.movies[i]);
+        }
+        break;
+    case S2C_EXPORT_END:
+        size += 2 * sizeof(u64);
+        break;
+    case S2C_MOVIES:
+        size += sizeof(u32);
+        for (u32 i = 0; packet->data.movies.movies && i < packet->data.movies.count; ++i) {
+            size += sizeof(u8) + calculate_movie_size(&packet->data.movies.movies[i]);
+        }
+        size += (size_t)packet->data.movies.missing_count * (sizeof(u8) + sizeof(u32));
+        break;
     case S2C_UNKNOWN:
     case S2C_OK:
         break;
@@ -151,18 +264,18 @@ static void serialize_string(const char *str, char **buffer_ptr) {
     }
 }
 
-static int deserialize_string(int socket_fd, char **str_ptr) {
+static int deserialize_string(PacketReader *reader, char **str_ptr) {
     u32 net_len, len;
     char *str_buffer = NULL;
     *str_ptr = NULL;
 
-    if (recv_all(socket_fd, &net_len, sizeof(u32)) != 0) return -1;
+    if (read_bytes(reader, &net_len, sizeof(u32)) != 0) return -1;
     len = ntohl(net_len);
 
     if (len > 0) {
         str_buffer = malloc(len + 1);
         if (!str_buffer) return -1;
-        if (recv_all(socket_fd, str_buffer, len) != 0) {
+        if (read_bytes(reader, str_buffer, len) != 0) {
             free(str_buffer);
             return -1;
         }
@@ -178,13 +291,27 @@ static void serialize_u32(u32 value, char **buffer_ptr) {
     *buffer_ptr += sizeof(u32);
 }
 
-static int deserialize_u32(int socket_fd, u32 *value_ptr) {
+static int deserialize_u32(PacketReader *reader, u32 *value_ptr) {
     u32 net_val;
-    if (recv_all(socket_fd, &net_val, sizeof(u32)) != 0) return -1;
+    if (read_bytes(reader, &net_val, sizeof(u32)) != 0) return -1;
     *value_ptr = ntohl(net_val);
     return 0;
 }
 
+// Não existe htonll, então usamos o htobe64 da glibc.
+static void serialize_u64(u64 value, char **buffer_ptr) {
+    u64 net_val = htobe64(value);
+    memcpy(*buffer_ptr, &net_val, sizeof(u64));
+    *buffer_ptr += sizeof(u64);
+}
+
+static int deserialize_u64(PacketReader *reader, u64 *value_ptr) {
+    u64 net_val;
+    if (read_bytes(reader, &net_val, sizeof(u64)) != 0) return -1;
+    *value_ptr = be64toh(net_val);
+    return 0;
+}
+
 
 static void serialize_c2s_add_movie(const C2S_AddMovieData* data, char **buffer_ptr) {
     serialize_string(data->title, buffer_ptr);
@@ -193,11 +320,11 @@ static void serialize_c2s_add_movie(const C2S_AddMovieData* data, char **buffer_
     serialize_string(data->release_year, buffer_ptr);
 }
 
-static int deserialize_c2s_add_movie(int socket_fd, C2S_AddMovieData* data) {
-    if (deserialize_string(socket_fd, (char**)&data->title) != 0) return -1;
-    if (deserialize_string(socket_fd, (char**)&data->genres) != 0) return -1;
-    if (deserialize_string(socket_fd, (char**)&data->director) != 0) return -1;
-    if (deserialize_string(socket_fd, (char**)&data->release_year) != 0) return -1;
+static int deserialize_c2s_add_movie(PacketReader *reader, C2S_AddMovieData* data) {
+    if (deserialize_string(reader, (char**)&data->title) != 0) return -1;
+    if (deserialize_string(reader, (char**)&data->genres) != 0) return -1;
+    if (deserialize_string(reader, (char**)&data->director) != 0) return -1;
+    if (deserialize_string(reader, (char**)&data->release_year) != 0) return -1;
     return 0;
 }
 
@@ -206,9 +333,9 @@ static void serialize_c2s_add_genre(const C2S_AddGenreData* data, char **buffer_
     serialize_string(data->genre, buffer_ptr);
 }
 
-static int deserialize_c2s_add_genre(int socket_fd, C2S_AddGenreData* data) {
-    if (deserialize_u32(socket_fd, &data->movie_id) != 0) return -1;
-    if (deserialize_string(socket_fd, (char**)&data->genre) != 0) return -1;
+static int deserialize_c2s_add_genre(PacketReader *reader, C2S_AddGenreData* data) {
+    if (deserialize_u32(reader, &data->movie_id) != 0) return -1;
+    if (deserialize_string(reader, (char**)&data->genre) != 0) return -1;
     return 0;
 }
 
@@ -216,38 +343,96 @@ static void serialize_c2s_movie_id(const C2S_RemoveMovieData* data, char **buffe
     serialize_u32(data->movie_id, buffer_ptr);
 }
 
-static int deserialize_c2s_movie_id(int socket_fd, C2S_RemoveMovieData* data) {
-    if (deserialize_u32(socket_fd, &data->movie_id) != 0) return -1;
+static int deserialize_c2s_movie_id(PacketReader *reader, C2S_RemoveMovieData* data) {
+    if (deserialize_u32(reader, &data->movie_id) != 0) return -1;
+    return 0;
+}
+
+static void serialize_c2s_get_movie(const C2S_GetMovieData* data, char **buffer_ptr) {
+    serialize_u32(data->movie_id, buffer_ptr);
+    serialize_u64(data->if_version, buffer_ptr);
+}
+
+static int deserialize_c2s_get_movie(PacketReader *reader, C2S_GetMovieData* data) {
+    if (deserialize_u32(reader, &data->movie_id) != 0) return -1;
+    if (deserialize_u64(reader, &data->if_version) != 0) return -1;
+    return 0;
+}
+
+static void serialize_c2s_get_movies(const C2S_GetMoviesData* data, char **buffer_ptr) {
+    serialize_u32(data->count, buffer_ptr);
+    for (u32 i = 0; i < data->count; ++i) {
+        serialize_u32(data->movie_ids[i], buffer_ptr);
+    }
+}
+
+static int deserialize_c2s_get_movies(PacketReader *reader, C2S_GetMoviesData* data) {
+    data->movie_ids = NULL;
+    data->count = 0;
+    u32 count;
+    if (deserialize_u32(reader, &count) != 0) return -1;
+    if (count > GET_MOVIES_MAX_IDS) return -1;
+    if (count > 0) {
+        data->movie_ids = malloc(count * sizeof(u32));
+        if (!data->movie_ids) return -1;
+        data->count = count;
+        for (u32 i = 0; i < count; ++i) {
+            if (deserialize_u32(reader, &data->movie_ids[i]) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static void serialize_c2s_list(const C2S_ListData* data, char **buffer_ptr) {
+    serialize_u64(data->if_version, buffer_ptr);
+}
+
+static int deserialize_c2s_list(PacketReader *reader, C2S_ListData* data) {
+    if (deserialize_u64(reader, &data->if_version) != 0) return -1;
     return 0;
 }
 
 static void serialize_c2s_list_by_genre(const C2S_ListByGenreData* data, char **buffer_ptr) {
     serialize_string(data->genre, buffer_ptr);
+    serialize_u64(data->if_version, buffer_ptr);
+}
+
+static int deserialize_c2s_list_by_genre(PacketReader *reader, C2S_ListByGenreData* data) {
+    if (deserialize_string(reader, (char**)&data->genre) != 0) return -1;
+    if (deserialize_u64(reader, &data->if_version) != 0) return -1;
+    return 0;
+}
+
+static void serialize_c2s_list_changes(const C2S_ListChangesData* data, char **buffer_ptr) {
+    serialize_u64(data->since_version, buffer_ptr);
 }
 
-static int deserialize_c2s_list_by_genre(int socket_fd, C2S_ListByGenreData* data) {
-    if (deserialize_string(socket_fd, (char**)&data->genre) != 0) return -1;
+static int deserialize_c2s_list_changes(PacketReader *reader, C2S_ListChangesData* data) {
+    if (deserialize_u64(reader, &data->since_version) != 0) return -1;
     return 0;
 }
 
 static void serialize_s2c_movie(const Movie* data, char **buffer_ptr) {
     serialize_u32(data->id, buffer_ptr);
+    serialize_u64(data->version, buffer_ptr);
     serialize_string(data->title, buffer_ptr);
     serialize_string(data->genres, buffer_ptr);
     serialize_string(data->director, buffer_ptr);
     serialize_string(data->release_year, buffer_ptr);
 }
 
-static int deserialize_s2c_movie(int socket_fd, Movie* data) {
-    if (deserialize_u32(socket_fd, &data->id) != 0) return -1;
-    if (deserialize_string(socket_fd, (char**)&data->title) != 0) return -1;
-    if (deserialize_string(socket_fd, (char**)&data->genres) != 0) return -1;
-    if (deserialize_string(socket_fd, (char**)&data->director) != 0) return -1;
-    if (deserialize_string(socket_fd, (char**)&data->release_year) != 0) return -1;
+static int deserialize_s2c_movie(PacketReader *reader, Movie* data) {
+    if (deserialize_u32(reader, &data->id) != 0) return -1;
+    if (deserialize_u64(reader, &data->version) != 0) return -1;
+    if (deserialize_string(reader, (char**)&data->title) != 0) return -1;
+    if (deserialize_string(reader, (char**)&data->genres) != 0) return -1;
+    if (deserialize_string(reader, (char**)&data->director) != 0) return -1;
+    if (deserialize_string(reader, (char**)&data->release_year) != 0) return -1;
     return 0;
 }
 
 static void serialize_s2c_movie_list(const S2C_MovieListData* data, char **buffer_ptr) {
+    serialize_u64(data->version, buffer_ptr);
     serialize_u32(data->count, buffer_ptr);
     if (data->movies) {
         for (u32 i = 0; i < data->count; ++i) {
@@ -257,16 +442,17 @@ static void serialize_s2c_movie_list(const S2C_MovieListData* data, char **buffe
     }
 }
 
-static int deserialize_s2c_movie_list(int socket_fd, S2C_MovieListData* data) {
-    if (deserialize_u32(socket_fd, &data->count) != 0) return -1;
+static int deserialize_s2c_movie_list(PacketReader *reader, S2C_MovieListData* data) {
+    if (deserialize_u64(reader, &data->version) != 0) return -1;
+    if (deserialize_u32(reader, &data->count) != 0) return -1;
     data->movies = NULL;
     if (data->count > 0) {
         data->movies = malloc(data->count * sizeof(S2C_MovieIdTitle));
         if (!data->movies) return -1;
         memset(data->movies, 0, data->count * sizeof(S2C_MovieIdTitle));
         for (u32 i = 0; i < data->count; ++i) {
-            if (deserialize_u32(socket_fd, &data->movies[i].id) != 0) return -1;
-            if (deserialize_string(socket_fd, (char**)&data->movies[i].title) != 0) return -1;
+            if (deserialize_u32(reader, &data->movies[i].id) != 0) return -1;
+            if (deserialize_string(reader, (char**)&data->movies[i].title) != 0) return -1;
         }
     }
     return 0;
@@ -274,6 +460,7 @@ static int deserialize_s2c_movie_list(int socket_fd, S2C_MovieListData* data) {
 
 
 static void serialize_s2c_movie_list_detailed(const S2C_MovieListDetailedData* data, char **buffer_ptr) {
+    serialize_u64(data->version, buffer_ptr);
     serialize_u32(data->count, buffer_ptr);
     if (data->movies) {
         for (u32 i = 0; i < data->count; ++i) {
@@ -282,15 +469,16 @@ static void serialize_s2c_movie_list_detailed(const S2C_MovieListDetailedData* d
     }
 }
 
-static int deserialize_s2c_movie_list_detailed(int socket_fd, S2C_MovieListDetailedData* data) {
-    if (deserialize_u32(socket_fd, &data->count) != 0) return -1;
+static int deserialize_s2c_movie_list_detailed(PacketReader *reader, S2C_MovieListDetailedData* data) {
+    if (deserialize_u64(reader, &data->version) != 0) return -1;
+    if (deserialize_u32(reader, &data->count) != 0) return -1;
     data->movies = NULL;
     if (data->count > 0) {
         data->movies = malloc(data->count * sizeof(Movie));
         if (!data->movies) return -1;
         memset(data->movies, 0, data->count * sizeof(Movie));
         for (u32 i = 0; i < data->count; ++i) {
-            if (deserialize_s2c_movie(socket_fd, &data->movies[i]) != 0) return -1;
+            if (deserialize_s2c_movie(reader, &data->movies[i]) != 0) return -1;
         }
     }
     return 0;
@@ -300,17 +488,222 @@ static void serialize_s2c_error(const S2C_ErrorData* data, char **buffer_ptr) {
     serialize_string(data->message, buffer_ptr);
 }
 
-static int deserialize_s2c_error(int socket_fd, S2C_ErrorData* data) {
-    if (deserialize_string(socket_fd, (char**)&data->message) != 0) return -1;
+static int deserialize_s2c_error(PacketReader *reader, S2C_ErrorData* data) {
+    if (deserialize_string(reader, (char**)&data->message) != 0) return -1;
     return 0;
 }
 
-int C2SPacket_send(int socket_fd, const C2SPacket *packet) {
-    size_t total_size = calculate_c2s_packet_size(packet);
+static void serialize_s2c_movie_changes(const S2C_MovieChangesData* data, char **buffer_ptr) {
+    serialize_u64(data->version, buffer_ptr);
+    memcpy(*buffer_ptr, &data->full, sizeof(u8));
+    *buffer_ptr += sizeof(u8);
+    serialize_u32(data->movies ? data->count : 0, buffer_ptr);
+    if (data->movies) {
+        for (u32 i = 0; i < data->count; ++i) {
+            serialize_s2c_movie(&data->movies[i], buffer_ptr);
+        }
+    }
+    serialize_u32(data->removed_ids ? data->removed_count : 0, buffer_ptr);
+    if (data->removed_ids) {
+        for (u32 i = 0; i < data->removed_count; ++i) {
+            serialize_u32(data->removed_ids[i], buffer_ptr);
+        }
+    }
+}
 
-    char *buffer = (char*)malloc(total_size);
-    if (!buffer) return -1;
+static int deserialize_s2c_movie_changes(PacketReader *reader, S2C_MovieChangesData* data) {
+    data->movies = NULL;
+    data->removed_ids = NULL;
+    data->count = 0;
+    data->removed_count = 0;
+    if (deserialize_u64(reader, &data->version) != 0) return -1;
+    if (read_bytes(reader, &data->full, sizeof(u8)) != 0) return -1;
+
+    u32 count;
+    if (deserialize_u32(reader, &count) != 0) return -1;
+    if (count > 0) {
+        data->movies = calloc(count, sizeof(Movie));
+        if (!data->movies) return -1;
+        data->count = count;
+        for (u32 i = 0; i < count; ++i) {
+            if (deserialize_s2c_movie(reader, &data->movies[i]) != 0) return -1;
+        }
+    }
+
+    u32 removed_count;
+    if (deserialize_u32(reader, &removed_count) != 0) return -1;
+    if (removed_count > 0) {
+        data->removed_ids = malloc(removed_count * sizeof(u32));
+        if (!data->removed_ids) return -1;
+        data->removed_count = removed_count;
+        for (u32 i = 0; i < removed_count; ++i) {
+            if (deserialize_u32(reader, &data->removed_ids[i]) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static void serialize_s2c_not_modified(const S2C_NotModifiedData* data, char **buffer_ptr) {
+    serialize_u64(data->version, buffer_ptr);
+}
+
+static int deserialize_s2c_not_modified(PacketReader *reader, S2C_NotModifiedData* data) {
+    if (deserialize_u64(reader, &data->version) != 0) return -1;
+    return 0;
+}
+
+static void serialize_s2c_stats(const S2C_StatsData* data, char **buffer_ptr) {
+    serialize_u32(data->counters ? data->counter_count : 0, buffer_ptr);
+    for (u32 i = 0; data->counters && i < data->counter_count; ++i) {
+        serialize_string(data->counters[i].name, buffer_ptr);
+        serialize_u64(data->counters[i].value, buffer_ptr);
+    }
+    serialize_u32(data->latencies ? data->latency_count : 0, buffer_ptr);
+    for (u32 i = 0; data->latencies && i < data->latency_count; ++i) {
+        const S2C_StatsLatency* item = &data->latencies[i];
+        serialize_string(item->name, buffer_ptr);
+        serialize_u64(item->count, buffer_ptr);
+        serialize_u64(item->p50_ns, buffer_ptr);
+        serialize_u64(item->p99_ns, buffer_ptr);
+        serialize_u64(item->p999_ns, buffer_ptr);
+        serialize_u64(item->max_ns, buffer_ptr);
+    }
+}
+
+static int deserialize_s2c_stats(PacketReader *reader, S2C_StatsData* data) {
+    memset(data, 0, sizeof(*data));
+
+    u32 count;
+    if (deserialize_u32(reader, &count) != 0) return -1;
+    if (count > 0) {
+        data->counters = calloc(count, sizeof(S2C_StatsCounter));
+        if (!data->counters) return -1;
+        data->counter_count = count;
+        for (u32 i = 0; i < count; ++i) {
+            if (deserialize_string(reader, &data->counters[i].name) != 0) return -1;
+            if (deserialize_u64(reader, &data->counters[i].value) != 0) return -1;
+        }
+    }
+
+    if (deserialize_u32(reader, &count) != 0) return -1;
+    if (count > 0) {
+        data->latencies = calloc(count, sizeof(S2C_StatsLatency));
+        if (!data->latencies) return -1;
+        data->latency_count = count;
+        for (u32 i = 0; i < count; ++i) {
+            S2C_StatsLatency* item = &data->latencies[i];
+            if (deserialize_string(reader, &item->name) != 0) return -1;
+            if (deserialize_u64(reader, &item->count) != 0) return -1;
+            if (deserialize_u64(reader, &item->p50_ns) != 0) return -1;
+            if (deserialize_u64(reader, &item->p99_ns) != 0) return -1;
+            if (deserialize_u64(reader, &item->p999_ns) != 0) return -1;
+            if (deserialize_u64(reader, &item->max_ns) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static void serialize_s2c_movie_chunk(const S2C_MovieChunkData* data, char **buffer_ptr) {
+    serialize_u32(data->movies ? data->count : 0, buffer_ptr);
+    for (u32 i = 0; data->movies && i < data->count; ++i) {
+        serialize_s2c_movie(&data->movies[i], buffer_ptr);
+    }
+}
+
+static int deserialize_s2c_movie_chunk(PacketReader *reader, S2C_MovieChunkData* data) {
+    data->movies = NULL;
+    data->count = 0;
+    u32 count;
+    if (deserialize_u32(reader, &count) != 0) return -1;
+    if (count > 0) {
+        data->movies = calloc(count, sizeof(Movie));
+        if (!data->movies) return -1;
+        data->count = count;
+        for (u32 i = 0; i < count; ++i) {
+            if (deserialize_s2c_movie(reader, &data->movies[i]) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static void serialize_s2c_export_end(const S2C_ExportEndData* data, char **buffer_ptr) {
+    serialize_u64(data->version, buffer_ptr);
+    serialize_u64(data->count, buffer_ptr);
+}
 
+static int deserialize_s2c_export_end(PacketReader *reader, S2C_ExportEndData* data) {
+    if (deserialize_u64(reader, &data->version) != 0) return -1;
+    if (deserialize_u64(reader, &data->count) != 0) return -1;
+    return 0;
+}
+
+// Tag de cada registro do S2C_MOVIES.
+#define MOVIES_RECORD_MISSING 0
+#define MOVIES_RECORD_MOVIE 1
+
+static void serialize_s2c_movies(const S2C_MoviesData* data, char **buffer_ptr) {
+    u32 movie_count = data->movies ? data->count : 0;
+    u32 missing_count = data->missing_ids ? data->missing_count : 0;
+    serialize_u32(movie_count + missing_count, buffer_ptr);
+    for (u32 i = 0; i < movie_count; ++i) {
+        *(*buffer_ptr)++ = MOVIES_RECORD_MOVIE;
+        serialize_s2c_movie(&data->movies[i], buffer_ptr);
+    }
+    for (u32 i = 0; i < missing_count; ++i) {
+        *(*buffer_ptr)++ = MOVIES_RECORD_MISSING;
+        serialize_u32(data->missing_ids[i], buffer_ptr);
+    }
+}
+
+static int deserialize_s2c_movies(PacketReader *reader, S2C_MoviesData* data) {
+    memset(data, 0, sizeof(*data));
+    u32 count;
+    if (deserialize_u32(reader, &count) != 0) return -1;
+    if (count == 0) return 0;
+
+    // Os dois arrays têm espaço para todos os registros, já que a divisão só é conhecida no fim.
+    data->movies = calloc(count, sizeof(Movie));
+    data->missing_ids = malloc(count * sizeof(u32));
+    if (!data->movies || !data->missing_ids) return -1;
+    for (u32 i = 0; i < count; ++i) {
+        u8 tag;
+        if (read_bytes(reader, &tag, sizeof(u8)) != 0) return -1;
+        if (tag == MOVIES_RECORD_MOVIE) {
+            // Conta antes de ler, para o S2CPacket_free liberar as strings de um filme lido pela metade.
+            Movie* item = &data->movies[data->count++];
+            if (deserialize_s2c_movie(reader, item) != 0) return -1;
+        } else if (tag == MOVIES_RECORD_MISSING) {
+            if (deserialize_u32(reader, &data->missing_ids[data->missing_count]) != 0) return -1;
+            data->missing_count++;
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+const char* C2SPacket_type_name(u8 type) {
+    switch (type) {
+    case C2S_ADD_MOVIE: return "ADD_MOVIE";
+    case C2S_ADD_GENRE_TO_MOVIE: return "ADD_GENRE_TO_MOVIE";
+    case C2S_REMOVE_MOVIE: return "REMOVE_MOVIE";
+    case C2S_LIST_MOVIES: return "LIST_MOVIES";
+    case C2S_LIST_MOVIES_DETAILED: return "LIST_MOVIES_DETAILED";
+    case C2S_GET_MOVIE: return "GET_MOVIE";
+    case C2S_LIST_MOVIES_BY_GENRE: return "LIST_MOVIES_BY_GENRE";
+    case C2S_LIST_CHANGES_SINCE: return "LIST_CHANGES_SINCE";
+    case C2S_STATS: return "STATS";
+    case C2S_EXPORT: return "EXPORT";
+    case C2S_GET_MOVIES: return "GET_MOVIES";
+    default: return "UNKNOWN";
+    }
+}
+
+size_t C2SPacket_encoded_size(const C2SPacket *packet) {
+    return calculate_c2s_packet_size(packet);
+}
+
+int C2SPacket_encode(const C2SPacket *packet, char *buffer) {
     char *ptr = buffer;
 
     memcpy(ptr, &packet->type, sizeof(u8));
@@ -324,17 +717,42 @@ int C2SPacket_send(int socket_fd, const C2SPacket *packet) {
         serialize_c2s_add_genre(&packet->data.add_genre, &ptr);
         break;
     case C2S_REMOVE_MOVIE:
-    case C2S_GET_MOVIE:
         serialize_c2s_movie_id(&packet->data.remove_movie, &ptr);
         break;
+    case C2S_GET_MOVIE:
+        serialize_c2s_get_movie(&packet->data.get_movie, &ptr);
+        break;
+    case C2S_GET_MOVIES:
+        if (packet->data.get_movies.count > GET_MOVIES_MAX_IDS) return -1;
+        serialize_c2s_get_movies(&packet->data.get_movies, &ptr);
+        break;
     case C2S_LIST_MOVIES_BY_GENRE:
         serialize_c2s_list_by_genre(&packet->data.list_by_genre, &ptr);
         break;
     case C2S_LIST_MOVIES:
     case C2S_LIST_MOVIES_DETAILED:
+        serialize_c2s_list(&packet->data.list, &ptr);
+        break;
+    case C2S_LIST_CHANGES_SINCE:
+        serialize_c2s_list_changes(&packet->data.list_changes, &ptr);
+        break;
+    case C2S_STATS:
+    case C2S_EXPORT:
     case C2S_UNKNOWN:
         break;
     default:
+        return -1;
+    }
+    return 0;
+}
+
+int C2SPacket_send(int socket_fd, const C2SPacket *packet) {
+    size_t total_size = calculate_c2s_packet_size(packet);
+
+    char *buffer = (char*)malloc(total_size);
+    if (!buffer) return -1;
+
+    if (C2SPacket_encode(packet, buffer) != 0) {
         free(buffer);
         return -1;
     }
@@ -344,27 +762,39 @@ int C2SPacket_send(int socket_fd, const C2SPacket *packet) {
     return result;
 }
 
-int C2SPacket_recv(int socket_fd, C2SPacket *packet) {
+static int c2s_read(PacketReader *reader, C2SPacket *packet) {
     int result = -1;
 
-    if (recv_all(socket_fd, &packet->type, sizeof(u8)) != 0) return -1;
+    if (read_bytes(reader, &packet->type, sizeof(u8)) != 0) return -1;
 
     switch (packet->type) {
     case C2S_ADD_MOVIE:
-        result = deserialize_c2s_add_movie(socket_fd, &packet->data.add_movie);
+        result = deserialize_c2s_add_movie(reader, &packet->data.add_movie);
         break;
     case C2S_ADD_GENRE_TO_MOVIE:
-        result = deserialize_c2s_add_genre(socket_fd, &packet->data.add_genre);
+        result = deserialize_c2s_add_genre(reader, &packet->data.add_genre);
         break;
     case C2S_REMOVE_MOVIE:
+        result = deserialize_c2s_movie_id(reader, &packet->data.remove_movie);
+        break;
     case C2S_GET_MOVIE:
-        result = deserialize_c2s_movie_id(socket_fd, &packet->data.remove_movie);
+        result = deserialize_c2s_get_movie(reader, &packet->data.get_movie);
+        break;
+    case C2S_GET_MOVIES:
+        result = deserialize_c2s_get_movies(reader, &packet->data.get_movies);
         break;
     case C2S_LIST_MOVIES_BY_GENRE:
-        result = deserialize_c2s_list_by_genre(socket_fd, &packet->data.list_by_genre);
+        result = deserialize_c2s_list_by_genre(reader, &packet->data.list_by_genre);
         break;
     case C2S_LIST_MOVIES:
     case C2S_LIST_MOVIES_DETAILED:
+        result = deserialize_c2s_list(reader, &packet->data.list);
+        break;
+    case C2S_LIST_CHANGES_SINCE:
+        result = deserialize_c2s_list_changes(reader, &packet->data.list_changes);
+        break;
+    case C2S_STATS:
+    case C2S_EXPORT:
     case C2S_UNKNOWN:
         result = 0;
         break;
@@ -385,6 +815,11 @@ recv_error:
     return -1;
 }
 
+int C2SPacket_recv(int socket_fd, C2SPacket *packet) {
+    PacketReader reader = {.socket_fd = socket_fd};
+    return c2s_read(&reader, packet);
+}
+
 void C2SPacket_free(C2SPacket *packet) {
     if (!packet) return;
     switch (packet->type) {
@@ -406,10 +841,17 @@ void C2SPacket_free(C2SPacket *packet) {
         free(packet->data.list_by_genre.genre);
         packet->data.list_by_genre.genre = NULL;
         break;
+    case C2S_GET_MOVIES:
+        free(packet->data.get_movies.movie_ids);
+        packet->data.get_movies.movie_ids = NULL;
+        break;
     case C2S_REMOVE_MOVIE:
     case C2S_LIST_MOVIES:
     case C2S_LIST_MOVIES_DETAILED:
     case C2S_GET_MOVIE:
+    case C2S_LIST_CHANGES_SINCE:
+    case C2S_STATS:
+    case C2S_EXPORT:
     case C2S_UNKNOWN:
     default:
         break;
@@ -446,6 +888,24 @@ int S2CPacket_send(int socket_fd, const S2CPacket *packet) {
     case S2C_ERROR:
         serialize_s2c_error(&packet->data.error, &ptr);
         break;
+    case S2C_NOT_MODIFIED:
+        serialize_s2c_not_modified(&packet->data.not_modified, &ptr);
+        break;
+    case S2C_MOVIE_CHANGES:
+        serialize_s2c_movie_changes(&packet->data.movie_changes, &ptr);
+        break;
+    case S2C_STATS:
+        serialize_s2c_stats(&packet->data.stats, &ptr);
+        break;
+    case S2C_MOVIE_CHUNK:
+        serialize_s2c_movie_chunk(&packet->data.movie_chunk, &ptr);
+        break;
+    case S2C_EXPORT_END:
+        serialize_s2c_export_end(&packet->data.export_end, &ptr);
+        break;
+    case S2C_MOVIES:
+        serialize_s2c_movies(&packet->data.movies, &ptr);
+        break;
     case S2C_UNKNOWN:
     case S2C_OK:
         break;
@@ -454,30 +914,48 @@ int S2CPacket_send(int socket_fd, const S2CPacket *packet) {
         return -1;
     }
 
-    int result = send_all(socket_fd, buffer, total_size);
+    int result = send_serialized(socket_fd, buffer, total_size);
     free(buffer);
     return result;
 }
 
-int S2CPacket_recv(int socket_fd, S2CPacket *packet) {
+static int s2c_read(PacketReader *reader, S2CPacket *packet) {
     int result = -1;
 
-    if (recv_all(socket_fd, &packet->type, sizeof(u8)) != 0) {
+    if (read_bytes(reader, &packet->type, sizeof(u8)) != 0) {
         return -1;
     }
 
     switch (packet->type) {
     case S2C_MOVIE:
-        result = deserialize_s2c_movie(socket_fd, &packet->data.movie);
+        result = deserialize_s2c_movie(reader, &packet->data.movie);
         break;
     case S2C_MOVIE_LIST:
-        result = deserialize_s2c_movie_list(socket_fd, &packet->data.movie_list);
+        result = deserialize_s2c_movie_list(reader, &packet->data.movie_list);
         break;
     case S2C_MOVIE_LIST_DETAILED:
-        result = deserialize_s2c_movie_list_detailed(socket_fd, &packet->data.movie_list_detailed);
+        result = deserialize_s2c_movie_list_detailed(reader, &packet->data.movie_list_detailed);
         break;
     case S2C_ERROR:
-        result = deserialize_s2c_error(socket_fd, &packet->data.error);
+        result = deserialize_s2c_error(reader, &packet->data.error);
+        break;
+    case S2C_NOT_MODIFIED:
+        result = deserialize_s2c_not_modified(reader, &packet->data.not_modified);
+        break;
+    case S2C_MOVIE_CHANGES:
+        result = deserialize_s2c_movie_changes(reader, &packet->data.movie_changes);
+        break;
+    case S2C_STATS:
+        result = deserialize_s2c_stats(reader, &packet->data.stats);
+        break;
+    case S2C_MOVIE_CHUNK:
+        result = deserialize_s2c_movie_chunk(reader, &packet->data.movie_chunk);
+        break;
+    case S2C_EXPORT_END:
+        result = deserialize_s2c_export_end(reader, &packet->data.export_end);
+        break;
+    case S2C_MOVIES:
+        result = deserialize_s2c_movies(reader, &packet->data.movies);
         break;
     case S2C_UNKNOWN:
     case S2C_OK:
@@ -500,6 +978,20 @@ s2c_recv_error:
     return -1;
 }
 
+int S2CPacket_recv(int socket_fd, S2CPacket *packet) {
+    PacketReader reader = {.socket_fd = socket_fd};
+    return s2c_read(&reader, packet);
+}
+
+ssize_t S2CPacket_decode(const char *data, size_t size, S2CPacket *packet) {
+    PacketReader reader = {.socket_fd = -1, .data = data, .size = size};
+    memset(packet, 0, sizeof(*packet));
+    if (s2c_read(&reader, packet) != 0) {
+        return reader.incomplete ? 0 : -1;
+    }
+    return (ssize_t)reader.offset;
+}
+
 void S2CPacket_free(S2CPacket *packet) {
     if (!packet) return;
     switch (packet->type) {
@@ -541,6 +1033,58 @@ void S2CPacket_free(S2CPacket *packet) {
         free(packet->data.error.message);
         packet->data.error.message = NULL;
         break;
+    case S2C_MOVIE_CHANGES:
+        if (packet->data.movie_changes.movies) {
+            for (u32 i = 0; i < packet->data.movie_changes.count; ++i) {
+                Movie* item = &packet->data.movie_changes.movies[i];
+                free(item->title);
+                free(item->genres);
+                free(item->director);
+                free(item->release_year);
+            }
+            free(packet->data.movie_changes.movies);
+        }
+        free(packet->data.movie_changes.removed_ids);
+        break;
+    case S2C_STATS:
+        if (packet->data.stats.counters) {
+            for (u32 i = 0; i < packet->data.stats.counter_count; ++i) {
+                free(packet->data.stats.counters[i].name);
+            }
+            free(packet->data.stats.counters);
+        }
+        if (packet->data.stats.latencies) {
+            for (u32 i = 0; i < packet->data.stats.latency_count; ++i) {
+                free(packet->data.stats.latencies[i].name);
+            }
+            free(packet->data.stats.latencies);
+        }
+        break;
+    case S2C_MOVIE_CHUNK:
+        if (packet->data.movie_chunk.movies) {
+            for (u32 i = 0; i < packet->data.movie_chunk.count; ++i) {
+                Movie* item = &packet->data.movie_chunk.movies[i];
+                free(item->title);
+                free(item->genres);
+                free(item->director);
+                free(item->release_year);
+            }
+            free(packet->data.movie_chunk.movies);
+        }
+        break;
+    case S2C_MOVIES:
+        if (packet->data.movies.movies) {
+            for (u32 i = 0; i < packet->data.movies.count; ++i) {
+                Movie* item = &packet->data.movies.movies[i];
+                free(item->title);
+                free(item->genres);
+                free(item->director);
+                free(item->release_year);
+            }
+            free(packet->data.movies.movies);
+        }
+        free(packet->data.movies.missing_ids);
+        break;
     case S2C_UNKNOWN:
     default:
         break;
@@ -548,3 +1092,98 @@ void S2CPacket_free(S2CPacket *packet) {
     memset(&packet->data, 0, sizeof(packet->data));
     packet->type = S2C_UNKNOWN;
 }
+
+// O cabeçalho (tipo + número de filmes) é reservado no começo do buffer e preenchido no envio.
+#define MOVIE_CHUNK_HEADER (sizeof(u8) + sizeof(u32))
+
+void MovieChunk_init(MovieChunk *chunk) {
+    memset(chunk, 0, sizeof(*chunk));
+}
+
+// Garante 'needed' bytes no buffer dos pacotes montados em partes (MovieChunk e MoviesReply).
+static int reserve_buffer(char **data, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) return 0;
+    size_t new_capacity = *capacity ? *capacity : 64 * 1024;
+    while (new_capacity < needed) new_capacity *= 2;
+    char *new_data = realloc(*data, new_capacity);
+    if (!new_data) return -1;
+    *data = new_data;
+    *capacity = new_capacity;
+    return 0;
+}
+
+int MovieChunk_add(MovieChunk *chunk, const Movie *movie) {
+    if (chunk->length == 0) chunk->length = MOVIE_CHUNK_HEADER;
+    size_t needed = chunk->length + calculate_movie_size(movie);
+    if (reserve_buffer(&chunk->data, &chunk->capacity, needed) != 0) return -1;
+    char *ptr = chunk->data + chunk->length;
+    serialize_s2c_movie(movie, &ptr);
+    chunk->length = (size_t)(ptr - chunk->data);
+    chunk->count++;
+    return 0;
+}
+
+int MovieChunk_send(int socket_fd, MovieChunk *chunk) {
+    if (chunk->count == 0) return 0;
+    char *ptr = chunk->data;
+    u8 type = S2C_MOVIE_CHUNK;
+    memcpy(ptr, &type, sizeof(u8));
+    ptr += sizeof(u8);
+    serialize_u32(chunk->count, &ptr);
+    int result = send_serialized(socket_fd, chunk->data, chunk->length);
+    chunk->length = 0;
+    chunk->count = 0;
+    return result;
+}
+
+void MovieChunk_free(MovieChunk *chunk) {
+    free(chunk->data);
+    memset(chunk, 0, sizeof(*chunk));
+}
+
+int MoviesReply_begin(MoviesReply *reply, u32 count) {
+    memset(reply, 0, sizeof(*reply));
+    if (reserve_buffer(&reply->data, &reply->capacity, sizeof(u8) + sizeof(u32)) != 0) return -1;
+    char *ptr = reply->data;
+    *ptr++ = S2C_MOVIES;
+    serialize_u32(count, &ptr);
+    reply->length = (size_t)(ptr - reply->data);
+    reply->remaining = count;
+    return 0;
+}
+
+int MoviesReply_add_movie(MoviesReply *reply, const Movie *movie) {
+    if (reply->remaining == 0) return -1;
+    size_t needed = reply->length + sizeof(u8) + calculate_movie_size(movie);
+    if (reserve_buffer(&reply->data, &reply->capacity, needed) != 0) return -1;
+    char *ptr = reply->data + reply->length;
+    *ptr++ = MOVIES_RECORD_MOVIE;
+    serialize_s2c_movie(movie, &ptr);
+    reply->length = (size_t)(ptr - reply->data);
+    reply->remaining--;
+    return 0;
+}
+
+int MoviesReply_add_missing(MoviesReply *reply, u32 movie_id) {
+    if (reply->remaining == 0) return -1;
+    size_t needed = reply->length + sizeof(u8) + sizeof(u32);
+    if (reserve_buffer(&reply->data, &reply->capacity, needed) != 0) return -1;
+    char *ptr = reply->data + reply->length;
+    *ptr++ = MOVIES_RECORD_MISSING;
+    serialize_u32(movie_id, &ptr);
+    reply->length = (size_t)(ptr - reply->data);
+    reply->remaining--;
+    return 0;
+}
+
+int MoviesReply_flush(int socket_fd, MoviesReply *reply) {
+    if (reply->length == 0) return 0;
+    int result = send_serialized(socket_fd, reply->data, reply->length);
+    reply->length = 0;
+    return result;
+}
+
+void MoviesReply_free(MoviesReply *reply) {
+    free(reply->data);
+    memset(reply, 0, sizeof(*reply));
+}
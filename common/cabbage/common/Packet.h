@@ -1,6 +1,7 @@
 #ifndef _CABBAGE_PACKET_H
 #define _CABBAGE_PACKET_H
 
+#include <sys/types.h>
 #include "cabbage/common/types.h"
 #include "Movie.h"
 
@@ -21,6 +22,10 @@
 #define C2S_LIST_MOVIES_DETAILED 0x05
 #define C2S_GET_MOVIE           0x06
 #define C2S_LIST_MOVIES_BY_GENRE 0x07
+#define C2S_LIST_CHANGES_SINCE  0x08
+#define C2S_STATS               0x09
+#define C2S_EXPORT              0x0A
+#define C2S_GET_MOVIES          0x0B
 
 // --- Pacotes Server-to-Client (S2C) ---
 #define S2C_UNKNOWN             0x00
@@ -29,6 +34,25 @@
 #define S2C_MOVIE_LIST_DETAILED 0x03
 #define S2C_ERROR               0x04
 #define S2C_OK                  0x05
+#define S2C_NOT_MODIFIED        0x06
+#define S2C_MOVIE_CHANGES       0x07
+#define S2C_STATS               0x08
+#define S2C_MOVIE_CHUNK         0x09
+#define S2C_EXPORT_END          0x0A
+#define S2C_MOVIES              0x0B
+
+// O C2S_EXPORT é o único pedido com várias respostas: o servidor manda a tabela inteira em vários S2C_MOVIE_CHUNK, à
+// medida que percorre os filmes, e termina com um S2C_EXPORT_END (ou um S2C_ERROR, se algo falhar no meio). Assim
+// nenhum dos lados precisa ter o catálogo inteiro em memória, ao contrário do LIST_MOVIES_DETAILED.
+
+// O C2S_GET_MOVIES busca vários filmes por ID numa ida e volta só (no máximo GET_MOVIES_MAX_IDS, os dois lados
+// recusam pedidos maiores). A resposta é um S2C_MOVIES com os filmes encontrados e os IDs que não existem; IDs
+// repetidos no pedido aparecem uma vez só.
+#define GET_MOVIES_MAX_IDS 4096
+
+// Os pacotes GET_MOVIE e LIST_* aceitam um campo opcional 'if_version' (if-version-differs).
+// Quando ele é diferente de 0 e a versão atual (do filme ou da store) é igual a ele, o servidor responde
+// apenas com um S2C_NOT_MODIFIED, sem reenviar os dados. O valor 0 significa "sempre envie".
 
 typedef struct {
     char* title;
@@ -48,20 +72,36 @@ typedef struct {
 
 typedef struct {
     u32 movie_id;
+    u64 if_version;
 } C2S_GetMovieData;
 
+typedef struct {
+    u32 count;
+    u32* movie_ids;
+} C2S_GetMoviesData;
+
+typedef struct {
+    u64 if_version;
+} C2S_ListData;
+
 typedef struct {
     char* genre;
+    u64 if_version;
 } C2S_ListByGenreData;
 
+typedef struct {
+    u64 since_version;
+} C2S_ListChangesData;
+
 typedef union {
     C2S_AddMovieData add_movie;
     C2S_AddGenreData add_genre;
     C2S_RemoveMovieData remove_movie;
-    // LIST_MOVIES não precisa de dados específicos
-    // LIST_MOVIES_DETAILED não precisa de dados específicos
+    C2S_ListData list; // LIST_MOVIES e LIST_MOVIES_DETAILED
     C2S_GetMovieData get_movie;
     C2S_ListByGenreData list_by_genre;
+    C2S_ListChangesData list_changes;
+    C2S_GetMoviesData get_movies;
 } C2SPacketDataUnion;
 
 // Definindo o pacote Client-to-Server (C2S)
@@ -76,24 +116,93 @@ typedef struct {
 } S2C_MovieIdTitle;
 
 typedef struct {
+    u64 version; // versão da store no momento da listagem
     u32 count;
     S2C_MovieIdTitle* movies;
 } S2C_MovieListData;
 
 typedef struct {
+    u64 version;
     u32 count;
     Movie* movies;
 } S2C_MovieListDetailedData;
 
+typedef struct {
+    u32 count;
+    Movie* movies;
+} S2C_MovieChunkData;
+
+// Fim do export. O export não é uma foto de um instante só: cada filme é lido com o lock dele, e 'version' é a versão
+// da store no começo, então toda mudança até ela está no export (mudanças feitas durante o export podem ou não estar).
+typedef struct {
+    u64 version;
+    u64 count;
+} S2C_ExportEndData;
+
+// Resposta do GET_MOVIES. No fio, cada um dos count + missing_count registros tem uma tag (1: filme, 0: ID não
+// encontrado), para o servidor poder mandar a resposta enquanto percorre a tabela sem saber antes quantos de cada.
+typedef struct {
+    u32 count;
+    Movie* movies;
+    u32 missing_count;
+    u32* missing_ids;
+} S2C_MoviesData;
+
 typedef struct {
     char* message;
 } S2C_ErrorData;
 
+typedef struct {
+    u64 version;
+} S2C_NotModifiedData;
+
+// Resposta do LIST_CHANGES_SINCE: filmes adicionados/modificados depois de 'since_version' e os IDs removidos
+// (tombstones). Quando 'full' é 1 o servidor não tem mais o histórico pedido, e 'movies' é a listagem completa,
+// que deve substituir o estado do cliente (removed_ids vem vazio nesse caso).
+typedef struct {
+    u64 version;
+    u8 full;
+    u32 count;
+    Movie* movies;
+    u32 removed_count;
+    u32* removed_ids;
+} S2C_MovieChangesData;
+
+// Resposta do C2S_STATS. As linhas são genéricas (nome + valores), para o servidor poder incluir novos números sem
+// mudar o formato: 'counters' tem contadores e medidas instantâneas (requisições, erros, bytes, conexões, ...), e
+// 'latencies' tem os percentis de latência de cada tipo de pacote, em nanossegundos.
+typedef struct {
+    char* name;
+    u64 value;
+} S2C_StatsCounter;
+
+typedef struct {
+    char* name;
+    u64 count;
+    u64 p50_ns;
+    u64 p99_ns;
+    u64 p999_ns;
+    u64 max_ns;
+} S2C_StatsLatency;
+
+typedef struct {
+    u32 counter_count;
+    S2C_StatsCounter* counters;
+    u32 latency_count;
+    S2C_StatsLatency* latencies;
+} S2C_StatsData;
+
 typedef union {
     Movie movie;
     S2C_MovieListData movie_list;
     S2C_MovieListDetailedData movie_list_detailed;
     S2C_ErrorData error;
+    S2C_NotModifiedData not_modified;
+    S2C_MovieChangesData movie_changes;
+    S2C_StatsData stats;
+    S2C_MovieChunkData movie_chunk;
+    S2C_ExportEndData export_end;
+    S2C_MoviesData movies;
     // OK não precisa de dados
 } S2CPacketDataUnion;
 
@@ -107,8 +216,60 @@ int C2SPacket_recv(int socket_fd, C2SPacket *packet);
 int C2SPacket_send(int socket_fd, const C2SPacket *packet);
 void C2SPacket_free(C2SPacket *packet);
 
+// Serialização em memória, para quem cuida do próprio I/O (a biblioteca do cliente): C2SPacket_encode escreve
+// C2SPacket_encoded_size(packet) bytes em 'buffer', e retorna -1 se o tipo for desconhecido.
+size_t C2SPacket_encoded_size(const C2SPacket *packet);
+int C2SPacket_encode(const C2SPacket *packet, char *buffer);
+
+// Nome do tipo de pacote (por exemplo "GET_MOVIE"), usado nas estatísticas.
+const char* C2SPacket_type_name(u8 type);
+
+// Bytes enviados e recebidos pela thread atual, contados pelas funções de send/recv.
+extern _Thread_local u64 packet_bytes_sent;
+extern _Thread_local u64 packet_bytes_received;
+
+// Chamada pelo S2CPacket_send, MovieChunk_send e MoviesReply_flush da thread atual entre a serialização e o envio
+// (usada pelo trace do servidor).
+extern _Thread_local void (*packet_serialized_hook)(void);
+
 int S2CPacket_recv(int socket_fd, S2CPacket *packet);
 int S2CPacket_send(int socket_fd, const S2CPacket *packet);
 void S2CPacket_free(S2CPacket *packet);
 
+// Lê um pacote dos 'size' bytes em 'data' (o contrário do S2CPacket_send). Retorna quantos bytes o pacote ocupa, 0
+// se os dados ainda não têm o pacote inteiro (nada fica alocado) ou -1 se o pacote é inválido.
+ssize_t S2CPacket_decode(const char *data, size_t size, S2CPacket *packet);
+
+// Montagem de um S2C_MOVIE_CHUNK direto da tabela do servidor: MovieChunk_add serializa o filme no buffer (sem as
+// cópias das strings que um S2CPacket precisaria), então pode ser chamada com o lock da entrada. MovieChunk_send manda
+// o pacote com os filmes adicionados até ali e esvazia o chunk, mantendo o buffer para o próximo.
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    u32 count;
+} MovieChunk;
+
+void MovieChunk_init(MovieChunk *chunk);
+int MovieChunk_add(MovieChunk *chunk, const Movie *movie);
+int MovieChunk_send(int socket_fd, MovieChunk *chunk);
+void MovieChunk_free(MovieChunk *chunk);
+
+// Montagem de um S2C_MOVIES em partes, também sem copiar as strings: MoviesReply_begin recebe o número total de
+// registros (que vai no cabeçalho), e depois cada filme encontrado ou ID que falta é adicionado ao buffer.
+// MoviesReply_flush manda o que já foi montado, então a resposta pode sair aos poucos; se um envio falhar no meio, o
+// pacote fica incompleto e a conexão não pode mais ser usada.
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    u32 remaining;
+} MoviesReply;
+
+int MoviesReply_begin(MoviesReply *reply, u32 count);
+int MoviesReply_add_movie(MoviesReply *reply, const Movie *movie);
+int MoviesReply_add_missing(MoviesReply *reply, u32 movie_id);
+int MoviesReply_flush(int socket_fd, MoviesReply *reply);
+void MoviesReply_free(MoviesReply *reply);
+
 #endif // _CABBAGE_PACKET_H
@@ -0,0 +1,48 @@
+#ifndef _CABBAGE_COMMON_HISTOGRAM_H
+#define _CABBAGE_COMMON_HISTOGRAM_H
+
+#include "cabbage/common/types.h"
+
+// Buckets de histograma de latência no estilo do HdrHistogram, usados pelo servidor (stats.c) e pelos benchmarks.
+// Cada potência de 2 é dividida em HIST_SUB_BUCKETS buckets lineares, então o erro relativo fica abaixo de
+// 1/HIST_SUB_BUCKETS (~3%). Quem usa guarda só o vetor de contagens, do tipo que precisar (atômico ou não).
+
+#define HIST_SUB_BUCKET_BITS 5
+#define HIST_SUB_BUCKETS (1u << HIST_SUB_BUCKET_BITS)
+// Valores a partir de 2^HIST_MAX_EXPONENT caem no último bucket.
+#define HIST_MAX_EXPONENT 40
+#define HIST_BUCKETS ((HIST_MAX_EXPONENT - HIST_SUB_BUCKET_BITS + 1) * HIST_SUB_BUCKETS)
+
+inline static unsigned hist_bucket_index(u64 value) {
+    if (value < HIST_SUB_BUCKETS) return (unsigned)value;
+    unsigned exponent = 63 - (unsigned)__builtin_clzll(value);
+    if (exponent >= HIST_MAX_EXPONENT) return HIST_BUCKETS - 1;
+    unsigned shift = exponent - HIST_SUB_BUCKET_BITS;
+    return (shift + 1) * HIST_SUB_BUCKETS + (unsigned)((value >> shift) - HIST_SUB_BUCKETS);
+}
+
+// Maior valor que cai no bucket (como o "highest equivalent value" do HdrHistogram).
+inline static u64 hist_bucket_upper_value(unsigned index) {
+    if (index < HIST_SUB_BUCKETS) return index;
+    unsigned shift = index / HIST_SUB_BUCKETS - 1;
+    u64 sub = HIST_SUB_BUCKETS + index % HIST_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+// Percentil (de 0 a 100) dos 'total' valores contados em 'buckets', limitado ao maior valor registrado.
+inline static u64 hist_percentile(const u64* buckets, u64 total, u64 max, double percentile) {
+    if (total == 0) return 0;
+    u64 target = (u64)(percentile / 100.0 * (double)total + 0.5);
+    if (target == 0) target = 1;
+    u64 seen = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen >= target) {
+            u64 value = hist_bucket_upper_value(i);
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
+
+#endif
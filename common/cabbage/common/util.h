@@ -0,0 +1,50 @@
+#ifndef _CABBAGE_COMMON_UTIL_H
+#define _CABBAGE_COMMON_UTIL_H
+
+#include <stdio.h>
+#include <time.h>
+#include "cabbage/common/types.h"
+
+// Funções pequenas usadas pelo cliente, pelas ferramentas e pelos benchmarks.
+
+// Relógio monotônico em nanossegundos, para medir intervalos e prazos.
+inline static u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+// xorshift64*: gerador rápido e sem estado global (cada thread guarda o seu), bom para gerar carga, não para
+// criptografia. O estado não pode começar em 0.
+inline static u64 next_random(u64* state) {
+    u64 x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 2685821657736338717ull;
+}
+
+// Escreve o texto como string JSON (com aspas e escapes), ou null se for NULL.
+inline static void json_write_string(FILE* out, const char* text) {
+    if (!text) {
+        fputs("null", out);
+        return;
+    }
+    putc('"', out);
+    for (const unsigned char* p = (const unsigned char*)text; *p; ++p) {
+        switch (*p) {
+        case '"': fputs("\\\"", out); break;
+        case '\\': fputs("\\\\", out); break;
+        case '\n': fputs("\\n", out); break;
+        case '\r': fputs("\\r", out); break;
+        case '\t': fputs("\\t", out); break;
+        default:
+            if (*p < 0x20) fprintf(out, "\\u%04x", *p);
+            else putc(*p, out);
+        }
+    }
+    putc('"', out);
+}
+
+#endif
@@ -0,0 +1,107 @@
+#include "IdIndex.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Mistura os bits do ID (IDs são sequenciais, então sem isso tudo cairia em buckets vizinhos).
+static inline size_t hash_id(u32 id, size_t mask) {
+    u32 h = id * 0x9E3779B1u;
+    h ^= h >> 16;
+    return (size_t)h & mask;
+}
+
+size_t IdIndex_capacity_for(size_t expected_size) {
+    size_t capacity = 16;
+    while (capacity < expected_size * 2) capacity <<= 1;
+    return capacity;
+}
+
+int IdIndex_init(IdIndex* index, size_t expected_size) {
+    size_t capacity = IdIndex_capacity_for(expected_size);
+
+    index->keys = calloc(capacity, sizeof(u32));
+    index->values = malloc(capacity * sizeof(u32));
+    if (!index->keys || !index->values) {
+        perror("IdIndex_init: allocation failed");
+        free(index->keys);
+        free(index->values);
+        index->keys = NULL;
+        index->values = NULL;
+        return -1;
+    }
+    index->capacity = capacity;
+    index->size = 0;
+    index->borrowed = 0;
+    return 0;
+}
+
+void IdIndex_wrap(IdIndex* index, u32* keys, u32* values, size_t capacity, size_t size) {
+    index->keys = keys;
+    index->values = values;
+    index->capacity = capacity;
+    index->size = size;
+    index->borrowed = 1;
+}
+
+void IdIndex_free(IdIndex* index) {
+    if (!index->borrowed) {
+        free(index->keys);
+        free(index->values);
+    }
+    index->keys = NULL;
+    index->values = NULL;
+    index->capacity = 0;
+    index->size = 0;
+    index->borrowed = 0;
+}
+
+u32 IdIndex_get(const IdIndex* index, u32 id) {
+    if (id == ID_INDEX_EMPTY) return ID_INDEX_NOT_FOUND;
+    size_t mask = index->capacity - 1;
+    for (size_t i = hash_id(id, mask);; i = (i + 1) & mask) {
+        if (index->keys[i] == id) return index->values[i];
+        if (index->keys[i] == ID_INDEX_EMPTY) return ID_INDEX_NOT_FOUND;
+    }
+}
+
+int IdIndex_put(IdIndex* index, u32 id, u32 value) {
+    if (id == ID_INDEX_EMPTY) return -1;
+    size_t mask = index->capacity - 1;
+    for (size_t i = hash_id(id, mask);; i = (i + 1) & mask) {
+        if (index->keys[i] == id) {
+            index->values[i] = value;
+            return 0;
+        }
+        if (index->keys[i] == ID_INDEX_EMPTY) {
+            // Mantém pelo menos metade da tabela vazia para a sondagem terminar rápido.
+            if ((index->size + 1) * 2 > index->capacity) return -1;
+            index->keys[i] = id;
+            index->values[i] = value;
+            index->size++;
+            return 0;
+        }
+    }
+}
+
+void IdIndex_remove(IdIndex* index, u32 id) {
+    if (id == ID_INDEX_EMPTY) return;
+    size_t mask = index->capacity - 1;
+    size_t i = hash_id(id, mask);
+    while (index->keys[i] != id) {
+        if (index->keys[i] == ID_INDEX_EMPTY) return;
+        i = (i + 1) & mask;
+    }
+
+    // Backward shift: puxa para trás os elementos seguintes do cluster que podem ocupar o buraco.
+    size_t hole = i;
+    for (size_t j = (hole + 1) & mask; index->keys[j] != ID_INDEX_EMPTY; j = (j + 1) & mask) {
+        size_t home = hash_id(index->keys[j], mask);
+        // O elemento em j pode ir para o buraco se sua posição ideal não estiver entre (hole, j].
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            index->keys[hole] = index->keys[j];
+            index->values[hole] = index->values[j];
+            hole = j;
+        }
+    }
+    index->keys[hole] = ID_INDEX_EMPTY;
+    index->size--;
+}
@@ -0,0 +1,35 @@
+#ifndef _CABBAGE_ID_INDEX_H
+#define _CABBAGE_ID_INDEX_H
+
+#include <stddef.h>
+#include "cabbage/common/types.h"
+
+// Hash map simples de ID de filme -> posição na tabela de MovieEntry.
+// Endereçamento aberto com sondagem linear e remoção por backward shift (sem tombstones), então o custo
+// das operações não degrada depois de muitas remoções. Não é thread-safe.
+
+typedef struct {
+    u32* keys;   // ID_INDEX_EMPTY marca um bucket vazio
+    u32* values;
+    size_t capacity; // potência de 2
+    size_t size;
+    int borrowed; // keys/values pertencem a outra pessoa (ver IdIndex_wrap)
+} IdIndex;
+
+#define ID_INDEX_EMPTY 0u // IDs de filme começam em 1
+#define ID_INDEX_NOT_FOUND ((u32)-1)
+
+// 'expected_size' é o número máximo de elementos; a tabela é criada com fator de carga <= 0.5 e não cresce.
+int IdIndex_init(IdIndex* index, size_t expected_size);
+// Capacidade que o IdIndex_init usa para 'expected_size' elementos.
+size_t IdIndex_capacity_for(size_t expected_size);
+// Usa tabelas keys/values já preenchidas (por exemplo mapeadas de um snapshot). Elas continuam podendo ser alteradas,
+// mas não são liberadas pelo IdIndex_free.
+void IdIndex_wrap(IdIndex* index, u32* keys, u32* values, size_t capacity, size_t size);
+void IdIndex_free(IdIndex* index);
+
+u32 IdIndex_get(const IdIndex* index, u32 id);
+int IdIndex_put(IdIndex* index, u32 id, u32 value);
+void IdIndex_remove(IdIndex* index, u32 id);
+
+#endif // _CABBAGE_ID_INDEX_H
@@ -0,0 +1,139 @@
+#include "LogRecord.h"
+#include <string.h>
+#include <endian.h>
+#include "crc32c.h"
+
+// Funções pequenas de (de)serialização, no mesmo estilo do Packet.c, mas em little-endian e em memória.
+
+static void put_u8(u8 value, char** ptr) {
+    **ptr = (char)value;
+    *ptr += sizeof(u8);
+}
+
+static void put_u32(u32 value, char** ptr) {
+    u32 le = htole32(value);
+    memcpy(*ptr, &le, sizeof(u32));
+    *ptr += sizeof(u32);
+}
+
+static void put_u64(u64 value, char** ptr) {
+    u64 le = htole64(value);
+    memcpy(*ptr, &le, sizeof(u64));
+    *ptr += sizeof(u64);
+}
+
+static u32 get_u32(const char* ptr) {
+    u32 le;
+    memcpy(&le, ptr, sizeof(u32));
+    return le32toh(le);
+}
+
+static u64 get_u64(const char* ptr) {
+    u64 le;
+    memcpy(&le, ptr, sizeof(u64));
+    return le64toh(le);
+}
+
+static u32 expected_field_count(u8 type) {
+    switch (type) {
+    case LOG_RECORD_ADD: return 4;
+    case LOG_RECORD_ADD_GENRE: return 1;
+    case LOG_RECORD_REMOVE: return 0;
+    default: return (u32)-1;
+    }
+}
+
+void LogFile_write_header(char* buffer) {
+    memset(buffer, 0, LOG_FILE_HEADER_SIZE);
+    memcpy(buffer, LOG_FILE_MAGIC, sizeof(LOG_FILE_MAGIC));
+    char* ptr = buffer + LOG_FILE_MAGIC_SIZE;
+    put_u32(LOG_FILE_FORMAT_VERSION, &ptr);
+}
+
+int LogFile_check_header(const char* buffer, size_t available) {
+    if (available < LOG_FILE_HEADER_SIZE) return 0;
+    if (memcmp(buffer, LOG_FILE_MAGIC, sizeof(LOG_FILE_MAGIC)) != 0) return 0;
+    return get_u32(buffer + LOG_FILE_MAGIC_SIZE) == LOG_FILE_FORMAT_VERSION;
+}
+
+size_t LogRecord_encoded_size(const LogRecord* record) {
+    size_t size = LOG_RECORD_HEADER_SIZE;
+    size += sizeof(u8) + sizeof(u64) + sizeof(u64) + sizeof(u32);
+    for (u32 i = 0; i < record->field_count; ++i) {
+        size += sizeof(u32) + record->field_lengths[i];
+    }
+    return size;
+}
+
+void LogRecord_encode(const LogRecord* record, char* buffer) {
+    char* ptr = buffer + LOG_RECORD_HEADER_SIZE;
+    put_u8(record->type, &ptr);
+    put_u64(record->version, &ptr);
+    put_u64(record->timestamp_us, &ptr);
+    put_u32(record->movie_id, &ptr);
+    for (u32 i = 0; i < record->field_count; ++i) {
+        put_u32(record->field_lengths[i], &ptr);
+        if (record->field_lengths[i] > 0) {
+            memcpy(ptr, record->fields[i], record->field_lengths[i]);
+            ptr += record->field_lengths[i];
+        }
+    }
+
+    u32 length = (u32)(ptr - buffer - LOG_RECORD_HEADER_SIZE);
+    char* header = buffer;
+    put_u32(length, &header);
+    u32 crc = crc32c_extend(crc32c(buffer, sizeof(u32)), buffer + LOG_RECORD_HEADER_SIZE, length);
+    put_u32(crc, &header);
+}
+
+static int decode_record(const char* data, size_t available, LogRecord* record, size_t* consumed, int check_crc) {
+    if (available < LOG_RECORD_HEADER_SIZE) return LOG_RECORD_TRUNCATED;
+
+    u32 length = get_u32(data);
+    u32 crc = get_u32(data + sizeof(u32));
+    if ((size_t)length > available - LOG_RECORD_HEADER_SIZE) return LOG_RECORD_TRUNCATED;
+
+    const char* payload = data + LOG_RECORD_HEADER_SIZE;
+    if (check_crc && crc32c_extend(crc32c(data, sizeof(u32)), payload, length) != crc) return LOG_RECORD_CORRUPT;
+
+    const size_t fixed = sizeof(u8) + sizeof(u64) + sizeof(u64) + sizeof(u32);
+    if (length < fixed) return LOG_RECORD_CORRUPT;
+
+    const char* ptr = payload;
+    const char* end = payload + length;
+    record->type = (u8)*ptr; ptr += sizeof(u8);
+    record->version = get_u64(ptr); ptr += sizeof(u64);
+    record->timestamp_us = get_u64(ptr); ptr += sizeof(u64);
+    record->movie_id = get_u32(ptr); ptr += sizeof(u32);
+
+    record->field_count = expected_field_count(record->type);
+    if (record->field_count > LOG_RECORD_MAX_FIELDS) return LOG_RECORD_CORRUPT;
+
+    for (u32 i = 0; i < record->field_count; ++i) {
+        if ((size_t)(end - ptr) < sizeof(u32)) return LOG_RECORD_CORRUPT;
+        u32 field_length = get_u32(ptr);
+        ptr += sizeof(u32);
+        if ((size_t)(end - ptr) < field_length) return LOG_RECORD_CORRUPT;
+        record->fields[i] = ptr;
+        record->field_lengths[i] = field_length;
+        ptr += field_length;
+    }
+    if (ptr != end) return LOG_RECORD_CORRUPT;
+
+    *consumed = LOG_RECORD_HEADER_SIZE + length;
+    return LOG_RECORD_OK;
+}
+
+int LogRecord_decode(const char* data, size_t available, LogRecord* record, size_t* consumed) {
+    return decode_record(data, available, record, consumed, 1);
+}
+
+int LogRecord_decode_trusted(const char* data, size_t available, LogRecord* record, size_t* consumed) {
+    return decode_record(data, available, record, consumed, 0);
+}
+
+size_t LogRecord_peek_size(const char* data, size_t available) {
+    if (available < LOG_RECORD_HEADER_SIZE) return 0;
+    size_t total = LOG_RECORD_HEADER_SIZE + (size_t)get_u32(data);
+    return total <= available ? total : 0;
+}
@@ -0,0 +1,68 @@
+#ifndef _CABBAGE_LOG_RECORD_H
+#define _CABBAGE_LOG_RECORD_H
+
+#include <stddef.h>
+#include "cabbage/common/types.h"
+
+// Formato binário do arquivo de log (versão 1).
+//
+// O arquivo começa com um cabeçalho de LOG_FILE_HEADER_SIZE bytes: o magic "CABBLOG\0", a versão do formato (u32)
+// e 4 bytes reservados. Depois vêm os registros, um após o outro:
+//
+//   u32 length     tamanho do payload
+//   u32 crc        CRC32C do campo length seguido do payload
+//   payload:
+//     u8  type     LOG_RECORD_ADD, LOG_RECORD_ADD_GENRE ou LOG_RECORD_REMOVE
+//     u64 version  versão da store produzida pela mutação
+//     u64 timestamp_us
+//     u32 movie_id
+//     strings      ADD: title, genres, director, release_year; ADD_GENRE: genre; REMOVE: nenhuma
+//                  cada string é um u32 com o tamanho seguido dos bytes (sem '\0')
+//
+// Todos os inteiros são little-endian. Como as strings têm prefixo de tamanho, qualquer caractere ('|', '\n', ...)
+// pode aparecer nos campos, e não existe limite de tamanho além do u32.
+
+#define LOG_FILE_MAGIC "CABBLOG"
+#define LOG_FILE_MAGIC_SIZE 8
+#define LOG_FILE_FORMAT_VERSION 1
+#define LOG_FILE_HEADER_SIZE 16
+
+#define LOG_RECORD_HEADER_SIZE 8
+#define LOG_RECORD_MAX_FIELDS 4
+
+#define LOG_RECORD_ADD       0x01
+#define LOG_RECORD_ADD_GENRE 0x02
+#define LOG_RECORD_REMOVE    0x03
+
+// Resultados de LogRecord_decode.
+#define LOG_RECORD_OK         0
+#define LOG_RECORD_TRUNCATED  1 // o buffer acaba no meio do registro
+#define LOG_RECORD_CORRUPT   -1 // checksum ou estrutura inválidos
+
+// Um registro decodificado. As strings NÃO são terminadas em '\0': apontam direto para o buffer de origem
+// (field_lengths diz o tamanho), assim a decodificação não aloca nada.
+typedef struct {
+    u8 type;
+    u64 version;
+    u64 timestamp_us;
+    u32 movie_id;
+    u32 field_count;
+    const char* fields[LOG_RECORD_MAX_FIELDS];
+    u32 field_lengths[LOG_RECORD_MAX_FIELDS];
+} LogRecord;
+
+void LogFile_write_header(char* buffer);
+// Retorna 1 se o buffer começa com um cabeçalho válido, 0 caso contrário.
+int LogFile_check_header(const char* buffer, size_t available);
+
+size_t LogRecord_encoded_size(const LogRecord* record);
+// Escreve o registro completo (cabeçalho + payload) em 'buffer', que precisa ter LogRecord_encoded_size() bytes.
+void LogRecord_encode(const LogRecord* record, char* buffer);
+// Decodifica o registro no início de 'data'. Em caso de sucesso *consumed recebe o tamanho total do registro.
+int LogRecord_decode(const char* data, size_t available, LogRecord* record, size_t* consumed);
+// Igual ao LogRecord_decode, mas sem verificar o checksum (para registros que já foram verificados).
+int LogRecord_decode_trusted(const char* data, size_t available, LogRecord* record, size_t* consumed);
+// Tamanho total do registro no início de 'data' olhando só o prefixo de tamanho, ou 0 se ele não cabe em 'available'.
+size_t LogRecord_peek_size(const char* data, size_t available);
+
+#endif // _CABBAGE_LOG_RECORD_H
@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+#include "stats.h"
+#include "lockprof.h"
 
 int MovieEntry_init(MovieEntry* entry) {
     if (entry == NULL) {
@@ -11,6 +13,8 @@ int MovieEntry_init(MovieEntry* entry) {
     }
 
     entry->movie = NULL;
+    atomic_init(&entry->lock_site, 0);
+    entry->locked_ns = 0;
 
     int status = pthread_mutex_init(&entry->mutex, NULL);
     if (status != 0) {
@@ -28,12 +32,30 @@ int MovieEntry_lock(MovieEntry* entry) {
         return -1;
     }
 
-    int status = pthread_mutex_lock(&entry->mutex);
+    // O tempo de espera só é medido quando o lock está ocupado, então o caminho comum não lê o relógio (a não ser
+    // com o perfil de locks ligado, que também mede o tempo com o lock).
+    int profiling = atomic_load_explicit(&lockprof_enabled, memory_order_relaxed);
+    int contended = 0;
+    u64 start = 0, now = 0;
+    u8 holder = 0;
+    int status = pthread_mutex_trylock(&entry->mutex);
+    if (status == EBUSY) {
+        contended = 1;
+        if (profiling) holder = atomic_load_explicit(&entry->lock_site, memory_order_relaxed);
+        start = stats_now_ns();
+        status = pthread_mutex_lock(&entry->mutex);
+        now = stats_now_ns();
+        stats_record(STATS_LOCK_WAIT, now - start);
+    }
     if (status != 0) {
         errno = status;
         perror("Erro ao bloquear o mutex do MovieEntry");
         return -1;
     }
+    if (profiling) {
+        if (!contended) now = stats_now_ns();
+        lockprof_acquired(entry, now, contended, contended ? now - start : 0, holder);
+    }
 
     return 0;
 }
@@ -44,6 +66,7 @@ int MovieEntry_unlock(MovieEntry* entry) {
         return -1;
     }
 
+    if (atomic_load_explicit(&lockprof_enabled, memory_order_relaxed)) lockprof_released(entry);
     int status = pthread_mutex_unlock(&entry->mutex);
     if (status != 0) {
         errno = status;
@@ -2,11 +2,15 @@
 #define MOVIE_ENTRY_H
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include "cabbage/common/Movie.h"
 
 typedef struct {
     Movie* movie;
     pthread_mutex_t mutex;
+    // Só usados com o perfil de locks ligado (lockprof.h): quem segura o lock e desde quando.
+    atomic_uchar lock_site;
+    u64 locked_ns;
 } MovieEntry;
 
 int MovieEntry_init(MovieEntry* entry);
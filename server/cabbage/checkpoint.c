@@ -0,0 +1,117 @@
+#include "checkpoint.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include "logger.h"
+#include "snapshot.h"
+#include "LogRecord.h"
+
+static checkpoint_config_t checkpoint_config;
+
+static pthread_t checkpoint_thread;
+static int checkpoint_running = 0;
+static pthread_mutex_t checkpoint_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t checkpoint_cond = PTHREAD_COND_INITIALIZER;
+static int checkpoint_stopping = 0;
+
+// Serializa checkpoints (thread de fundo e chamadas diretas ao checkpoint_run).
+static pthread_mutex_t checkpoint_run_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static u64 monotonic_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec;
+}
+
+int checkpoint_run(void) {
+    pthread_mutex_lock(&checkpoint_run_mutex);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    u64 first_segment;
+    if (log_rotate(&first_segment) < 0) {
+        fprintf(stderr, "Checkpoint: log rotation failed\n");
+        pthread_mutex_unlock(&checkpoint_run_mutex);
+        return -1;
+    }
+
+    if (snapshot_write(checkpoint_config.snapshot_filename,
+                       checkpoint_config.entries,
+                       checkpoint_config.max_entries,
+                       checkpoint_config.next_id_ptr,
+                       checkpoint_config.store_version_ptr) < 0) {
+        fprintf(stderr, "Checkpoint: snapshot failed, keeping the log segments\n");
+        pthread_mutex_unlock(&checkpoint_run_mutex);
+        return -1;
+    }
+
+    log_remove_segments_before(first_segment);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("Checkpoint finished in %.1f ms.\n", elapsed_ms);
+    pthread_mutex_unlock(&checkpoint_run_mutex);
+    return 0;
+}
+
+static void* checkpoint_main(void* arg) {
+    (void)arg;
+    u64 last_checkpoint = monotonic_s();
+
+    pthread_mutex_lock(&checkpoint_mutex);
+    while (!checkpoint_stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+        pthread_cond_timedwait(&checkpoint_cond, &checkpoint_mutex, &deadline);
+        if (checkpoint_stopping) break;
+
+        // Um log só com o cabeçalho não tem nada para compactar.
+        size_t size = log_size();
+        if (size <= LOG_FILE_HEADER_SIZE) {
+            last_checkpoint = monotonic_s();
+            continue;
+        }
+
+        u64 now = monotonic_s();
+        int by_time = checkpoint_config.interval_seconds > 0 &&
+                      now - last_checkpoint >= checkpoint_config.interval_seconds;
+        int by_size = checkpoint_config.log_size_threshold > 0 && size >= checkpoint_config.log_size_threshold;
+        if (!by_time && !by_size) continue;
+
+        pthread_mutex_unlock(&checkpoint_mutex);
+        checkpoint_run();
+        last_checkpoint = monotonic_s();
+        pthread_mutex_lock(&checkpoint_mutex);
+    }
+    pthread_mutex_unlock(&checkpoint_mutex);
+    return NULL;
+}
+
+int checkpoint_start(const checkpoint_config_t* config) {
+    checkpoint_config = *config;
+
+    if (config->interval_seconds == 0 && config->log_size_threshold == 0) {
+        return 0;
+    }
+
+    checkpoint_stopping = 0;
+    if (pthread_create(&checkpoint_thread, NULL, checkpoint_main, NULL) != 0) {
+        perror("checkpoint_start: pthread_create failed");
+        return -1;
+    }
+    checkpoint_running = 1;
+    return 0;
+}
+
+void checkpoint_stop(void) {
+    if (!checkpoint_running) return;
+    pthread_mutex_lock(&checkpoint_mutex);
+    checkpoint_stopping = 1;
+    pthread_cond_signal(&checkpoint_cond);
+    pthread_mutex_unlock(&checkpoint_mutex);
+    pthread_join(checkpoint_thread, NULL);
+    checkpoint_running = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef _CABBAGE_CHECKPOINT_H
+#define _CABBAGE_CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include "MovieEntry.h"
+
+// Checkpoint em segundo plano: de tempos em tempos (ou quando o log passa de um tamanho) a store é salva em um
+// snapshot e o log é truncado, para o restore não precisar reaplicar todo o histórico.
+//
+// O checkpoint é feito em três passos, cada um seguro contra quedas:
+//   1. o escritor do log fecha o segmento atual e começa um novo (log_rotate);
+//   2. o snapshot é escrito em '<snapshot>.tmp' e renomeado para '<snapshot>';
+//   3. os segmentos anteriores ao novo são apagados.
+// No boot, o restore carrega o snapshot e aplica todos os segmentos que sobraram (se o checkpoint foi interrompido,
+// os segmentos antigos ainda estão lá e são aplicados de novo, o que é seguro porque a reaplicação é idempotente).
+
+typedef struct {
+    const char* snapshot_filename;
+    MovieEntry* entries;
+    size_t max_entries;
+    atomic_uint* next_id_ptr;
+    atomic_ullong* store_version_ptr;
+    unsigned interval_seconds; // 0 desativa o checkpoint por tempo
+    size_t log_size_threshold; // 0 desativa o checkpoint por tamanho
+} checkpoint_config_t;
+
+// Inicia a thread de checkpoint. Deve ser chamada depois do log_init.
+int checkpoint_start(const checkpoint_config_t* config);
+void checkpoint_stop(void);
+
+// Faz um checkpoint imediatamente (bloqueante). Retorna 0 em caso de sucesso e -1 em caso de erro.
+int checkpoint_run(void);
+
+#endif // _CABBAGE_CHECKPOINT_H
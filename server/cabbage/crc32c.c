@@ -0,0 +1,81 @@
+#include "crc32c.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_HAVE_HW 1
+
+// Com a instrução crc32 do SSE4.2. O atributo target permite usá-la sem compilar o resto com -msse4.2; a escolha é
+// feita em tempo de execução, no crc32c_extend.
+__attribute__((target("sse4.2")))
+static u32 crc32c_extend_hw(u32 crc, const void* data, size_t length) {
+    const u8* p = (const u8*)data;
+    u64 c = ~crc;
+    while (length >= 8) {
+        u64 word;
+        memcpy(&word, p, sizeof(word));
+        c = _mm_crc32_u64(c, word);
+        p += 8;
+        length -= 8;
+    }
+    u32 c32 = (u32)c;
+    while (length--) {
+        c32 = _mm_crc32_u8(c32, *p++);
+    }
+    return ~c32;
+}
+#endif
+
+#define CRC32C_POLY 0x82F63B78u // polinômio refletido
+
+static u32 crc32c_table[8][256];
+static pthread_once_t crc32c_table_once = PTHREAD_ONCE_INIT;
+
+static void crc32c_init_table(void) {
+    for (u32 i = 0; i < 256; ++i) {
+        u32 c = i;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        }
+        crc32c_table[0][i] = c;
+    }
+    for (u32 i = 0; i < 256; ++i) {
+        u32 c = crc32c_table[0][i];
+        for (int t = 1; t < 8; ++t) {
+            c = crc32c_table[0][c & 0xFF] ^ (c >> 8);
+            crc32c_table[t][i] = c;
+        }
+    }
+}
+
+// Slicing-by-8: processa 8 bytes por iteração usando 8 tabelas, assumindo little-endian (x86/ARM).
+static u32 crc32c_extend_table(u32 crc, const void* data, size_t length) {
+    pthread_once(&crc32c_table_once, crc32c_init_table);
+
+    const u8* p = (const u8*)data;
+    u32 c = ~crc;
+    while (length >= 8) {
+        u32 lo, hi;
+        memcpy(&lo, p, sizeof(lo));
+        memcpy(&hi, p + 4, sizeof(hi));
+        lo ^= c;
+        c = crc32c_table[7][lo & 0xFF] ^ crc32c_table[6][(lo >> 8) & 0xFF] ^
+            crc32c_table[5][(lo >> 16) & 0xFF] ^ crc32c_table[4][lo >> 24] ^
+            crc32c_table[3][hi & 0xFF] ^ crc32c_table[2][(hi >> 8) & 0xFF] ^
+            crc32c_table[1][(hi >> 16) & 0xFF] ^ crc32c_table[0][hi >> 24];
+        p += 8;
+        length -= 8;
+    }
+    while (length--) {
+        c = crc32c_table[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+    }
+    return ~c;
+}
+
+u32 crc32c_extend(u32 crc, const void* data, size_t length) {
+#ifdef CRC32C_HAVE_HW
+    if (__builtin_cpu_supports("sse4.2")) return crc32c_extend_hw(crc, data, length);
+#endif
+    return crc32c_extend_table(crc, data, length);
+}
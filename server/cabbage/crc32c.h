@@ -0,0 +1,17 @@
+#ifndef _CABBAGE_CRC32C_H
+#define _CABBAGE_CRC32C_H
+
+#include <stddef.h>
+#include "cabbage/common/types.h"
+
+// CRC32C (Castagnoli), o mesmo usado por ext4/iSCSI. No x86-64 usa a instrução crc32 quando o processador tem
+// SSE4.2 (detectado em tempo de execução), senão cai numa implementação por tabela (slicing-by-8).
+
+// Continua um CRC já calculado: crc32c_extend(crc32c(a), b) == crc32c(a concatenado com b).
+u32 crc32c_extend(u32 crc, const void* data, size_t length);
+
+static inline u32 crc32c(const void* data, size_t length) {
+    return crc32c_extend(0, data, length);
+}
+
+#endif // _CABBAGE_CRC32C_H
@@ -0,0 +1,93 @@
+#include "history.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    u32 movie_id;
+    u64 version;
+} Tombstone;
+
+static Tombstone* tombstones = NULL;
+static size_t tombstones_capacity = 0;
+static size_t tombstones_head = 0; // próxima posição a ser escrita
+static size_t tombstones_size = 0;
+static u64 window_floor = 0;
+static pthread_mutex_t history_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int history_init(size_t capacity, u64 initial_version) {
+    tombstones = calloc(capacity, sizeof(Tombstone));
+    if (!tombstones) {
+        perror("history_init: calloc failed");
+        return -1;
+    }
+    tombstones_capacity = capacity;
+    tombstones_head = 0;
+    tombstones_size = 0;
+    // Não sabemos nada sobre remoções anteriores ao boot.
+    window_floor = initial_version;
+    return 0;
+}
+
+void history_free(void) {
+    pthread_mutex_lock(&history_mutex);
+    free(tombstones);
+    tombstones = NULL;
+    tombstones_capacity = 0;
+    tombstones_size = 0;
+    pthread_mutex_unlock(&history_mutex);
+}
+
+void history_record_removal(u32 movie_id, u64 version) {
+    pthread_mutex_lock(&history_mutex);
+    if (tombstones_capacity > 0) {
+        if (tombstones_size == tombstones_capacity) {
+            // Vamos sobrescrever a tombstone mais antiga, então quem pedir mudanças antes dela não tem mais histórico.
+            Tombstone* oldest = &tombstones[tombstones_head];
+            if (oldest->version > window_floor) window_floor = oldest->version;
+        } else {
+            tombstones_size++;
+        }
+        tombstones[tombstones_head].movie_id = movie_id;
+        tombstones[tombstones_head].version = version;
+        tombstones_head = (tombstones_head + 1) % tombstones_capacity;
+    }
+    pthread_mutex_unlock(&history_mutex);
+}
+
+int history_removals_since(u64 since_version, u32** ids, u32* count) {
+    *ids = NULL;
+    *count = 0;
+
+    pthread_mutex_lock(&history_mutex);
+    if (since_version < window_floor) {
+        pthread_mutex_unlock(&history_mutex);
+        return 1;
+    }
+
+    // As tombstones estão quase em ordem de versão (duas remoções concorrentes podem inverter a ordem de inserção),
+    // então não dá pra fazer busca binária, percorremos todas e filtramos pela versão.
+    size_t start = (tombstones_head + tombstones_capacity - tombstones_size) % (tombstones_capacity ? tombstones_capacity : 1);
+    u32 matches = 0;
+    for (size_t i = 0; i < tombstones_size; ++i) {
+        if (tombstones[(start + i) % tombstones_capacity].version > since_version) matches++;
+    }
+
+    if (matches > 0) {
+        u32* result = malloc(matches * sizeof(u32));
+        if (!result) {
+            pthread_mutex_unlock(&history_mutex);
+            perror("history_removals_since: malloc failed");
+            return -1;
+        }
+        u32 n = 0;
+        for (size_t i = 0; i < tombstones_size; ++i) {
+            const Tombstone* t = &tombstones[(start + i) % tombstones_capacity];
+            if (t->version > since_version) result[n++] = t->movie_id;
+        }
+        *ids = result;
+        *count = n;
+    }
+    pthread_mutex_unlock(&history_mutex);
+    return 0;
+}
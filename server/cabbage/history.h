@@ -0,0 +1,22 @@
+#ifndef _CABBAGE_HISTORY_H
+#define _CABBAGE_HISTORY_H
+
+#include <stddef.h>
+#include "cabbage/common/types.h"
+
+// Histórico de remoções (tombstones) usado pelo LIST_CHANGES_SINCE.
+// Adições e modificações não precisam de histórico, pois cada filme guarda a versão da última mutação,
+// mas um filme removido some da tabela, então guardamos (id, versão) das remoções em um buffer circular.
+// Quando o buffer dá a volta, as remoções mais antigas são perdidas e o "piso" da janela sobe; pedidos com
+// uma versão abaixo do piso precisam receber a listagem completa.
+
+int history_init(size_t capacity, u64 initial_version);
+void history_free(void);
+
+void history_record_removal(u32 movie_id, u64 version);
+
+// Retorna os IDs removidos com versão > since_version em *ids (alocado com malloc, deve ser liberado pelo chamador).
+// Retorna 0 em caso de sucesso, 1 se o histórico não cobre since_version (janela expirada), e -1 em caso de erro.
+int history_removals_since(u64 since_version, u32** ids, u32* count);
+
+#endif // _CABBAGE_HISTORY_H
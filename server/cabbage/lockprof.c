@@ -0,0 +1,225 @@
+#define _GNU_SOURCE
+#include "lockprof.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "stats.h"
+
+typedef struct {
+    atomic_ullong acquires;
+    atomic_ullong contended;
+    atomic_ullong wait_ns;
+    atomic_ullong hold_ns;
+    atomic_ullong max_wait_ns;
+    atomic_ullong max_hold_ns;
+} ThreadCounters;
+
+typedef struct LockprofThread {
+    struct LockprofThread* prev;
+    struct LockprofThread* next;
+    ThreadCounters sites[LOCKPROF_SITES];
+    ThreadCounters stripes[LOCKPROF_STRIPES];
+    atomic_ullong blocked_count[LOCKPROF_SITES][LOCKPROF_SITES];
+    atomic_ullong blocked_ns[LOCKPROF_SITES][LOCKPROF_SITES];
+} LockprofThread;
+
+atomic_bool lockprof_enabled;
+
+static const MovieEntry* lockprof_entries = NULL;
+static size_t lockprof_entry_count = 0;
+
+// Mesmo esquema do stats.c: lista das threads vivas e a soma das que terminaram, o mutex nunca é usado no lock.
+static pthread_mutex_t lockprof_mutex = PTHREAD_MUTEX_INITIALIZER;
+static LockprofThread* lockprof_threads = NULL;
+static LockprofTotals lockprof_retired;
+static pthread_key_t lockprof_key;
+
+static _Thread_local LockprofThread* lockprof_self = NULL;
+static _Thread_local u8 lockprof_site = 0;
+
+static inline void counter_add(atomic_ullong* counter, u64 value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static inline void counter_max(atomic_ullong* counter, u64 value) {
+    if (value > atomic_load_explicit(counter, memory_order_relaxed)) {
+        atomic_store_explicit(counter, value, memory_order_relaxed);
+    }
+}
+
+static inline u64 counter_get(atomic_ullong* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static void counters_merge(LockprofCounters* dst, ThreadCounters* src) {
+    dst->acquires += counter_get(&src->acquires);
+    dst->contended += counter_get(&src->contended);
+    dst->wait_ns += counter_get(&src->wait_ns);
+    dst->hold_ns += counter_get(&src->hold_ns);
+    if (counter_get(&src->max_wait_ns) > dst->max_wait_ns) dst->max_wait_ns = counter_get(&src->max_wait_ns);
+    if (counter_get(&src->max_hold_ns) > dst->max_hold_ns) dst->max_hold_ns = counter_get(&src->max_hold_ns);
+}
+
+// Deve ser chamada com o lockprof_mutex.
+static void thread_merge(LockprofTotals* dst, LockprofThread* src) {
+    for (int i = 0; i < LOCKPROF_SITES; ++i) counters_merge(&dst->sites[i], &src->sites[i]);
+    for (int i = 0; i < LOCKPROF_STRIPES; ++i) counters_merge(&dst->stripes[i], &src->stripes[i]);
+    for (int i = 0; i < LOCKPROF_SITES; ++i) {
+        for (int j = 0; j < LOCKPROF_SITES; ++j) {
+            dst->blocked_count[i][j] += counter_get(&src->blocked_count[i][j]);
+            dst->blocked_ns[i][j] += counter_get(&src->blocked_ns[i][j]);
+        }
+    }
+}
+
+static void thread_retire(void* ptr) {
+    LockprofThread* thread = ptr;
+    pthread_mutex_lock(&lockprof_mutex);
+    if (thread->prev) thread->prev->next = thread->next;
+    else lockprof_threads = thread->next;
+    if (thread->next) thread->next->prev = thread->prev;
+    thread_merge(&lockprof_retired, thread);
+    pthread_mutex_unlock(&lockprof_mutex);
+    free(thread);
+}
+
+// As threads são registradas no primeiro lock, qualquer thread pode pegar um lock de entrada.
+static LockprofThread* thread_get(void) {
+    if (lockprof_self) return lockprof_self;
+    LockprofThread* thread = calloc(1, sizeof(LockprofThread));
+    if (!thread) return NULL;
+    pthread_mutex_lock(&lockprof_mutex);
+    thread->next = lockprof_threads;
+    if (lockprof_threads) lockprof_threads->prev = thread;
+    lockprof_threads = thread;
+    pthread_mutex_unlock(&lockprof_mutex);
+    pthread_setspecific(lockprof_key, thread);
+    lockprof_self = thread;
+    return thread;
+}
+
+void lockprof_enable(const MovieEntry* entries, size_t count) {
+    pthread_key_create(&lockprof_key, thread_retire);
+    lockprof_entries = entries;
+    lockprof_entry_count = count;
+    atomic_store(&lockprof_enabled, true);
+}
+
+void lockprof_set_site(u8 site) {
+    lockprof_site = site % LOCKPROF_SITES;
+}
+
+static unsigned stripe_of(const MovieEntry* entry) {
+    size_t index = (size_t)(entry - lockprof_entries);
+    if (index >= lockprof_entry_count) return 0;
+    return (unsigned)(index * LOCKPROF_STRIPES / lockprof_entry_count);
+}
+
+void lockprof_acquired(MovieEntry* entry, u64 now_ns, int contended, u64 wait_ns, u8 holder) {
+    LockprofThread* thread = thread_get();
+    entry->locked_ns = now_ns;
+    atomic_store_explicit(&entry->lock_site, lockprof_site, memory_order_relaxed);
+    if (!thread) return;
+
+    ThreadCounters* counters[2] = {&thread->sites[lockprof_site], &thread->stripes[stripe_of(entry)]};
+    for (int i = 0; i < 2; ++i) {
+        counter_add(&counters[i]->acquires, 1);
+        if (!contended) continue;
+        counter_add(&counters[i]->contended, 1);
+        counter_add(&counters[i]->wait_ns, wait_ns);
+        counter_max(&counters[i]->max_wait_ns, wait_ns);
+    }
+    if (contended) {
+        holder %= LOCKPROF_SITES;
+        counter_add(&thread->blocked_count[lockprof_site][holder], 1);
+        counter_add(&thread->blocked_ns[lockprof_site][holder], wait_ns);
+    }
+}
+
+void lockprof_released(MovieEntry* entry) {
+    // O perfil pode ter sido ligado com o lock já pego.
+    if (entry->locked_ns == 0) return;
+    u64 hold_ns = stats_now_ns() - entry->locked_ns;
+    entry->locked_ns = 0;
+    LockprofThread* thread = thread_get();
+    if (!thread) return;
+
+    ThreadCounters* counters[2] = {&thread->sites[lockprof_site], &thread->stripes[stripe_of(entry)]};
+    for (int i = 0; i < 2; ++i) {
+        counter_add(&counters[i]->hold_ns, hold_ns);
+        counter_max(&counters[i]->max_hold_ns, hold_ns);
+    }
+}
+
+int lockprof_collect(LockprofTotals* totals) {
+    if (!atomic_load(&lockprof_enabled)) return -1;
+    pthread_mutex_lock(&lockprof_mutex);
+    *totals = lockprof_retired;
+    for (LockprofThread* thread = lockprof_threads; thread; thread = thread->next) {
+        thread_merge(totals, thread);
+    }
+    pthread_mutex_unlock(&lockprof_mutex);
+    totals->entry_count = lockprof_entry_count;
+    return 0;
+}
+
+const char* lockprof_site_name(unsigned site) {
+    if (site == 0) return "internal";
+    return C2SPacket_type_name((u8)site);
+}
+
+static int compare_stripes_by_wait(const void* a, const void* b, void* arg) {
+    const LockprofCounters* stripes = arg;
+    u64 x = stripes[*(const int*)a].wait_ns;
+    u64 y = stripes[*(const int*)b].wait_ns;
+    return (x < y) - (x > y);
+}
+
+#define LOCKPROF_REPORT_STRIPES 8
+
+void lockprof_report(FILE* out) {
+    LockprofTotals* totals = malloc(sizeof(LockprofTotals));
+    if (!totals) return;
+    if (lockprof_collect(totals) < 0) {
+        free(totals);
+        return;
+    }
+
+    fprintf(out, "Lock profile (%zu entries, %d stripes):\n", totals->entry_count, LOCKPROF_STRIPES);
+    fprintf(out, "  %-24s %12s %10s %10s %12s %10s %12s\n",
+            "site", "acquires", "contended", "wait_ms", "max_wait_us", "hold_ms", "max_hold_us");
+    for (unsigned i = 0; i < LOCKPROF_SITES; ++i) {
+        LockprofCounters* c = &totals->sites[i];
+        if (c->acquires == 0) continue;
+        fprintf(out, "  %-24s %12llu %10llu %10.3f %12.1f %10.3f %12.1f\n", lockprof_site_name(i),
+                (unsigned long long)c->acquires, (unsigned long long)c->contended, c->wait_ns / 1e6,
+                c->max_wait_ns / 1e3, c->hold_ns / 1e6, c->max_hold_ns / 1e3);
+    }
+
+    int order[LOCKPROF_STRIPES];
+    for (int i = 0; i < LOCKPROF_STRIPES; ++i) order[i] = i;
+    qsort_r(order, LOCKPROF_STRIPES, sizeof(int), compare_stripes_by_wait, totals->stripes);
+    fprintf(out, "Stripes with the most waiting:\n");
+    fprintf(out, "  %-17s %12s %10s %10s %10s\n", "entries", "acquires", "contended", "wait_ms", "hold_ms");
+    for (int k = 0; k < LOCKPROF_REPORT_STRIPES; ++k) {
+        LockprofCounters* c = &totals->stripes[order[k]];
+        if (c->contended == 0) break;
+        size_t first = (size_t)order[k] * totals->entry_count / LOCKPROF_STRIPES;
+        size_t last = ((size_t)order[k] + 1) * totals->entry_count / LOCKPROF_STRIPES - 1;
+        char range[32];
+        snprintf(range, sizeof(range), "%zu-%zu", first, last);
+        fprintf(out, "  %-17s %12llu %10llu %10.3f %10.3f\n", range, (unsigned long long)c->acquires,
+                (unsigned long long)c->contended, c->wait_ns / 1e6, c->hold_ns / 1e6);
+    }
+
+    fprintf(out, "Blocked by (waiter <- holder):\n");
+    for (unsigned i = 0; i < LOCKPROF_SITES; ++i) {
+        for (unsigned j = 0; j < LOCKPROF_SITES; ++j) {
+            if (totals->blocked_count[i][j] == 0) continue;
+            fprintf(out, "  %-24s <- %-24s %10llu times %10.3f ms\n", lockprof_site_name(i), lockprof_site_name(j),
+                    (unsigned long long)totals->blocked_count[i][j], totals->blocked_ns[i][j] / 1e6);
+        }
+    }
+    free(totals);
+}
@@ -0,0 +1,63 @@
+#ifndef _CABBAGE_LOCKPROF_H
+#define _CABBAGE_LOCKPROF_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "cabbage/common/types.h"
+#include "MovieEntry.h"
+
+// Perfil dos locks de entrada, ligado em tempo de execução (-L no servidor).
+//
+// Com o perfil ligado, cada MovieEntry_lock/unlock registra, por ponto de chamada (o tipo de pacote que a thread está
+// atendendo; 0 é o trabalho interno, como checkpoint e réplica) e por faixa de entradas: aquisições, quantas
+// encontraram o lock ocupado, tempo de espera e tempo com o lock. Quando uma espera acontece, também é anotado quem
+// segurava o lock, o que mostra quais operações serializam quais outras. Os números ficam em blocos por thread, como
+// os de stats.h, e são somados no C2S_STATS, no /metrics e no relatório de lockprof_report.
+//
+// Desligado, o custo no lock é um load relaxado. Ligado, cada aquisição lê o relógio duas vezes (uma listagem
+// completa passa por todas as entradas), então serve para medir, não para produção.
+
+#define LOCKPROF_SITES 32
+#define LOCKPROF_STRIPES 64
+
+typedef struct {
+    u64 acquires;
+    u64 contended;
+    u64 wait_ns;
+    u64 hold_ns;
+    u64 max_wait_ns;
+    u64 max_hold_ns;
+} LockprofCounters;
+
+// Soma de todas as threads.
+typedef struct {
+    size_t entry_count;
+    LockprofCounters sites[LOCKPROF_SITES];
+    LockprofCounters stripes[LOCKPROF_STRIPES];
+    // [quem esperou][quem segurava]
+    u64 blocked_count[LOCKPROF_SITES][LOCKPROF_SITES];
+    u64 blocked_ns[LOCKPROF_SITES][LOCKPROF_SITES];
+} LockprofTotals;
+
+extern atomic_bool lockprof_enabled;
+
+// Liga o perfil para a tabela 'entries' (as faixas são calculadas pela posição da entrada na tabela).
+void lockprof_enable(const MovieEntry* entries, size_t count);
+
+// Ponto de chamada das próximas aquisições da thread atual.
+void lockprof_set_site(u8 site);
+
+// Chamadas pelo MovieEntry_lock/unlock com o perfil ligado. 'holder' é o ponto que segurava o lock quando a espera
+// começou (só faz sentido com contended != 0).
+void lockprof_acquired(MovieEntry* entry, u64 now_ns, int contended, u64 wait_ns, u8 holder);
+void lockprof_released(MovieEntry* entry);
+
+// Retorna -1 se o perfil não estiver ligado.
+int lockprof_collect(LockprofTotals* totals);
+const char* lockprof_site_name(unsigned site);
+
+// Relatório em texto: pontos de chamada, faixas com mais espera e quem bloqueou quem.
+void lockprof_report(FILE* out);
+
+#endif // _CABBAGE_LOCKPROF_H
@@ -1,3 +1,5 @@
+// fallocate (preallocação dos segmentos)
+#define _GNU_SOURCE
 #include "logger.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -5,19 +7,31 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
-
-#define LOG_BUFFER_SIZE 4096
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <dirent.h>
+#include <libgen.h>
+#include "LogRecord.h"
+#include "stats.h"
+#include "IdIndex.h"
+#include "snapshot.h"
 
 static int log_fd = -1;
+static char log_basename[4096];
 
 // TODO: Essa função podem ser unificada com o server.c
 static void Movie_free(Movie* movie) {
     if (!movie) return;
-    free(movie->title);
-    free(movie->genres);
-    free(movie->director);
-    free(movie->release_year);
-    free(movie);
+    snapshot_free(movie->title);
+    snapshot_free(movie->genres);
+    snapshot_free(movie->director);
+    snapshot_free(movie->release_year);
+    snapshot_free(movie);
 }
 
 // TODO: Essa função podem ser unificada com o server.c
@@ -36,265 +50,1441 @@ static int genre_exists(const char* genres, const char* genre) {
     return 0;
 }
 
-int log_init(const char* filename) {
-    log_fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+// --- Escritor assíncrono do log (group commit) ---
+//
+// As threads de cliente não escrevem mais no arquivo diretamente. Cada registro é formatado e colocado em um
+// ring buffer MPSC lock-free (a fila limitada do Vyukov: cada slot tem um número de sequência que diz se ele está
+// livre ou pronto), e uma thread dedicada consome tudo o que estiver pronto e grava com um único writev().
+// Assim várias mutações concorrentes viram uma só chamada de sistema (e um só fsync, dependendo da durabilidade).
+//
+// Cada registro recebe um ticket (sua posição na fila, começando em 1). O cliente chama log_wait(ticket) depois de
+// soltar o lock da entrada, e só recebe a confirmação quando o registro atingiu o nível de durabilidade configurado.
+
+#define LOG_RING_SIZE 4096 // precisa ser potência de 2
+#define LOG_BATCH_MAX 1024 // IOV_MAX no Linux
+
+typedef struct {
+    atomic_size_t sequence;
+    char* data;
+    size_t length;
+} LogSlot;
+
+static LogSlot log_ring[LOG_RING_SIZE];
+static atomic_size_t log_enqueue_pos;
+static size_t log_dequeue_pos; // só a thread do escritor mexe
+
+static log_durability_t log_durability = LOG_DURABILITY_NONE;
+static unsigned log_sync_interval_ms = 1000;
+
+static pthread_t log_writer_thread;
+static atomic_bool log_writer_running;
+static atomic_bool log_writer_stop;
+static atomic_bool log_writer_sleeping;
+static pthread_mutex_t log_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_writer_cond = PTHREAD_COND_INITIALIZER;
+
+// Progresso do escritor, em tickets: tudo <= written_ticket já foi para o kernel, tudo <= durable_ticket já passou por fsync.
+static atomic_ullong log_written_ticket;
+static atomic_ullong log_durable_ticket;
+static atomic_bool log_failed;
+static pthread_mutex_t log_done_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_done_cond = PTHREAD_COND_INITIALIZER;
+
+// Segmentos: o log é uma sequência de arquivos '<base>.000001', '<base>.000002', ... Quando o segmento atual passa
+// de log_segment_size bytes o escritor começa o próximo, e o checkpoint apaga os segmentos que o snapshot já cobre
+// (apagar arquivos inteiros em vez de reescrever o log). Cada segmento novo é preallocado com fallocate, para os
+// appends não precisarem alocar blocos no caminho quente.
+static u64 log_segment;          // segmento atual (só o escritor mexe depois do log_init)
+static size_t log_segment_size;
+static size_t log_segment_bytes; // bytes escritos no segmento atual (só o escritor mexe)
+
+// Bytes de log ainda não cobertos por um checkpoint, usado para decidir quando fazer o próximo.
+static atomic_size_t log_bytes;
+
+// Pedido de rotação (log_rotate), atendido pela thread do escritor entre dois lotes.
+static atomic_bool log_rotate_pending;
+static u64 log_rotate_segment;
+static int log_rotate_result;
+static pthread_mutex_t log_rotate_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_rotate_cond = PTHREAD_COND_INITIALIZER;
+
+static u64 monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000 + (u64)ts.tv_nsec / 1000000;
+}
+
+static void log_publish_progress(u64 written, u64 durable) {
+    pthread_mutex_lock(&log_done_mutex);
+    atomic_store(&log_written_ticket, written);
+    atomic_store(&log_durable_ticket, durable);
+    pthread_cond_broadcast(&log_done_cond);
+    pthread_mutex_unlock(&log_done_mutex);
+}
+
+// writev() também pode escrever menos do que o pedido, então avançamos os iovecs até acabar.
+static int writev_all(int fd, struct iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, iov, iovcnt);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+static void segment_filename(char* out, size_t size, const char* base_filename, u64 segment) {
+    snprintf(out, size, "%s.%06llu", base_filename, (unsigned long long)segment);
+}
+
+// Depois de criar um arquivo, o diretório precisa de fsync para a entrada nova sobreviver a uma queda.
+static void fsync_log_dir(const char* base_filename) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s", base_filename);
+    int fd = open(dirname(path), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+// Cria o segmento com o cabeçalho e prealloca log_segment_size bytes (FALLOC_FL_KEEP_SIZE: o tamanho do arquivo
+// continua sendo só o que foi escrito, então o O_APPEND e o restore não veem a área preallocada).
+static int open_segment(u64 segment) {
+    char filename[4096 + 32];
+    segment_filename(filename, sizeof(filename), log_basename, segment);
+    int fd = open(filename, O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644);
+    if (fd < 0) {
+        perror("log: open segment failed");
+        return -1;
+    }
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)log_segment_size) < 0 && errno != EOPNOTSUPP) {
+        perror("log: fallocate failed");
+    }
+
+    char header[LOG_FILE_HEADER_SIZE];
+    LogFile_write_header(header);
+    if (write(fd, header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        perror("log: header write failed");
+        close(fd);
+        unlink(filename);
+        return -1;
+    }
+    if (log_durability != LOG_DURABILITY_NONE) {
+        fdatasync(fd);
+        fsync_log_dir(log_basename);
+    }
+    return fd;
+}
+
+// Fecha o segmento atual e começa o próximo. Tudo o que já foi escrito fica durável antes da troca.
+static int log_writer_next_segment(void) {
+    if (fdatasync(log_fd) < 0) {
+        perror("log: fdatasync failed");
+        return -1;
+    }
+    int fd = open_segment(log_segment + 1);
+    if (fd < 0) return -1;
+
+    // Devolve a parte da preallocação que não foi usada (o segmento pode ter sido fechado antes de encher).
+    if (log_segment_bytes < log_segment_size) {
+        fallocate(log_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)log_segment_bytes,
+                  (off_t)(log_segment_size - log_segment_bytes));
+    }
+    close(log_fd);
+    log_fd = fd;
+    log_segment++;
+    log_segment_bytes = LOG_FILE_HEADER_SIZE;
+    return 0;
+}
+
+static int log_ring_has_ready(void) {
+    LogSlot* slot = &log_ring[log_dequeue_pos & (LOG_RING_SIZE - 1)];
+    return atomic_load_explicit(&slot->sequence, memory_order_acquire) == log_dequeue_pos + 1;
+}
+
+static void* log_writer_main(void* arg) {
+    (void)arg;
+    struct iovec iov[LOG_BATCH_MAX];
+    char* batch[LOG_BATCH_MAX];
+    u64 written = 0, durable = 0;
+    u64 last_sync_ms = monotonic_ms();
+    stats_thread_begin();
+
+    while (1) {
+        int count = 0;
+        while (count < LOG_BATCH_MAX && log_ring_has_ready()) {
+            LogSlot* slot = &log_ring[log_dequeue_pos & (LOG_RING_SIZE - 1)];
+            batch[count] = slot->data;
+            iov[count].iov_base = slot->data;
+            iov[count].iov_len = slot->length;
+            count++;
+            // Libera o slot para a próxima volta do ring.
+            atomic_store_explicit(&slot->sequence, log_dequeue_pos + LOG_RING_SIZE, memory_order_release);
+            log_dequeue_pos++;
+        }
+
+        if (count > 0) {
+            u64 batch_start = stats_now_ns();
+            if (writev_all(log_fd, iov, count) < 0) {
+                perror("log writer: writev failed");
+                atomic_store(&log_failed, true);
+            }
+            size_t batch_bytes = 0;
+            for (int i = 0; i < count; ++i) {
+                batch_bytes += iov[i].iov_len;
+                free(batch[i]);
+            }
+            atomic_fetch_add(&log_bytes, batch_bytes);
+            log_segment_bytes += batch_bytes;
+            written += count;
+
+            if (log_durability == LOG_DURABILITY_BATCH) {
+                if (fdatasync(log_fd) < 0) {
+                    perror("log writer: fdatasync failed");
+                    atomic_store(&log_failed, true);
+                }
+                durable = written;
+            }
+            stats_record(STATS_LOG_WRITE, stats_now_ns() - batch_start);
+        }
+
+        if (log_durability == LOG_DURABILITY_INTERVAL && durable != written &&
+            monotonic_ms() - last_sync_ms >= log_sync_interval_ms) {
+            if (fdatasync(log_fd) < 0) {
+                perror("log writer: fdatasync failed");
+                atomic_store(&log_failed, true);
+            }
+            durable = written;
+            last_sync_ms = monotonic_ms();
+            if (count == 0) log_publish_progress(written, durable);
+        }
+
+        // Um segmento que só tem o cabeçalho não precisa ser trocado para um checkpoint.
+        int rotate_requested = atomic_load(&log_rotate_pending);
+        if (log_segment_bytes >= log_segment_size ||
+            (rotate_requested && log_segment_bytes > LOG_FILE_HEADER_SIZE)) {
+            if (log_writer_next_segment() == 0) {
+                durable = written;
+                log_publish_progress(written, durable);
+            } else if (rotate_requested) {
+                rotate_requested = -1;
+            }
+        }
+
+        if (rotate_requested) {
+            pthread_mutex_lock(&log_rotate_mutex);
+            log_rotate_result = rotate_requested < 0 ? -1 : 0;
+            log_rotate_segment = log_segment;
+            atomic_store(&log_bytes, log_segment_bytes);
+            atomic_store(&log_rotate_pending, false);
+            pthread_cond_broadcast(&log_rotate_cond);
+            pthread_mutex_unlock(&log_rotate_mutex);
+        }
+
+        if (count > 0) {
+            log_publish_progress(written, durable);
+            continue;
+        }
+
+        if (atomic_load(&log_writer_stop)) break;
+
+        // Nada para escrever: dorme até algum produtor avisar (ou até o próximo fsync periódico).
+        pthread_mutex_lock(&log_writer_mutex);
+        atomic_store(&log_writer_sleeping, true);
+        if (!log_ring_has_ready() && !atomic_load(&log_writer_stop) && !atomic_load(&log_rotate_pending)) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += (long)(log_sync_interval_ms % 1000) * 1000000L;
+            deadline.tv_sec += log_sync_interval_ms / 1000 + deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&log_writer_cond, &log_writer_mutex, &deadline);
+        }
+        atomic_store(&log_writer_sleeping, false);
+        pthread_mutex_unlock(&log_writer_mutex);
+    }
+
+    // No desligamento, o que foi escrito fica durável independente do modo.
+    if (durable != written) {
+        fdatasync(log_fd);
+        durable = written;
+    }
+    log_publish_progress(written, durable);
+    stats_thread_end();
+    return NULL;
+}
+
+// Lista os segmentos de 'base_filename' em ordem crescente (*segments é alocado com malloc).
+static int list_segments(const char* base_filename, u64** segments, size_t* count) {
+    char dir_path[4096], base_path[4096];
+    snprintf(dir_path, sizeof(dir_path), "%s", base_filename);
+    snprintf(base_path, sizeof(base_path), "%s", base_filename);
+    const char* dir_name = dirname(dir_path);
+    const char* prefix = basename(base_path);
+    size_t prefix_len = strlen(prefix);
+
+    *segments = NULL;
+    *count = 0;
+    DIR* dir = opendir(dir_name);
+    if (!dir) {
+        perror("log: opendir failed");
+        return -1;
+    }
+
+    size_t capacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char* name = entry->d_name;
+        if (strncmp(name, prefix, prefix_len) != 0 || name[prefix_len] != '.') continue;
+        const char* digits = name + prefix_len + 1;
+        if (*digits == '\0' || strspn(digits, "0123456789") != strlen(digits)) continue;
+
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            u64* new_segments = realloc(*segments, capacity * sizeof(u64));
+            if (!new_segments) {
+                perror("log: realloc failed");
+                free(*segments);
+                *segments = NULL;
+                closedir(dir);
+                return -1;
+            }
+            *segments = new_segments;
+        }
+        (*segments)[(*count)++] = strtoull(digits, NULL, 10);
+    }
+    closedir(dir);
+
+    // Poucos segmentos, insertion sort é suficiente.
+    for (size_t i = 1; i < *count; ++i) {
+        u64 value = (*segments)[i];
+        size_t j = i;
+        while (j > 0 && (*segments)[j - 1] > value) {
+            (*segments)[j] = (*segments)[j - 1];
+            j--;
+        }
+        (*segments)[j] = value;
+    }
+    return 0;
+}
+
+int log_init(const char* base_filename, log_durability_t durability, unsigned sync_interval_ms, size_t segment_size) {
+    snprintf(log_basename, sizeof(log_basename), "%s", base_filename);
+    log_durability = durability;
+    log_sync_interval_ms = sync_interval_ms > 0 ? sync_interval_ms : 1000;
+    log_segment_size = segment_size > LOG_FILE_HEADER_SIZE ? segment_size : LOG_DEFAULT_SEGMENT_SIZE;
+
+    // Os segmentos existentes já foram restaurados; a escrita sempre começa em um segmento novo.
+    u64* segments;
+    size_t segment_count;
+    if (list_segments(base_filename, &segments, &segment_count) < 0) return -1;
+    size_t existing_bytes = 0;
+    for (size_t i = 0; i < segment_count; ++i) {
+        char filename[4096 + 32];
+        struct stat st;
+        segment_filename(filename, sizeof(filename), base_filename, segments[i]);
+        if (stat(filename, &st) == 0) existing_bytes += (size_t)st.st_size;
+    }
+    log_segment = segment_count > 0 ? segments[segment_count - 1] + 1 : 1;
+    free(segments);
+
+    log_fd = open_segment(log_segment);
     if (log_fd < 0) {
-        perror("log_init: open failed");
         return -1;
     }
+    log_segment_bytes = LOG_FILE_HEADER_SIZE;
+    atomic_store(&log_bytes, existing_bytes + LOG_FILE_HEADER_SIZE);
+    atomic_store(&log_rotate_pending, false);
+
+    for (size_t i = 0; i < LOG_RING_SIZE; ++i) {
+        atomic_init(&log_ring[i].sequence, i);
+        log_ring[i].data = NULL;
+        log_ring[i].length = 0;
+    }
+    atomic_store(&log_enqueue_pos, 0);
+    log_dequeue_pos = 0;
+    atomic_store(&log_written_ticket, 0);
+    atomic_store(&log_durable_ticket, 0);
+    atomic_store(&log_failed, false);
+    atomic_store(&log_writer_stop, false);
+
+    if (pthread_create(&log_writer_thread, NULL, log_writer_main, NULL) != 0) {
+        perror("log_init: pthread_create failed");
+        close(log_fd);
+        log_fd = -1;
+        return -1;
+    }
+    atomic_store(&log_writer_running, true);
     return 0;
 }
 
 void log_close(void) {
+    if (atomic_load(&log_writer_running)) {
+        pthread_mutex_lock(&log_writer_mutex);
+        atomic_store(&log_writer_stop, true);
+        pthread_cond_signal(&log_writer_cond);
+        pthread_mutex_unlock(&log_writer_mutex);
+        pthread_join(log_writer_thread, NULL);
+        atomic_store(&log_writer_running, false);
+    }
     if (log_fd >= 0) {
+        if (log_segment_bytes < log_segment_size) {
+            fallocate(log_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)log_segment_bytes,
+                      (off_t)(log_segment_size - log_segment_bytes));
+        }
         close(log_fd);
         log_fd = -1;
     }
 }
 
-static int write_log_entry(const char* entry_buffer, size_t length) {
-    if (log_fd < 0) {
+int log_rotate(u64* first_segment) {
+    if (!atomic_load(&log_writer_running)) return -1;
+
+    pthread_mutex_lock(&log_rotate_mutex);
+    atomic_store(&log_rotate_pending, true);
+
+    pthread_mutex_lock(&log_writer_mutex);
+    pthread_cond_signal(&log_writer_cond);
+    pthread_mutex_unlock(&log_writer_mutex);
+
+    while (atomic_load(&log_rotate_pending)) {
+        pthread_cond_wait(&log_rotate_cond, &log_rotate_mutex);
+    }
+    int result = log_rotate_result;
+    if (result == 0 && first_segment) *first_segment = log_rotate_segment;
+    pthread_mutex_unlock(&log_rotate_mutex);
+    return result;
+}
+
+size_t log_size(void) {
+    return atomic_load(&log_bytes);
+}
+
+int log_remove_segments_before(u64 segment) {
+    u64* segments;
+    size_t count;
+    if (list_segments(log_basename, &segments, &count) < 0) return -1;
+    int result = 0;
+    for (size_t i = 0; i < count && segments[i] < segment; ++i) {
+        char filename[4096 + 32];
+        segment_filename(filename, sizeof(filename), log_basename, segments[i]);
+        if (unlink(filename) < 0 && errno != ENOENT) {
+            perror("log: unlink segment failed");
+            result = -1;
+        }
+    }
+    free(segments);
+    return result;
+}
+
+// Quando a thread atual enfileirou o último registro, para o log_wait medir a latência do append.
+static _Thread_local u64 log_enqueue_ns;
+
+// Coloca o registro no ring. O buffer passa a pertencer ao escritor (que dá free depois do write).
+static int enqueue_log_entry(char* entry_buffer, size_t length, log_ticket_t* ticket) {
+    if (!atomic_load(&log_writer_running)) {
         fprintf(stderr, "Logger not initialized.\n");
+        free(entry_buffer);
         return -1;
     }
-    ssize_t written = write(log_fd, entry_buffer, length);
-    if (written < 0) {
-        perror("write_log_entry: write failed");
-        return -1;
+
+    size_t pos = atomic_load_explicit(&log_enqueue_pos, memory_order_relaxed);
+    LogSlot* slot;
+    while (1) {
+        slot = &log_ring[pos & (LOG_RING_SIZE - 1)];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&log_enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Ring cheio, o escritor está atrasado. Espera ele liberar espaço.
+            sched_yield();
+            pos = atomic_load_explicit(&log_enqueue_pos, memory_order_relaxed);
+        } else {
+            pos = atomic_load_explicit(&log_enqueue_pos, memory_order_relaxed);
+        }
     }
-    if ((size_t)written != length) {
-        fprintf(stderr, "WARNING: Partial write to log file (%zd / %zu bytes).\n", written, length);
-        return -1;
+
+    slot->data = entry_buffer;
+    slot->length = length;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_seq_cst);
+    if (ticket) *ticket = pos + 1;
+    log_enqueue_ns = stats_now_ns();
+
+    // Só acorda o escritor se ele estiver dormindo, assim o caminho comum não toca no mutex.
+    if (atomic_load(&log_writer_sleeping)) {
+        pthread_mutex_lock(&log_writer_mutex);
+        pthread_cond_signal(&log_writer_cond);
+        pthread_mutex_unlock(&log_writer_mutex);
     }
     return 0;
 }
 
-int log_add_movie(const Movie* movie) {
+int log_wait(log_ticket_t ticket) {
+    if (ticket == 0) return 0;
+    atomic_ullong* progress = (log_durability == LOG_DURABILITY_BATCH) ? &log_durable_ticket : &log_written_ticket;
+
+    if (atomic_load(progress) < ticket) {
+        pthread_mutex_lock(&log_done_mutex);
+        while (atomic_load(progress) < ticket) {
+            pthread_cond_wait(&log_done_cond, &log_done_mutex);
+        }
+        pthread_mutex_unlock(&log_done_mutex);
+    }
+    if (log_enqueue_ns) stats_record(STATS_LOG_APPEND, stats_now_ns() - log_enqueue_ns);
+    return atomic_load(&log_failed) ? -1 : 0;
+}
+
+size_t log_queue_depth(void) {
+    size_t enqueued = atomic_load(&log_enqueue_pos);
+    size_t written = (size_t)atomic_load(&log_written_ticket);
+    return enqueued > written ? enqueued - written : 0;
+}
+
+static u64 realtime_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (u64)ts.tv_sec * 1000000 + (u64)ts.tv_nsec / 1000;
+}
+
+// Codifica o registro em um buffer próprio, que vai para o ring (o escritor dá free depois do write).
+static int encode_and_enqueue(LogRecord* record, log_ticket_t* ticket) {
+    record->timestamp_us = realtime_us();
+    size_t size = LogRecord_encoded_size(record);
+    char* entry = malloc(size);
+    if (!entry) {
+        perror("log: malloc failed");
+        return -1;
+    }
+    LogRecord_encode(record, entry);
+    return enqueue_log_entry(entry, size, ticket);
+}
+
+static void set_field(LogRecord* record, u32 index, const char* value) {
+    record->fields[index] = value ? value : "";
+    record->field_lengths[index] = value ? (u32)strlen(value) : 0;
+}
+
+int log_add_movie(const Movie* movie, log_ticket_t* ticket) {
     if (!movie) {
         fprintf(stderr, "log_add_movie: received NULL movie pointer.\n");
         return -1;
     }
-    char buffer[LOG_BUFFER_SIZE];
-    int len = snprintf(buffer, LOG_BUFFER_SIZE, "ADD %u %s|%s|%s|%s\n",
-            movie->id,
-            movie->title ? movie->title : "",
-            movie->genres ? movie->genres : "",
-            movie->director ? movie->director : "",
-            movie->release_year ? movie->release_year : "");
+    LogRecord record;
+    record.type = LOG_RECORD_ADD;
+    record.version = movie->version;
+    record.movie_id = movie->id;
+    record.field_count = 4;
+    set_field(&record, 0, movie->title);
+    set_field(&record, 1, movie->genres);
+    set_field(&record, 2, movie->director);
+    set_field(&record, 3, movie->release_year);
+    return encode_and_enqueue(&record, ticket);
+}
+
+int log_add_genre(uint32_t movie_id, const char* genre, uint64_t version, log_ticket_t* ticket) {
+    LogRecord record;
+    record.type = LOG_RECORD_ADD_GENRE;
+    record.version = version;
+    record.movie_id = movie_id;
+    record.field_count = 1;
+    set_field(&record, 0, genre);
+    return encode_and_enqueue(&record, ticket);
+}
 
-    if (len < 0 || len >= LOG_BUFFER_SIZE) {
-        fprintf(stderr, "log_add_movie: snprintf error or buffer too small.\n");
+int log_remove_movie(uint32_t movie_id, uint64_t version, log_ticket_t* ticket) {
+    LogRecord record;
+    record.type = LOG_RECORD_REMOVE;
+    record.version = version;
+    record.movie_id = movie_id;
+    record.field_count = 0;
+    return encode_and_enqueue(&record, ticket);
+}
+
+// --- Restauração ---
+//
+// Os dois formatos (o binário atual e o texto antigo) são convertidos para LogRecord e aplicados pelas mesmas
+// funções replay_*. Um log em texto é convertido para o formato binário no fim da restauração.
+//
+// O log binário é restaurado em três fases:
+//  1. o arquivo é mapeado com mmap e os limites dos registros são encontrados seguindo os prefixos de tamanho;
+//  2. várias threads verificam o CRC dos registros e já montam os Movie dos ADDs (o malloc/strdup é a parte cara);
+//  3. uma única thread aplica os registros em ordem. Os IDs são achados por um IdIndex e os slots livres por uma
+//     pilha, então cada registro custa O(1) em vez de uma varredura de max_entries.
+
+#define RESTORE_MAX_THREADS 16
+#define RESTORE_MIN_RECORDS_PER_THREAD 4096
+
+// Em modo somente leitura (réplica lendo os arquivos do líder) o restore não altera nada no disco.
+static int restore_read_only = 0;
+
+void log_restore_set_read_only(int read_only) {
+    restore_read_only = read_only;
+}
+
+typedef struct {
+    MovieEntry* entries;
+    size_t max_entries;
+    IdIndex index;
+    u32* free_slots; // pilha de slots livres, o topo é o menor índice
+    size_t free_count;
+    u32 count;
+    u32 max_id;
+    u64 max_version;
+    int errors;
+    u32 missing; // registros de filmes que não estão na tabela
+    // Modo réplica (log_tail_*): a tabela está sendo lida por outras threads ao mesmo tempo, então cada alteração é
+    // feita com o lock da entrada e as remoções são repassadas para 'on_remove' (histórico de tombstones).
+    int live;
+    void (*on_remove)(u32 movie_id, u64 version);
+} RestoreState;
+
+static void restore_lock(RestoreState* state, u32 idx) {
+    if (state->live) MovieEntry_lock(&state->entries[idx]);
+}
+
+static void restore_unlock(RestoreState* state, u32 idx) {
+    if (state->live) MovieEntry_unlock(&state->entries[idx]);
+}
+
+// A tabela pode já ter filmes (por exemplo vindos de um snapshot), então o índice e a pilha são montados a partir dela.
+// Se 'seed' já tem um índice pronto para a tabela (o do snapshot), ele é usado e só os slots livres são procurados,
+// sem tocar nos filmes.
+static int restore_state_init(RestoreState* state, MovieEntry* entries, size_t max_entries, IdIndex* seed) {
+    memset(state, 0, sizeof(RestoreState));
+    state->entries = entries;
+    state->max_entries = max_entries;
+    state->free_slots = malloc(max_entries * sizeof(u32));
+    int seeded = seed && seed->capacity > 0;
+    if (seeded) {
+        state->index = *seed;
+    }
+    if (!state->free_slots || (!seeded && IdIndex_init(&state->index, max_entries) < 0)) {
+        perror("log_restore: allocation failed");
+        free(state->free_slots);
         return -1;
     }
-    return write_log_entry(buffer, len);
+    for (size_t i = max_entries; i-- > 0;) {
+        const Movie* movie = entries[i].movie;
+        if (!movie) {
+            state->free_slots[state->free_count++] = (u32)i;
+            continue;
+        }
+        if (seeded) continue;
+        IdIndex_put(&state->index, movie->id, (u32)i);
+        if (movie->id > state->max_id) state->max_id = movie->id;
+        if (movie->version > state->max_version) state->max_version = movie->version;
+    }
+    state->count = (u32)state->index.size;
+    return 0;
 }
 
-int log_add_genre(uint32_t movie_id, const char* genre) {
-    char buffer[LOG_BUFFER_SIZE];
-    int len = snprintf(buffer, LOG_BUFFER_SIZE, "ADDGENRE %u %s\n",
-            movie_id, genre ? genre : "");
+// Se 'seed' não é NULL, o índice (já atualizado pelo log) é devolvido para ser usado pelo próximo log_restore.
+static void restore_state_free(RestoreState* state, IdIndex* seed) {
+    if (seed) {
+        *seed = state->index;
+    } else {
+        IdIndex_free(&state->index);
+    }
+    free(state->free_slots);
+    state->free_slots = NULL;
+}
 
-    if (len < 0 || len >= LOG_BUFFER_SIZE) {
-        fprintf(stderr, "log_add_genre: snprintf error or buffer too small.\n");
-        return -1;
+static char* field_dup(const LogRecord* record, u32 index) {
+    return strndup(record->fields[index], record->field_lengths[index]);
+}
+
+static Movie* movie_from_record(const LogRecord* record) {
+    Movie* movie = calloc(1, sizeof(Movie));
+    if (!movie) return NULL;
+    movie->id = record->movie_id;
+    movie->version = record->version;
+    movie->title = field_dup(record, 0);
+    movie->genres = field_dup(record, 1);
+    movie->director = field_dup(record, 2);
+    movie->release_year = field_dup(record, 3);
+    if (!movie->title || !movie->genres || !movie->director || !movie->release_year) {
+        Movie_free(movie);
+        return NULL;
+    }
+    return movie;
+}
+
+// 'prepared' é o Movie já montado na fase paralela (ou NULL para montar aqui).
+static void replay_add(RestoreState* state, const LogRecord* record, Movie* prepared) {
+    Movie* movie = prepared ? prepared : movie_from_record(record);
+    if (!movie) {
+        fprintf(stderr, "Log Restore Error (ADD): allocation failed for ID %u\n", record->movie_id);
+        state->errors++;
+        return;
+    }
+
+    // Um ADD de um ID que já existe substitui o filme (o mesmo estado que o ADD original produziu).
+    u32 idx = IdIndex_get(&state->index, record->movie_id);
+    if (idx != ID_INDEX_NOT_FOUND) {
+        restore_lock(state, idx);
+        Movie* old_movie = state->entries[idx].movie;
+        state->entries[idx].movie = movie;
+        restore_unlock(state, idx);
+        Movie_free(old_movie);
+    } else {
+        if (state->free_count == 0) {
+            fprintf(stderr, "Log Restore Error (ADD): No free slots for ID %u.\n", record->movie_id);
+            Movie_free(movie);
+            state->errors++;
+            return;
+        }
+        idx = state->free_slots[--state->free_count];
+        restore_lock(state, idx);
+        state->entries[idx].movie = movie;
+        restore_unlock(state, idx);
+        IdIndex_put(&state->index, record->movie_id, idx);
+        state->count++;
     }
-    return write_log_entry(buffer, len);
+    if (record->movie_id > state->max_id) state->max_id = record->movie_id;
 }
 
-int log_remove_movie(uint32_t movie_id) {
-    char buffer[LOG_BUFFER_SIZE];
-    int len = snprintf(buffer, LOG_BUFFER_SIZE, "REM %u\n", movie_id);
+static void replay_add_genre(RestoreState* state, const LogRecord* record) {
+    u32 idx = IdIndex_get(&state->index, record->movie_id);
+    char* genre = field_dup(record, 0);
+    if (!genre) {
+        perror("Log Restore Error (ADDGENRE): malloc failed");
+        state->errors++;
+        return;
+    }
+    if (idx == ID_INDEX_NOT_FOUND) {
+        state->missing++;
+        free(genre);
+        return;
+    }
 
-    if (len < 0 || len >= LOG_BUFFER_SIZE) {
-        fprintf(stderr, "log_remove_movie: snprintf error or buffer too small.\n");
+    restore_lock(state, idx);
+    Movie* movie = state->entries[idx].movie;
+    if (!genre_exists(movie->genres, genre)) {
+        size_t old_len = movie->genres ? strlen(movie->genres) : 0;
+        size_t add_len = strlen(genre);
+        char* new_genres = snapshot_realloc_string(movie->genres, old_len + (old_len > 0 ? 1 : 0) + add_len + 1);
+        if (!new_genres) {
+            perror("Log Restore Error (ADDGENRE): realloc failed");
+            restore_unlock(state, idx);
+            state->errors++;
+            free(genre);
+            return;
+        }
+        if (old_len > 0) {
+            new_genres[old_len] = ',';
+            memcpy(new_genres + old_len + 1, genre, add_len + 1);
+        } else {
+            memcpy(new_genres, genre, add_len + 1);
+        }
+        movie->genres = new_genres;
+    }
+    movie->version = record->version;
+    restore_unlock(state, idx);
+    free(genre);
+}
+
+static void replay_remove(RestoreState* state, const LogRecord* record) {
+    u32 idx = IdIndex_get(&state->index, record->movie_id);
+    if (idx == ID_INDEX_NOT_FOUND) {
+        state->missing++;
+        return;
+    }
+    restore_lock(state, idx);
+    Movie* movie = state->entries[idx].movie;
+    state->entries[idx].movie = NULL;
+    restore_unlock(state, idx);
+    Movie_free(movie);
+    IdIndex_remove(&state->index, record->movie_id);
+    state->free_slots[state->free_count++] = idx;
+    state->count--;
+    if (state->on_remove) state->on_remove(record->movie_id, record->version);
+}
+
+static void replay_record(RestoreState* state, const LogRecord* record, Movie* prepared) {
+    switch (record->type) {
+    case LOG_RECORD_ADD: replay_add(state, record, prepared); break;
+    case LOG_RECORD_ADD_GENRE: replay_add_genre(state, record); break;
+    case LOG_RECORD_REMOVE: replay_remove(state, record); break;
+    }
+    if (record->version > state->max_version) state->max_version = record->version;
+}
+
+// Lê o log antigo em texto ("ADD id title|genres|director|year", "ADDGENRE id genre", "REM id").
+static void restore_text_log(RestoreState* state, char* data, size_t size) {
+    char* line = data;
+    char* data_end = data + size;
+    while (line < data_end) {
+        char* line_end = memchr(line, '\n', data_end - line);
+        if (!line_end) line_end = data_end;
+        *line_end = '\0';
+        // Considera tanto CRLF quanto LF como terminadores de linha
+        if (line_end > line && line_end[-1] == '\r') line_end[-1] = '\0';
+
+        LogRecord record;
+        memset(&record, 0, sizeof(record));
+        char* rest;
+
+        if (strncmp(line, "ADD ", 4) == 0) {
+            record.type = LOG_RECORD_ADD;
+            record.movie_id = (u32)strtoul(line + 4, &rest, 10);
+            char* genres_part = strchr(rest, '|');
+            char* director_part = genres_part ? strchr(genres_part + 1, '|') : NULL;
+            char* year_part = director_part ? strchr(director_part + 1, '|') : NULL;
+            if (rest == line + 4 || *rest != ' ' || !year_part) {
+                fprintf(stderr, "Log Restore Error (ADD): Malformed line: %s\n", line);
+                state->errors++;
+            } else {
+                record.field_count = 4;
+                record.fields[0] = rest + 1;
+                record.field_lengths[0] = (u32)(genres_part - (rest + 1));
+                record.fields[1] = genres_part + 1;
+                record.field_lengths[1] = (u32)(director_part - (genres_part + 1));
+                record.fields[2] = director_part + 1;
+                record.field_lengths[2] = (u32)(year_part - (director_part + 1));
+                record.fields[3] = year_part + 1;
+                record.field_lengths[3] = (u32)strlen(year_part + 1);
+                replay_record(state, &record, NULL);
+            }
+        } else if (strncmp(line, "REM ", 4) == 0) {
+            record.type = LOG_RECORD_REMOVE;
+            record.movie_id = (u32)strtoul(line + 4, &rest, 10);
+            if (rest == line + 4) {
+                fprintf(stderr, "Log Restore Error (REM): Malformed line: %s\n", line);
+                state->errors++;
+            } else {
+                replay_record(state, &record, NULL);
+            }
+        } else if (strncmp(line, "ADDGENRE ", 9) == 0) {
+            // O gênero é o resto da linha (o formato antigo lia com %s e perdia gêneros com espaço).
+            record.type = LOG_RECORD_ADD_GENRE;
+            record.movie_id = (u32)strtoul(line + 9, &rest, 10);
+            if (rest == line + 9 || *rest != ' ') {
+                fprintf(stderr, "Log Restore Error (ADDGENRE): Malformed line: %s\n", line);
+                state->errors++;
+            } else {
+                record.field_count = 1;
+                record.fields[0] = rest + 1;
+                record.field_lengths[0] = (u32)strlen(rest + 1);
+                replay_record(state, &record, NULL);
+            }
+        } else if (strlen(line) > 0) {
+            fprintf(stderr, "Log Restore Warning: Unknown line type: %s\n", line);
+            state->errors++;
+        }
+
+        line = line_end + 1;
+    }
+}
+
+typedef struct {
+    const char* data;
+    const size_t* offsets; // offsets[i] é o início do registro i, offsets[i + 1] o fim
+    Movie** prepared;
+    size_t begin;
+    size_t end;
+    size_t first_bad; // primeiro registro inválido da faixa, ou 'end'
+} VerifyTask;
+
+static void* verify_worker(void* arg) {
+    VerifyTask* task = (VerifyTask*)arg;
+    task->first_bad = task->end;
+    for (size_t i = task->begin; i < task->end; ++i) {
+        LogRecord record;
+        size_t consumed;
+        size_t length = task->offsets[i + 1] - task->offsets[i];
+        if (LogRecord_decode(task->data + task->offsets[i], length, &record, &consumed) != LOG_RECORD_OK) {
+            task->first_bad = i;
+            break;
+        }
+        if (record.type == LOG_RECORD_ADD) {
+            task->prepared[i] = movie_from_record(&record);
+        }
+    }
+    return NULL;
+}
+
+static size_t restore_thread_count(size_t records) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t threads = cpus > 0 ? (size_t)cpus : 1;
+    if (threads > RESTORE_MAX_THREADS) threads = RESTORE_MAX_THREADS;
+    size_t by_size = records / RESTORE_MIN_RECORDS_PER_THREAD;
+    if (threads > by_size) threads = by_size;
+    return threads > 0 ? threads : 1;
+}
+
+// Procura um registro válido (tamanho, checksum e estrutura) começando em qualquer byte depois de 'offset'. Um
+// registro que passa do fim do arquivo só é uma escrita interrompida se nada válido vier depois dele; se vier, foi o
+// campo de tamanho que se corrompeu, e truncar ali jogaria fora registros bons.
+static int valid_record_after(const char* data, size_t size, size_t offset) {
+    LogRecord record;
+    size_t consumed;
+    for (size_t p = offset + 1; p + LOG_RECORD_HEADER_SIZE <= size; ++p) {
+        if (LogRecord_decode(data + p, size - p, &record, &consumed) == LOG_RECORD_OK) return 1;
+    }
+    return 0;
+}
+
+// Retorna o offset até onde o log é válido. Um registro incompleto ou com checksum inválido no fim do arquivo é
+// tratado como uma escrita interrompida (crash no meio do write) e descartado; no meio do arquivo é corrupção.
+static size_t restore_binary_log(RestoreState* state, const char* data, size_t size, int* corrupted) {
+    *corrupted = 0;
+
+    // Fase 1: limites dos registros.
+    size_t capacity = 1024, count = 0;
+    size_t* offsets = malloc((capacity + 1) * sizeof(size_t));
+    if (!offsets) {
+        perror("log_restore: malloc failed");
+        state->errors++;
+        return LOG_FILE_HEADER_SIZE;
+    }
+    size_t offset = LOG_FILE_HEADER_SIZE;
+    while (offset < size) {
+        size_t record_size = LogRecord_peek_size(data + offset, size - offset);
+        if (record_size == 0) {
+            if (valid_record_after(data, size, offset)) {
+                fprintf(stderr, "Log Restore Error: corrupted record length at offset %zu.\n", offset);
+                *corrupted = 1;
+            } else {
+                fprintf(stderr, "Log Restore Warning: truncated record at offset %zu (%zu trailing bytes discarded).\n",
+                        offset, size - offset);
+            }
+            break;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            size_t* new_offsets = realloc(offsets, (capacity + 1) * sizeof(size_t));
+            if (!new_offsets) {
+                perror("log_restore: realloc failed");
+                free(offsets);
+                state->errors++;
+                return LOG_FILE_HEADER_SIZE;
+            }
+            offsets = new_offsets;
+        }
+        offsets[count++] = offset;
+        offset += record_size;
+    }
+    offsets[count] = offset;
+
+    // Fase 2: verificação e pré-montagem em paralelo.
+    Movie** prepared = calloc(count > 0 ? count : 1, sizeof(Movie*));
+    if (!prepared) {
+        perror("log_restore: calloc failed");
+        free(offsets);
+        state->errors++;
+        return LOG_FILE_HEADER_SIZE;
+    }
+
+    size_t thread_count = restore_thread_count(count);
+    VerifyTask tasks[RESTORE_MAX_THREADS];
+    pthread_t threads[RESTORE_MAX_THREADS];
+    int started[RESTORE_MAX_THREADS] = {0};
+    for (size_t t = 0; t < thread_count; ++t) {
+        tasks[t].data = data;
+        tasks[t].offsets = offsets;
+        tasks[t].prepared = prepared;
+        tasks[t].begin = count * t / thread_count;
+        tasks[t].end = count * (t + 1) / thread_count;
+        // A primeira faixa roda na própria thread, se alguma thread não puder ser criada também.
+        if (t > 0 && pthread_create(&threads[t], NULL, verify_worker, &tasks[t]) == 0) {
+            started[t] = 1;
+        }
+    }
+    for (size_t t = 0; t < thread_count; ++t) {
+        if (!started[t]) verify_worker(&tasks[t]);
+    }
+    size_t first_bad = count;
+    for (size_t t = 0; t < thread_count; ++t) {
+        if (started[t]) pthread_join(threads[t], NULL);
+        if (tasks[t].first_bad < tasks[t].end && tasks[t].first_bad < first_bad) {
+            first_bad = tasks[t].first_bad;
+        }
+    }
+
+    if (first_bad < count && !*corrupted) {
+        if (first_bad == count - 1 && !valid_record_after(data, size, offsets[first_bad])) {
+            fprintf(stderr, "Log Restore Warning: torn record at offset %zu (%zu trailing bytes discarded).\n",
+                    offsets[first_bad], size - offsets[first_bad]);
+        } else {
+            fprintf(stderr, "Log Restore Error: corrupted record at offset %zu.\n", offsets[first_bad]);
+            *corrupted = 1;
+        }
+    }
+
+    // Fase 3: aplicação em ordem.
+    for (size_t i = 0; i < first_bad; ++i) {
+        LogRecord record;
+        size_t consumed;
+        LogRecord_decode_trusted(data + offsets[i], offsets[i + 1] - offsets[i], &record, &consumed);
+        replay_record(state, &record, prepared[i]);
+    }
+    for (size_t i = first_bad; i < count; ++i) {
+        Movie_free(prepared[i]);
+    }
+
+    size_t valid = offsets[first_bad];
+    free(prepared);
+    free(offsets);
+    return valid;
+}
+
+static int write_all(int fd, const char* buffer, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, buffer, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buffer += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+// Reescreve o estado restaurado como um log binário (um ADD por filme) e troca o arquivo de texto por ele.
+// O log em texto original é mantido como <filename>.text.bak.
+static int convert_text_log(const char* filename, RestoreState* state) {
+    char tmp_name[4096], backup_name[4096];
+    snprintf(tmp_name, sizeof(tmp_name), "%s.convert", filename);
+    snprintf(backup_name, sizeof(backup_name), "%s.text.bak", filename);
+
+    int fd = open(tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("log_restore: open for conversion failed");
         return -1;
     }
-    return write_log_entry(buffer, len);
+
+    char header[LOG_FILE_HEADER_SIZE];
+    LogFile_write_header(header);
+    int result = write_all(fd, header, sizeof(header));
+
+    for (size_t i = 0; i < state->max_entries && result == 0; ++i) {
+        const Movie* movie = state->entries[i].movie;
+        if (!movie) continue;
+        LogRecord record;
+        record.type = LOG_RECORD_ADD;
+        record.version = movie->version;
+        record.timestamp_us = realtime_us();
+        record.movie_id = movie->id;
+        record.field_count = 4;
+        set_field(&record, 0, movie->title);
+        set_field(&record, 1, movie->genres);
+        set_field(&record, 2, movie->director);
+        set_field(&record, 3, movie->release_year);
+
+        size_t size = LogRecord_encoded_size(&record);
+        char* buffer = malloc(size);
+        if (!buffer) {
+            result = -1;
+            break;
+        }
+        LogRecord_encode(&record, buffer);
+        result = write_all(fd, buffer, size);
+        free(buffer);
+    }
+
+    if (result == 0) result = fsync(fd);
+    close(fd);
+    if (result == 0 && rename(filename, backup_name) == 0 && rename(tmp_name, filename) == 0) {
+        printf("Converted text log to binary format (backup at %s).\n", backup_name);
+        return 0;
+    }
+
+    perror("log_restore: text log conversion failed");
+    unlink(tmp_name);
+    return -1;
+}
+
+// O log em texto é pequeno e só é lido uma vez (na conversão), então é lido para um buffer comum.
+static char* read_whole_file(int fd, size_t size) {
+    char* data = malloc(size + 1);
+    if (!data) return NULL;
+    size_t total = 0;
+    while (total < size) {
+        ssize_t n = read(fd, data + total, size - total);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            free(data);
+            return NULL;
+        }
+        total += (size_t)n;
+    }
+    data[size] = '\0';
+    return data;
 }
 
 int log_restore(const char* filename,
         MovieEntry* entries,
         size_t max_entries,
+        IdIndex* index,
         atomic_uint* movie_count_ptr,
-        atomic_uint* next_id_ptr)
+        atomic_uint* next_id_ptr,
+        atomic_ullong* store_version_ptr)
 {
-    FILE* f = fopen(filename, "r");
-    if (!f) {
+    int fd = open(filename, restore_read_only ? O_RDONLY : O_RDWR);
+    if (fd < 0) {
         if (errno == ENOENT) {
-            atomic_store(movie_count_ptr, 0);
-            atomic_store(next_id_ptr, 1);
             return 0;
         } else {
-            perror("log_restore: fopen failed");
+            perror("log_restore: open failed");
             return -1;
         }
     }
 
-    char line[LOG_BUFFER_SIZE];
-    uint32_t max_id_seen = 0;
-    uint32_t current_count = 0;
-    int parse_errors = 0;
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("log_restore: fstat failed");
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
 
-    while (fgets(line, sizeof(line), f)) {
-        // Considera tanto CRLF quanto LF como terminadores de linha
-        line[strcspn(line, "\r\n")] = 0;
+    RestoreState state;
+    if (restore_state_init(&state, entries, max_entries, index) < 0) {
+        close(fd);
+        return -1;
+    }
 
-        if (strncmp(line, "ADD ", 4) == 0) {
-            uint32_t id;
-            char* data_part = line + 4;
-            char* title_part = data_part;
-            char* genres_part = strchr(title_part, '|');
-            char* director_part = genres_part ? strchr(genres_part + 1, '|') : NULL;
-            char* year_part = director_part ? strchr(director_part + 1, '|') : NULL;
+    char header[LOG_FILE_HEADER_SIZE];
+    ssize_t header_size = pread(fd, header, sizeof(header), 0);
+    int is_text = (size > 0 && !LogFile_check_header(header, header_size > 0 ? (size_t)header_size : 0));
 
-            if (!genres_part || !director_part || !year_part) {
-                fprintf(stderr, "Log Restore Error (ADD): Malformed line: %s\n", line);
-                parse_errors++;
-                continue;
+    if (is_text) {
+        char* data = read_whole_file(fd, size);
+        if (!data) {
+            perror("log_restore: read failed");
+            state.errors++;
+        } else {
+            restore_text_log(&state, data, size);
+            free(data);
+        }
+    } else if (size > 0) {
+        char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            perror("log_restore: mmap failed");
+            state.errors++;
+        } else {
+            madvise(data, size, MADV_WILLNEED);
+            int corrupted;
+            size_t valid = restore_binary_log(&state, data, size, &corrupted);
+            munmap(data, size);
+            if (corrupted) {
+                state.errors++;
+            } else if (valid < size && !restore_read_only) {
+                // Remove a cauda inválida, senão os próximos registros seriam escritos depois dela.
+                if (ftruncate(fd, (off_t)valid) < 0) {
+                    perror("log_restore: ftruncate failed");
+                    state.errors++;
+                }
             }
+        }
+    }
 
-            *genres_part = '\0';
-            *director_part = '\0';
-            *year_part = '\0';
+    close(fd);
 
-            if (sscanf(title_part, "%u ", &id) != 1) {
-                fprintf(stderr, "Log Restore Error (ADD): Failed ID parse: %s\n", line);
-                *genres_part = '|'; *director_part = '|'; *year_part = '|';
-                parse_errors++;
-                continue;
-            }
-            char* title_start = strchr(title_part, ' ');
-            if (!title_start) {
-                fprintf(stderr, "Log Restore Error (ADD): Malformed title/ID: %s\n", line);
-                *genres_part = '|'; *director_part = '|'; *year_part = '|';
-                parse_errors++;
-                continue;
-            }
-            title_start++;
+    // next_id e store_version nunca diminuem: o snapshot carregado antes pode ter valores maiores que os dos filmes
+    // presentes (por exemplo se o filme de maior ID foi removido).
+    atomic_store(movie_count_ptr, state.count);
+    if (state.max_id + 1 > atomic_load(next_id_ptr)) atomic_store(next_id_ptr, state.max_id + 1);
+    if (state.max_version > atomic_load(store_version_ptr)) atomic_store(store_version_ptr, state.max_version);
+    restore_state_free(&state, index);
 
-            int idx = -1;
-            for (size_t i = 0; i < max_entries; ++i) {
-                if (entries[i].movie == NULL) {
-                    idx = i;
-                    break;
-                }
-            }
+    // Depois de um checkpoint isso é esperado: o snapshot é tirado sem pausar as requisições, então pode já conter
+    // o efeito de registros do começo do log (por exemplo um filme que já foi removido).
+    if (state.missing > 0) {
+        fprintf(stderr, "Log Restore: %u records referenced movies that are not present (skipped).\n", state.missing);
+    }
 
-            if (idx == -1) {
-                fprintf(stderr, "Log Restore Error (ADD): No free slots for ID %u.\n", id);
-                *genres_part = '|'; *director_part = '|'; *year_part = '|';
-                parse_errors++;
-                continue;
-            }
+    if (state.errors > 0) {
+        fprintf(stderr, "Log Restore finished with %d parsing errors.\n", state.errors);
+        return -1;
+    }
 
-            Movie* movie = malloc(sizeof(Movie));
-            if (!movie) {
-                perror("Log Restore Error (ADD): malloc failed");
-                *genres_part = '|'; *director_part = '|'; *year_part = '|';
-                parse_errors++;
-                break;
-            }
-            memset(movie, 0, sizeof(Movie));
+    if (is_text && !restore_read_only && convert_text_log(filename, &state) < 0) {
+        return -1;
+    }
 
-            movie->id = id;
-            movie->title = strdup(title_start);
-            movie->genres = strdup(genres_part + 1);
-            movie->director = strdup(director_part + 1);
-            movie->release_year = strdup(year_part + 1);
+    return 1;
+}
 
-            *genres_part = '|'; *director_part = '|'; *year_part = '|';
+// Versões antigas usavam um arquivo só ('<base>', mais '<base>.old' durante um checkpoint). Eles viram os primeiros
+// segmentos, na ordem em que foram escritos.
+static int migrate_legacy_log(const char* base_filename) {
+    char old_filename[4096 + 8];
+    char segment[4096 + 32];
+    u64 next = 1;
+    snprintf(old_filename, sizeof(old_filename), "%s.old", base_filename);
 
-            if (!movie->title || !movie->genres || !movie->director || !movie->release_year) {
-                fprintf(stderr, "Log Restore Error (ADD): strdup failed for ID %u\n", id);
-                Movie_free(movie);
-                parse_errors++;
-                continue;
-            }
+    const char* legacy[2] = {old_filename, base_filename};
+    for (int i = 0; i < 2; ++i) {
+        if (access(legacy[i], F_OK) != 0) continue;
+        segment_filename(segment, sizeof(segment), base_filename, next++);
+        if (rename(legacy[i], segment) < 0) {
+            perror("log: legacy log migration failed");
+            return -1;
+        }
+        printf("Log: migrated %s to %s\n", legacy[i], segment);
+    }
+    return 0;
+}
+
+int log_restore_segments(const char* base_filename,
+        MovieEntry* entries,
+        size_t max_entries,
+        IdIndex* index,
+        atomic_uint* movie_count_ptr,
+        atomic_uint* next_id_ptr,
+        atomic_ullong* store_version_ptr,
+        uint64_t* last_segment)
+{
+    u64* segments;
+    size_t count;
+    if (list_segments(base_filename, &segments, &count) < 0) return -1;
+    if (count == 0 && !restore_read_only) {
+        free(segments);
+        if (migrate_legacy_log(base_filename) < 0 || list_segments(base_filename, &segments, &count) < 0) return -1;
+    }
+
+    int result = count > 0 ? 1 : 0;
+    for (size_t i = 0; i < count && result > 0; ++i) {
+        char filename[4096 + 32];
+        segment_filename(filename, sizeof(filename), base_filename, segments[i]);
+        if (log_restore(filename, entries, max_entries, index, movie_count_ptr, next_id_ptr, store_version_ptr) < 0) {
+            fprintf(stderr, "Log Restore: failed on segment %s\n", filename);
+            result = -1;
+        }
+    }
+    if (last_segment) *last_segment = count > 0 ? segments[count - 1] : 0;
+    free(segments);
+    return result;
+}
 
-            entries[idx].movie = movie;
-            current_count++;
-            if (id > max_id_seen) max_id_seen = id;
+// --- Réplica ---
 
-        } else if (strncmp(line, "REM ", 4) == 0) {
-            uint32_t id;
-            if (sscanf(line + 4, "%u", &id) == 1) {
-                int found = 0;
-                for (size_t i = 0; i < max_entries; ++i) {
-                    if (entries[i].movie && entries[i].movie->id == id) {
-                        Movie_free(entries[i].movie);
-                        entries[i].movie = NULL;
-                        current_count--;
-                        found = 1;
-                        break;
-                    }
-                }
-                if (!found) {
-                    fprintf(stderr, "Log Restore Warning (REM): ID %u not found.\n", id);
-                }
-            } else {
-                fprintf(stderr, "Log Restore Error (REM): Malformed line: %s\n", line);
-                parse_errors++;
+#define LOG_TAIL_READ_CHUNK (1 << 20)
+
+struct LogTail {
+    RestoreState state;
+    char base_filename[4096];
+    u64 segment;        // segmento aberto (ou o próximo esperado, se fd < 0)
+    int fd;
+    size_t offset;      // próximo byte do arquivo a ser lido
+    int header_checked;
+    char* buffer;       // bytes lidos que ainda não formam um registro completo
+    size_t buffer_length;
+    size_t buffer_capacity;
+    u64 last_timestamp_us;
+    int caught_up;
+    atomic_uint* movie_count_ptr;
+    atomic_uint* next_id_ptr;
+    atomic_ullong* store_version_ptr;
+};
+
+// Menor segmento existente >= 'first' (0 se não há nenhum).
+static u64 find_segment_from(const char* base_filename, u64 first) {
+    u64* segments;
+    size_t count;
+    if (list_segments(base_filename, &segments, &count) < 0) return 0;
+    u64 found = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (segments[i] >= first) {
+            found = segments[i];
+            break;
+        }
+    }
+    free(segments);
+    return found;
+}
+
+static int tail_open_segment(LogTail* tail, u64 segment) {
+    char filename[4096 + 32];
+    segment_filename(filename, sizeof(filename), tail->base_filename, segment);
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("log tail: open failed");
+        return -1;
+    }
+    if (tail->fd >= 0) close(tail->fd);
+    tail->fd = fd;
+    tail->segment = segment;
+    tail->offset = 0;
+    tail->header_checked = 0;
+    tail->buffer_length = 0;
+    return 0;
+}
+
+// Lê o que foi escrito no segmento aberto e aplica os registros completos.
+static long tail_drain(LogTail* tail) {
+    struct stat st;
+    if (fstat(tail->fd, &st) < 0) {
+        perror("log tail: fstat failed");
+        return -1;
+    }
+
+    long applied = 0;
+    while (tail->offset < (size_t)st.st_size) {
+        size_t chunk = (size_t)st.st_size - tail->offset;
+        if (chunk > LOG_TAIL_READ_CHUNK) chunk = LOG_TAIL_READ_CHUNK;
+        if (tail->buffer_length + chunk > tail->buffer_capacity) {
+            size_t capacity = tail->buffer_length + chunk;
+            char* buffer = realloc(tail->buffer, capacity);
+            if (!buffer) {
+                perror("log tail: realloc failed");
+                return -1;
             }
-        } else if (strncmp(line, "ADDGENRE ", 9) == 0) {
-            uint32_t id;
-            char genre[LOG_BUFFER_SIZE];
-
-            if (sscanf(line + 9, "%u %s", &id, genre) == 2) {
-                int found = 0;
-                for (size_t i = 0; i < max_entries; ++i) {
-                    if (entries[i].movie && entries[i].movie->id == id) {
-                        if (genre_exists(entries[i].movie->genres, genre)) {
-                            found = 1;
-                            break;
-                        }
-
-                        char* old_genres = entries[i].movie->genres;
-                        size_t old_len = old_genres ? strlen(old_genres) : 0;
-                        size_t add_len = strlen(genre);
-                        size_t new_len = old_len + (old_len > 0 ? 1 : 0) + add_len + 1;
-                        char* temp_genres = realloc(old_genres, new_len);
-
-                        if (!temp_genres) {
-                            perror("Log Restore Error (ADDGENRE): realloc failed");
-                            parse_errors++;
-                            found = 1;
-                            break;
-                        }
-
-                        entries[i].movie->genres = temp_genres;
-
-                        if (old_len > 0) {
-                            strcat(entries[i].movie->genres, ",");
-                        } else {
-                            entries[i].movie->genres[0] = '\0';
-                        }
-                        strcat(entries[i].movie->genres, genre);
-                        found = 1;
-                        break;
-                    }
-                }
-                if (!found) {
-                    fprintf(stderr, "Log Restore Warning (ADDGENRE): ID %u not found for genre '%s'.\n", id, genre);
-                }
-            } else {
-                fprintf(stderr, "Log Restore Error (ADDGENRE): Malformed line: %s\n", line);
-                parse_errors++;
+            tail->buffer = buffer;
+            tail->buffer_capacity = capacity;
+        }
+        ssize_t n = pread(tail->fd, tail->buffer + tail->buffer_length, chunk, (off_t)tail->offset);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) perror("log tail: read failed");
+            return n < 0 ? -1 : applied;
+        }
+        tail->offset += (size_t)n;
+        tail->buffer_length += (size_t)n;
+
+        size_t pos = 0;
+        if (!tail->header_checked) {
+            if (tail->buffer_length < LOG_FILE_HEADER_SIZE) continue;
+            if (!LogFile_check_header(tail->buffer, tail->buffer_length)) {
+                fprintf(stderr, "log tail: segment %llu has an invalid header\n", (unsigned long long)tail->segment);
+                return -1;
             }
-        } else if (strlen(line) > 0) {
-            fprintf(stderr, "Log Restore Warning: Unknown line type: %s\n", line);
-            parse_errors++;
+            tail->header_checked = 1;
+            pos = LOG_FILE_HEADER_SIZE;
+        }
+
+        while (pos < tail->buffer_length) {
+            LogRecord record;
+            size_t consumed;
+            int result = LogRecord_decode(tail->buffer + pos, tail->buffer_length - pos, &record, &consumed);
+            if (result == LOG_RECORD_TRUNCATED) break;
+            if (result != LOG_RECORD_OK) {
+                fprintf(stderr, "log tail: corrupted record in segment %llu\n", (unsigned long long)tail->segment);
+                return -1;
+            }
+            replay_record(&tail->state, &record, NULL);
+            tail->last_timestamp_us = record.timestamp_us;
+            pos += consumed;
+            applied++;
+        }
+        memmove(tail->buffer, tail->buffer + pos, tail->buffer_length - pos);
+        tail->buffer_length -= pos;
+    }
+
+    if (applied > 0) {
+        atomic_store(tail->movie_count_ptr, tail->state.count);
+        if (tail->state.max_id + 1 > atomic_load(tail->next_id_ptr)) {
+            atomic_store(tail->next_id_ptr, tail->state.max_id + 1);
+        }
+        if (tail->state.max_version > atomic_load(tail->store_version_ptr)) {
+            atomic_store(tail->store_version_ptr, tail->state.max_version);
+        }
+    }
+    return applied;
+}
+
+LogTail* log_tail_open(const char* base_filename,
+        uint64_t start_segment,
+        MovieEntry* entries,
+        size_t max_entries,
+        IdIndex* index,
+        atomic_uint* movie_count_ptr,
+        atomic_uint* next_id_ptr,
+        atomic_ullong* store_version_ptr,
+        void (*on_remove)(uint32_t movie_id, uint64_t version))
+{
+    LogTail* tail = calloc(1, sizeof(LogTail));
+    if (!tail) return NULL;
+    if (restore_state_init(&tail->state, entries, max_entries, index) < 0) {
+        free(tail);
+        return NULL;
+    }
+    tail->state.live = 1;
+    tail->state.on_remove = on_remove;
+    snprintf(tail->base_filename, sizeof(tail->base_filename), "%s", base_filename);
+    tail->segment = start_segment > 0 ? start_segment : 1;
+    tail->fd = -1;
+    tail->movie_count_ptr = movie_count_ptr;
+    tail->next_id_ptr = next_id_ptr;
+    tail->store_version_ptr = store_version_ptr;
+    return tail;
+}
+
+long log_tail_poll(LogTail* tail) {
+    long total = 0;
+    tail->caught_up = 0;
+
+    if (tail->fd < 0) {
+        u64 first = find_segment_from(tail->base_filename, tail->segment);
+        if (first == 0) {
+            // O líder ainda não criou o segmento.
+            tail->caught_up = 1;
+            return 0;
+        }
+        if (first != tail->segment) {
+            fprintf(stderr, "log tail: segment %llu was removed before being read\n", (unsigned long long)tail->segment);
+            return -1;
         }
+        if (tail_open_segment(tail, first) < 0) return -1;
     }
 
-    fclose(f);
+    while (1) {
+        long applied = tail_drain(tail);
+        if (applied < 0) return -1;
+        total += applied;
 
-    atomic_store(movie_count_ptr, current_count);
-    atomic_store(next_id_ptr, max_id_seen + 1);
+        u64 next = find_segment_from(tail->base_filename, tail->segment + 1);
+        if (next == 0) break;
 
-    if (parse_errors > 0) {
-        fprintf(stderr, "Log Restore finished with %d parsing errors.\n", parse_errors);
-        return -1;
+        // O escritor só cria o próximo segmento depois de terminar de escrever no atual, então uma última leitura
+        // pega tudo o que faltava nele.
+        applied = tail_drain(tail);
+        if (applied < 0) return -1;
+        total += applied;
+        if (tail->buffer_length > 0) {
+            fprintf(stderr, "log tail: discarding an incomplete record at the end of segment %llu\n",
+                    (unsigned long long)tail->segment);
+        }
+        if (next != tail->segment + 1) {
+            // Um checkpoint do líder apagou segmentos que a réplica ainda não tinha lido.
+            fprintf(stderr, "log tail: segment %llu was removed before being read\n",
+                    (unsigned long long)(tail->segment + 1));
+            return -1;
+        }
+        if (tail_open_segment(tail, next) < 0) return -1;
     }
 
-    return 1;
+    tail->caught_up = tail->buffer_length == 0;
+    return total;
+}
+
+int log_tail_caught_up(const LogTail* tail) {
+    return tail->caught_up;
+}
+
+uint64_t log_tail_last_timestamp_us(const LogTail* tail) {
+    return tail->last_timestamp_us;
+}
+
+void log_tail_close(LogTail* tail) {
+    if (!tail) return;
+    if (tail->fd >= 0) close(tail->fd);
+    restore_state_free(&tail->state, NULL);
+    free(tail->buffer);
+    free(tail);
 }
@@ -5,20 +5,104 @@
 #include <stdint.h>
 #include <stdatomic.h>
 #include "MovieEntry.h"
+#include "IdIndex.h"
 #include "cabbage/common/Movie.h"
 
 
-int log_init(const char* filename);
+// Níveis de durabilidade do log:
+//  - NONE: a confirmação sai quando o registro foi escrito no arquivo (write), sem fsync.
+//  - BATCH: cada lote escrito pelo escritor passa por fsync, e a confirmação só sai depois dele.
+//  - INTERVAL: a confirmação sai depois do write, e o fsync é feito no máximo a cada 'sync_interval_ms'.
+typedef enum {
+    LOG_DURABILITY_NONE,
+    LOG_DURABILITY_BATCH,
+    LOG_DURABILITY_INTERVAL,
+} log_durability_t;
+
+// Identifica um registro enfileirado, usado para esperar sua durabilidade com log_wait().
+typedef uint64_t log_ticket_t;
+
+#define LOG_DEFAULT_SEGMENT_SIZE (64u << 20)
+
+// O log é dividido em segmentos '<base_filename>.000001', '<base_filename>.000002', ...; um segmento novo é começado
+// quando o atual passa de 'segment_size' bytes. log_init sempre começa um segmento novo, depois dos existentes.
+int log_init(const char* base_filename, log_durability_t durability, unsigned sync_interval_ms, size_t segment_size);
 void log_close(void);
 
-int log_add_movie(const Movie* movie);
-int log_add_genre(uint32_t movie_id, const char* genre);
-int log_remove_movie(uint32_t movie_id);
+// As funções de log apenas enfileiram o registro (a ordem da fila é a ordem do arquivo) e retornam um ticket.
+// Devem ser chamadas com o lock da entrada em mãos, para que a ordem no log siga a ordem das mutações.
+int log_add_movie(const Movie* movie, log_ticket_t* ticket);
+// 'version' é a versão da store produzida pela mutação, guardada no registro para ser restaurada no boot.
+int log_add_genre(uint32_t movie_id, const char* genre, uint64_t version, log_ticket_t* ticket);
+int log_remove_movie(uint32_t movie_id, uint64_t version, log_ticket_t* ticket);
+
+// Bloqueia até o registro atingir o nível de durabilidade configurado. Retorna -1 se o escritor falhou.
+int log_wait(log_ticket_t ticket);
+
+// Fecha o segmento atual e começa um novo (usado pelo checkpoint). Os registros já escritos ficam duráveis antes da
+// troca, e *first_segment recebe o número do segmento novo: tudo o que está nos anteriores já está na memória.
+int log_rotate(uint64_t* first_segment);
+// Bytes de log ainda não cobertos por um checkpoint.
+size_t log_size(void);
+// Registros enfileirados que o escritor ainda não gravou.
+size_t log_queue_depth(void);
+// Apaga os segmentos anteriores a 'segment' (depois que um snapshot os cobre).
+int log_remove_segments_before(uint64_t segment);
 
+// Reconstrói a tabela a partir do log. Aceita o formato binário (ver LogRecord.h) e o formato em texto antigo,
+// que é convertido para binário. Retorna 0 se o arquivo não existe, 1 em caso de sucesso e -1 em caso de erro.
+// Os filmes já presentes em 'entries' (vindos de um snapshot) são mantidos e os registros são aplicados por cima;
+// next_id e store_version só aumentam. 'index' (pode ser NULL) guarda o índice ID -> slot entre chamadas: se estiver
+// vazio é montado a partir da tabela, e no final contém o índice atualizado (deve ser liberado com IdIndex_free).
 int log_restore(const char* filename,
                 MovieEntry* entries,
                 size_t max_entries,
+                IdIndex* index,
                 atomic_uint* movie_count_ptr,
-                atomic_uint* next_id_ptr);
+                atomic_uint* next_id_ptr,
+                atomic_ullong* store_version_ptr);
+
+// Restaura todos os segmentos de 'base_filename', em ordem, com log_restore. Um log antigo de arquivo único é
+// renomeado para os primeiros segmentos. Retorna 0 se não há nenhum segmento, 1 em caso de sucesso e -1 em caso de erro.
+// '*last_segment' (pode ser NULL) recebe o número do último segmento restaurado (0 se não há nenhum).
+int log_restore_segments(const char* base_filename,
+                         MovieEntry* entries,
+                         size_t max_entries,
+                         IdIndex* index,
+                         atomic_uint* movie_count_ptr,
+                         atomic_uint* next_id_ptr,
+                         atomic_ullong* store_version_ptr,
+                         uint64_t* last_segment);
+
+// Em modo somente leitura o restore não trunca caudas inválidas, não converte logs em texto e não migra logs
+// antigos (usado pela réplica, que lê os arquivos do líder).
+void log_restore_set_read_only(int read_only);
+
+// --- Réplica ---
+// Acompanha os segmentos do log enquanto outro processo escreve neles, aplicando os registros novos na tabela com
+// o mesmo código do restore. As alterações são feitas com o lock de cada entrada, então a tabela pode ser lida por
+// outras threads ao mesmo tempo.
+typedef struct LogTail LogTail;
+
+// Começa a leitura no início do segmento 'start_segment' (ou no primeiro que existir depois dele). Os registros
+// que já estavam na tabela são reaplicados sem problema, porque a reaplicação é idempotente. 'index' passa a
+// pertencer ao LogTail. 'on_remove' (pode ser NULL) é chamada para cada remoção aplicada.
+LogTail* log_tail_open(const char* base_filename,
+                       uint64_t start_segment,
+                       MovieEntry* entries,
+                       size_t max_entries,
+                       IdIndex* index,
+                       atomic_uint* movie_count_ptr,
+                       atomic_uint* next_id_ptr,
+                       atomic_ullong* store_version_ptr,
+                       void (*on_remove)(uint32_t movie_id, uint64_t version));
+// Aplica tudo o que foi escrito desde a última chamada. Retorna o número de registros aplicados ou -1 em caso de erro
+// (por exemplo, um checkpoint do líder apagou um segmento que ainda não tinha sido lido).
+long log_tail_poll(LogTail* tail);
+// Verdadeiro se a última chamada de log_tail_poll chegou ao fim do log.
+int log_tail_caught_up(const LogTail* tail);
+// Timestamp (gravado pelo líder) do último registro aplicado.
+uint64_t log_tail_last_timestamp_us(const LogTail* tail);
+void log_tail_close(LogTail* tail);
 
 #endif // _CABBAGE_LOGGER_H
@@ -0,0 +1,148 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include "stats.h"
+#include "trace.h"
+#include "msglog.h"
+#include "util.h"
+
+#define METRICS_BACKLOG 16
+#define METRICS_REQUEST_MAX 4096
+// Um scraper lento não pode prender a thread.
+#define METRICS_TIMEOUT_S 5
+// Pausa depois de um erro do accept que não passa sozinho (por exemplo EMFILE), para não girar em cima dele.
+#define METRICS_ACCEPT_BACKOFF_US 100000
+
+static int metrics_fd = -1;
+
+static int send_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return 0;
+}
+
+static void send_response(int fd, const char* status, const char* content_type, const char* body, size_t length) {
+    char header[256];
+    int header_length = snprintf(header, sizeof(header),
+                                 "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                                 status, content_type, length);
+    if (send_all(fd, header, (size_t)header_length) == 0) {
+        send_all(fd, body, length);
+    }
+}
+
+// Lê até o fim do cabeçalho do pedido (só a primeira linha importa).
+static int read_request(int fd, char* buffer, size_t size) {
+    size_t length = 0;
+    while (length + 1 < size) {
+        ssize_t n = recv(fd, buffer + length, size - 1 - length, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        length += (size_t)n;
+        buffer[length] = '\0';
+        if (strstr(buffer, "\r\n\r\n") || strstr(buffer, "\n\n")) return 0;
+    }
+    return -1;
+}
+
+static int path_matches(const char* path, const char* expected) {
+    size_t length = strlen(expected);
+    return strncmp(path, expected, length) == 0 && (path[length] == ' ' || path[length] == '?');
+}
+
+static void handle_request(int fd) {
+    char request[METRICS_REQUEST_MAX];
+    if (read_request(fd, request, sizeof(request)) < 0) return;
+
+    if (strncmp(request, "GET ", 4) != 0) {
+        const char* body = "Method not allowed\n";
+        send_response(fd, "405 Method Not Allowed", "text/plain", body, strlen(body));
+        return;
+    }
+    const char* path = request + 4;
+    int is_trace = path_matches(path, "/trace");
+    if (!path_matches(path, "/metrics") && !is_trace) {
+        const char* body = "Not found, try /metrics or /trace\n";
+        send_response(fd, "404 Not Found", "text/plain", body, strlen(body));
+        return;
+    }
+
+    size_t length;
+    char* body = is_trace ? trace_render_chrome(&length) : stats_render_prometheus(&length);
+    if (!body) {
+        const char* error = "Failed to render metrics\n";
+        send_response(fd, "500 Internal Server Error", "text/plain", error, strlen(error));
+        return;
+    }
+    send_response(fd, "200 OK", is_trace ? "application/json" : "text/plain; version=0.0.4", body, length);
+    free(body);
+}
+
+static void* metrics_main(void* arg) {
+    (void)arg;
+    int last_error = 0;
+    while (1) {
+        int fd = accept(metrics_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            // Um erro que se repete é registrado uma vez só.
+            if (errno != last_error) LOG(ERROR, "Metrics: accept failed: %s", errmsg());
+            last_error = errno;
+            usleep(METRICS_ACCEPT_BACKOFF_US);
+            continue;
+        }
+        last_error = 0;
+        struct timeval timeout = {.tv_sec = METRICS_TIMEOUT_S};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        handle_request(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+int metrics_start(int port) {
+    metrics_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (metrics_fd < 0) {
+        perror("Metrics: socket failed");
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(metrics_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    if (bind(metrics_fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(metrics_fd, METRICS_BACKLOG) < 0) {
+        perror("Metrics: bind/listen failed");
+        close(metrics_fd);
+        metrics_fd = -1;
+        return -1;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, metrics_main, NULL) != 0) {
+        perror("Metrics: pthread_create failed");
+        close(metrics_fd);
+        metrics_fd = -1;
+        return -1;
+    }
+    pthread_detach(thread);
+    printf("Metrics available at http://0.0.0.0:%d/metrics\n", port);
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef _CABBAGE_METRICS_H
+#define _CABBAGE_METRICS_H
+
+// Endpoint HTTP com as métricas no formato de texto do Prometheus (GET /metrics), em uma porta separada. É um
+// servidor HTTP mínimo: uma thread atende uma conexão por vez, lê o pedido, responde e fecha a conexão. Os números
+// vêm de stats_render_prometheus, então montar a resposta não trava nada no caminho das requisições.
+//
+// GET /trace devolve os traces das requisições (trace.h) no formato do Chrome, vazio se o trace não estiver ligado.
+
+int metrics_start(int port);
+
+#endif // _CABBAGE_METRICS_H
@@ -0,0 +1,334 @@
+#include "msglog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include "cabbage/common/types.h"
+
+#define MSGLOG_RING_SLOTS 64 // precisa ser potência de 2
+#define MSGLOG_MESSAGE_MAX 240
+#define MSGLOG_LINE_MAX (MSGLOG_MESSAGE_MAX + 96)
+#define MSGLOG_BATCH_MAX 1024
+#define MSGLOG_DRAIN_INTERVAL_MS 20
+#define MSGLOG_DEFAULT_RATE_LIMIT 100
+
+typedef struct {
+    u64 timestamp_ns; // CLOCK_REALTIME
+    msglog_level_t level;
+    const char* file;
+    int line;
+    char text[MSGLOG_MESSAGE_MAX];
+} MsglogMessage;
+
+// Ring de uma thread: só ela escreve (head), só quem segura o msglog_mutex lê (tail).
+typedef struct MsglogRing {
+    struct MsglogRing* next;
+    atomic_size_t head;
+    atomic_size_t tail;
+    atomic_bool dead; // a thread terminou, o ring é liberado quando ficar vazio
+    atomic_ullong dropped;
+    u64 dropped_reported;
+    MsglogMessage slots[MSGLOG_RING_SLOTS];
+} MsglogRing;
+
+atomic_int msglog_current_level = MSGLOG_INFO;
+static atomic_uint msglog_rate_limit = MSGLOG_DEFAULT_RATE_LIMIT;
+
+static atomic_bool msglog_running;
+static pthread_t msglog_thread;
+static pthread_key_t msglog_key;
+static pthread_once_t msglog_key_once = PTHREAD_ONCE_INIT;
+
+// Serializa o consumo dos rings e a escrita. As threads que logam nunca pegam esse mutex: o registro de um ring
+// novo é só um push sem lock no começo da lista, então um stdout lento não trava ninguém fora o consumidor.
+static pthread_mutex_t msglog_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic(MsglogRing*) msglog_rings = NULL;
+static MsglogMessage* msglog_batch = NULL;
+
+static _Thread_local MsglogRing* msglog_self = NULL;
+// A thread já está terminando (o destrutor do ring rodou): LOGs de outros destrutores de TLS escrevem na hora.
+static _Thread_local bool msglog_exiting = false;
+
+static const char* level_names[] = {"DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+
+// Depois disso o msglog_flush pode liberar o ring a qualquer momento, então a thread não pode mais usá-lo.
+static void ring_destructor(void* ptr) {
+    MsglogRing* ring = ptr;
+    msglog_self = NULL;
+    msglog_exiting = true;
+    atomic_store(&ring->dead, true);
+}
+
+static void create_key(void) {
+    pthread_key_create(&msglog_key, ring_destructor);
+}
+
+static MsglogRing* thread_ring(void) {
+    if (msglog_self) return msglog_self;
+    if (msglog_exiting) return NULL;
+    MsglogRing* ring = calloc(1, sizeof(MsglogRing));
+    if (!ring) return NULL;
+    pthread_setspecific(msglog_key, ring);
+    MsglogRing* first = atomic_load_explicit(&msglog_rings, memory_order_relaxed);
+    do {
+        ring->next = first;
+    } while (!atomic_compare_exchange_weak_explicit(&msglog_rings, &first, ring, memory_order_release,
+                                                    memory_order_relaxed));
+    msglog_self = ring;
+    return ring;
+}
+
+static size_t format_line(const MsglogMessage* message, char* out, size_t size) {
+    time_t seconds = (time_t)(message->timestamp_ns / 1000000000ull);
+    struct tm tm;
+    localtime_r(&seconds, &tm);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+
+    const char* file = strrchr(message->file, '/');
+    file = file ? file + 1 : message->file;
+    int length = snprintf(out, size, "%s.%06llu %-5s %s:%d %s\n", date,
+                          (unsigned long long)(message->timestamp_ns % 1000000000ull / 1000),
+                          level_names[message->level], file, message->line, message->text);
+    if (length < 0) return 0;
+    if ((size_t)length >= size) {
+        out[size - 2] = '\n';
+        return size - 1;
+    }
+    return (size_t)length;
+}
+
+static void write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+}
+
+static int output_fd(msglog_level_t level) {
+    return level >= MSGLOG_WARN ? STDERR_FILENO : STDOUT_FILENO;
+}
+
+static int compare_messages(const void* a, const void* b) {
+    const MsglogMessage* x = a;
+    const MsglogMessage* y = b;
+    return (x->timestamp_ns > y->timestamp_ns) - (x->timestamp_ns < y->timestamp_ns);
+}
+
+// Escreve o lote em ordem de horário, agrupando as linhas de cada saída em um só write().
+static void write_batch(size_t count) {
+    qsort(msglog_batch, count, sizeof(MsglogMessage), compare_messages);
+
+    static char buffers[2][MSGLOG_BATCH_MAX * 128];
+    size_t lengths[2] = {0, 0};
+    for (size_t i = 0; i < count; ++i) {
+        char line[MSGLOG_LINE_MAX];
+        size_t length = format_line(&msglog_batch[i], line, sizeof(line));
+        int out = output_fd(msglog_batch[i].level) == STDERR_FILENO;
+        if (lengths[out] + length > sizeof(buffers[out])) {
+            write_all(out ? STDERR_FILENO : STDOUT_FILENO, buffers[out], lengths[out]);
+            lengths[out] = 0;
+        }
+        memcpy(buffers[out] + lengths[out], line, length);
+        lengths[out] += length;
+    }
+    if (lengths[0]) write_all(STDOUT_FILENO, buffers[0], lengths[0]);
+    if (lengths[1]) write_all(STDERR_FILENO, buffers[1], lengths[1]);
+}
+
+void msglog_flush(void) {
+    // O stdio ainda é usado nas mensagens de boot, então ele vai antes para manter a ordem.
+    fflush(stdout);
+
+    pthread_mutex_lock(&msglog_mutex);
+    if (!msglog_batch) {
+        pthread_mutex_unlock(&msglog_mutex);
+        return;
+    }
+    size_t count = 0;
+    // Só o primeiro da lista é disputado com os pushes; dele para frente os next são mexidos só aqui. Por isso o
+    // primeiro nunca é liberado nesta passada, fica para quando outro ring entrar na frente.
+    MsglogRing* prev = NULL;
+    MsglogRing* ring = atomic_load_explicit(&msglog_rings, memory_order_acquire);
+    while (ring) {
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        while (tail != head) {
+            if (count == MSGLOG_BATCH_MAX) {
+                write_batch(count);
+                count = 0;
+            }
+            msglog_batch[count++] = ring->slots[tail & (MSGLOG_RING_SLOTS - 1)];
+            tail++;
+            atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        }
+
+        u64 dropped = atomic_load(&ring->dropped);
+        if (dropped != ring->dropped_reported && count < MSGLOG_BATCH_MAX) {
+            MsglogMessage* note = &msglog_batch[count++];
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            note->timestamp_ns = (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+            note->level = MSGLOG_WARN;
+            note->file = __FILE__;
+            note->line = __LINE__;
+            snprintf(note->text, sizeof(note->text), "%llu messages dropped (ring full)",
+                     (unsigned long long)(dropped - ring->dropped_reported));
+            ring->dropped_reported = dropped;
+        }
+
+        MsglogRing* next = ring->next;
+        if (prev && atomic_load(&ring->dead) && atomic_load(&ring->head) == tail) {
+            prev->next = next;
+            free(ring);
+        } else {
+            prev = ring;
+        }
+        ring = next;
+    }
+    if (count > 0) write_batch(count);
+    pthread_mutex_unlock(&msglog_mutex);
+}
+
+static void* msglog_main(void* arg) {
+    (void)arg;
+    struct timespec interval = {.tv_sec = 0, .tv_nsec = MSGLOG_DRAIN_INTERVAL_MS * 1000000L};
+    while (1) {
+        nanosleep(&interval, NULL);
+        msglog_flush();
+    }
+    return NULL;
+}
+
+static void flush_at_exit(void) {
+    msglog_flush();
+}
+
+int msglog_init(void) {
+    if (atomic_load(&msglog_running)) return 0;
+    pthread_once(&msglog_key_once, create_key);
+
+    msglog_batch = malloc(MSGLOG_BATCH_MAX * sizeof(MsglogMessage));
+    if (!msglog_batch) {
+        perror("msglog: malloc failed");
+        return -1;
+    }
+    if (pthread_create(&msglog_thread, NULL, msglog_main, NULL) != 0) {
+        perror("msglog: pthread_create failed");
+        free(msglog_batch);
+        msglog_batch = NULL;
+        return -1;
+    }
+    pthread_detach(msglog_thread);
+    atexit(flush_at_exit);
+    atomic_store(&msglog_running, true);
+    return 0;
+}
+
+void msglog_set_level(msglog_level_t level) {
+    atomic_store(&msglog_current_level, (int)level);
+}
+
+int msglog_parse_level(const char* name, msglog_level_t* level) {
+    static const char* names[] = {"debug", "info", "warn", "error", "fatal"};
+    for (int i = 0; i <= MSGLOG_FATAL; ++i) {
+        if (strcmp(name, names[i]) == 0) {
+            *level = (msglog_level_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void msglog_set_rate_limit(unsigned per_second) {
+    atomic_store(&msglog_rate_limit, per_second);
+}
+
+// Janela de um segundo por ponto de chamada. A troca de janela não é exata entre threads, mas só precisa segurar
+// rajadas, não contar com precisão.
+static int site_allow(MsglogSite* site, u64 now_s, unsigned* suppressed) {
+    unsigned limit = atomic_load_explicit(&msglog_rate_limit, memory_order_relaxed);
+    if (limit == 0) return 1;
+    u64 window = atomic_load_explicit(&site->window, memory_order_relaxed);
+    if (window != now_s && atomic_compare_exchange_strong(&site->window, &window, now_s)) {
+        atomic_store(&site->count, 0);
+    }
+    if (atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed) < limit) {
+        if (atomic_load_explicit(&site->suppressed, memory_order_relaxed)) {
+            *suppressed = atomic_exchange(&site->suppressed, 0);
+        }
+        return 1;
+    }
+    atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+    return 0;
+}
+
+static void format_message(MsglogMessage* message, unsigned suppressed, const char* fmt, va_list args) {
+    int length = vsnprintf(message->text, sizeof(message->text), fmt, args);
+    if (length < 0) {
+        message->text[0] = '\0';
+        length = 0;
+    }
+    if (suppressed > 0 && (size_t)length < sizeof(message->text)) {
+        snprintf(message->text + length, sizeof(message->text) - (size_t)length,
+                 " (%u similar messages suppressed)", suppressed);
+    }
+}
+
+void msglog_write(MsglogSite* site, msglog_level_t level, const char* file, int line, const char* fmt, ...) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    unsigned suppressed = 0;
+    if (level < MSGLOG_FATAL && !site_allow(site, (u64)ts.tv_sec, &suppressed)) return;
+
+    MsglogRing* ring = (atomic_load_explicit(&msglog_running, memory_order_relaxed) && level < MSGLOG_FATAL)
+                           ? thread_ring() : NULL;
+    va_list args;
+
+    if (!ring) {
+        // Sem a thread de escrita, thread terminando (ou FATAL): escreve na hora, depois do que já estava na fila.
+        MsglogMessage message;
+        message.timestamp_ns = (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+        message.level = level;
+        message.file = file;
+        message.line = line;
+        va_start(args, fmt);
+        format_message(&message, suppressed, fmt, args);
+        va_end(args);
+        if (level == MSGLOG_FATAL || msglog_exiting) msglog_flush();
+        else fflush(stdout);
+        char out[MSGLOG_LINE_MAX];
+        size_t length = format_line(&message, out, sizeof(out));
+        write_all(output_fd(level), out, length);
+        return;
+    }
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail == MSGLOG_RING_SLOTS) {
+        atomic_store_explicit(&ring->dropped, atomic_load_explicit(&ring->dropped, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+        return;
+    }
+
+    MsglogMessage* message = &ring->slots[head & (MSGLOG_RING_SLOTS - 1)];
+    message->timestamp_ns = (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+    message->level = level;
+    message->file = file;
+    message->line = line;
+    va_start(args, fmt);
+    format_message(message, suppressed, fmt, args);
+    va_end(args);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
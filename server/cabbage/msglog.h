@@ -0,0 +1,57 @@
+#ifndef _CABBAGE_MSGLOG_H
+#define _CABBAGE_MSGLOG_H
+
+#include <stdatomic.h>
+
+// Mensagens de diagnóstico do servidor (não confundir com o log de dados em logger.h).
+//
+// LOG(nível, fmt, ...) formata a mensagem em um ring buffer da própria thread (SPSC, sem lock) e uma thread de fundo
+// junta os rings de todas as threads, ordena pelo horário e escreve tudo com um write() por lote. Assim um printf no
+// meio de uma requisição não paga pelo lock do stdio nem pela escrita no terminal/pipe. Se o ring estiver cheio, a
+// mensagem é descartada (e contada), a requisição nunca espera pelo log.
+//
+// Cada ponto de chamada tem um limite de mensagens por segundo (msglog_set_rate_limit); o excesso é descartado e o
+// número de mensagens suprimidas aparece na próxima mensagem daquele ponto. Mensagens abaixo do nível atual não são
+// nem formatadas. FATAL é escrita na hora, antes de o processo terminar.
+//
+// Antes do msglog_init (ou em programas que não o chamam, como os benchmarks) as mensagens são escritas direto.
+
+typedef enum {
+    MSGLOG_DEBUG,
+    MSGLOG_INFO,
+    MSGLOG_WARN,
+    MSGLOG_ERROR,
+    MSGLOG_FATAL,
+} msglog_level_t;
+
+// Estado de cada ponto de chamada do LOG, para o limite de mensagens por segundo.
+typedef struct {
+    atomic_ullong window;
+    atomic_uint count;
+    atomic_uint suppressed;
+} MsglogSite;
+
+extern atomic_int msglog_current_level;
+
+#define LOG(level, fmt, ...) do { \
+    if (MSGLOG_##level >= atomic_load_explicit(&msglog_current_level, memory_order_relaxed)) { \
+        static MsglogSite msglog_site_; \
+        msglog_write(&msglog_site_, MSGLOG_##level, __FILE__, __LINE__, fmt, ##__VA_ARGS__); \
+    } \
+} while (0)
+
+// Inicia a thread de escrita. As mensagens pendentes também são escritas no exit().
+int msglog_init(void);
+// Escreve tudo o que está nos rings (bloqueante).
+void msglog_flush(void);
+
+void msglog_set_level(msglog_level_t level);
+// Retorna -1 se o nome não for um nível válido ("debug", "info", "warn", "error", "fatal").
+int msglog_parse_level(const char* name, msglog_level_t* level);
+// Mensagens por segundo por ponto de chamada (0 desativa o limite).
+void msglog_set_rate_limit(unsigned per_second);
+
+void msglog_write(MsglogSite* site, msglog_level_t level, const char* file, int line, const char* fmt, ...)
+    __attribute__((format(printf, 5, 6)));
+
+#endif // _CABBAGE_MSGLOG_H
@@ -0,0 +1,168 @@
+#include "replica.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <libgen.h>
+#include <time.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include "logger.h"
+#include "history.h"
+
+#define REPLICA_POLL_TIMEOUT_MS 1000
+#define REPLICA_REPORT_INTERVAL_US (10ull * 1000000)
+
+static LogTail* replica_tail;
+static int replica_inotify_fd = -1;
+// Acorda a thread no replica_stop.
+static int replica_stop_fd = -1;
+static atomic_bool replica_stopping;
+static pthread_t replica_thread;
+
+static atomic_ullong replica_lag;
+static atomic_ullong replica_applied;
+
+static u64 realtime_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (u64)ts.tv_sec * 1000000 + (u64)ts.tv_nsec / 1000;
+}
+
+static void update_lag(void) {
+    if (log_tail_caught_up(replica_tail)) {
+        atomic_store(&replica_lag, 0);
+        return;
+    }
+    u64 now = realtime_us();
+    u64 last = log_tail_last_timestamp_us(replica_tail);
+    atomic_store(&replica_lag, now > last ? now - last : 0);
+}
+
+static void* replica_main(void* arg) {
+    (void)arg;
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    u64 last_report = 0;
+
+    while (!atomic_load(&replica_stopping)) {
+        long applied = log_tail_poll(replica_tail);
+        if (applied < 0) {
+            fprintf(stderr, "Replica: cannot keep following the leader's log, restart the replica.\n");
+            exit(EXIT_FAILURE);
+        }
+        atomic_fetch_add(&replica_applied, (u64)applied);
+        update_lag();
+
+        u64 lag = atomic_load(&replica_lag);
+        u64 now = realtime_us();
+        if (lag > 0 && now - last_report >= REPLICA_REPORT_INTERVAL_US) {
+            printf("Replica: %.1f ms behind the leader (%llu records applied)\n", lag / 1000.0,
+                   (unsigned long long)atomic_load(&replica_applied));
+            last_report = now;
+        }
+        // Ainda há dados no arquivo (o poll lê no máximo o que existia quando começou), não espera evento.
+        if (!log_tail_caught_up(replica_tail) && applied > 0) continue;
+
+        struct pollfd pfds[2] = {
+            {.fd = replica_inotify_fd, .events = POLLIN},
+            {.fd = replica_stop_fd, .events = POLLIN},
+        };
+        int ready = poll(pfds, 2, REPLICA_POLL_TIMEOUT_MS);
+        if (ready > 0) {
+            // Só interessa saber que algo mudou; os eventos são descartados.
+            while (read(replica_inotify_fd, events, sizeof(events)) > 0) {
+            }
+        } else if (ready < 0 && errno != EINTR) {
+            perror("Replica: poll failed");
+        }
+    }
+    return NULL;
+}
+
+static void replica_on_remove(u32 movie_id, u64 version) {
+    history_record_removal(movie_id, version);
+}
+
+int replica_start(const char* log_base_filename,
+                  u64 start_segment,
+                  MovieEntry* entries,
+                  size_t max_entries,
+                  IdIndex* index,
+                  atomic_uint* movie_count_ptr,
+                  atomic_uint* next_id_ptr,
+                  atomic_ullong* store_version_ptr)
+{
+    char dir_path[4096];
+    snprintf(dir_path, sizeof(dir_path), "%s", log_base_filename);
+
+    replica_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (replica_inotify_fd < 0) {
+        perror("Replica: inotify_init1 failed");
+        return -1;
+    }
+    // O diretório inteiro é observado: escritas no segmento atual e criação de segmentos novos.
+    if (inotify_add_watch(replica_inotify_fd, dirname(dir_path), IN_MODIFY | IN_CREATE | IN_MOVED_TO) < 0) {
+        perror("Replica: inotify_add_watch failed");
+        close(replica_inotify_fd);
+        return -1;
+    }
+
+    replica_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (replica_stop_fd < 0) {
+        perror("Replica: eventfd failed");
+        close(replica_inotify_fd);
+        return -1;
+    }
+
+    replica_tail = log_tail_open(log_base_filename, start_segment, entries, max_entries, index,
+                                 movie_count_ptr, next_id_ptr, store_version_ptr, replica_on_remove);
+    if (!replica_tail) {
+        close(replica_inotify_fd);
+        close(replica_stop_fd);
+        return -1;
+    }
+
+    if (pthread_create(&replica_thread, NULL, replica_main, NULL) != 0) {
+        perror("Replica: pthread_create failed");
+        log_tail_close(replica_tail);
+        close(replica_inotify_fd);
+        close(replica_stop_fd);
+        return -1;
+    }
+    return 0;
+}
+
+int replica_stop(void) {
+    if (!replica_tail) return 0;
+    atomic_store(&replica_stopping, true);
+    u64 one = 1;
+    if (write(replica_stop_fd, &one, sizeof(one)) < 0) {
+        perror("Replica: waking the tail thread failed");
+    }
+    pthread_join(replica_thread, NULL);
+
+    // O escritor já fechou o log, então uma última leitura pega tudo até o fim.
+    long applied;
+    while ((applied = log_tail_poll(replica_tail)) > 0) {
+        atomic_fetch_add(&replica_applied, (u64)applied);
+    }
+    atomic_store(&replica_lag, 0);
+
+    log_tail_close(replica_tail);
+    replica_tail = NULL;
+    close(replica_inotify_fd);
+    close(replica_stop_fd);
+    return applied < 0 ? -1 : 0;
+}
+
+u64 replica_lag_us(void) {
+    return atomic_load(&replica_lag);
+}
+
+u64 replica_applied_records(void) {
+    return atomic_load(&replica_applied);
+}
@@ -0,0 +1,37 @@
+#ifndef _CABBAGE_REPLICA_H
+#define _CABBAGE_REPLICA_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include "MovieEntry.h"
+#include "IdIndex.h"
+#include "cabbage/common/types.h"
+
+// Réplica de leitura: uma thread acompanha os segmentos do log do líder (inotify no diretório, com uma verificação
+// periódica de segurança) e aplica os registros novos na tabela com log_tail_poll. A réplica não escreve nada: o
+// servidor recusa as mutações e atende só as leituras.
+//
+// Se um checkpoint do líder apagar um segmento que a réplica ainda não leu, não há como continuar sem recarregar
+// o snapshot, então o processo termina com erro e deve ser reiniciado.
+
+// Começa a acompanhar o log a partir do segmento 'start_segment' (o último restaurado no boot). 'index' passa a
+// pertencer à réplica.
+int replica_start(const char* log_base_filename,
+                  u64 start_segment,
+                  MovieEntry* entries,
+                  size_t max_entries,
+                  IdIndex* index,
+                  atomic_uint* movie_count_ptr,
+                  atomic_uint* next_id_ptr,
+                  atomic_ullong* store_version_ptr);
+
+// Para de acompanhar o log: aplica o que ainda falta e libera o LogTail. Usado no restart sem downtime, quando o
+// processo novo deixa de seguir o antigo e vira o escritor. Retorna -1 se o fim do log não pôde ser lido.
+int replica_stop(void);
+
+// Atraso da réplica: 0 se ela já aplicou tudo o que o líder escreveu, senão o tempo desde que o líder escreveu o
+// último registro aplicado.
+u64 replica_lag_us(void);
+u64 replica_applied_records(void);
+
+#endif // _CABBAGE_REPLICA_H
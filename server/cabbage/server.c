@@ -11,6 +11,11 @@
 // Claro que isso também implica que apenas um servidor por vez, e meu código não lida com isso, então por favor evite executar mais de um servidor com o mesmo arquivo de log.
 //
 // Também estou assumindo um máximo de MAX_ENTRIES filmes, que nesse caso ai é 65536.
+//
+// Versionamento: a store tem um contador global (store_version) que é incrementado em toda mutação, e cada filme guarda
+// a versão da última mutação que o alterou. O incremento é sempre feito com o lock da entrada em mãos, então quem lê a
+// store_version antes de percorrer a tabela tem a garantia de ver (pelo menos) todas as mutações até aquela versão.
+// Isso permite responder S2C_NOT_MODIFIED para clientes que já têm a versão atual em cache.
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,50 +26,259 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <stdatomic.h>
+#include <stdbool.h>
 #include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
 
 #include "MovieEntry.h"
 #include "cabbage/common/Packet.h"
 #include "logger.h"
+#include "history.h"
+#include "snapshot.h"
+#include "checkpoint.h"
+#include "replica.h"
+#include "upgrade.h"
+#include "stats.h"
+#include "metrics.h"
+#include "msglog.h"
+#include "util.h"
+#include "lockprof.h"
+#include "trace.h"
 
 #define DEFAULT_PORT 12345
+// Pode ser alterado na compilação, por exemplo: make EXTRA_CFLAGS=-DMAX_ENTRIES=1048576
+#ifndef MAX_ENTRIES
 #define MAX_ENTRIES 65536
+#endif
 #define MAX_BACKLOG 128
 #define LOG_FILE "cabbage.log"
+#define SNAPSHOT_FILE "cabbage.snap"
+#define HISTORY_CAPACITY 65536
+// Tamanho de cada S2C_MOVIE_CHUNK do export.
+#define EXPORT_CHUNK_BYTES (64 * 1024)
+// Quanto da resposta do GET_MOVIES é montado antes de ser enviado.
+#define GET_MOVIES_FLUSH_BYTES (64 * 1024)
+// O accept acorda periodicamente para ver se o socket foi entregue para um processo novo.
+#define ACCEPT_POLL_TIMEOUT_MS 500
+// Tempo máximo para as requisições em andamento terminarem antes de entregar o log para o processo novo.
+#define UPGRADE_DRAIN_TIMEOUT_S 30
+// Tempo para as conexões terminarem a requisição atual sozinhas, antes de fechar as que estão paradas no recv.
+#define UPGRADE_DRAIN_GRACE_MS 1000
 
 MovieEntry movie_entries[MAX_ENTRIES];
+// Onde o ADD começa a procurar um slot livre, em vez do índice 0: os slots abaixo dele estão ocupados (o REMOVE baixa o
+// valor), então a busca não passa pelo lock de todos os filmes a cada ADD. Um REMOVE concorrente com um ADD pode deixar
+// um slot livre abaixo dele; a busca dá a volta na tabela, então esse slot só é reaproveitado mais tarde.
+// Só o ADD e o REMOVE mexem nos slots enquanto o servidor atende (a réplica, que aplica o log, recusa os ADDs).
+static atomic_int free_slot_hint;
 atomic_uint next_movie_id;
 atomic_uint movie_count;
+atomic_ullong store_version;
+// Réplica de leitura (-R): as mutações são recusadas.
+static int read_only = 0;
+
+// Conexões abertas, para o restart sem downtime poder esperar as requisições em andamento terminarem.
+static pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t clients_cond = PTHREAD_COND_INITIALIZER;
+static int* client_fds = NULL;
+static size_t client_count = 0;
+static size_t client_capacity = 0;
+// Depois do upgrade, cada conexão sai assim que termina a requisição atual.
+static atomic_bool draining;
+
+// No processo novo de um upgrade, as conexões são aceitas antes dele virar o escritor: as leituras são atendidas pela
+// store que acompanha o log do antigo, e as mutações esperam aqui até o log ser aberto.
+static atomic_bool writes_open = true;
+static pthread_mutex_t writes_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writes_cond = PTHREAD_COND_INITIALIZER;
+
+static void wait_for_writes(void) {
+    if (atomic_load(&writes_open)) return;
+    pthread_mutex_lock(&writes_mutex);
+    while (!atomic_load(&writes_open)) {
+        pthread_cond_wait(&writes_cond, &writes_mutex);
+    }
+    pthread_mutex_unlock(&writes_mutex);
+}
+
+static void open_writes(void) {
+    pthread_mutex_lock(&writes_mutex);
+    atomic_store(&writes_open, true);
+    pthread_cond_broadcast(&writes_cond);
+    pthread_mutex_unlock(&writes_mutex);
+}
+
+static int register_client(int client_fd) {
+    pthread_mutex_lock(&clients_mutex);
+    if (client_count == client_capacity) {
+        size_t capacity = client_capacity ? client_capacity * 2 : 64;
+        int* fds = realloc(client_fds, capacity * sizeof(int));
+        if (!fds) {
+            pthread_mutex_unlock(&clients_mutex);
+            return -1;
+        }
+        client_fds = fds;
+        client_capacity = capacity;
+    }
+    client_fds[client_count++] = client_fd;
+    pthread_mutex_unlock(&clients_mutex);
+    return 0;
+}
+
+static void unregister_client(int client_fd) {
+    pthread_mutex_lock(&clients_mutex);
+    for (size_t i = 0; i < client_count; ++i) {
+        if (client_fds[i] == client_fd) {
+            client_fds[i] = client_fds[--client_count];
+            break;
+        }
+    }
+    if (client_count == 0) pthread_cond_broadcast(&clients_cond);
+    pthread_mutex_unlock(&clients_mutex);
+}
+
+// Espera as conexões terminarem a requisição atual. As que continuam paradas no recv depois de 'grace_ms' têm o lado
+// de leitura fechado, então o recv vê o fim da conexão (a resposta de uma requisição já lida ainda é enviada).
+// Espera as threads saírem por até 'timeout_s' segundos e retorna quantas sobraram.
+static size_t drain_clients(unsigned grace_ms, unsigned timeout_s) {
+    atomic_store(&draining, true);
+
+    struct timespec grace, deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    grace = deadline;
+    deadline.tv_sec += timeout_s;
+    grace.tv_sec += grace_ms / 1000;
+    grace.tv_nsec += (long)(grace_ms % 1000) * 1000000;
+    if (grace.tv_nsec >= 1000000000) {
+        grace.tv_sec += 1;
+        grace.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&clients_mutex);
+    while (client_count > 0) {
+        if (pthread_cond_timedwait(&clients_cond, &clients_mutex, &grace) == ETIMEDOUT) break;
+    }
+    for (size_t i = 0; i < client_count; ++i) {
+        shutdown(client_fds[i], SHUT_RD);
+    }
+    while (client_count > 0) {
+        if (pthread_cond_timedwait(&clients_cond, &clients_mutex, &deadline) == ETIMEDOUT) break;
+    }
+    size_t left = client_count;
+    pthread_mutex_unlock(&clients_mutex);
+    return left;
+}
 
 // Apenas um DTO para passar o fd do cliente para a thread.
 typedef struct {
     int client_fd;
 } client_args_t;
 
+// Os filmes carregados do snapshot continuam no arquivo mapeado, por isso snapshot_free em vez de free.
 static void Movie_free(Movie* movie) {
     if (!movie) return;
-    free(movie->title);
-    free(movie->genres);
-    free(movie->director);
-    free(movie->release_year);
-    free(movie);
+    snapshot_free(movie->title);
+    snapshot_free(movie->genres);
+    snapshot_free(movie->director);
+    snapshot_free(movie->release_year);
+    snapshot_free(movie);
 }
 
 static void send_error_packet(int client_fd, const char* error_message) {
-    fprintf(stderr, "Client %d Error: %s\n", client_fd, error_message);
+    stats_record_error();
+    LOG(WARN, "Client %d error: %s", client_fd, error_message);
     S2CPacket response;
     response.type = S2C_ERROR;
     response.data.error.message = strdup(error_message);
     if (!response.data.error.message) {
-        perror("strdup failed for error message");
+        LOG(ERROR, "strdup failed for error message: %s", errmsg());
         return;
     }
     if (S2CPacket_send(client_fd, &response) < 0) {
-        perror("Failed to send error packet");
+        LOG(ERROR, "Failed to send error packet: %s", errmsg());
     }
     S2CPacket_free(&response);
 }
 
+// Gera a versão de uma nova mutação, deve ser chamada com o lock da entrada alterada.
+static u64 bump_store_version(void) {
+    return atomic_fetch_add(&store_version, 1) + 1;
+}
+
+static void send_not_modified_packet(int client_fd, u64 version) {
+    S2CPacket response;
+    response.type = S2C_NOT_MODIFIED;
+    response.data.not_modified.version = version;
+    if (S2CPacket_send(client_fd, &response) < 0) {
+        LOG(ERROR, "Failed to send not modified packet: %s", errmsg());
+    }
+}
+
+// Copia os campos de um filme (com strdup), usada nas respostas que precisam de uma cópia estável.
+static int Movie_copy(Movie* dst, const Movie* src) {
+    *dst = *src;
+    dst->title = strdup(src->title);
+    dst->genres = strdup(src->genres);
+    dst->director = strdup(src->director);
+    dst->release_year = strdup(src->release_year);
+    if (!dst->title || !dst->genres || !dst->director || !dst->release_year) {
+        free(dst->title); free(dst->genres); free(dst->director); free(dst->release_year);
+        memset(dst, 0, sizeof(Movie));
+        return -1;
+    }
+    return 0;
+}
+
+static void Movie_list_free(Movie* movies, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        free(movies[i].title); free(movies[i].genres); free(movies[i].director); free(movies[i].release_year);
+    }
+    free(movies);
+}
+
+// Copia os filmes com versão > min_version, passando pelo lock de cada entrada. Retorna -1 se faltar memória (nada
+// fica alocado nesse caso).
+static int collect_changes(u64 min_version, Movie** movies, u32* count) {
+    u32 capacity = atomic_load(&movie_count);
+    u32 list_count = 0;
+    Movie* list_buffer = NULL;
+    for (int i = 0; i < MAX_ENTRIES; ++i) {
+        if (MovieEntry_lock(&movie_entries[i]) != 0) continue;
+        if (movie_entries[i].movie && movie_entries[i].movie->version > min_version) {
+            // A quantidade de filmes pode crescer durante a varredura, então o buffer cresce sob demanda.
+            if (list_count == capacity || !list_buffer) {
+                u32 new_capacity = capacity > list_count ? capacity : (list_count + 1) * 2;
+                Movie* new_buffer = realloc(list_buffer, new_capacity * sizeof(Movie));
+                if (!new_buffer) {
+                    MovieEntry_unlock(&movie_entries[i]);
+                    Movie_list_free(list_buffer, list_count);
+                    return -1;
+                }
+                list_buffer = new_buffer;
+                capacity = new_capacity;
+            }
+            if (Movie_copy(&list_buffer[list_count], movie_entries[i].movie) != 0) {
+                MovieEntry_unlock(&movie_entries[i]);
+                Movie_list_free(list_buffer, list_count);
+                return -1;
+            }
+            list_count++;
+        }
+        MovieEntry_unlock(&movie_entries[i]);
+    }
+    *movies = list_buffer;
+    *count = list_count;
+    return 0;
+}
+
+static int compare_u32(const void* a, const void* b) {
+    u32 x = *(const u32*)a;
+    u32 y = *(const u32*)b;
+    return (x > y) - (x < y);
+}
+
 static int genre_exists(const char* genres, const char* genre) {
     if (!genres || !genre) return 0;
     size_t len = strlen(genre);
@@ -80,21 +294,43 @@ static int genre_exists(const char* genres, const char* genre) {
     return 0;
 }
 
+static int is_write_request(u8 type) {
+    return type == C2S_ADD_MOVIE || type == C2S_ADD_GENRE_TO_MOVIE || type == C2S_REMOVE_MOVIE;
+}
+
 // Função de handle da Thread.
 void* handle_client(void* arg) {
     client_args_t* args = (client_args_t*)arg;
     int client_fd = args->client_fd;
     free(args);
 
-    printf("Client %d connected.\n", client_fd);
+    LOG(INFO, "Client %d connected", client_fd);
+    stats_connection_opened();
+    stats_thread_begin();
+    trace_thread_begin(client_fd);
 
     C2SPacket request;
     S2CPacket response;
 
-    while (C2SPacket_recv(client_fd, &request) >= 0) {
+    while (!atomic_load(&draining) && C2SPacket_recv(client_fd, &request) >= 0) {
+        // A latência é medida do fim do recv ao fim do send da resposta.
+        u64 request_start = stats_now_ns();
+        lockprof_set_site(request.type);
+        trace_request_begin(request.type, request_start);
         memset(&response, 0, sizeof(S2CPacket));
         int requires_lock = 1;
         int answered;
+        log_ticket_t ticket = 0;
+        int logged = 0; // retorno do log_* da mutação: se o registro nem entrou na fila, o ticket fica 0
+
+        if (read_only && is_write_request(request.type)) {
+            send_error_packet(client_fd, "Read-only replica: send writes to the leader");
+            trace_request_end();
+            stats_record_request(request.type, stats_now_ns() - request_start);
+            C2SPacket_free(&request);
+            continue;
+        }
+        if (is_write_request(request.type)) wait_for_writes();
 
         // Como eu disse, cada operação é feita usando lock/unlock. Um número atômico é usado para contar o número de filmes, e outro para o próximo ID disponível.
         // A ideia é que uma transação reserva um id antes de fazer a operação.
@@ -102,20 +338,21 @@ void* handle_client(void* arg) {
         case C2S_ADD_MOVIE:
             if (atomic_load(&movie_count) >= MAX_ENTRIES) {
                 send_error_packet(client_fd, "Maximum number of movies reached");
-                C2SPacket_free(&request);
-                continue;
+                break;
             }
 
             u32 new_id = atomic_fetch_add(&next_movie_id, 1);
             int movie_idx = -1;
+            int first_free = atomic_load(&free_slot_hint);
 
-            for (int i = 0; i < MAX_ENTRIES; ++i) {
+            for (int n = 0; n < MAX_ENTRIES; ++n) {
+                int i = (first_free + n) % MAX_ENTRIES;
                 if (MovieEntry_lock(&movie_entries[i]) != 0) continue;
                 if (movie_entries[i].movie == NULL) {
                     Movie* new_movie = malloc(sizeof(Movie));
                     if (!new_movie) {
                         MovieEntry_unlock(&movie_entries[i]);
-                        perror("malloc failed for new Movie");
+                        LOG(ERROR, "malloc failed for new Movie: %s", errmsg());
                         send_error_packet(client_fd, "Internal server error: allocation failed");
                         movie_idx = -2; // um placeholder para indicar erro
                         break;
@@ -131,7 +368,7 @@ void* handle_client(void* arg) {
                     if (!new_movie->title || !new_movie->genres || !new_movie->director || !new_movie->release_year) {
                         Movie_free(new_movie);
                         MovieEntry_unlock(&movie_entries[i]);
-                        perror("strdup failed for movie data");
+                        LOG(ERROR, "strdup failed for movie data: %s", errmsg());
                         send_error_packet(client_fd, "Internal server error: allocation failed");
                         movie_idx = -2; // um placeholder para indicar erro
                         break;
@@ -139,25 +376,40 @@ void* handle_client(void* arg) {
 
                     movie_entries[i].movie = new_movie;
                     atomic_fetch_add(&movie_count, 1);
+                    // Se um REMOVE baixou o limite enquanto isso, o CAS falha e o valor menor (que continua certo) fica.
+                    if (i >= first_free) atomic_compare_exchange_strong(&free_slot_hint, &first_free, i + 1);
+                    new_movie->version = bump_store_version();
                     movie_idx = i;
-                    printf("Server: Added movie '%s' (ID: %u) at index %d\n", new_movie->title, new_id, i);
-                    log_add_movie(new_movie);
+                    logged = log_add_movie(new_movie, &ticket);
+                    // A cópia da resposta é feita ainda com o lock, o filme pode ser removido logo depois do unlock.
+                    response.type = S2C_MOVIE;
+                    if (Movie_copy(&response.data.movie, new_movie) != 0) {
+                        response.type = S2C_UNKNOWN;
+                    }
                     MovieEntry_unlock(&movie_entries[i]);
                     break;
                 }
                 MovieEntry_unlock(&movie_entries[i]);
             }
 
-            // Envia o filme de volta nas operações que precisam dele.
+            trace_mark(TRACE_LOOKUP);
+
+            // Envia o filme de volta nas operações que precisam dele, depois do registro estar durável.
             if (movie_idx >= 0) {
-                response.type = S2C_MOVIE;
-                response.data.movie = *movie_entries[movie_idx].movie;
-                response.data.movie.title = strdup(movie_entries[movie_idx].movie->title);
-                response.data.movie.genres = strdup(movie_entries[movie_idx].movie->genres);
-                response.data.movie.director = strdup(movie_entries[movie_idx].movie->director);
-                response.data.movie.release_year = strdup(movie_entries[movie_idx].movie->release_year);
+                // As mensagens são escritas fora do lock da entrada, com os dados da requisição.
+                LOG(INFO, "Added movie '%s' (ID: %u) at index %d", request.data.add_movie.title, new_id, movie_idx);
+                if (logged < 0 || log_wait(ticket) < 0) {
+                    S2CPacket_free(&response);
+                    send_error_packet(client_fd, "Internal server error: log write failed");
+                    break;
+                }
+                trace_mark(TRACE_LOG);
+                if (response.type != S2C_MOVIE) {
+                    send_error_packet(client_fd, "Internal server error: allocation failed");
+                    break;
+                }
                 if (S2CPacket_send(client_fd, &response) < 0) {
-                    perror("Failed to send add movie confirmation");
+                    LOG(ERROR, "Failed to send add movie confirmation: %s", errmsg());
                 }
                 S2CPacket_free(&response);
             } else if (movie_idx == -1) {
@@ -188,12 +440,12 @@ void* handle_client(void* arg) {
                     size_t old_len = old_genres ? strlen(old_genres) : 0;
                     size_t add_len = strlen(request.data.add_genre.genre);
                     size_t new_len = old_len + (old_len > 0 ? 1 : 0) + add_len + 1; // +1 for comma, +1 for null
-                    char* new_genres = (char*)realloc(old_genres, new_len);
+                    char* new_genres = snapshot_realloc_string(old_genres, new_len);
 
                     if (!new_genres) {
                         movie_entries[i].movie->genres = old_genres; // Volta o ponteiro se falhar
                         MovieEntry_unlock(&movie_entries[i]);
-                        perror("realloc failed for genres");
+                        LOG(ERROR, "realloc failed for genres: %s", errmsg());
                         send_error_packet(client_fd, "Internal server error: allocation failed");
                         answered = 1;
                         break;
@@ -206,16 +458,23 @@ void* handle_client(void* arg) {
                     }
                     strcat(new_genres, request.data.add_genre.genre);
                     movie_entries[i].movie->genres = new_genres;
-                    printf("Server: Added genre '%s' to movie ID %u\n", request.data.add_genre.genre, request.data.add_genre.movie_id);
-                    log_add_genre(movie_entries[i].movie->id, request.data.add_genre.genre);
+                    movie_entries[i].movie->version = bump_store_version();
+                    logged = log_add_genre(movie_entries[i].movie->id, request.data.add_genre.genre, movie_entries[i].movie->version, &ticket);
 
                     MovieEntry_unlock(&movie_entries[i]);
+                    LOG(INFO, "Added genre '%s' to movie ID %u", request.data.add_genre.genre, request.data.add_genre.movie_id);
+                    trace_mark(TRACE_LOOKUP);
+                    answered = 1;
+                    if (logged < 0 || log_wait(ticket) < 0) {
+                        send_error_packet(client_fd, "Internal server error: log write failed");
+                        break;
+                    }
+                    trace_mark(TRACE_LOG);
                     response.type = S2C_OK;
 
                     if (S2CPacket_send(client_fd, &response) < 0) {
-                        perror("Failed to send add genre confirmation");
+                        LOG(ERROR, "Failed to send add genre confirmation: %s", errmsg());
                     }
-                    answered = 1;
                     break;
                 }
                 MovieEntry_unlock(&movie_entries[i]);
@@ -231,19 +490,28 @@ void* handle_client(void* arg) {
             for (int i = 0; i < MAX_ENTRIES; ++i) {
                 if (MovieEntry_lock(&movie_entries[i]) != 0) continue;
                 if (movie_entries[i].movie && movie_entries[i].movie->id == request.data.remove_movie.movie_id) {
-                    printf("Server: Removing movie '%s' (ID: %u) from index %d\n", movie_entries[i].movie->title, movie_entries[i].movie->id, i);
                     Movie_free(movie_entries[i].movie);
                     movie_entries[i].movie = NULL;
                     atomic_fetch_sub(&movie_count, 1);
-                    log_remove_movie(request.data.remove_movie.movie_id);
+                    int hint = atomic_load(&free_slot_hint);
+                    while (i < hint && !atomic_compare_exchange_weak(&free_slot_hint, &hint, i)) {}
+                    u64 removal_version = bump_store_version();
+                    history_record_removal(request.data.remove_movie.movie_id, removal_version);
+                    logged = log_remove_movie(request.data.remove_movie.movie_id, removal_version, &ticket);
                     MovieEntry_unlock(&movie_entries[i]);
+                    LOG(INFO, "Removed movie ID %u from index %d", request.data.remove_movie.movie_id, i);
+                    trace_mark(TRACE_LOOKUP);
 
+                    answered = 1;
+                    if (logged < 0 || log_wait(ticket) < 0) {
+                        send_error_packet(client_fd, "Internal server error: log write failed");
+                        break;
+                    }
+                    trace_mark(TRACE_LOG);
                     response.type = S2C_OK;
                     if (S2CPacket_send(client_fd, &response) < 0) {
-                        perror("Failed to send remove movie confirmation");
+                        LOG(ERROR, "Failed to send remove movie confirmation: %s", errmsg());
                     }
-
-                    answered = 1;
                     break;
                 }
                 MovieEntry_unlock(&movie_entries[i]);
@@ -256,9 +524,18 @@ void* handle_client(void* arg) {
         case C2S_LIST_MOVIES:
         case C2S_LIST_MOVIES_DETAILED: 
             { // tive que colocar um scope aqui, o switch do C é mt triste de lidar :(, odeio fallthrough
+                // A versão precisa ser lida antes do movie_count e da varredura, senão podemos anunciar uma versão
+                // mais nova que o conteúdo da lista.
+                u64 current_version = atomic_load(&store_version);
+                if (request.data.list.if_version != 0 && request.data.list.if_version == current_version) {
+                    send_not_modified_packet(client_fd, current_version);
+                    break;
+                }
+
                 u32 current_movie_count = atomic_load(&movie_count);
                 if (current_movie_count == 0) {
                     response.type = (request.type == C2S_LIST_MOVIES) ? S2C_MOVIE_LIST : S2C_MOVIE_LIST_DETAILED;
+                    response.data.movie_list.version = current_version;
                     response.data.movie_list.count = 0;
                     response.data.movie_list.movies = NULL;
                 } else {
@@ -267,7 +544,7 @@ void* handle_client(void* arg) {
                     list_buffer = malloc(current_movie_count * element_size);
 
                     if (!list_buffer) {
-                        perror("malloc failed for movie list");
+                        LOG(ERROR, "malloc failed for movie list: %s", errmsg());
                         send_error_packet(client_fd, "Internal server error: allocation failed");
                         break;
                     }
@@ -288,6 +565,7 @@ void* handle_client(void* arg) {
                             } else { // DETAILED
                                 Movie* entry = &((Movie*)list_buffer)[list_count];
                                 entry->id = movie_entries[i].movie->id;
+                                entry->version = movie_entries[i].movie->version;
                                 entry->title = strdup(movie_entries[i].movie->title);
                                 entry->genres = strdup(movie_entries[i].movie->genres);
                                 entry->director = strdup(movie_entries[i].movie->director);
@@ -303,6 +581,7 @@ void* handle_client(void* arg) {
                         MovieEntry_unlock(&movie_entries[i]);
                     }
 
+                    trace_mark(TRACE_LOOKUP);
                     if (list_count == (u32)-1) {
                         u32 actual_count = 0;
                         for (int i = 0; i < MAX_ENTRIES && actual_count < current_movie_count; ++i) {
@@ -320,23 +599,25 @@ void* handle_client(void* arg) {
                         }
 
                         free(list_buffer);
-                        perror("strdup failed during list creation");
+                        LOG(ERROR, "strdup failed during list creation: %s", errmsg());
                         send_error_packet(client_fd, "Internal server error: allocation failed");
                         break;
                     }
 
                     response.type = (request.type == C2S_LIST_MOVIES) ? S2C_MOVIE_LIST : S2C_MOVIE_LIST_DETAILED;
                     if (request.type == C2S_LIST_MOVIES) {
+                        response.data.movie_list.version = current_version;
                         response.data.movie_list.count = list_count;
                         response.data.movie_list.movies = (S2C_MovieIdTitle*)list_buffer;
                     } else {
+                        response.data.movie_list_detailed.version = current_version;
                         response.data.movie_list_detailed.count = list_count;
                         response.data.movie_list_detailed.movies = (Movie*)list_buffer;
                     }
                 }
 
                 if (S2CPacket_send(client_fd, &response) < 0) {
-                    perror("Failed to send movie list");
+                    LOG(ERROR, "Failed to send movie list: %s", errmsg());
                 }
                 S2CPacket_free(&response);
             }
@@ -347,6 +628,14 @@ void* handle_client(void* arg) {
             for (int i = 0; i < MAX_ENTRIES; ++i) {
                 if (MovieEntry_lock(&movie_entries[i]) != 0) continue;
                 if (movie_entries[i].movie && movie_entries[i].movie->id == request.data.get_movie.movie_id) {
+                    u64 movie_version = movie_entries[i].movie->version;
+                    if (request.data.get_movie.if_version != 0 && request.data.get_movie.if_version == movie_version) {
+                        MovieEntry_unlock(&movie_entries[i]);
+                        send_not_modified_packet(client_fd, movie_version);
+                        answered = 1;
+                        break;
+                    }
+
                     response.type = S2C_MOVIE;
                     response.data.movie = *movie_entries[i].movie;
                     response.data.movie.title = strdup(movie_entries[i].movie->title);
@@ -357,15 +646,16 @@ void* handle_client(void* arg) {
                     if (!response.data.movie.title || !response.data.movie.genres || !response.data.movie.director || !response.data.movie.release_year) {
                         S2CPacket_free(&response);
                         MovieEntry_unlock(&movie_entries[i]);
-                        perror("strdup failed for get movie");
+                        LOG(ERROR, "strdup failed for get movie: %s", errmsg());
                         send_error_packet(client_fd, "Internal server error: allocation failed");
                         answered = 1;
                         break;
                     }
 
                     MovieEntry_unlock(&movie_entries[i]);
+                    trace_mark(TRACE_LOOKUP);
                     if (S2CPacket_send(client_fd, &response) < 0) {
-                        perror("Failed to send get movie response");
+                        LOG(ERROR, "Failed to send get movie response: %s", errmsg());
                     }
                     S2CPacket_free(&response);
                     answered = 1;
@@ -380,9 +670,17 @@ void* handle_client(void* arg) {
 
         case C2S_LIST_MOVIES_BY_GENRE:
             {
+                // O filtro por gênero não tem versão própria, então usamos a versão da store inteira.
+                u64 current_version = atomic_load(&store_version);
+                if (request.data.list_by_genre.if_version != 0 && request.data.list_by_genre.if_version == current_version) {
+                    send_not_modified_packet(client_fd, current_version);
+                    break;
+                }
+
                 u32 current_movie_count = atomic_load(&movie_count);
                 if (current_movie_count == 0) {
                     response.type = S2C_MOVIE_LIST;
+                    response.data.movie_list.version = current_version;
                     response.data.movie_list.count = 0;
                     response.data.movie_list.movies = NULL;
                 } else {
@@ -399,7 +697,7 @@ void* handle_client(void* arg) {
                     S2C_MovieIdTitle* list_buffer = (S2C_MovieIdTitle*)malloc(current_movie_count * sizeof(S2C_MovieIdTitle));
 
                     if (!list_buffer) {
-                        perror("malloc failed for genre list");
+                        LOG(ERROR, "malloc failed for genre list: %s", errmsg());
                         send_error_packet(client_fd, "Internal server error: allocation failed");
                         break;
                     }
@@ -418,6 +716,7 @@ void* handle_client(void* arg) {
                     }
 
                     // um hackzinho pra detectar erro. o (u32)-1 é um valor inválido.
+                    trace_mark(TRACE_LOOKUP);
                     if (list_count == (u32)-1) {
                         u32 actual_count = 0;
                         for (int i = 0; i < MAX_ENTRIES && actual_count < current_movie_count; ++i) {
@@ -428,48 +727,449 @@ void* handle_client(void* arg) {
                             }
                         }
                         free(list_buffer);
-                        perror("strdup failed during genre list creation");
+                        LOG(ERROR, "strdup failed during genre list creation: %s", errmsg());
                         send_error_packet(client_fd, "Internal server error: allocation failed");
                         break;
                     }
 
                     response.type = S2C_MOVIE_LIST;
+                    response.data.movie_list.version = current_version;
                     response.data.movie_list.count = list_count;
                     response.data.movie_list.movies = list_buffer;
                 }
 
                 if (S2CPacket_send(client_fd, &response) < 0) {
-                    perror("Failed to send movie list by genre");
+                    LOG(ERROR, "Failed to send movie list by genre: %s", errmsg());
                 }
                 S2CPacket_free(&response);
             }
             break;
+        case C2S_LIST_CHANGES_SINCE:
+            {
+                // Mesma regra das listagens: a versão é lida antes de qualquer coisa.
+                u64 current_version = atomic_load(&store_version);
+                u64 since = request.data.list_changes.since_version;
+
+                if (since != 0 && since == current_version) {
+                    send_not_modified_packet(client_fd, current_version);
+                    break;
+                }
+
+                response.type = S2C_MOVIE_CHANGES;
+                response.data.movie_changes.version = current_version;
+
+                // As tombstones são lidas depois da varredura: uma remoção incrementa a versão da store antes de
+                // registrar a tombstone (as duas coisas com o lock da entrada), então lendo antes poderíamos perder uma
+                // remoção com versão <= current_version. A varredura passa pelo lock de todas as entradas, então no fim
+                // dela toda remoção até current_version já está no histórico.
+                // since == 0 (cliente sem estado) ou uma versão "do futuro" (de outra execução) caem na listagem completa.
+                int partial = since != 0 && since < current_version;
+                u32 list_count = 0;
+                Movie* list_buffer = NULL;
+                int failed = collect_changes(partial ? since : 0, &list_buffer, &list_count) != 0;
+                int removals = 1;
+                if (!failed && partial) {
+                    removals = history_removals_since(since, &response.data.movie_changes.removed_ids,
+                                                      &response.data.movie_changes.removed_count);
+                    if (removals < 0) {
+                        failed = 1;
+                    } else if (removals == 1) {
+                        // O histórico não cobre mais 'since': refaz a varredura com todos os filmes.
+                        Movie_list_free(list_buffer, list_count);
+                        list_buffer = NULL;
+                        list_count = 0;
+                        failed = collect_changes(0, &list_buffer, &list_count) != 0;
+                    }
+                }
+                response.data.movie_changes.full = (removals == 1);
+
+                trace_mark(TRACE_LOOKUP);
+                response.data.movie_changes.count = list_count;
+                response.data.movie_changes.movies = list_buffer;
+
+                if (failed) {
+                    LOG(ERROR, "allocation failed during changes list creation: %s", errmsg());
+                    S2CPacket_free(&response);
+                    send_error_packet(client_fd, "Internal server error: allocation failed");
+                    break;
+                }
+
+                if (S2CPacket_send(client_fd, &response) < 0) {
+                    LOG(ERROR, "Failed to send changes list: %s", errmsg());
+                }
+                S2CPacket_free(&response);
+            }
+            break;
+
+        case C2S_EXPORT:
+            {
+                // Os filmes são serializados direto da tabela, com o lock de cada entrada, e cada chunk é enviado
+                // fora do lock assim que enche: a memória do export é a de um chunk, qualquer que seja o catálogo.
+                u64 current_version = atomic_load(&store_version);
+                MovieChunk chunk;
+                MovieChunk_init(&chunk);
+                u64 exported = 0;
+                int failed = 0;
+                for (int i = 0; i < MAX_ENTRIES && !failed; ++i) {
+                    if (MovieEntry_lock(&movie_entries[i]) != 0) continue;
+                    if (movie_entries[i].movie) {
+                        if (MovieChunk_add(&chunk, movie_entries[i].movie) == 0) exported++;
+                        else failed = 1;
+                    }
+                    MovieEntry_unlock(&movie_entries[i]);
+                    if (!failed && chunk.length >= EXPORT_CHUNK_BYTES && MovieChunk_send(client_fd, &chunk) < 0) {
+                        failed = 2;
+                    }
+                }
+                if (!failed && MovieChunk_send(client_fd, &chunk) < 0) failed = 2;
+                MovieChunk_free(&chunk);
+                trace_mark(TRACE_LOOKUP);
+
+                if (failed == 1) {
+                    LOG(ERROR, "Allocation failed during export: %s", errmsg());
+                    send_error_packet(client_fd, "Internal server error: allocation failed");
+                    break;
+                }
+                if (failed == 2) {
+                    LOG(ERROR, "Failed to send export chunk: %s", errmsg());
+                    break;
+                }
+                response.type = S2C_EXPORT_END;
+                response.data.export_end.version = current_version;
+                response.data.export_end.count = exported;
+                if (S2CPacket_send(client_fd, &response) < 0) {
+                    LOG(ERROR, "Failed to send export end: %s", errmsg());
+                }
+                LOG(INFO, "Exported %llu movies to client %d", (unsigned long long)exported, client_fd);
+            }
+            break;
+
+        case C2S_GET_MOVIES:
+            {
+                // Em vez de uma busca na tabela por ID, os IDs são ordenados (e os repetidos tirados) e a tabela é
+                // percorrida uma vez só, procurando o ID de cada filme com busca binária. A busca para quando todos
+                // foram encontrados. Como no export, os filmes são serializados direto da entrada, com o lock dela,
+                // e a resposta é enviada em partes fora do lock.
+                u32* ids = request.data.get_movies.movie_ids;
+                u32 count = 0;
+                if (request.data.get_movies.count > 0) {
+                    qsort(ids, request.data.get_movies.count, sizeof(u32), compare_u32);
+                    count = 1;
+                    for (u32 j = 1; j < request.data.get_movies.count; ++j) {
+                        if (ids[j] != ids[count - 1]) ids[count++] = ids[j];
+                    }
+                }
+
+                u8* found = calloc(count ? count : 1, sizeof(u8));
+                MoviesReply reply;
+                if (!found || MoviesReply_begin(&reply, count) != 0) {
+                    free(found);
+                    LOG(ERROR, "Allocation failed for get movies: %s", errmsg());
+                    send_error_packet(client_fd, "Internal server error: allocation failed");
+                    break;
+                }
+
+                u32 found_count = 0;
+                int sent = 0;   // parte da resposta já saiu, então um erro não pode mais virar um S2C_ERROR
+                int failed = 0;
+                for (int i = 0; i < MAX_ENTRIES && found_count < count && !failed; ++i) {
+                    if (MovieEntry_lock(&movie_entries[i]) != 0) continue;
+                    const Movie* movie = movie_entries[i].movie;
+                    if (movie && movie->id >= ids[0] && movie->id <= ids[count - 1]) {
+                        u32* match = bsearch(&movie->id, ids, count, sizeof(u32), compare_u32);
+                        if (match && !found[match - ids]) {
+                            if (MoviesReply_add_movie(&reply, movie) == 0) {
+                                found[match - ids] = 1;
+                                found_count++;
+                            } else {
+                                failed = 1;
+                            }
+                        }
+                    }
+                    MovieEntry_unlock(&movie_entries[i]);
+                    if (!failed && reply.length >= GET_MOVIES_FLUSH_BYTES) {
+                        if (MoviesReply_flush(client_fd, &reply) < 0) failed = 2;
+                        sent = 1;
+                    }
+                }
+                trace_mark(TRACE_LOOKUP);
+                for (u32 j = 0; j < count && !failed; ++j) {
+                    if (!found[j] && MoviesReply_add_missing(&reply, ids[j]) != 0) failed = 1;
+                }
+                if (!failed && MoviesReply_flush(client_fd, &reply) < 0) failed = 2;
+                MoviesReply_free(&reply);
+                free(found);
+
+                if (failed == 1) {
+                    LOG(ERROR, "Allocation failed for get movies: %s", errmsg());
+                    if (!sent) {
+                        send_error_packet(client_fd, "Internal server error: allocation failed");
+                    } else {
+                        // A resposta ficou pela metade e o cliente não teria como se recuperar: fecha a conexão.
+                        shutdown(client_fd, SHUT_RDWR);
+                    }
+                } else if (failed == 2) {
+                    LOG(ERROR, "Failed to send get movies response: %s", errmsg());
+                }
+            }
+            break;
+
+        case C2S_STATS:
+            if (stats_fill_packet(&response) < 0) {
+                send_error_packet(client_fd, "Internal server error: allocation failed");
+                break;
+            }
+            if (S2CPacket_send(client_fd, &response) < 0) {
+                LOG(ERROR, "Failed to send stats: %s", errmsg());
+            }
+            S2CPacket_free(&response);
+            break;
+
         default:
             send_error_packet(client_fd, "Unknown C2S packet type received");
             break;
         }
+        trace_request_end();
+        stats_record_request(request.type, stats_now_ns() - request_start);
         C2SPacket_free(&request);
     }
 
     if (errno != 0 && errno != ECONNRESET) {
-        perror("C2SPacket_recv error");
+        LOG(ERROR, "C2SPacket_recv error: %s", errmsg());
     }
 
-    printf("Client %d disconnected.\n", client_fd);
+    LOG(INFO, "Client %d disconnected", client_fd);
+    trace_thread_end();
+    stats_thread_end();
+    stats_connection_closed();
+    unregister_client(client_fd);
     close(client_fd);
     return NULL;
 }
 
+static void print_server_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [options] [port]\n", program);
+    fprintf(stderr, "  -d none|batch|interval  log durability (default: none)\n");
+    fprintf(stderr, "  -i <ms>                 fsync interval for '-d interval' (default: 1000)\n");
+    fprintf(stderr, "  -R <dir>                read replica of the leader whose files are in <dir>\n");
+    fprintf(stderr, "  -S <bytes>              log segment size (default: 64M)\n");
+    fprintf(stderr, "  -c <seconds>            checkpoint interval, 0 disables (default: 300)\n");
+    fprintf(stderr, "  -C <bytes>              checkpoint when the log reaches this size, 0 disables (default: 64M)\n");
+    fprintf(stderr, "  -u <path>               accept zero-downtime upgrades on the Unix socket <path>\n");
+    fprintf(stderr, "  -T <path>               take over from the server listening for upgrades on <path>\n");
+    fprintf(stderr, "  -m <port>               serve Prometheus metrics over HTTP on <port>\n");
+    fprintf(stderr, "  -l <level>              message level: debug|info|warn|error (default: info)\n");
+    fprintf(stderr, "  -r <count>              messages per second per call site, 0 disables (default: 100)\n");
+    fprintf(stderr, "  -L                      profile entry locks (report in stats and at shutdown)\n");
+    fprintf(stderr, "  -t <us>                 trace request phases, logging requests slower than <us> (0: only trace)\n");
+}
+
+// Com o perfil de locks ligado, SIGINT/SIGTERM param o servidor pelo loop de accept para o relatório ser impresso.
+static atomic_bool stop_requested;
+static void stop_handler(int sig) {
+    (void)sig;
+    atomic_store(&stop_requested, true);
+}
+
+// SIGUSR1 deixa as mensagens mais detalhadas e SIGUSR2 menos, sem reiniciar o servidor.
+static void change_level_handler(int sig) {
+    int level = atomic_load(&msglog_current_level);
+    if (sig == SIGUSR1 && level > MSGLOG_DEBUG) level--;
+    if (sig == SIGUSR2 && level < MSGLOG_ERROR) level++;
+    atomic_store(&msglog_current_level, level);
+}
+
+static u64 movie_count_gauge(void) {
+    return atomic_load(&movie_count);
+}
+
+static u64 store_version_gauge(void) {
+    return atomic_load(&store_version);
+}
+
+static u64 capacity_gauge(void) {
+    return MAX_ENTRIES;
+}
+
+static u64 restore_duration_us;
+static u64 restore_duration_gauge(void) {
+    return restore_duration_us;
+}
+
+static u64 log_queue_depth_gauge(void) {
+    return log_queue_depth();
+}
+
+static u64 log_pending_bytes_gauge(void) {
+    return log_size();
+}
+
+// O log guarda a versão de cada mutação, mas registros que não chegaram ao disco (durabilidade 'none' e queda
+// de energia) poderiam ter versões reutilizadas. Por isso a versão de boot também é limitada inferiormente pelo
+// horário: as versões de uma execução são sempre maiores que as da anterior, e um cliente com cache antigo nunca
+// recebe um NOT_MODIFIED indevido depois de um restart. Filmes vindos de um log em texto (sem versão) recebem
+// a versão de boot. A réplica usa as versões do líder, sem o piso.
+// Com 'serving', as conexões já estão sendo atendidas (upgrade), então cada entrada é alterada com o lock dela.
+static void apply_boot_version_floor(int serving) {
+    u64 boot_version = (u64)time(NULL) << 32;
+    if (atomic_load(&store_version) < boot_version) {
+        atomic_store(&store_version, boot_version);
+    }
+    for (int i = 0; i < MAX_ENTRIES; ++i) {
+        if (serving && MovieEntry_lock(&movie_entries[i]) != 0) continue;
+        // Os filmes do snapshot sempre têm versão; pular eles evita tocar nas páginas do arquivo mapeado.
+        if (movie_entries[i].movie && !snapshot_owns(movie_entries[i].movie) && movie_entries[i].movie->version == 0) {
+            movie_entries[i].movie->version = atomic_load(&store_version);
+        }
+        if (serving) MovieEntry_unlock(&movie_entries[i]);
+    }
+}
+
+// O que o processo precisa para virar o escritor: o log e a thread de checkpoint.
+typedef struct {
+    log_durability_t durability;
+    unsigned sync_interval_ms;
+    size_t segment_size;
+    unsigned checkpoint_interval;
+    size_t checkpoint_log_size;
+} writer_config_t;
+
+static int start_writer(const writer_config_t* config) {
+    if (log_init(LOG_FILE, config->durability, config->sync_interval_ms, config->segment_size) < 0) {
+        fprintf(stderr, "Failed to initialize log file\n");
+        return -1;
+    }
+
+    checkpoint_config_t checkpoint = {
+        .snapshot_filename = SNAPSHOT_FILE,
+        .entries = movie_entries,
+        .max_entries = MAX_ENTRIES,
+        .next_id_ptr = &next_movie_id,
+        .store_version_ptr = &store_version,
+        .interval_seconds = config->checkpoint_interval,
+        .log_size_threshold = config->checkpoint_log_size,
+    };
+    if (checkpoint_start(&checkpoint) < 0) {
+        fprintf(stderr, "Failed to start checkpoint thread\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Fim do upgrade no processo novo, rodando enquanto as conexões já são aceitas: espera o antigo fechar o log, aplica
+// o fim dele e vira o escritor. Sem isso não há como continuar, então um erro aqui termina o processo.
+static void* takeover_main(void* arg) {
+    const writer_config_t* config = arg;
+    if (upgrade_wait_done() < 0) {
+        fprintf(stderr, "Upgrade: the old process exited without finishing, continuing from its log\n");
+    }
+    if (replica_stop() < 0) {
+        fprintf(stderr, "Upgrade: failed to read the end of the log\n");
+        exit(EXIT_FAILURE);
+    }
+    log_restore_set_read_only(0);
+    apply_boot_version_floor(1);
+    if (start_writer(config) < 0) exit(EXIT_FAILURE);
+    open_writes();
+    printf("Upgrade: took over with %u movies\n", atomic_load(&movie_count));
+    fflush(stdout);
+    return NULL;
+}
+
 int main(int argc, char* argv[]) {
     int server_fd;
     struct sockaddr_in address;
     int opt = 1;
 
     int server_port = DEFAULT_PORT;
+    log_durability_t durability = LOG_DURABILITY_NONE;
+    unsigned sync_interval_ms = 1000;
+    unsigned checkpoint_interval = 300;
+    size_t checkpoint_log_size = 64u << 20;
+    size_t segment_size = LOG_DEFAULT_SEGMENT_SIZE;
+    const char* leader_dir = NULL;
+    const char* upgrade_path = NULL;
+    const char* takeover_path = NULL;
+    int metrics_port = 0;
+    msglog_level_t level = MSGLOG_INFO;
+    int lock_profile = 0;
+    long long slow_request_us = -1;
+
+    int c;
+    while ((c = getopt(argc, argv, "d:i:S:c:C:R:u:T:m:l:r:Lt:h")) != -1) {
+        switch (c) {
+        case 'd':
+            if (strcmp(optarg, "none") == 0) durability = LOG_DURABILITY_NONE;
+            else if (strcmp(optarg, "batch") == 0) durability = LOG_DURABILITY_BATCH;
+            else if (strcmp(optarg, "interval") == 0) durability = LOG_DURABILITY_INTERVAL;
+            else {
+                fprintf(stderr, "Invalid durability mode: %s\n", optarg);
+                print_server_usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'i':
+            sync_interval_ms = (unsigned)strtoul(optarg, NULL, 10);
+            break;
+        case 'R':
+            leader_dir = optarg;
+            break;
+        case 'S':
+            segment_size = (size_t)strtoull(optarg, NULL, 10);
+            break;
+        case 'c':
+            checkpoint_interval = (unsigned)strtoul(optarg, NULL, 10);
+            break;
+        case 'C':
+            checkpoint_log_size = (size_t)strtoull(optarg, NULL, 10);
+            break;
+        case 'u':
+            upgrade_path = optarg;
+            break;
+        case 'T':
+            takeover_path = optarg;
+            break;
+        case 'm':
+            metrics_port = atoi(optarg);
+            break;
+        case 'l':
+            if (msglog_parse_level(optarg, &level) < 0) {
+                fprintf(stderr, "Invalid message level: %s\n", optarg);
+                print_server_usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'r':
+            msglog_set_rate_limit((unsigned)strtoul(optarg, NULL, 10));
+            break;
+        case 'L':
+            lock_profile = 1;
+            break;
+        case 't':
+            slow_request_us = strtoll(optarg, NULL, 10);
+            break;
+        default:
+            print_server_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind < argc) {
+        server_port = atoi(argv[optind]);
+    }
+    if (leader_dir && (upgrade_path || takeover_path)) {
+        fprintf(stderr, "Upgrades (-u/-T) are only supported on the leader\n");
+        return 1;
+    }
 
-    if (argc >= 2) {
-        server_port = atoi(argv[1]);
+    msglog_set_level(level);
+    if (msglog_init() < 0) {
+        return 1;
     }
+    struct sigaction level_action = {.sa_handler = change_level_handler, .sa_flags = SA_RESTART};
+    sigemptyset(&level_action.sa_mask);
+    sigaction(SIGUSR1, &level_action, NULL);
+    sigaction(SIGUSR2, &level_action, NULL);
 
     printf("Initializing server...\n");
 
@@ -481,8 +1181,52 @@ int main(int argc, char* argv[]) {
         }
     }
     printf("Initialized %d movie entry slots.\n", MAX_ENTRIES);
+    if (lock_profile) {
+        lockprof_enable(movie_entries, MAX_ENTRIES);
+        struct sigaction stop_action = {.sa_handler = stop_handler};
+        sigemptyset(&stop_action.sa_mask);
+        sigaction(SIGINT, &stop_action, NULL);
+        sigaction(SIGTERM, &stop_action, NULL);
+        printf("Lock profiling enabled.\n");
+    }
+    if (slow_request_us >= 0) {
+        trace_enable((u64)slow_request_us * 1000);
+        printf("Request tracing enabled.\n");
+    }
+
+    atomic_store(&next_movie_id, 1);
+
+    // A réplica lê os arquivos do líder, sem alterar nada neles.
+    char log_file[4096] = LOG_FILE;
+    char snapshot_file[4096] = SNAPSHOT_FILE;
+    if (leader_dir) {
+        snprintf(log_file, sizeof(log_file), "%s/%s", leader_dir, LOG_FILE);
+        snprintf(snapshot_file, sizeof(snapshot_file), "%s/%s", leader_dir, SNAPSHOT_FILE);
+        read_only = 1;
+        log_restore_set_read_only(1);
+        printf("Starting as a read replica of %s\n", leader_dir);
+    } else if (takeover_path) {
+        // O processo antigo ainda está escrevendo no log: o restore não pode truncar nem migrar nada.
+        log_restore_set_read_only(1);
+    }
+
+    // Ordem do restore: snapshot e depois os segmentos do log que ainda existem.
+    IdIndex restore_index = {0};
+    u64 last_segment = 0;
+    u64 restore_start = stats_now_ns();
+    switch (snapshot_load(snapshot_file, movie_entries, MAX_ENTRIES, &restore_index, &movie_count, &next_movie_id, &store_version)) {
+        case 0:
+            printf("Snapshot not found, restoring from the log only...\n");
+            break;
+        case 1:
+            printf("Snapshot loaded: %u movies.\n", atomic_load(&movie_count));
+            break;
+        case -1:
+            fprintf(stderr, "Failed to load snapshot\n");
+            return 1;
+    }
 
-    switch (log_restore(LOG_FILE, movie_entries, MAX_ENTRIES, &movie_count, &next_movie_id)) {
+    switch (log_restore_segments(log_file, movie_entries, MAX_ENTRIES, &restore_index, &movie_count, &next_movie_id, &store_version, &last_segment)) {
         case 0:
             printf("Log file not found, starting fresh...\n");
             break;
@@ -494,54 +1238,126 @@ int main(int argc, char* argv[]) {
             fprintf(stderr, "Failed to restore log file\n");
             return 1;
     }
+    restore_duration_us = (stats_now_ns() - restore_start) / 1000;
 
-    if (log_init(LOG_FILE) < 0) {
-        fprintf(stderr, "Failed to initialize log file\n");
-        return 1;
+    if (!read_only && !takeover_path) {
+        apply_boot_version_floor(0);
     }
 
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
-        perror("socket failed");
-        exit(EXIT_FAILURE);
+    if (history_init(HISTORY_CAPACITY, atomic_load(&store_version)) < 0) {
+        fprintf(stderr, "Failed to initialize removal history\n");
+        return 1;
     }
 
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
-        perror("setsockopt SO_REUSEADDR failed");
-        close(server_fd);
-        exit(EXIT_FAILURE);
+    stats_register_gauge("movies", movie_count_gauge);
+    stats_register_gauge("capacity", capacity_gauge);
+    stats_register_gauge("store_version", store_version_gauge);
+    stats_register_gauge("restore_duration_us", restore_duration_gauge);
+    if (!read_only) {
+        stats_register_gauge("log_queue_depth", log_queue_depth_gauge);
+        stats_register_gauge("log_pending_bytes", log_pending_bytes_gauge);
+    }
+    if (metrics_port > 0 && metrics_start(metrics_port) < 0) {
+        fprintf(stderr, "Failed to start the metrics endpoint\n");
+        return 1;
+    }
+    writer_config_t writer = {
+        .durability = durability,
+        .sync_interval_ms = sync_interval_ms,
+        .segment_size = segment_size,
+        .checkpoint_interval = checkpoint_interval,
+        .checkpoint_log_size = checkpoint_log_size,
+    };
+    pthread_t takeover_thread;
+    int takeover_started = 0;
+    if (read_only) {
+        stats_register_gauge("replica_lag_us", replica_lag_us);
+        if (replica_start(log_file, last_segment, movie_entries, MAX_ENTRIES, &restore_index, &movie_count, &next_movie_id, &store_version) < 0) {
+            fprintf(stderr, "Failed to start replica\n");
+            return 1;
+        }
+    } else if (takeover_path) {
+        // A store já está quente; até o processo antigo fechar o log, ela acompanha o log como uma réplica. As
+        // conexões passam a ser aceitas logo depois de receber o socket, e a takeover_main abre as mutações quando
+        // este processo vira o escritor.
+        if (replica_start(log_file, last_segment, movie_entries, MAX_ENTRIES, &restore_index, &movie_count, &next_movie_id, &store_version) < 0) {
+            fprintf(stderr, "Failed to follow the log of the running server\n");
+            return 1;
+        }
+        printf("Upgrade: store ready (%u movies), taking over from %s\n", atomic_load(&movie_count), takeover_path);
+        if (upgrade_takeover(takeover_path, &server_fd) < 0) {
+            return 1;
+        }
+        atomic_store(&writes_open, false);
+        if (pthread_create(&takeover_thread, NULL, takeover_main, &writer) != 0) {
+            fprintf(stderr, "Upgrade: failed to start the takeover thread\n");
+            return 1;
+        }
+        takeover_started = 1;
+    } else {
+        IdIndex_free(&restore_index);
+        if (start_writer(&writer) < 0) return 1;
     }
 
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(server_port);
+    // Num upgrade, o socket já está escutando (veio do processo antigo).
+    if (!takeover_path) {
+        if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+            LOG(ERROR, "socket failed: %s", errmsg());
+            exit(EXIT_FAILURE);
+        }
 
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
-        perror("bind failed");
-        close(server_fd);
-        exit(EXIT_FAILURE);
+        if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt))) {
+            LOG(ERROR, "setsockopt SO_REUSEADDR failed: %s", errmsg());
+            close(server_fd);
+            exit(EXIT_FAILURE);
+        }
+
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port = htons(server_port);
+
+        if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+            LOG(ERROR, "bind failed: %s", errmsg());
+            close(server_fd);
+            exit(EXIT_FAILURE);
+        }
+
+        if (listen(server_fd, MAX_BACKLOG) < 0) {
+            LOG(ERROR, "listen failed: %s", errmsg());
+            close(server_fd);
+            exit(EXIT_FAILURE);
+        }
     }
 
-    if (listen(server_fd, MAX_BACKLOG) < 0) {
-        perror("listen failed");
-        close(server_fd);
-        exit(EXIT_FAILURE);
+    if (upgrade_path && upgrade_listen(upgrade_path, server_fd) < 0) {
+        fprintf(stderr, "Failed to listen for upgrades on %s\n", upgrade_path);
+        return 1;
     }
 
+    if (takeover_path) {
+        socklen_t address_len = sizeof(address);
+        getsockname(server_fd, (struct sockaddr *)&address, &address_len);
+        server_port = ntohs(address.sin_port);
+    }
     printf("Server listening on port %d\n", server_port);
 
-    while (1) {
+    while (!upgrade_requested() && !atomic_load(&stop_requested)) {
+        struct pollfd pfd = {.fd = server_fd, .events = POLLIN};
+        if (poll(&pfd, 1, ACCEPT_POLL_TIMEOUT_MS) <= 0) continue;
+
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
         int client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &client_len);
 
         if (client_fd < 0) {
-            perror("accept failed");
+            LOG(ERROR, "accept failed: %s", errmsg());
             continue;
         }
 
         client_args_t* args = malloc(sizeof(client_args_t));
-        if (!args) {
-            perror("malloc failed for client args");
+        if (!args || register_client(client_fd) < 0) {
+            LOG(ERROR, "malloc failed for client args: %s", errmsg());
+            free(args);
             close(client_fd);
             continue;
         }
@@ -549,8 +1365,9 @@ int main(int argc, char* argv[]) {
 
         pthread_t thread_id;
         if (pthread_create(&thread_id, NULL, handle_client, (void*)args) != 0) {
-            perror("pthread_create failed");
+            LOG(ERROR, "pthread_create failed: %s", errmsg());
             free(args);
+            unregister_client(client_fd);
             close(client_fd);
             continue;
         }
@@ -558,8 +1375,37 @@ int main(int argc, char* argv[]) {
         pthread_detach(thread_id);
     }
 
-    for (int i = 0; i < MAX_ENTRIES; ++i) {
-        MovieEntry_free(&movie_entries[i]);
+    // O log e o checkpoint só existem depois que o processo virou o escritor.
+    if (takeover_started) pthread_join(takeover_thread, NULL);
+
+    if (atomic_load(&stop_requested)) {
+        // As threads de cliente continuam rodando até o exit, só o relatório e o fim do log importam aqui.
+        LOG(INFO, "Shutting down");
+        msglog_flush();
+        lockprof_report(stdout);
+        fflush(stdout);
+        checkpoint_stop();
+        log_close();
+        return 0;
+    }
+
+    // O socket de escuta foi entregue: as conexões novas ficam na fila até o processo novo começar a aceitar. Aqui
+    // só falta terminar as requisições em andamento e fechar o log, para o processo novo ler tudo antes de escrever.
+    checkpoint_stop();
+    size_t left = drain_clients(UPGRADE_DRAIN_GRACE_MS, UPGRADE_DRAIN_TIMEOUT_S);
+    if (left > 0) {
+        fprintf(stderr, "Upgrade: %zu connections did not finish in %d s\n", left, UPGRADE_DRAIN_TIMEOUT_S);
+    }
+    log_close();
+    upgrade_finish();
+    printf("Upgrade: handed over to the new process, exiting.\n");
+    lockprof_report(stdout);
+
+    // Conexões que não terminaram ainda podem estar usando as entradas.
+    if (left == 0) {
+        for (int i = 0; i < MAX_ENTRIES; ++i) {
+            MovieEntry_free(&movie_entries[i]);
+        }
     }
     close(server_fd);
 
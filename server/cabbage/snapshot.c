@@ -0,0 +1,365 @@
+#include "snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <endian.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "crc32c.h"
+
+#define SNAPSHOT_IO_BUFFER_SIZE (1 << 20)
+#define SNAPSHOT_PAGE_SIZE 4096
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+// Posições dos campos do cabeçalho.
+#define HDR_FORMAT_VERSION 8
+#define HDR_MOVIE_SIZE 12
+#define HDR_BASE_ADDRESS 16
+#define HDR_FILE_SIZE 24
+#define HDR_NEXT_ID 32
+#define HDR_STORE_VERSION 40
+#define HDR_MOVIE_COUNT 48
+#define HDR_STRINGS_OFFSET 56
+#define HDR_STRINGS_SIZE 64
+#define HDR_RECORDS_OFFSET 72
+#define HDR_INDEX_OFFSET 80
+#define HDR_INDEX_CAPACITY 88
+#define HDR_BODY_CRC 96
+#define HDR_CRC 100
+
+// Região do snapshot mapeado (vazia até o snapshot_load).
+static uintptr_t snapshot_map_start = 0;
+static size_t snapshot_map_size = 0;
+
+static void put_u32(u32 value, char* ptr) {
+    u32 le = htole32(value);
+    memcpy(ptr, &le, sizeof(u32));
+}
+
+static void put_u64(u64 value, char* ptr) {
+    u64 le = htole64(value);
+    memcpy(ptr, &le, sizeof(u64));
+}
+
+static u32 get_u32(const char* ptr) {
+    u32 le;
+    memcpy(&le, ptr, sizeof(u32));
+    return le32toh(le);
+}
+
+static u64 get_u64(const char* ptr) {
+    u64 le;
+    memcpy(&le, ptr, sizeof(u64));
+    return le64toh(le);
+}
+
+// Depois de um rename, o diretório também precisa de fsync para a troca sobreviver a uma queda.
+static int fsync_parent_dir(const char* filename) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s", filename);
+    int fd = open(dirname(path), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return -1;
+    int result = fsync(fd);
+    close(fd);
+    return result;
+}
+
+// Tudo o que vem depois do cabeçalho passa por aqui, para o CRC do corpo.
+static int write_body(FILE* f, const void* data, size_t size, u32* crc) {
+    *crc = crc32c_extend(*crc, data, size);
+    return fwrite(data, 1, size, f) == size ? 0 : -1;
+}
+
+static int write_padding(FILE* f, size_t* pos, u32* crc) {
+    static const char zeros[SNAPSHOT_PAGE_SIZE];
+    size_t padding = (SNAPSHOT_PAGE_SIZE - *pos % SNAPSHOT_PAGE_SIZE) % SNAPSHOT_PAGE_SIZE;
+    *pos += padding;
+    return write_body(f, zeros, padding, crc);
+}
+
+int snapshot_write(const char* filename,
+                   MovieEntry* entries,
+                   size_t max_entries,
+                   atomic_uint* next_id_ptr,
+                   atomic_ullong* store_version_ptr)
+{
+    char tmp_name[4096];
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", filename);
+
+    IdIndex index;
+    if (IdIndex_init(&index, max_entries) < 0) return -1;
+    memset(index.values, 0, index.capacity * sizeof(u32));
+
+    FILE* f = fopen(tmp_name, "wb");
+    if (!f) {
+        perror("snapshot_write: fopen failed");
+        IdIndex_free(&index);
+        return -1;
+    }
+    setvbuf(f, NULL, _IOFBF, SNAPSHOT_IO_BUFFER_SIZE);
+
+    // O cabeçalho é escrito no final, quando as seções já têm tamanho conhecido. As versões são lidas antes da
+    // varredura.
+    char header[SNAPSHOT_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    u64 next_id = atomic_load(next_id_ptr);
+    u64 store_version = atomic_load(store_version_ptr);
+    int failed = fwrite(header, 1, sizeof(header), f) != sizeof(header);
+    u32 body_crc = 0;
+
+    // As strings vão direto para o arquivo; os registros ficam em memória até o fim da varredura, porque seus
+    // ponteiros dependem da posição de cada string no heap.
+    const size_t strings_offset = SNAPSHOT_HEADER_SIZE;
+    size_t strings_size = 0;
+    Movie* records = NULL;
+    size_t record_capacity = 0;
+    size_t movie_count = 0;
+    char* buffer = NULL;
+    size_t buffer_size = 0;
+
+    for (size_t i = 0; i < max_entries && !failed; ++i) {
+        if (MovieEntry_lock(&entries[i]) != 0) continue;
+        const Movie* movie = entries[i].movie;
+        if (!movie) {
+            MovieEntry_unlock(&entries[i]);
+            continue;
+        }
+
+        const char* fields[4] = {movie->title, movie->genres, movie->director, movie->release_year};
+        size_t lengths[4];
+        size_t size = 0;
+        for (int k = 0; k < 4; ++k) {
+            if (!fields[k]) fields[k] = "";
+            lengths[k] = strlen(fields[k]) + 1;
+            size += lengths[k];
+        }
+        if (size > buffer_size || movie_count == record_capacity) {
+            char* new_buffer = size > buffer_size ? realloc(buffer, size) : buffer;
+            size_t new_capacity = movie_count == record_capacity ? (record_capacity ? record_capacity * 2 : 1024) : record_capacity;
+            Movie* new_records = new_capacity != record_capacity ? realloc(records, new_capacity * sizeof(Movie)) : records;
+            if (new_buffer) {
+                buffer = new_buffer;
+                if (size > buffer_size) buffer_size = size;
+            }
+            if (new_records) {
+                records = new_records;
+                record_capacity = new_capacity;
+            }
+            if (!new_buffer || !new_records) {
+                MovieEntry_unlock(&entries[i]);
+                failed = 1;
+                break;
+            }
+        }
+
+        Movie* record = &records[movie_count];
+        record->id = movie->id;
+        record->version = movie->version;
+        char** targets[4] = {&record->title, &record->genres, &record->director, &record->release_year};
+        size_t offset = 0;
+        for (int k = 0; k < 4; ++k) {
+            memcpy(buffer + offset, fields[k], lengths[k]);
+            *targets[k] = (char*)(uintptr_t)(SNAPSHOT_BASE_ADDRESS + strings_offset + strings_size + offset);
+            offset += lengths[k];
+        }
+        // A escrita no arquivo é feita fora do lock.
+        MovieEntry_unlock(&entries[i]);
+
+        if (IdIndex_put(&index, record->id, (u32)movie_count) < 0 || write_body(f, buffer, size, &body_crc) < 0) {
+            failed = 1;
+            break;
+        }
+        strings_size += size;
+        movie_count++;
+    }
+    free(buffer);
+
+    size_t pos = strings_offset + strings_size;
+    size_t records_offset = 0, index_offset = 0;
+    if (!failed) {
+        failed = write_padding(f, &pos, &body_crc) < 0;
+        records_offset = pos;
+        failed = failed || write_body(f, records, movie_count * sizeof(Movie), &body_crc) < 0;
+        pos += movie_count * sizeof(Movie);
+        failed = failed || write_padding(f, &pos, &body_crc) < 0;
+        index_offset = pos;
+        failed = failed || write_body(f, index.keys, index.capacity * sizeof(u32), &body_crc) < 0;
+        failed = failed || write_body(f, index.values, index.capacity * sizeof(u32), &body_crc) < 0;
+        pos += 2 * index.capacity * sizeof(u32);
+    }
+    free(records);
+
+    if (!failed) {
+        memcpy(header, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE);
+        put_u32(SNAPSHOT_FORMAT_VERSION, header + HDR_FORMAT_VERSION);
+        put_u32((u32)sizeof(Movie), header + HDR_MOVIE_SIZE);
+        put_u64(SNAPSHOT_BASE_ADDRESS, header + HDR_BASE_ADDRESS);
+        put_u64(pos, header + HDR_FILE_SIZE);
+        put_u64(next_id, header + HDR_NEXT_ID);
+        put_u64(store_version, header + HDR_STORE_VERSION);
+        put_u64(movie_count, header + HDR_MOVIE_COUNT);
+        put_u64(strings_offset, header + HDR_STRINGS_OFFSET);
+        put_u64(strings_size, header + HDR_STRINGS_SIZE);
+        put_u64(records_offset, header + HDR_RECORDS_OFFSET);
+        put_u64(index_offset, header + HDR_INDEX_OFFSET);
+        put_u64(index.capacity, header + HDR_INDEX_CAPACITY);
+        put_u32(body_crc, header + HDR_BODY_CRC);
+        put_u32(crc32c(header, HDR_CRC), header + HDR_CRC);
+        failed = fseek(f, 0, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), f) != sizeof(header);
+    }
+    IdIndex_free(&index);
+
+    if (!failed) failed = fflush(f) != 0 || fsync(fileno(f)) != 0;
+    if (fclose(f) != 0) failed = 1;
+
+    if (failed || rename(tmp_name, filename) != 0) {
+        perror("snapshot_write: failed");
+        unlink(tmp_name);
+        return -1;
+    }
+    fsync_parent_dir(filename);
+    return 0;
+}
+
+static void relocate_pointer(char** ptr, uintptr_t delta) {
+    *ptr = (char*)((uintptr_t)*ptr + delta);
+}
+
+int snapshot_load(const char* filename,
+                  MovieEntry* entries,
+                  size_t max_entries,
+                  IdIndex* index,
+                  atomic_uint* movie_count_ptr,
+                  atomic_uint* next_id_ptr,
+                  atomic_ullong* store_version_ptr)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) return 0;
+        perror("snapshot_load: open failed");
+        return -1;
+    }
+
+    struct stat st;
+    char header[SNAPSHOT_HEADER_SIZE];
+    if (fstat(fd, &st) < 0 || pread(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE) != 0 ||
+        get_u32(header + HDR_CRC) != crc32c(header, HDR_CRC)) {
+        fprintf(stderr, "snapshot_load: invalid snapshot header in %s\n", filename);
+        close(fd);
+        return -1;
+    }
+
+    u32 format_version = get_u32(header + HDR_FORMAT_VERSION);
+    u32 movie_size = get_u32(header + HDR_MOVIE_SIZE);
+    u64 base = get_u64(header + HDR_BASE_ADDRESS);
+    u64 file_size = get_u64(header + HDR_FILE_SIZE);
+    u64 next_id = get_u64(header + HDR_NEXT_ID);
+    u64 store_version = get_u64(header + HDR_STORE_VERSION);
+    u64 movie_count = get_u64(header + HDR_MOVIE_COUNT);
+    u64 records_offset = get_u64(header + HDR_RECORDS_OFFSET);
+    u64 index_offset = get_u64(header + HDR_INDEX_OFFSET);
+    u64 index_capacity = get_u64(header + HDR_INDEX_CAPACITY);
+
+    if (format_version != SNAPSHOT_FORMAT_VERSION || movie_size != sizeof(Movie)) {
+        fprintf(stderr, "snapshot_load: unsupported snapshot format (version %u, movie size %u)\n",
+                format_version, movie_size);
+        close(fd);
+        return -1;
+    }
+    if (file_size != (u64)st.st_size || file_size < SNAPSHOT_HEADER_SIZE || records_offset + movie_count * sizeof(Movie) > file_size ||
+        index_offset + 2 * index_capacity * sizeof(u32) > file_size) {
+        fprintf(stderr, "snapshot_load: %s is truncated\n", filename);
+        close(fd);
+        return -1;
+    }
+    if (movie_count > max_entries || atomic_load(movie_count_ptr) != 0) {
+        fprintf(stderr, "snapshot_load: %llu movies do not fit in the table\n", (unsigned long long)movie_count);
+        close(fd);
+        return -1;
+    }
+
+    // MAP_PRIVATE: as escritas nos registros (versão, ponteiro de gêneros) ficam só na memória do processo.
+    char* map = mmap((void*)(uintptr_t)base, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED_NOREPLACE, fd, 0);
+    if (map == MAP_FAILED) {
+        map = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("snapshot_load: mmap failed");
+        return -1;
+    }
+    madvise(map, file_size, MADV_WILLNEED);
+
+    // O cabeçalho tem CRC próprio, mas os ponteiros dos registros e o índice vêm do corpo e são usados sem outra
+    // validação: um bit trocado ali viraria um ponteiro inválido. Ler o corpo inteiro custa uma passada no arquivo
+    // (que o MADV_WILLNEED já traz para a memória), bem menos que reconstruir a store pelo log.
+    if (get_u32(header + HDR_BODY_CRC) != crc32c(map + SNAPSHOT_HEADER_SIZE, file_size - SNAPSHOT_HEADER_SIZE)) {
+        fprintf(stderr, "snapshot_load: %s is corrupted (body checksum mismatch)\n", filename);
+        munmap(map, file_size);
+        return -1;
+    }
+
+    Movie* records = (Movie*)(map + records_offset);
+    if ((uintptr_t)map != base) {
+        // O endereço base estava ocupado (ou o kernel não conhece MAP_FIXED_NOREPLACE): corrige os ponteiros.
+        uintptr_t delta = (uintptr_t)map - (uintptr_t)base;
+        for (u64 i = 0; i < movie_count; ++i) {
+            relocate_pointer(&records[i].title, delta);
+            relocate_pointer(&records[i].genres, delta);
+            relocate_pointer(&records[i].director, delta);
+            relocate_pointer(&records[i].release_year, delta);
+        }
+    }
+    snapshot_map_start = (uintptr_t)map;
+    snapshot_map_size = file_size;
+
+    for (u64 i = 0; i < movie_count; ++i) {
+        entries[i].movie = &records[i];
+    }
+
+    if (index) {
+        if (index_capacity == IdIndex_capacity_for(max_entries)) {
+            // O índice salvo foi criado para o mesmo max_entries: usa as tabelas mapeadas (copy-on-write) sem copiar.
+            u32* keys = (u32*)(map + index_offset);
+            IdIndex_wrap(index, keys, keys + index_capacity, index_capacity, movie_count);
+        } else {
+            // O snapshot foi escrito com outro MAX_ENTRIES, então o índice salvo não serve.
+            if (IdIndex_init(index, max_entries) < 0) return -1;
+            for (u64 i = 0; i < movie_count; ++i) {
+                IdIndex_put(index, records[i].id, (u32)i);
+            }
+        }
+    }
+
+    atomic_store(movie_count_ptr, (unsigned)movie_count);
+    if (next_id > atomic_load(next_id_ptr)) atomic_store(next_id_ptr, (unsigned)next_id);
+    if (store_version > atomic_load(store_version_ptr)) atomic_store(store_version_ptr, store_version);
+    return 1;
+}
+
+int snapshot_owns(const void* ptr) {
+    return (uintptr_t)ptr - snapshot_map_start < snapshot_map_size;
+}
+
+void snapshot_free(void* ptr) {
+    if (!snapshot_owns(ptr)) free(ptr);
+}
+
+char* snapshot_realloc_string(char* str, size_t size) {
+    if (!snapshot_owns(str)) return realloc(str, size);
+    char* copy = malloc(size);
+    if (!copy) return NULL;
+    size_t length = strnlen(str, size - 1);
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
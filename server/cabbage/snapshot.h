@@ -0,0 +1,62 @@
+#ifndef _CABBAGE_SNAPSHOT_H
+#define _CABBAGE_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include "MovieEntry.h"
+#include "IdIndex.h"
+
+// Snapshot da store, usado pelo checkpoint para compactar o log.
+//
+// O arquivo tem o mesmo layout da store em memória, para o boot só precisar de um mmap:
+//   - cabeçalho (SNAPSHOT_HEADER_SIZE bytes): magic "CABBSNAP", versão do formato, sizeof(Movie), endereço base,
+//     next_id, store_version, número de filmes, a posição de cada seção e o CRC32C do resto do arquivo, protegido por
+//     um CRC32C próprio;
+//   - heap de strings: os campos dos filmes, terminados em '\0';
+//   - registros: um array de Movie (layout nativo), cujos ponteiros já apontam para o heap de strings supondo que o
+//     arquivo está mapeado no endereço base;
+//   - índice: as tabelas keys/values de um IdIndex (ID -> slot) criado para max_entries.
+// O arquivo é mapeado com MAP_PRIVATE no endereço base; se ele estiver ocupado, o arquivo é mapeado em outro lugar
+// e os ponteiros são corrigidos (o que toca todas as páginas dos registros, mas ainda sem nenhum malloc).
+// Os filmes ficam no mapeamento até serem modificados: alterar um campo do Movie só copia a página (copy-on-write
+// do kernel), e as strings são copiadas para o heap na primeira modificação (ver snapshot_free e
+// snapshot_realloc_string). O mapeamento nunca é desfeito; o checkpoint troca o arquivo com rename, então o inode
+// antigo continua válido.
+//
+// O snapshot é "fuzzy": ele é tirado travando uma entrada de cada vez, sem pausar as requisições, então pode conter
+// mutações feitas depois da rotação do log. Isso não é problema porque a reaplicação do log é idempotente: um ADD
+// substitui o filme, um ADDGENRE de um gênero existente não faz nada e um REM de um filme ausente é ignorado.
+
+#define SNAPSHOT_MAGIC "CABBSNAP"
+#define SNAPSHOT_MAGIC_SIZE 8
+#define SNAPSHOT_FORMAT_VERSION 3
+#define SNAPSHOT_HEADER_SIZE 4096
+// Fora das regiões usadas normalmente pelo binário (0x55...), heap e bibliotecas (0x7f...) no x86-64.
+#define SNAPSHOT_BASE_ADDRESS 0x200000000000ull
+
+// Escreve o snapshot em '<filename>.tmp' e renomeia para 'filename' no final (a troca é atômica).
+int snapshot_write(const char* filename,
+                   MovieEntry* entries,
+                   size_t max_entries,
+                   atomic_uint* next_id_ptr,
+                   atomic_ullong* store_version_ptr);
+
+// Mapeia o snapshot e coloca os filmes nos primeiros slots de 'entries', que precisa estar vazia. Se 'index' não for
+// NULL, recebe o índice ID -> slot (deve ser liberado com IdIndex_free). Retorna 0 se o arquivo não existe, 1 em
+// caso de sucesso e -1 em caso de erro. next_id e store_version só são atualizados se forem maiores que os atuais.
+int snapshot_load(const char* filename,
+                  MovieEntry* entries,
+                  size_t max_entries,
+                  IdIndex* index,
+                  atomic_uint* movie_count_ptr,
+                  atomic_uint* next_id_ptr,
+                  atomic_ullong* store_version_ptr);
+
+// Verdadeiro se 'ptr' aponta para dentro do snapshot mapeado (não pode ser liberado nem realocado).
+int snapshot_owns(const void* ptr);
+// free() que ignora a memória do snapshot mapeado.
+void snapshot_free(void* ptr);
+// realloc() de uma string que pode estar no snapshot mapeado: nesse caso ela é copiada para um buffer novo.
+char* snapshot_realloc_string(char* str, size_t size);
+
+#endif // _CABBAGE_SNAPSHOT_H
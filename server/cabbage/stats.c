@@ -0,0 +1,446 @@
+#include "stats.h"
+#include "lockprof.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "cabbage/common/histogram.h"
+
+#define STATS_MAX_GAUGES 16
+// Os histogramas de requisição ocupam os primeiros STATS_MAX_TYPES slots, e os de stats_histogram_t vêm depois.
+#define STATS_SLOTS (STATS_MAX_TYPES + STATS_HISTOGRAM_COUNT)
+
+typedef struct {
+    atomic_ullong buckets[HIST_BUCKETS];
+    atomic_ullong max;
+    atomic_ullong sum;
+} Histogram;
+
+typedef struct StatsThread {
+    struct StatsThread* prev;
+    struct StatsThread* next;
+    atomic_ullong requests;
+    atomic_ullong errors;
+    atomic_ullong bytes_in;
+    atomic_ullong bytes_out;
+    Histogram* _Atomic histograms[STATS_SLOTS];
+} StatsThread;
+
+typedef struct {
+    const char* name;
+    u64 (*read)(void);
+} StatsGauge;
+
+// Lista das threads vivas e a soma das que já terminaram. O mutex só é usado ao criar/terminar threads e no
+// C2S_STATS, nunca no caminho de uma requisição.
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static StatsThread* stats_threads = NULL;
+static StatsThread stats_retired;
+static StatsGauge stats_gauges[STATS_MAX_GAUGES];
+static int stats_gauge_count = 0;
+
+static atomic_ullong stats_connections_total;
+static atomic_ullong stats_connections_active;
+
+static _Thread_local StatsThread* stats_self = NULL;
+
+u64 stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+// Só a thread dona escreve no contador, então não precisa de um fetch_add.
+static inline void counter_add(atomic_ullong* counter, u64 value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static inline void counter_set(atomic_ullong* counter, u64 value) {
+    atomic_store_explicit(counter, value, memory_order_relaxed);
+}
+
+static inline u64 counter_get(atomic_ullong* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static Histogram* histogram_get(StatsThread* thread, int slot) {
+    Histogram* histogram = atomic_load_explicit(&thread->histograms[slot], memory_order_acquire);
+    if (histogram) return histogram;
+    histogram = calloc(1, sizeof(Histogram));
+    if (!histogram) return NULL;
+    atomic_store_explicit(&thread->histograms[slot], histogram, memory_order_release);
+    return histogram;
+}
+
+static void histogram_merge(Histogram* dst, Histogram* src) {
+    for (unsigned i = 0; i < HIST_BUCKETS; ++i) {
+        u64 count = counter_get(&src->buckets[i]);
+        if (count) counter_add(&dst->buckets[i], count);
+    }
+    if (counter_get(&src->max) > counter_get(&dst->max)) counter_set(&dst->max, counter_get(&src->max));
+    counter_add(&dst->sum, counter_get(&src->sum));
+}
+
+static void histogram_record(Histogram* histogram, u64 value) {
+    counter_add(&histogram->buckets[hist_bucket_index(value)], 1);
+    counter_add(&histogram->sum, value);
+    if (value > counter_get(&histogram->max)) counter_set(&histogram->max, value);
+}
+
+static u64 histogram_count(Histogram* histogram) {
+    u64 count = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; ++i) {
+        count += counter_get(&histogram->buckets[i]);
+    }
+    return count;
+}
+
+static void thread_free_histograms(StatsThread* thread) {
+    for (int slot = 0; slot < STATS_SLOTS; ++slot) {
+        free(atomic_load(&thread->histograms[slot]));
+    }
+}
+
+// Soma os números de 'src' em 'dst'. Deve ser chamada com o stats_mutex.
+static void thread_merge(StatsThread* dst, StatsThread* src) {
+    counter_add(&dst->requests, counter_get(&src->requests));
+    counter_add(&dst->errors, counter_get(&src->errors));
+    counter_add(&dst->bytes_in, counter_get(&src->bytes_in));
+    counter_add(&dst->bytes_out, counter_get(&src->bytes_out));
+    for (int slot = 0; slot < STATS_SLOTS; ++slot) {
+        Histogram* histogram = atomic_load_explicit(&src->histograms[slot], memory_order_acquire);
+        if (!histogram) continue;
+        Histogram* total = histogram_get(dst, slot);
+        if (total) histogram_merge(total, histogram);
+    }
+}
+
+void stats_connection_opened(void) {
+    atomic_fetch_add(&stats_connections_total, 1);
+    atomic_fetch_add(&stats_connections_active, 1);
+}
+
+void stats_connection_closed(void) {
+    atomic_fetch_sub(&stats_connections_active, 1);
+}
+
+void stats_thread_begin(void) {
+    StatsThread* thread = calloc(1, sizeof(StatsThread));
+    if (!thread) return;
+    pthread_mutex_lock(&stats_mutex);
+    thread->next = stats_threads;
+    if (stats_threads) stats_threads->prev = thread;
+    stats_threads = thread;
+    pthread_mutex_unlock(&stats_mutex);
+    stats_self = thread;
+}
+
+void stats_thread_end(void) {
+    StatsThread* thread = stats_self;
+    if (!thread) return;
+    stats_self = NULL;
+
+    pthread_mutex_lock(&stats_mutex);
+    if (thread->prev) thread->prev->next = thread->next;
+    else stats_threads = thread->next;
+    if (thread->next) thread->next->prev = thread->prev;
+    thread_merge(&stats_retired, thread);
+    pthread_mutex_unlock(&stats_mutex);
+
+    thread_free_histograms(thread);
+    free(thread);
+}
+
+void stats_record_request(u8 type, u64 latency_ns) {
+    StatsThread* thread = stats_self;
+    if (!thread) return;
+    counter_add(&thread->requests, 1);
+    counter_set(&thread->bytes_in, packet_bytes_received);
+    counter_set(&thread->bytes_out, packet_bytes_sent);
+
+    Histogram* histogram = histogram_get(thread, type % STATS_MAX_TYPES);
+    if (histogram) histogram_record(histogram, latency_ns);
+}
+
+void stats_record_error(void) {
+    if (stats_self) counter_add(&stats_self->errors, 1);
+}
+
+void stats_record(stats_histogram_t which, u64 duration_ns) {
+    StatsThread* thread = stats_self;
+    if (!thread) return;
+    Histogram* histogram = histogram_get(thread, STATS_MAX_TYPES + (int)which);
+    if (histogram) histogram_record(histogram, duration_ns);
+}
+
+int stats_register_gauge(const char* name, u64 (*read)(void)) {
+    pthread_mutex_lock(&stats_mutex);
+    if (stats_gauge_count == STATS_MAX_GAUGES) {
+        pthread_mutex_unlock(&stats_mutex);
+        return -1;
+    }
+    stats_gauges[stats_gauge_count].name = name;
+    stats_gauges[stats_gauge_count].read = read;
+    stats_gauge_count++;
+    pthread_mutex_unlock(&stats_mutex);
+    return 0;
+}
+
+static u64 histogram_percentile(Histogram* histogram, u64 total, double percentile) {
+    u64 counts[HIST_BUCKETS];
+    for (unsigned i = 0; i < HIST_BUCKETS; ++i) counts[i] = counter_get(&histogram->buckets[i]);
+    return hist_percentile(counts, total, counter_get(&histogram->max), percentile);
+}
+
+static int add_counter(S2C_StatsData* data, const char* name, u64 value) {
+    S2C_StatsCounter* item = &data->counters[data->counter_count];
+    item->name = strdup(name);
+    if (!item->name) return -1;
+    item->value = value;
+    data->counter_count++;
+    return 0;
+}
+
+static const char* stats_histogram_names[STATS_HISTOGRAM_COUNT] = {
+    [STATS_LOG_APPEND] = "log_append",
+    [STATS_LOG_WRITE] = "log_write",
+    [STATS_LOCK_WAIT] = "lock_wait",
+};
+
+// Nome do slot de histograma, ou NULL se ele não é usado.
+static const char* slot_name(int slot) {
+    if (slot >= STATS_MAX_TYPES) return stats_histogram_names[slot - STATS_MAX_TYPES];
+    const char* name = C2SPacket_type_name((u8)slot);
+    return strcmp(name, "UNKNOWN") == 0 ? NULL : name;
+}
+
+// Com o perfil de locks ligado, inclui os números de cada ponto de chamada ("lock_wait_us.ADD_MOVIE", ...).
+static int add_lock_counters(S2C_StatsData* data) {
+    LockprofTotals* totals = malloc(sizeof(LockprofTotals));
+    if (!totals) return -1;
+    if (lockprof_collect(totals) < 0) {
+        free(totals);
+        return 0;
+    }
+    int result = 0;
+    for (unsigned site = 0; site < LOCKPROF_SITES && result == 0; ++site) {
+        LockprofCounters* c = &totals->sites[site];
+        if (c->acquires == 0) continue;
+        char name[64];
+        const char* site_name = lockprof_site_name(site);
+        snprintf(name, sizeof(name), "lock_acquires.%s", site_name);
+        result |= add_counter(data, name, c->acquires);
+        snprintf(name, sizeof(name), "lock_contended.%s", site_name);
+        result |= add_counter(data, name, c->contended);
+        snprintf(name, sizeof(name), "lock_wait_us.%s", site_name);
+        result |= add_counter(data, name, c->wait_ns / 1000);
+        snprintf(name, sizeof(name), "lock_hold_us.%s", site_name);
+        result |= add_counter(data, name, c->hold_ns / 1000);
+    }
+    free(totals);
+    return result;
+}
+
+// Uma família por número, com os pontos de chamada ({site=...}) ou as faixas de entradas ({stripe=...}).
+static void render_lock_family(FILE* out, const char* group, LockprofCounters* counters, unsigned count, int by_site) {
+    static const char* names[] = {"acquires_total", "contended_total", "wait_seconds_total", "hold_seconds_total"};
+    for (int m = 0; m < 4; ++m) {
+        fprintf(out, "# TYPE cabbage_%s_%s counter\n", group, names[m]);
+        for (unsigned i = 0; i < count; ++i) {
+            LockprofCounters* c = &counters[i];
+            if (c->acquires == 0) continue;
+            char label[64];
+            if (by_site) snprintf(label, sizeof(label), "site=\"%s\"", lockprof_site_name(i));
+            else snprintf(label, sizeof(label), "stripe=\"%u\"", i);
+            u64 values[] = {c->acquires, c->contended, c->wait_ns, c->hold_ns};
+            if (m < 2) fprintf(out, "cabbage_%s_%s{%s} %llu\n", group, names[m], label, (unsigned long long)values[m]);
+            else fprintf(out, "cabbage_%s_%s{%s} %.9f\n", group, names[m], label, values[m] / 1e9);
+        }
+    }
+}
+
+static void render_lock_metrics(FILE* out) {
+    LockprofTotals* totals = malloc(sizeof(LockprofTotals));
+    if (!totals) return;
+    if (lockprof_collect(totals) == 0) {
+        render_lock_family(out, "lock", totals->sites, LOCKPROF_SITES, 1);
+        render_lock_family(out, "lock_stripe", totals->stripes, LOCKPROF_STRIPES, 0);
+    }
+    free(totals);
+}
+
+// Soma as threads que já terminaram e as vivas em 'total', e copia os gauges registrados.
+static StatsThread* stats_collect(StatsGauge* gauges, int* gauge_count) {
+    StatsThread* total = calloc(1, sizeof(StatsThread));
+    if (!total) return NULL;
+    pthread_mutex_lock(&stats_mutex);
+    thread_merge(total, &stats_retired);
+    for (StatsThread* thread = stats_threads; thread; thread = thread->next) {
+        thread_merge(total, thread);
+    }
+    *gauge_count = stats_gauge_count;
+    memcpy(gauges, stats_gauges, sizeof(StatsGauge) * (size_t)stats_gauge_count);
+    pthread_mutex_unlock(&stats_mutex);
+    return total;
+}
+
+int stats_fill_packet(S2CPacket* packet) {
+    memset(packet, 0, sizeof(S2CPacket));
+    packet->type = S2C_STATS;
+    S2C_StatsData* data = &packet->data.stats;
+
+    StatsGauge gauges[STATS_MAX_GAUGES];
+    int gauge_count;
+    StatsThread* total = stats_collect(gauges, &gauge_count);
+    data->counters = calloc(6 + STATS_MAX_GAUGES + 4 * LOCKPROF_SITES, sizeof(S2C_StatsCounter));
+    data->latencies = calloc(STATS_SLOTS, sizeof(S2C_StatsLatency));
+    if (!total || !data->counters || !data->latencies) {
+        if (total) thread_free_histograms(total);
+        free(total);
+        S2CPacket_free(packet);
+        return -1;
+    }
+
+    int result = 0;
+    result |= add_counter(data, "requests", counter_get(&total->requests));
+    result |= add_counter(data, "errors", counter_get(&total->errors));
+    result |= add_counter(data, "bytes_in", counter_get(&total->bytes_in));
+    result |= add_counter(data, "bytes_out", counter_get(&total->bytes_out));
+    result |= add_counter(data, "connections_active", atomic_load(&stats_connections_active));
+    result |= add_counter(data, "connections_total", atomic_load(&stats_connections_total));
+    for (int i = 0; i < gauge_count; ++i) {
+        result |= add_counter(data, gauges[i].name, gauges[i].read());
+    }
+    if (result == 0) result = add_lock_counters(data);
+
+    for (int slot = 0; slot < STATS_SLOTS && result == 0; ++slot) {
+        Histogram* histogram = atomic_load(&total->histograms[slot]);
+        if (!histogram || !slot_name(slot)) continue;
+        u64 count = histogram_count(histogram);
+        if (count == 0) continue;
+
+        S2C_StatsLatency* item = &data->latencies[data->latency_count];
+        item->name = strdup(slot_name(slot));
+        if (!item->name) {
+            result = -1;
+            break;
+        }
+        item->count = count;
+        item->p50_ns = histogram_percentile(histogram, count, 50.0);
+        item->p99_ns = histogram_percentile(histogram, count, 99.0);
+        item->p999_ns = histogram_percentile(histogram, count, 99.9);
+        item->max_ns = atomic_load(&histogram->max);
+        data->latency_count++;
+    }
+
+    thread_free_histograms(total);
+    free(total);
+
+    if (result != 0) {
+        S2CPacket_free(packet);
+        return -1;
+    }
+    return 0;
+}
+
+// Limites (em segundos) dos buckets dos histogramas no Prometheus. Cada bucket do HDR entra no primeiro limite que
+// é maior ou igual ao seu maior valor, então a contagem de um limite pode errar em até 3.2% do valor.
+static const double prometheus_bounds[] = {
+    0.000001, 0.0000025, 0.000005, 0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005,
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10,
+};
+#define PROMETHEUS_BOUND_COUNT (sizeof(prometheus_bounds) / sizeof(prometheus_bounds[0]))
+
+static void render_histogram(FILE* out, const char* metric, const char* label, Histogram* histogram) {
+    char labels[128];
+    snprintf(labels, sizeof(labels), label ? "type=\"%s\"," : "%s", label ? label : "");
+
+    u64 cumulative = 0;
+    unsigned bucket = 0;
+    for (size_t i = 0; i < PROMETHEUS_BOUND_COUNT; ++i) {
+        u64 bound_ns = (u64)(prometheus_bounds[i] * 1e9 + 0.5);
+        while (bucket < HIST_BUCKETS && hist_bucket_upper_value(bucket) <= bound_ns) {
+            cumulative += counter_get(&histogram->buckets[bucket]);
+            bucket++;
+        }
+        fprintf(out, "%s_bucket{%sle=\"%g\"} %llu\n", metric, labels, prometheus_bounds[i], (unsigned long long)cumulative);
+    }
+    u64 count = histogram_count(histogram);
+    fprintf(out, "%s_bucket{%sle=\"+Inf\"} %llu\n", metric, labels, (unsigned long long)count);
+    // Sem rótulos, o Prometheus não aceita as chaves vazias.
+    if (label) {
+        fprintf(out, "%s_sum{type=\"%s\"} %.9f\n", metric, label, counter_get(&histogram->sum) / 1e9);
+        fprintf(out, "%s_count{type=\"%s\"} %llu\n", metric, label, (unsigned long long)count);
+    } else {
+        fprintf(out, "%s_sum %.9f\n", metric, counter_get(&histogram->sum) / 1e9);
+        fprintf(out, "%s_count %llu\n", metric, (unsigned long long)count);
+    }
+}
+
+char* stats_render_prometheus(size_t* length) {
+    StatsGauge gauges[STATS_MAX_GAUGES];
+    int gauge_count;
+    StatsThread* total = stats_collect(gauges, &gauge_count);
+    if (!total) return NULL;
+
+    char* buffer = NULL;
+    FILE* out = open_memstream(&buffer, length);
+    if (!out) {
+        thread_free_histograms(total);
+        free(total);
+        return NULL;
+    }
+
+    fprintf(out, "# TYPE cabbage_requests_total counter\n");
+    for (int type = 0; type < STATS_MAX_TYPES; ++type) {
+        Histogram* histogram = atomic_load(&total->histograms[type]);
+        if (!histogram || !slot_name(type)) continue;
+        fprintf(out, "cabbage_requests_total{type=\"%s\"} %llu\n", slot_name(type),
+                (unsigned long long)histogram_count(histogram));
+    }
+    fprintf(out, "# TYPE cabbage_errors_total counter\ncabbage_errors_total %llu\n",
+            (unsigned long long)counter_get(&total->errors));
+    fprintf(out, "# TYPE cabbage_received_bytes_total counter\ncabbage_received_bytes_total %llu\n",
+            (unsigned long long)counter_get(&total->bytes_in));
+    fprintf(out, "# TYPE cabbage_sent_bytes_total counter\ncabbage_sent_bytes_total %llu\n",
+            (unsigned long long)counter_get(&total->bytes_out));
+    fprintf(out, "# TYPE cabbage_connections_total counter\ncabbage_connections_total %llu\n",
+            (unsigned long long)atomic_load(&stats_connections_total));
+    fprintf(out, "# TYPE cabbage_connections gauge\ncabbage_connections %llu\n",
+            (unsigned long long)atomic_load(&stats_connections_active));
+    for (int i = 0; i < gauge_count; ++i) {
+        fprintf(out, "# TYPE cabbage_%s gauge\ncabbage_%s %llu\n", gauges[i].name, gauges[i].name,
+                (unsigned long long)gauges[i].read());
+    }
+
+    fprintf(out, "# TYPE cabbage_request_duration_seconds histogram\n");
+    for (int type = 0; type < STATS_MAX_TYPES; ++type) {
+        Histogram* histogram = atomic_load(&total->histograms[type]);
+        if (!histogram || !slot_name(type)) continue;
+        render_histogram(out, "cabbage_request_duration_seconds", slot_name(type), histogram);
+    }
+    for (int i = 0; i < STATS_HISTOGRAM_COUNT; ++i) {
+        char metric[64];
+        snprintf(metric, sizeof(metric), "cabbage_%s_duration_seconds", stats_histogram_names[i]);
+        fprintf(out, "# TYPE %s histogram\n", metric);
+        Histogram* histogram = atomic_load(&total->histograms[STATS_MAX_TYPES + i]);
+        Histogram empty;
+        if (!histogram) {
+            memset(&empty, 0, sizeof(empty));
+            histogram = &empty;
+        }
+        render_histogram(out, metric, NULL, histogram);
+    }
+
+    render_lock_metrics(out);
+
+    thread_free_histograms(total);
+    free(total);
+    if (fclose(out) != 0) {
+        free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
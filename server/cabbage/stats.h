@@ -0,0 +1,53 @@
+#ifndef _CABBAGE_STATS_H
+#define _CABBAGE_STATS_H
+
+#include <stddef.h>
+#include "cabbage/common/types.h"
+#include "cabbage/common/Packet.h"
+
+// Estatísticas do servidor: contadores e histogramas de latência por tipo de pacote.
+//
+// Cada thread de cliente tem seus próprios números (só ela escreve neles, então o incremento é um load + store
+// relaxado, sem instrução atômica de read-modify-write nem cache line compartilhada). O C2S_STATS percorre as threads
+// vivas e soma tudo; quando uma thread termina, os números dela são somados aos de threads que já saíram.
+//
+// Os histogramas são no estilo HDR: buckets log-lineares (32 sub-buckets por potência de 2, erro relativo menor
+// que 3.2%) de 1 ns até ~18 minutos, alocados no primeiro uso de cada tipo de pacote.
+
+#define STATS_MAX_TYPES 32
+
+// Histogramas além dos de requisição (um por tipo de pacote).
+typedef enum {
+    STATS_LOG_APPEND,  // do enfileiramento no log até o log_wait voltar, na thread do cliente
+    STATS_LOG_WRITE,   // writev (e fsync, dependendo da durabilidade) de um lote, na thread do escritor
+    STATS_LOCK_WAIT,   // espera por um lock de entrada, medida só quando o trylock falha
+    STATS_HISTOGRAM_COUNT
+} stats_histogram_t;
+
+// Registra a thread atual (threads de cliente, escritor do log, ...). Números de threads não registradas são ignorados.
+void stats_thread_begin(void);
+// Soma os números da thread atual aos globais e libera os dela.
+void stats_thread_end(void);
+
+void stats_connection_opened(void);
+void stats_connection_closed(void);
+
+// Uma requisição atendida: do fim do recv ao fim do send da resposta.
+void stats_record_request(u8 type, u64 latency_ns);
+void stats_record_error(void);
+void stats_record(stats_histogram_t histogram, u64 duration_ns);
+
+// Medidas instantâneas incluídas nas estatísticas (número de filmes, atraso da réplica, ...).
+// 'name' deve ser uma string estática.
+int stats_register_gauge(const char* name, u64 (*read)(void));
+
+// Monta a resposta do C2S_STATS (liberada com S2CPacket_free).
+int stats_fill_packet(S2CPacket* packet);
+
+// Gera as métricas no formato de texto do Prometheus. Retorna um buffer alocado com malloc (e o tamanho em *length).
+char* stats_render_prometheus(size_t* length);
+
+// Tempo monotônico em nanossegundos.
+u64 stats_now_ns(void);
+
+#endif // _CABBAGE_STATS_H
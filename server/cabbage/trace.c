@@ -0,0 +1,211 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "cabbage/common/Packet.h"
+#include "stats.h"
+#include "msglog.h"
+
+#define TRACE_RING_SIZE 1024
+#define TRACE_MAX_RETIRED 64
+
+// Os campos são atômicos (relaxados) porque o export lê enquanto a thread dona escreve.
+typedef struct {
+    atomic_ullong phases[TRACE_PHASE_COUNT];
+    atomic_ullong type;
+} TraceRecord;
+
+// Cópia de um registro feita pelo export.
+typedef struct {
+    u64 phases[TRACE_PHASE_COUNT];
+    u8 type;
+} TraceSample;
+
+typedef struct TraceRing {
+    struct TraceRing* prev;
+    struct TraceRing* next;
+    unsigned id;
+    int client_fd;
+    // 'writing' é o índice do registro sendo escrito e 'head' o número de registros completos. Quem lê copia os
+    // registros e depois confere o 'writing': os que podem ter sido sobrescritos durante a cópia são descartados.
+    atomic_ullong writing;
+    atomic_ullong head;
+    TraceRecord records[TRACE_RING_SIZE];
+} TraceRing;
+
+atomic_bool trace_enabled;
+static u64 trace_slow_threshold_ns = 0;
+
+// Protege só as listas de rings (criação, fim de thread e export), nunca o caminho de uma requisição.
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static TraceRing* trace_rings = NULL;
+static TraceRing* trace_retired_head = NULL;
+static TraceRing* trace_retired_tail = NULL;
+static unsigned trace_retired_count = 0;
+static unsigned trace_next_id = 1;
+
+static _Thread_local TraceRing* trace_self = NULL;
+static _Thread_local u64 trace_current[TRACE_PHASE_COUNT];
+static _Thread_local u8 trace_current_type;
+
+static const char* trace_phase_names[TRACE_PHASE_COUNT] = {
+    [TRACE_RECV] = "recv",
+    [TRACE_LOOKUP] = "lookup",
+    [TRACE_LOG] = "log",
+    [TRACE_SERIALIZE] = "serialize",
+    [TRACE_SEND] = "send",
+};
+
+void trace_enable(u64 slow_threshold_ns) {
+    trace_slow_threshold_ns = slow_threshold_ns;
+    atomic_store(&trace_enabled, true);
+}
+
+static void trace_serialized(void) {
+    trace_mark(TRACE_SERIALIZE);
+}
+
+void trace_thread_begin(int client_fd) {
+    if (!atomic_load(&trace_enabled)) return;
+    TraceRing* ring = calloc(1, sizeof(TraceRing));
+    if (!ring) return;
+    ring->client_fd = client_fd;
+    pthread_mutex_lock(&trace_mutex);
+    ring->id = trace_next_id++;
+    ring->next = trace_rings;
+    if (trace_rings) trace_rings->prev = ring;
+    trace_rings = ring;
+    pthread_mutex_unlock(&trace_mutex);
+    trace_self = ring;
+    packet_serialized_hook = trace_serialized;
+}
+
+void trace_thread_end(void) {
+    TraceRing* ring = trace_self;
+    if (!ring) return;
+    trace_self = NULL;
+    packet_serialized_hook = NULL;
+
+    pthread_mutex_lock(&trace_mutex);
+    if (ring->prev) ring->prev->next = ring->next;
+    else trace_rings = ring->next;
+    if (ring->next) ring->next->prev = ring->prev;
+
+    // Threads que terminaram ficam em uma fila; a mais antiga é liberada quando passa do limite.
+    ring->prev = trace_retired_tail;
+    ring->next = NULL;
+    if (trace_retired_tail) trace_retired_tail->next = ring;
+    else trace_retired_head = ring;
+    trace_retired_tail = ring;
+    TraceRing* oldest = NULL;
+    if (++trace_retired_count > TRACE_MAX_RETIRED) {
+        oldest = trace_retired_head;
+        trace_retired_head = oldest->next;
+        trace_retired_head->prev = NULL;
+        trace_retired_count--;
+    }
+    pthread_mutex_unlock(&trace_mutex);
+    free(oldest);
+}
+
+void trace_request_begin(u8 type, u64 recv_ns) {
+    if (!trace_self) return;
+    memset(trace_current, 0, sizeof(trace_current));
+    trace_current[TRACE_RECV] = recv_ns;
+    trace_current_type = type;
+}
+
+void trace_mark(trace_phase_t phase) {
+    if (!trace_self) return;
+    trace_current[phase] = stats_now_ns();
+}
+
+static double phase_ms(const u64* phases, int phase) {
+    return (double)(phases[phase] - phases[phase - 1]) / 1e6;
+}
+
+void trace_request_end(void) {
+    TraceRing* ring = trace_self;
+    if (!ring) return;
+    trace_current[TRACE_SEND] = stats_now_ns();
+    // Fases que a requisição não teve (leituras não passam pelo log, erros não têm busca) duram zero.
+    for (int phase = 1; phase < TRACE_PHASE_COUNT; ++phase) {
+        if (trace_current[phase] < trace_current[phase - 1]) trace_current[phase] = trace_current[phase - 1];
+    }
+
+    u64 index = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->writing, index, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    TraceRecord* record = &ring->records[index % TRACE_RING_SIZE];
+    for (int phase = 0; phase < TRACE_PHASE_COUNT; ++phase) {
+        atomic_store_explicit(&record->phases[phase], trace_current[phase], memory_order_relaxed);
+    }
+    atomic_store_explicit(&record->type, trace_current_type, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, index + 1, memory_order_release);
+
+    u64 total = trace_current[TRACE_SEND] - trace_current[TRACE_RECV];
+    if (trace_slow_threshold_ns && total > trace_slow_threshold_ns) {
+        LOG(WARN, "Slow request %s from client %d: %.3f ms (lookup %.3f, log %.3f, serialize %.3f, send %.3f)",
+            C2SPacket_type_name(trace_current_type), ring->client_fd, (double)total / 1e6,
+            phase_ms(trace_current, TRACE_LOOKUP), phase_ms(trace_current, TRACE_LOG),
+            phase_ms(trace_current, TRACE_SERIALIZE), phase_ms(trace_current, TRACE_SEND));
+    }
+}
+
+static void render_ring(FILE* out, TraceRing* ring, int* first) {
+    // Só usada com o trace_mutex.
+    static TraceSample copy[TRACE_RING_SIZE];
+    u64 head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    u64 start = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+    for (u64 i = start; i < head; ++i) {
+        TraceRecord* record = &ring->records[i % TRACE_RING_SIZE];
+        TraceSample* sample = &copy[i % TRACE_RING_SIZE];
+        for (int phase = 0; phase < TRACE_PHASE_COUNT; ++phase) {
+            sample->phases[phase] = atomic_load_explicit(&record->phases[phase], memory_order_relaxed);
+        }
+        sample->type = (u8)atomic_load_explicit(&record->type, memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_acquire);
+    u64 writing = atomic_load_explicit(&ring->writing, memory_order_relaxed);
+    if (writing >= TRACE_RING_SIZE && writing - TRACE_RING_SIZE + 1 > start) {
+        start = writing - TRACE_RING_SIZE + 1;
+    }
+
+    fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"client %d\"}}",
+            *first ? "" : ",\n", ring->id, ring->client_fd);
+    *first = 0;
+    for (u64 i = start; i < head; ++i) {
+        const u64* phases = copy[i % TRACE_RING_SIZE].phases;
+        const char* type = C2SPacket_type_name(copy[i % TRACE_RING_SIZE].type);
+        fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                type, phases[TRACE_RECV] / 1e3, (phases[TRACE_SEND] - phases[TRACE_RECV]) / 1e3, ring->id);
+        for (int phase = 1; phase < TRACE_PHASE_COUNT; ++phase) {
+            if (phases[phase] == phases[phase - 1]) continue;
+            fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                    trace_phase_names[phase], phases[phase - 1] / 1e3, (phases[phase] - phases[phase - 1]) / 1e3,
+                    ring->id);
+        }
+    }
+}
+
+char* trace_render_chrome(size_t* length) {
+    char* buffer = NULL;
+    FILE* out = open_memstream(&buffer, length);
+    if (!out) return NULL;
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    int first = 1;
+    pthread_mutex_lock(&trace_mutex);
+    for (TraceRing* ring = trace_retired_head; ring; ring = ring->next) render_ring(out, ring, &first);
+    for (TraceRing* ring = trace_rings; ring; ring = ring->next) render_ring(out, ring, &first);
+    pthread_mutex_unlock(&trace_mutex);
+    fprintf(out, "\n]}\n");
+
+    if (fclose(out) != 0) {
+        free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
@@ -0,0 +1,43 @@
+#ifndef _CABBAGE_TRACE_H
+#define _CABBAGE_TRACE_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include "cabbage/common/types.h"
+
+// Trace das requisições, ligado com -t no servidor.
+//
+// Cada requisição anota o horário das suas fases (fim do recv, fim da busca/varredura, registro no log confirmado,
+// resposta serializada e resposta enviada) em um ring buffer da própria thread, sem locks: só a thread dona escreve,
+// e quem lê confere o contador do ring depois de copiar para descartar registros sobrescritos. As requisições mais
+// lentas que o limite configurado são escritas no log de mensagens com o tempo de cada fase, e os rings podem ser
+// exportados no formato de trace do Chrome (GET /trace no endpoint de métricas), para abrir no chrome://tracing ou
+// no Perfetto.
+
+typedef enum {
+    TRACE_RECV,       // fim do recv da requisição (começo do trace)
+    TRACE_LOOKUP,     // fim da busca ou da varredura das entradas
+    TRACE_LOG,        // registro no log confirmado (só escritas)
+    TRACE_SERIALIZE,  // resposta serializada
+    TRACE_SEND,       // resposta enviada
+    TRACE_PHASE_COUNT
+} trace_phase_t;
+
+extern atomic_bool trace_enabled;
+
+// Liga o trace. Requisições mais lentas que 'slow_threshold_ns' são escritas no log (0 desativa).
+void trace_enable(u64 slow_threshold_ns);
+
+void trace_thread_begin(int client_fd);
+// O ring da thread é mantido entre os de threads que terminaram (até um limite) para ainda aparecer no export.
+void trace_thread_end(void);
+
+void trace_request_begin(u8 type, u64 recv_ns);
+void trace_mark(trace_phase_t phase);
+// Marca o TRACE_SEND, grava o registro e confere o limite de requisição lenta.
+void trace_request_end(void);
+
+// JSON no formato de trace do Chrome, alocado com malloc (tamanho em *length).
+char* trace_render_chrome(size_t* length);
+
+#endif // _CABBAGE_TRACE_H
@@ -0,0 +1,180 @@
+#include "upgrade.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define UPGRADE_MSG_LISTEN_FD 'F'
+#define UPGRADE_MSG_DONE 'D'
+
+static char upgrade_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static int upgrade_server_fd = -1;
+static int upgrade_conn_fd = -1;
+// Conexão com o processo antigo, no processo novo. Separada de upgrade_conn_fd porque o processo novo já aceita o
+// próximo upgrade enquanto ainda espera o antigo terminar.
+static int takeover_conn_fd = -1;
+static int upgrade_listen_fd = -1;
+static atomic_bool upgrade_handed_over;
+
+static int make_address(const char* path, struct sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "Upgrade: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+static int send_fd(int conn, int fd) {
+    char message = UPGRADE_MSG_LISTEN_FD;
+    struct iovec iov = {.iov_base = &message, .iov_len = 1};
+    union {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    return sendmsg(conn, &msg, 0) == 1 ? 0 : -1;
+}
+
+static int recv_fd(int conn, int* fd) {
+    char message;
+    struct iovec iov = {.iov_base = &message, .iov_len = 1};
+    union {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    if (recvmsg(conn, &msg, 0) != 1 || message != UPGRADE_MSG_LISTEN_FD) return -1;
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) return -1;
+    memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+    return 0;
+}
+
+static void* upgrade_main(void* arg) {
+    (void)arg;
+    while (1) {
+        int conn = accept(upgrade_server_fd, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR) continue;
+            perror("Upgrade: accept failed");
+            return NULL;
+        }
+        if (send_fd(conn, upgrade_listen_fd) < 0) {
+            perror("Upgrade: sending the listening socket failed");
+            close(conn);
+            continue;
+        }
+        printf("Upgrade: listening socket handed over, draining...\n");
+        upgrade_conn_fd = conn;
+        atomic_store(&upgrade_handed_over, true);
+        // O caminho passa a ser do processo novo.
+        close(upgrade_server_fd);
+        return NULL;
+    }
+}
+
+int upgrade_listen(const char* path, int listen_fd) {
+    struct sockaddr_un addr;
+    if (make_address(path, &addr) < 0) return -1;
+
+    upgrade_server_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (upgrade_server_fd < 0) {
+        perror("Upgrade: socket failed");
+        return -1;
+    }
+    unlink(path);
+    if (bind(upgrade_server_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(upgrade_server_fd, 1) < 0) {
+        perror("Upgrade: bind/listen failed");
+        close(upgrade_server_fd);
+        upgrade_server_fd = -1;
+        return -1;
+    }
+    snprintf(upgrade_path, sizeof(upgrade_path), "%s", path);
+    upgrade_listen_fd = listen_fd;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, upgrade_main, NULL) != 0) {
+        perror("Upgrade: pthread_create failed");
+        close(upgrade_server_fd);
+        upgrade_server_fd = -1;
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
+
+int upgrade_requested(void) {
+    return atomic_load(&upgrade_handed_over);
+}
+
+void upgrade_finish(void) {
+    if (upgrade_conn_fd < 0) return;
+    char message = UPGRADE_MSG_DONE;
+    if (write(upgrade_conn_fd, &message, 1) != 1) {
+        perror("Upgrade: notifying the new process failed");
+    }
+    close(upgrade_conn_fd);
+    upgrade_conn_fd = -1;
+}
+
+int upgrade_takeover(const char* path, int* listen_fd) {
+    struct sockaddr_un addr;
+    if (make_address(path, &addr) < 0) return -1;
+
+    int conn = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (conn < 0) {
+        perror("Upgrade: socket failed");
+        return -1;
+    }
+    if (connect(conn, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Upgrade: connect to the running server failed");
+        close(conn);
+        return -1;
+    }
+    if (recv_fd(conn, listen_fd) < 0) {
+        fprintf(stderr, "Upgrade: did not receive the listening socket\n");
+        close(conn);
+        return -1;
+    }
+    takeover_conn_fd = conn;
+    return 0;
+}
+
+int upgrade_wait_done(void) {
+    char message = 0;
+    ssize_t n;
+    do {
+        n = read(takeover_conn_fd, &message, 1);
+    } while (n < 0 && errno == EINTR);
+    close(takeover_conn_fd);
+    takeover_conn_fd = -1;
+    return (n == 1 && message == UPGRADE_MSG_DONE) ? 0 : -1;
+}
@@ -0,0 +1,27 @@
+#ifndef _CABBAGE_UPGRADE_H
+#define _CABBAGE_UPGRADE_H
+
+// Restart sem downtime: o processo novo recebe o socket de escuta do processo antigo (SCM_RIGHTS em um socket Unix),
+// então nenhuma conexão é recusada durante a troca.
+//
+//   1. o processo novo (-T <path>) carrega o snapshot e o log e fica acompanhando o log como uma réplica;
+//   2. ele conecta no socket Unix do processo antigo (-u <path>), que envia o fd de escuta e para de aceitar;
+//   3. o processo novo começa a aceitar conexões no fd recebido, atendendo as leituras com a store que acompanha o
+//      log; as mutações esperam até o passo 5;
+//   4. o processo antigo termina as requisições em andamento, fecha o log (flush + fsync) e avisa que terminou;
+//   5. o processo novo aplica o fim do log e vira o escritor.
+// Assim o accept não para durante a troca: só as mutações esperam, e apenas até o antigo fechar o log.
+
+// Processo antigo: cria o socket Unix em 'path' e uma thread que espera o processo novo.
+int upgrade_listen(const char* path, int listen_fd);
+// Verdadeiro depois que o fd de escuta foi entregue para um processo novo.
+int upgrade_requested(void);
+// Avisa o processo novo que o log já foi fechado.
+void upgrade_finish(void);
+
+// Processo novo: conecta em 'path' e recebe o fd de escuta.
+int upgrade_takeover(const char* path, int* listen_fd);
+// Espera o processo antigo terminar. Retorna 0 se ele avisou, -1 se a conexão caiu antes.
+int upgrade_wait_done(void);
+
+#endif // _CABBAGE_UPGRADE_H
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include "msglog.h"
 
 inline static const char* errmsg() {
     return strerror(errno);
@@ -0,0 +1,22 @@
+# Objetos do servidor que podem ser reutilizados por outras ferramentas (tudo menos o main, em server.c).
+SERVER_LIB =
+SERVER_LIB += $(SERVER_DIR)/cabbage/MovieEntry.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/logger.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/history.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/LogRecord.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/crc32c.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/IdIndex.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/snapshot.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/checkpoint.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/replica.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/upgrade.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/stats.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/metrics.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/msglog.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/lockprof.o
+SERVER_LIB += $(SERVER_DIR)/cabbage/trace.o
+
+$(SERVER_LIB): SERVER_FORCE
+	@$(MAKE) -C $(SERVER_DIR)
+
+SERVER_FORCE: